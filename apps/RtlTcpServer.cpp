@@ -0,0 +1,126 @@
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include <unistd.h>
+
+#include "PortSDR.h"
+#include "RtlTcpServer.h"
+
+static volatile std::sig_atomic_t g_stop = 0;
+
+static void SignalHandler(int)
+{
+    g_stop = 1;
+}
+
+static void PrintUsage(const char* name)
+{
+    std::cerr << "Usage: " << name << " [options]\n"
+        << "  -a address     listen address (default: 127.0.0.1)\n"
+        << "  -p port        listen port (default: 1234)\n"
+        << "  -d serial      device serial (default: first available)\n"
+        << "  -f frequency   center frequency in Hz (default: 100000000)\n"
+        << "  -s samplerate  sample rate in Hz (default: 2048000)\n"
+        << "  -g gain        gain in dB of the primary stage\n"
+        << "  -b size        ring buffer size in bytes\n";
+}
+
+int main(int argc, char** argv)
+{
+    std::string address = "127.0.0.1";
+    uint16_t port = 1234;
+    std::string serial;
+    uint32_t frequency = 100000000;
+    uint32_t sampleRate = 2048000;
+    double gain = -1;
+    std::size_t bufferSize = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+        if (std::strlen(arg) != 2 || arg[0] != '-' || !value)
+        {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+
+        switch (arg[1])
+        {
+        case 'a': address = value; break;
+        case 'p': port = static_cast<uint16_t>(std::strtoul(value, nullptr, 10)); break;
+        case 'd': serial = value; break;
+        case 'f': frequency = static_cast<uint32_t>(std::strtod(value, nullptr)); break;
+        case 's': sampleRate = static_cast<uint32_t>(std::strtod(value, nullptr)); break;
+        case 'g': gain = std::strtod(value, nullptr); break;
+        case 'b': bufferSize = std::strtoull(value, nullptr, 10); break;
+        default:
+            PrintUsage(argv[0]);
+            return 1;
+        }
+        i++;
+    }
+
+    PortSDR::PortSDR sdr;
+
+    std::optional<PortSDR::Device> device;
+    if (serial.empty())
+    {
+        device = sdr.GetFirstAvailableSDR();
+    }
+    else
+    {
+        for (const PortSDR::Device& dev : sdr.GetDevices())
+        {
+            if (dev.serial == serial)
+                device = dev;
+        }
+    }
+
+    if (!device)
+    {
+        std::cerr << "There are no devices" << std::endl;
+        return 1;
+    }
+
+    std::unique_ptr<PortSDR::Stream> stream;
+    if (sdr.CreateStream(*device, stream) != PortSDR::ErrorCode::OK)
+    {
+        std::cerr << "Failed to open the device" << std::endl;
+        return 1;
+    }
+
+    std::cout << "Using " << stream->GetUSBStrings().name << std::endl;
+
+    stream->SetSampleRate(sampleRate);
+    stream->SetCenterFrequency(frequency);
+
+    const auto stages = stream->GetGainStages();
+    if (gain >= 0 && !stages.empty())
+        stream->SetGain(gain, stages.back().stage);
+
+    PortSDR::RtlTcpServer server(*stream);
+    if (bufferSize > 0)
+        server.SetBufferSize(bufferSize);
+
+    if (server.Start(address, port) != PortSDR::ErrorCode::OK)
+    {
+        std::cerr << "Failed to listen on " << address << ":" << port << std::endl;
+        return 1;
+    }
+
+    std::cout << "Listening on " << address << ":" << server.GetPort() << std::endl;
+
+    std::signal(SIGINT, SignalHandler);
+    std::signal(SIGTERM, SignalHandler);
+
+    while (!g_stop)
+        pause();
+
+    server.Stop();
+    return 0;
+}
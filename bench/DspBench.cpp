@@ -0,0 +1,195 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "Channelizer.h"
+#include "dsp/Convert.h"
+#include "dsp/Cpu.h"
+#include "dsp/IQConverter.h"
+#include "dsp/Unpack.h"
+
+// Same as a libairspy transfer
+#define BENCH_SAMPLES (128 * 1024)
+#define BENCH_SECONDS 0.5
+
+struct BenchResult
+{
+    double samplesPerSecond;
+    double nsPerSample;
+};
+
+/**
+ * Runs a kernel over blocks of BENCH_SAMPLES real samples until BENCH_SECONDS have passed.
+ */
+static BenchResult Measure(const std::function<void()>& kernel)
+{
+    using clock = std::chrono::steady_clock;
+
+    // Warm up caches and the dispatch.
+    kernel();
+
+    std::size_t iterations = 0;
+    const auto start = clock::now();
+    std::chrono::duration<double> elapsed{};
+    do
+    {
+        kernel();
+        iterations++;
+        elapsed = clock::now() - start;
+    }
+    while (elapsed.count() < BENCH_SECONDS);
+
+    const double samples = static_cast<double>(iterations) * BENCH_SAMPLES;
+    return {samples / elapsed.count(), elapsed.count() * 1e9 / samples};
+}
+
+static void Print(const char* name, const BenchResult& result)
+{
+    // The AirSpy R2 produces 20 million real samples a second at 10 MSPS.
+    std::printf("%-32s %10.1f MS/s %8.3f ns/sample %6.2f%% of a core at 20 MS/s\n",
+                name,
+                result.samplesPerSecond / 1e6,
+                result.nsPerSample,
+                20e6 / result.samplesPerSecond * 100.0);
+}
+
+int main()
+{
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<int> dist(0, 4095);
+
+    std::vector<uint16_t> raw(BENCH_SAMPLES);
+    for (auto& sample : raw)
+        sample = static_cast<uint16_t>(dist(rng));
+
+    std::vector<uint8_t> packed(BENCH_SAMPLES / 8 * 12);
+    for (std::size_t i = 0, j = 0; i < raw.size(); i += 8, j += 12)
+    {
+        const uint16_t* x = &raw[i];
+        const uint32_t words[3] = {
+            static_cast<uint32_t>(x[0] << 20 | x[1] << 8 | x[2] >> 4),
+            static_cast<uint32_t>((x[2] & 0xf) << 28 | x[3] << 16 | x[4] << 4 | x[5] >> 8),
+            static_cast<uint32_t>((x[5] & 0xff) << 24 | x[6] << 12 | x[7]),
+        };
+        std::memcpy(&packed[j], words, sizeof(words));
+    }
+
+    std::vector<int16_t> real(BENCH_SAMPLES);
+    std::vector<float> iq(BENCH_SAMPLES);
+    PortSDR::IQConverter scalar(false);
+    PortSDR::IQConverter converter;
+
+    std::printf("AVX2: %s SSSE3: %s\n",
+                PortSDR::CpuHasAvx2() ? "yes" : "no",
+                PortSDR::CpuHasSsse3() ? "yes" : "no");
+    std::printf("USB: unpacked %.1f MB/s, packed %.1f MB/s at 20 MS/s\n\n",
+                20e6 * 2 / 1e6,
+                20e6 * 1.5 / 1e6);
+
+    Print("unpacked 16-bit to int16", Measure([&]
+    {
+        PortSDR::ConvertAirSpy12(raw.data(), real.data(), BENCH_SAMPLES);
+    }));
+    Print("packed 12-bit to int16 (scalar)", Measure([&]
+    {
+        PortSDR::UnpackAirSpy12Scalar(packed.data(), real.data(), BENCH_SAMPLES);
+    }));
+    Print("packed 12-bit to int16", Measure([&]
+    {
+        PortSDR::UnpackAirSpy12(packed.data(), real.data(), BENCH_SAMPLES);
+    }));
+
+    // The DDC replaces libairspy's converter, which runs on its own thread for every device.
+    for (const auto format : {PortSDR::SAMPLE_FORMAT_IQ_INT16, PortSDR::SAMPLE_FORMAT_IQ_FLOAT32})
+    {
+        const char* name = format == PortSDR::SAMPLE_FORMAT_IQ_INT16 ? "int16" : "float32";
+        char label[64];
+
+        std::snprintf(label, sizeof(label), "DDC to IQ %s (scalar)", name);
+        Print(label, Measure([&]
+        {
+            scalar.Process(real.data(), BENCH_SAMPLES, format, iq.data());
+        }));
+
+        std::snprintf(label, sizeof(label), "DDC to IQ %s", name);
+        Print(label, Measure([&]
+        {
+            converter.Process(real.data(), BENCH_SAMPLES, format, iq.data());
+        }));
+    }
+
+    // ReadInto() converts straight from the transfer, instead of copying it out first.
+    std::vector<uint8_t> transfer(BENCH_SAMPLES);
+    std::vector<uint8_t> copy(BENCH_SAMPLES);
+    for (std::size_t i = 0; i < transfer.size(); i++)
+        transfer[i] = static_cast<uint8_t>(raw[i]);
+
+    std::printf("\n");
+    Print("uint8 copy then to float32", Measure([&]
+    {
+        std::memcpy(copy.data(), transfer.data(), BENCH_SAMPLES);
+        PortSDR::ConvertSamples(copy.data(), PortSDR::SAMPLE_FORMAT_IQ_UINT8,
+                                iq.data(), PortSDR::SAMPLE_FORMAT_IQ_FLOAT32, BENCH_SAMPLES);
+    }));
+    Print("uint8 fused to float32", Measure([&]
+    {
+        PortSDR::ConvertSamples(transfer.data(), PortSDR::SAMPLE_FORMAT_IQ_UINT8,
+                                iq.data(), PortSDR::SAMPLE_FORMAT_IQ_FLOAT32, BENCH_SAMPLES);
+    }));
+
+    // SAMPLE_LAYOUT_PLANAR splits I and Q in the same pass, instead of a shuffle pass by the consumer.
+    std::vector<float> planeI(BENCH_SAMPLES / 2);
+    std::vector<float> planeQ(BENCH_SAMPLES / 2);
+    Print("uint8 to float32 then split", Measure([&]
+    {
+        PortSDR::ConvertSamples(transfer.data(), PortSDR::SAMPLE_FORMAT_IQ_UINT8,
+                                iq.data(), PortSDR::SAMPLE_FORMAT_IQ_FLOAT32, BENCH_SAMPLES);
+        for (std::size_t i = 0; i < BENCH_SAMPLES / 2; i++)
+        {
+            planeI[i] = iq[2 * i];
+            planeQ[i] = iq[2 * i + 1];
+        }
+    }));
+    Print("uint8 fused to planar float32", Measure([&]
+    {
+        PortSDR::ConvertSamplesPlanar(transfer.data(), PortSDR::SAMPLE_FORMAT_IQ_UINT8,
+                                      planeI.data(), planeQ.data(), PortSDR::SAMPLE_FORMAT_IQ_FLOAT32, BENCH_SAMPLES);
+    }));
+
+    // A 10 MSPS stream split into channels, the cost per sample barely depends on the amount of channels.
+    std::printf("\n");
+    std::vector<std::size_t> threadCounts = {1};
+    if (std::thread::hardware_concurrency() > 1)
+        threadCounts.push_back(std::thread::hardware_concurrency());
+
+    for (const std::size_t channels : {64, 256, 1024})
+    {
+        for (const std::size_t count : threadCounts)
+        {
+            PortSDR::ChannelizerConfig config;
+            config.channels = channels;
+            config.threads = count;
+
+            PortSDR::Channelizer channelizer;
+            channelizer.Create(config);
+
+            PortSDR::SDRTransfer block{};
+            block.data = iq.data();
+            block.frame_size = BENCH_SAMPLES / 2;
+            block.format = PortSDR::SAMPLE_FORMAT_IQ_FLOAT32;
+
+            char label[64];
+            std::snprintf(label, sizeof(label), "PFB %zu channels, %zu threads", channels, count);
+            Print(label, Measure([&]
+            {
+                channelizer.Process(block);
+            }));
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,847 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "PortSDR.h"
+#include "dsp/Convert.h"
+
+#ifdef LATENCY_BENCH_RTLTCP
+#include "RtlTcpServer.h"
+#endif
+#ifdef LATENCY_BENCH_RTLSDR
+#include "vendors/RTLSDR.h"
+#endif
+#ifdef LATENCY_BENCH_AIRSPY
+#include "vendors/AirSpy.h"
+#endif
+
+// Values of the marker at the start of every replayed transfer: sync, then the timestamp in nibbles
+#define MARKER_SYNC_VALUES 4
+#define MARKER_NIBBLES 16
+#define MARKER_VALUES (MARKER_SYNC_VALUES + MARKER_NIBBLES)
+#define MARKER_FILL 0x80
+// Nibbles are spread out, so conversions between formats don't change them
+#define MARKER_NIBBLE_BASE 0x40
+#define MARKER_NIBBLE_STEP 8
+// Markers ignored while the stream warms up
+#define WARMUP_MARKERS 8
+
+static int64_t Now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * Paces a signal like hardware: a buffer is handed on once its last sample would have left the ADC.
+ * The first values of every buffer carry the time its first sample left the ADC.
+ */
+class Replayer
+{
+public:
+    Replayer(const PortSDR::SampleFormat format, const std::size_t frameSize)
+        : m_format(format), m_frameSize(frameSize)
+    {
+        std::vector<uint8_t> fill(frameSize * 2, MARKER_FILL);
+        m_buffer.resize(frameSize * PortSDR::GetSampleSize(format));
+        PortSDR::ConvertFromUInt8(fill.data(), format, m_buffer.data(), fill.size());
+    }
+
+    /**
+     * Hands on buffers of frameSize IQ samples until running is cleared.
+     * @param deliver called with every buffer on the calling thread.
+     */
+    template <typename Deliver>
+    void Run(const uint32_t sampleRate, const std::atomic<bool>& running, Deliver&& deliver)
+    {
+        const int64_t start = Now();
+        uint64_t index = 0;
+
+        while (running)
+        {
+            const int64_t adcTime = start + static_cast<int64_t>(index * 1e9 / sampleRate);
+            index += m_frameSize;
+            const int64_t complete = start + static_cast<int64_t>(index * 1e9 / sampleRate);
+
+            std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::nanoseconds(complete)));
+
+            uint8_t marker[MARKER_VALUES] = {0x00, 0xff, 0x00, 0xff};
+            for (int i = 0; i < MARKER_NIBBLES; i++)
+            {
+                const auto nibble = static_cast<uint8_t>(static_cast<uint64_t>(adcTime) >> (60 - i * 4) & 0xf);
+                marker[MARKER_SYNC_VALUES + i] = MARKER_NIBBLE_BASE + nibble * MARKER_NIBBLE_STEP;
+            }
+            PortSDR::ConvertFromUInt8(marker, m_format, m_buffer.data(), MARKER_VALUES);
+
+            deliver(m_buffer.data());
+        }
+    }
+
+private:
+    PortSDR::SampleFormat m_format;
+    std::size_t m_frameSize;
+    std::vector<uint8_t> m_buffer;
+};
+
+/**
+ * Replays the signal straight through Deliver().
+ */
+class ReplayStream final : public PortSDR::Stream
+{
+public:
+    ReplayStream(const PortSDR::SampleFormat format, const std::size_t frameSize)
+        : m_format(format), m_frameSize(frameSize), m_replayer(format, frameSize)
+    {
+    }
+
+    ~ReplayStream() override
+    {
+        StopCommands();
+        Stop();
+    }
+
+    PortSDR::DeviceInfo GetUSBStrings() override
+    {
+        return {"Replay", "REPLAY01"};
+    }
+
+    PortSDR::ErrorCode Start() override
+    {
+        if (m_thread.joinable())
+            return PortSDR::ErrorCode::OK;
+
+        m_running = true;
+        m_thread = std::thread(&ReplayStream::Process, this);
+        return PortSDR::ErrorCode::OK;
+    }
+
+    PortSDR::ErrorCode Stop() override
+    {
+        if (!m_thread.joinable())
+            return PortSDR::ErrorCode::INVALID_ARGUMENT;
+
+        CancelReads();
+
+        m_running = false;
+        m_thread.join();
+        return PortSDR::ErrorCode::OK;
+    }
+
+    PortSDR::ErrorCode SetSampleRate(const uint32_t sampleRate) override
+    {
+        m_sampleRate = sampleRate;
+        return PortSDR::ErrorCode::OK;
+    }
+
+    PortSDR::ErrorCode SetCenterFrequency(const uint32_t freq) override
+    {
+        m_freq = freq;
+        return PortSDR::ErrorCode::OK;
+    }
+
+    PortSDR::ErrorCode SetSampleFormat(const PortSDR::SampleFormat format) override
+    {
+        return format == m_format ? PortSDR::ErrorCode::OK : PortSDR::ErrorCode::INVALID_ARGUMENT;
+    }
+
+    PortSDR::ErrorCode SetGain(double, std::string_view) override
+    {
+        return PortSDR::ErrorCode::OK;
+    }
+
+    PortSDR::ErrorCode SetGainMode(PortSDR::GainMode) override
+    {
+        return PortSDR::ErrorCode::OK;
+    }
+
+    [[nodiscard]] std::vector<uint32_t> GetSampleRates() const override
+    {
+        return {m_sampleRate};
+    }
+
+    [[nodiscard]] std::vector<PortSDR::SampleFormat> GetSampleFormats() const override
+    {
+        return {m_format};
+    }
+
+    [[nodiscard]] std::vector<PortSDR::GainMode> GetGainModes() const override
+    {
+        return {PortSDR::GAIN_MODE_FREE};
+    }
+
+    [[nodiscard]] std::vector<PortSDR::Gain> GetGainStages(PortSDR::GainMode) const override
+    {
+        return {{"LNA", PortSDR::MetaRange{0, 49, 1}}};
+    }
+
+    [[nodiscard]] uint32_t GetCenterFrequency() const override
+    {
+        return m_freq;
+    }
+
+    [[nodiscard]] uint32_t GetSampleRate() const override
+    {
+        return m_sampleRate;
+    }
+
+    [[nodiscard]] double GetGain(std::string_view) const override
+    {
+        return 0;
+    }
+
+    [[nodiscard]] PortSDR::GainMode GetGainMode() const override
+    {
+        return PortSDR::GAIN_MODE_FREE;
+    }
+
+private:
+    void Process()
+    {
+        m_replayer.Run(m_sampleRate, m_running, [this](uint8_t* data)
+        {
+            PortSDR::SDRTransfer transfer{};
+            transfer.data = data;
+            transfer.frame_size = m_frameSize;
+            transfer.format = m_format;
+            Deliver(transfer);
+        });
+    }
+
+    PortSDR::SampleFormat m_format;
+    std::size_t m_frameSize;
+    Replayer m_replayer;
+
+    std::thread m_thread;
+    std::atomic<bool> m_running{false};
+    std::atomic<uint32_t> m_sampleRate{2048000};
+    std::atomic<uint32_t> m_freq{100000000};
+};
+
+#if defined(LATENCY_BENCH_RTLSDR) || defined(LATENCY_BENCH_AIRSPY)
+/**
+ * Stands in for the vendor libraries behind the function tables of the backends, one device replaying the signal.
+ * Transfers have the size of the run, not the size of the buffers the backend asks for.
+ */
+struct StubDevice
+{
+    PortSDR::SampleFormat format = PortSDR::SAMPLE_FORMAT_IQ_UINT8;
+    std::size_t frames = 0;
+    std::atomic<uint32_t> sampleRate{2048000};
+    std::atomic<bool> streaming{false};
+    std::thread thread; // Receiving thread of libairspy
+
+    static StubDevice& Get()
+    {
+        static StubDevice device;
+        return device;
+    }
+};
+#endif
+
+#ifdef LATENCY_BENCH_RTLSDR
+#define STUB_RTLSDR_SERIAL "00000001"
+
+static const PortSDR::RTLApi& StubRtlApi()
+{
+    static const PortSDR::RTLApi api = []
+    {
+        PortSDR::RTLApi table{};
+        table.get_device_count = []() -> uint32_t { return 1; };
+        table.get_device_usb_strings = [](uint32_t, char*, char*, char* serial)
+        {
+            std::strcpy(serial, STUB_RTLSDR_SERIAL);
+            return 0;
+        };
+        table.get_index_by_serial = [](const char*) { return 0; };
+        table.open = [](rtlsdr_dev_t** dev, uint32_t)
+        {
+            // Never dereferenced, only handed back to the stubs.
+            *dev = reinterpret_cast<rtlsdr_dev_t*>(&StubDevice::Get());
+            return 0;
+        };
+        table.close = [](rtlsdr_dev_t*) { return 0; };
+        table.get_usb_strings = [](rtlsdr_dev_t*, char* manufact, char* product, char* serial)
+        {
+            std::strcpy(manufact, "Stub");
+            std::strcpy(product, "RTL2838");
+            std::strcpy(serial, STUB_RTLSDR_SERIAL);
+            return 0;
+        };
+        table.set_offset_tuning = [](rtlsdr_dev_t*, int) { return 0; };
+        table.reset_buffer = [](rtlsdr_dev_t*) { return 0; };
+        table.set_center_freq = [](rtlsdr_dev_t*, uint32_t) { return 0; };
+        table.set_sample_rate = [](rtlsdr_dev_t*, const uint32_t rate)
+        {
+            StubDevice::Get().sampleRate = rate;
+            return 0;
+        };
+        table.get_tuner_type = [](rtlsdr_dev_t*) { return RTLSDR_TUNER_R820T; };
+        table.get_tuner_gains = [](rtlsdr_dev_t*, int* gains)
+        {
+            if (gains)
+                gains[0] = 0;
+            return 1;
+        };
+        table.set_tuner_gain = [](rtlsdr_dev_t*, int) { return 0; };
+        table.set_tuner_if_gain = [](rtlsdr_dev_t*, int, int) { return 0; };
+        table.read_async = [](rtlsdr_dev_t*, const rtlsdr_read_async_cb_t callback, void* ctx, uint32_t, uint32_t)
+        {
+            // Blocks on the thread of the backend like librtlsdr, until cancelled from the callback or Stop().
+            StubDevice& device = StubDevice::Get();
+            Replayer replayer(PortSDR::SAMPLE_FORMAT_IQ_UINT8, device.frames);
+            device.streaming = true;
+            replayer.Run(device.sampleRate, device.streaming, [&device, callback, ctx](uint8_t* data)
+            {
+                callback(data, static_cast<uint32_t>(device.frames * 2), ctx);
+            });
+            return 0;
+        };
+        table.cancel_async = [](rtlsdr_dev_t*)
+        {
+            StubDevice::Get().streaming = false;
+            return 0;
+        };
+        return table;
+    }();
+    return api;
+}
+#endif
+
+#ifdef LATENCY_BENCH_AIRSPY
+#define STUB_AIRSPY_SERIAL 0x1ULL
+
+static const PortSDR::AirSpyApi& StubAirSpyApi()
+{
+    static const PortSDR::AirSpyApi api = []
+    {
+        PortSDR::AirSpyApi table{};
+        table.list_devices = [](uint64_t* serials, const int count)
+        {
+            if (serials && count > 0)
+                serials[0] = STUB_AIRSPY_SERIAL;
+            return 1;
+        };
+        table.open_sn = [](airspy_device** device, uint64_t)
+        {
+            // Never dereferenced, only handed back to the stubs.
+            *device = reinterpret_cast<airspy_device*>(&StubDevice::Get());
+            return static_cast<int>(AIRSPY_SUCCESS);
+        };
+        table.close = [](airspy_device*) { return static_cast<int>(AIRSPY_SUCCESS); };
+        table.board_id_read = [](airspy_device*, uint8_t* value)
+        {
+            *value = AIRSPY_BOARD_ID_PROTO_AIRSPY;
+            return static_cast<int>(AIRSPY_SUCCESS);
+        };
+        table.board_id_name = [](airspy_board_id) { return "AIRSPY"; };
+        table.board_partid_serialno_read = [](airspy_device*, airspy_read_partid_serialno_t* read)
+        {
+            *read = {};
+            read->serial_no[3] = static_cast<uint32_t>(STUB_AIRSPY_SERIAL);
+            return static_cast<int>(AIRSPY_SUCCESS);
+        };
+        table.get_samplerates = [](airspy_device*, uint32_t* buffer, const uint32_t len)
+        {
+            if (len == 0)
+                *buffer = 1;
+            else
+                *buffer = StubDevice::Get().sampleRate;
+            return static_cast<int>(AIRSPY_SUCCESS);
+        };
+        table.set_samplerate = [](airspy_device*, const uint32_t rate)
+        {
+            StubDevice::Get().sampleRate = rate;
+            return static_cast<int>(AIRSPY_SUCCESS);
+        };
+        table.set_sample_type = [](airspy_device*, const airspy_sample_type type)
+        {
+            // Only the IQ types, real samples would take the converter of the backend.
+            if (type == AIRSPY_SAMPLE_INT16_IQ)
+                StubDevice::Get().format = PortSDR::SAMPLE_FORMAT_IQ_INT16;
+            else if (type == AIRSPY_SAMPLE_FLOAT32_IQ)
+                StubDevice::Get().format = PortSDR::SAMPLE_FORMAT_IQ_FLOAT32;
+            else
+                return static_cast<int>(AIRSPY_ERROR_INVALID_PARAM);
+            return static_cast<int>(AIRSPY_SUCCESS);
+        };
+        table.set_packing = [](airspy_device*, uint8_t) { return static_cast<int>(AIRSPY_SUCCESS); };
+        table.set_freq = [](airspy_device*, uint32_t) { return static_cast<int>(AIRSPY_SUCCESS); };
+        table.set_lna_gain = [](airspy_device*, uint8_t) { return static_cast<int>(AIRSPY_SUCCESS); };
+        table.set_mixer_gain = [](airspy_device*, uint8_t) { return static_cast<int>(AIRSPY_SUCCESS); };
+        table.set_vga_gain = [](airspy_device*, uint8_t) { return static_cast<int>(AIRSPY_SUCCESS); };
+        table.set_linearity_gain = [](airspy_device*, uint8_t) { return static_cast<int>(AIRSPY_SUCCESS); };
+        table.set_sensitivity_gain = [](airspy_device*, uint8_t) { return static_cast<int>(AIRSPY_SUCCESS); };
+        table.start_rx = [](airspy_device* handle, const airspy_sample_block_cb_fn callback, void* ctx)
+        {
+            // libairspy calls back from a thread of its own.
+            StubDevice& device = StubDevice::Get();
+            if (device.thread.joinable())
+                return static_cast<int>(AIRSPY_ERROR_BUSY);
+
+            device.streaming = true;
+            device.thread = std::thread([&device, handle, callback, ctx]
+            {
+                Replayer replayer(device.format, device.frames);
+                replayer.Run(device.sampleRate, device.streaming, [&](uint8_t* data)
+                {
+                    airspy_transfer transfer{};
+                    transfer.device = handle;
+                    transfer.ctx = ctx;
+                    transfer.samples = data;
+                    transfer.sample_count = static_cast<int>(device.frames);
+                    transfer.sample_type = device.format == PortSDR::SAMPLE_FORMAT_IQ_INT16
+                                               ? AIRSPY_SAMPLE_INT16_IQ
+                                               : AIRSPY_SAMPLE_FLOAT32_IQ;
+                    callback(&transfer);
+                });
+            });
+            return static_cast<int>(AIRSPY_SUCCESS);
+        };
+        table.stop_rx = [](airspy_device*)
+        {
+            StubDevice& device = StubDevice::Get();
+            device.streaming = false;
+            if (device.thread.joinable())
+                device.thread.join();
+            return static_cast<int>(AIRSPY_SUCCESS);
+        };
+        table.is_streaming = [](airspy_device*)
+        {
+            return static_cast<int>(StubDevice::Get().streaming ? AIRSPY_TRUE : AIRSPY_SUCCESS);
+        };
+        return table;
+    }();
+    return api;
+}
+#endif
+
+/**
+ * Finds the markers in the received values, also when they are split between transfers.
+ */
+class MarkerScanner
+{
+public:
+    void Scan(const uint8_t* values, const std::size_t count, const int64_t received)
+    {
+        for (std::size_t i = 0; i < count; i++)
+        {
+            const uint8_t value = values[i];
+
+            if (m_nibbles >= 0)
+            {
+                const int nibble = std::clamp((value - MARKER_NIBBLE_BASE + MARKER_NIBBLE_STEP / 2) / MARKER_NIBBLE_STEP,
+                                              0, 15);
+                m_timestamp = m_timestamp << 4 | static_cast<uint64_t>(nibble);
+
+                if (++m_nibbles == MARKER_NIBBLES)
+                {
+                    if (m_markers++ >= WARMUP_MARKERS)
+                        m_latencies.push_back(static_cast<double>(received - static_cast<int64_t>(m_timestamp)) / 1e3);
+                    m_nibbles = -1;
+                }
+                continue;
+            }
+
+            // Sync is low, high, low, high. Converted values may be off by one.
+            const bool high = value >= 0xf8;
+            const bool low = value <= 0x07;
+            if ((m_sync % 2 == 0 && low) || (m_sync % 2 == 1 && high))
+                m_sync++;
+            else
+                m_sync = low ? 1 : 0;
+
+            if (m_sync == MARKER_SYNC_VALUES)
+            {
+                m_sync = 0;
+                m_nibbles = 0;
+                m_timestamp = 0;
+            }
+        }
+    }
+
+    std::vector<double>& GetLatencies()
+    {
+        return m_latencies;
+    }
+
+private:
+    int m_sync = 0;
+    int m_nibbles = -1;
+    uint64_t m_timestamp = 0;
+    uint64_t m_markers = 0;
+    std::vector<double> m_latencies; // Microseconds
+};
+
+struct RunConfig
+{
+    std::string backend;
+    PortSDR::SampleFormat format;
+    std::size_t frames;
+    uint32_t sampleRate;
+    double seconds;
+    std::size_t load;
+    bool read;
+};
+
+struct RunResult
+{
+    std::size_t count = 0;
+    double p50 = 0;
+    double p99 = 0;
+    double p999 = 0;
+    double max = 0;
+    double jitter = 0;
+    bool skipped = false; // The backend doesn't offer the format
+};
+
+static const char* FormatName(const PortSDR::SampleFormat format)
+{
+    switch (format)
+    {
+    case PortSDR::SAMPLE_FORMAT_IQ_UINT8:
+        return "uint8";
+    case PortSDR::SAMPLE_FORMAT_IQ_INT16:
+        return "int16";
+    case PortSDR::SAMPLE_FORMAT_IQ_FLOAT32:
+        return "float32";
+    }
+    return "unknown";
+}
+
+static RunResult Summarize(std::vector<double>& latencies)
+{
+    RunResult result;
+    result.count = latencies.size();
+    if (latencies.empty())
+        return result;
+
+    std::sort(latencies.begin(), latencies.end());
+    const auto percentile = [&latencies](const double p)
+    {
+        const auto index = static_cast<std::size_t>(std::ceil(p * latencies.size())) - 1;
+        return latencies[std::min(index, latencies.size() - 1)];
+    };
+
+    double sum = 0;
+    for (const double latency : latencies)
+        sum += latency;
+    const double mean = sum / latencies.size();
+
+    double variance = 0;
+    for (const double latency : latencies)
+        variance += (latency - mean) * (latency - mean);
+
+    result.p50 = percentile(0.5);
+    result.p99 = percentile(0.99);
+    result.p999 = percentile(0.999);
+    result.max = latencies.back();
+    result.jitter = std::sqrt(variance / latencies.size());
+    return result;
+}
+
+/**
+ * Receives from a stream through the callback or ReadInto() until the time is up.
+ */
+static std::vector<double> Receive(PortSDR::Stream& stream, const RunConfig& config)
+{
+    MarkerScanner scanner;
+    std::vector<uint8_t> converted;
+    std::mutex mutex;
+
+    if (!config.read)
+    {
+        stream.SetCallback([&](const PortSDR::SDRTransfer& transfer)
+        {
+            // Taken first, the conversion for the scanner isn't part of the latency.
+            const int64_t received = Now();
+            const std::size_t count = transfer.frame_size * 2;
+
+            std::lock_guard lock(mutex);
+            if (transfer.format == PortSDR::SAMPLE_FORMAT_IQ_UINT8)
+            {
+                scanner.Scan(static_cast<const uint8_t*>(transfer.data), count, received);
+                return;
+            }
+
+            converted.resize(count);
+            PortSDR::ConvertToUInt8(transfer.data, transfer.format, converted.data(), count);
+            scanner.Scan(converted.data(), count, received);
+        });
+    }
+
+    if (stream.Start() != PortSDR::ErrorCode::OK)
+        return {};
+
+    const auto end = std::chrono::steady_clock::now() + std::chrono::duration<double>(config.seconds);
+    if (config.read)
+    {
+        std::vector<uint8_t> buffer(config.frames * 2);
+        while (std::chrono::steady_clock::now() < end)
+        {
+            std::size_t frames = 0;
+            if (stream.ReadInto(PortSDR::Span<uint8_t>(buffer), frames) != PortSDR::ErrorCode::OK)
+                break;
+            scanner.Scan(buffer.data(), frames * 2, Now());
+        }
+    }
+    else
+    {
+        std::this_thread::sleep_until(end);
+    }
+
+    stream.Stop();
+    stream.SetCallback([](const PortSDR::SDRTransfer&)
+    {
+    });
+
+    std::lock_guard lock(mutex);
+    return std::move(scanner.GetLatencies());
+}
+
+static bool Run(const RunConfig& config, RunResult& result)
+{
+    std::vector<double> latencies;
+
+    if (config.backend == "replay")
+    {
+        ReplayStream stream(config.format, config.frames);
+        stream.SetSampleRate(config.sampleRate);
+        latencies = Receive(stream, config);
+    }
+#ifdef LATENCY_BENCH_RTLTCP
+    else if (config.backend == "rtltcp")
+    {
+        // rtl_tcp carries 8-bit values, the client converts them into the format.
+        ReplayStream remote(PortSDR::SAMPLE_FORMAT_IQ_UINT8, config.frames);
+        remote.SetSampleRate(config.sampleRate);
+
+        PortSDR::RtlTcpServer server(remote);
+        if (server.Start("127.0.0.1", 0) != PortSDR::ErrorCode::OK)
+            return false;
+
+        PortSDR::Device device;
+        device.type = PortSDR::HostType::RTL_TCP;
+        device.serial = "127.0.0.1:" + std::to_string(server.GetPort());
+
+        PortSDR::PortSDR sdr;
+        std::unique_ptr<PortSDR::Stream> stream;
+        if (sdr.CreateStream(device, stream) != PortSDR::ErrorCode::OK
+            || stream->SetSampleFormat(config.format) != PortSDR::ErrorCode::OK)
+            return false;
+
+        latencies = Receive(*stream, config);
+        server.Stop();
+    }
+#endif
+#ifdef LATENCY_BENCH_RTLSDR
+    else if (config.backend == "rtlsdr")
+    {
+        StubDevice::Get().frames = config.frames;
+
+        PortSDR::Device device;
+        device.type = PortSDR::HostType::RTL_SDR;
+        device.serial = STUB_RTLSDR_SERIAL;
+
+        PortSDR::RTLStream stream(StubRtlApi());
+        if (stream.Initialize(device) != PortSDR::ErrorCode::OK
+            || stream.SetSampleRate(config.sampleRate) != PortSDR::ErrorCode::OK)
+            return false;
+
+        if (stream.SetSampleFormat(config.format) != PortSDR::ErrorCode::OK)
+        {
+            result.skipped = true;
+            return true;
+        }
+        latencies = Receive(stream, config);
+    }
+#endif
+#ifdef LATENCY_BENCH_AIRSPY
+    else if (config.backend == "airspy")
+    {
+        StubDevice::Get().frames = config.frames;
+
+        PortSDR::Device device;
+        device.type = PortSDR::HostType::AIRSPY;
+        device.serial = "0000000000000001";
+
+        PortSDR::AirSpyStream stream(StubAirSpyApi());
+        if (stream.Initialize(device) != PortSDR::ErrorCode::OK
+            || stream.SetSampleRate(config.sampleRate) != PortSDR::ErrorCode::OK)
+            return false;
+
+        if (stream.SetSampleFormat(config.format) != PortSDR::ErrorCode::OK)
+        {
+            result.skipped = true;
+            return true;
+        }
+        latencies = Receive(stream, config);
+    }
+#endif
+    else
+    {
+        return false;
+    }
+
+    result = Summarize(latencies);
+    return result.count > 0;
+}
+
+static void PrintUsage(const char* name)
+{
+    std::fprintf(stderr,
+                 "Usage: %s [options]\n"
+                 "  -b backends    replay,rtltcp,rtlsdr,airspy (default: all that are built)\n"
+                 "  -f formats     uint8,int16,float32 (default: all)\n"
+                 "  -n frames      samples per transfer (default: 4096,16384,65536)\n"
+                 "  -s samplerate  sample rate in Hz (default: 2048000)\n"
+                 "  -t seconds     duration of every run (default: 2)\n"
+                 "  -l threads     busy threads loading the CPU meanwhile (default: 0)\n"
+                 "  -m mode        callback or read, ReadInto() from another thread (default: callback)\n"
+                 "  -g us          exit with 2 if any p99 latency exceeds this\n"
+                 "Prints one JSON object per run, latencies in microseconds from the ADC to the consumer.\n",
+                 name);
+}
+
+static std::vector<std::string> Split(const std::string& list)
+{
+    std::vector<std::string> items;
+    std::size_t start = 0;
+    while (start <= list.size())
+    {
+        const std::size_t end = std::min(list.find(',', start), list.size());
+        if (end > start)
+            items.push_back(list.substr(start, end - start));
+        start = end + 1;
+    }
+    return items;
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> backends = {"replay"};
+#ifdef LATENCY_BENCH_RTLTCP
+    backends.emplace_back("rtltcp");
+#endif
+#ifdef LATENCY_BENCH_RTLSDR
+    backends.emplace_back("rtlsdr");
+#endif
+#ifdef LATENCY_BENCH_AIRSPY
+    backends.emplace_back("airspy");
+#endif
+    std::vector<std::string> formats = {"uint8", "int16", "float32"};
+    std::vector<std::string> frameSizes = {"4096", "16384", "65536"};
+    uint32_t sampleRate = 2048000;
+    double seconds = 2;
+    std::size_t load = 0;
+    bool read = false;
+    double gate = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+        if (std::strlen(arg) != 2 || arg[0] != '-' || !value)
+        {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+
+        switch (arg[1])
+        {
+        case 'b': backends = Split(value); break;
+        case 'f': formats = Split(value); break;
+        case 'n': frameSizes = Split(value); break;
+        case 's': sampleRate = static_cast<uint32_t>(std::strtod(value, nullptr)); break;
+        case 't': seconds = std::strtod(value, nullptr); break;
+        case 'l': load = std::strtoull(value, nullptr, 10); break;
+        case 'm': read = std::strcmp(value, "read") == 0; break;
+        case 'g': gate = std::strtod(value, nullptr); break;
+        default:
+            PrintUsage(argv[0]);
+            return 1;
+        }
+        i++;
+    }
+
+    // Competes with the stream threads for the CPU.
+    std::atomic<bool> loading{true};
+    std::vector<std::thread> loadThreads;
+    for (std::size_t i = 0; i < load; i++)
+    {
+        loadThreads.emplace_back([&loading]
+        {
+            volatile double x = 1.0;
+            while (loading.load(std::memory_order_relaxed))
+                x = std::sqrt(x + 1.0);
+        });
+    }
+
+    bool passed = true;
+    for (const std::string& backend : backends)
+    {
+        for (const std::string& formatName : formats)
+        {
+            PortSDR::SampleFormat format;
+            if (formatName == "uint8")
+                format = PortSDR::SAMPLE_FORMAT_IQ_UINT8;
+            else if (formatName == "int16")
+                format = PortSDR::SAMPLE_FORMAT_IQ_INT16;
+            else if (formatName == "float32")
+                format = PortSDR::SAMPLE_FORMAT_IQ_FLOAT32;
+            else
+                continue;
+
+            for (const std::string& frames : frameSizes)
+            {
+                const RunConfig config{backend, format, std::strtoull(frames.c_str(), nullptr, 10),
+                                       sampleRate, seconds, load, read};
+                if (config.frames < MARKER_VALUES)
+                    continue;
+
+                RunResult result;
+                if (!Run(config, result))
+                {
+                    std::fprintf(stderr, "%s %s %zu: no samples received\n",
+                                 backend.c_str(), FormatName(format), config.frames);
+                    passed = false;
+                    continue;
+                }
+                if (result.skipped)
+                {
+                    std::fprintf(stderr, "%s %s %zu: format not offered by the backend, skipped\n",
+                                 backend.c_str(), FormatName(format), config.frames);
+                    continue;
+                }
+
+                // A sample waits for the rest of its transfer to fill up, that's part of the latency.
+                std::printf("{\"backend\":\"%s\",\"format\":\"%s\",\"frames\":%zu,\"sample_rate\":%u,"
+                            "\"mode\":\"%s\",\"load\":%zu,\"transfers\":%zu,\"fill_us\":%.1f,"
+                            "\"p50_us\":%.1f,\"p99_us\":%.1f,\"p999_us\":%.1f,\"max_us\":%.1f,\"jitter_us\":%.1f}\n",
+                            backend.c_str(), FormatName(format), config.frames, sampleRate,
+                            read ? "read" : "callback", load, result.count,
+                            config.frames * 1e6 / sampleRate,
+                            result.p50, result.p99, result.p999, result.max, result.jitter);
+                std::fflush(stdout);
+
+                if (gate > 0 && result.p99 > gate)
+                    passed = false;
+            }
+        }
+    }
+
+    loading = false;
+    for (std::thread& thread : loadThreads)
+        thread.join();
+
+    return passed ? 0 : 2;
+}
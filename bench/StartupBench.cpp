@@ -0,0 +1,102 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "PortSDR.h"
+
+struct HostName
+{
+    const char* name;
+    PortSDR::HostType type;
+};
+
+static const HostName kHosts[] = {
+    {"rtlsdr", PortSDR::HostType::RTL_SDR},
+    {"airspy", PortSDR::HostType::AIRSPY},
+    {"airspyhf", PortSDR::HostType::AIRSPY_HF},
+    {"rtltcp", PortSDR::HostType::RTL_TCP},
+};
+
+static double ElapsedUs(const std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void PrintUsage(const char* name)
+{
+    std::fprintf(stderr,
+                 "Usage: %s [options]\n"
+                 "  -t host    rtlsdr, airspy, airspyhf or rtltcp, the host that is used (default: rtlsdr)\n"
+                 "  -e         load every host first, like an instance that built all of them up front\n"
+                 "Prints one JSON object, times in microseconds since main() was entered.\n"
+                 "Run it in a fresh process for every sample, the vendor libraries are only loaded once.\n",
+                 name);
+}
+
+int main(int argc, char** argv)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    const HostName* used = &kHosts[0];
+    bool eager = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "-e") == 0)
+        {
+            eager = true;
+            continue;
+        }
+
+        if (std::strcmp(argv[i], "-t") != 0 || i + 1 >= argc)
+        {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+
+        used = nullptr;
+        for (const HostName& host : kHosts)
+        {
+            if (std::strcmp(host.name, argv[i + 1]) == 0)
+                used = &host;
+        }
+        if (!used)
+        {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+        i++;
+    }
+
+    PortSDR::PortSDR sdr;
+    const double constructed = ElapsedUs(start);
+
+    std::string available;
+    if (eager)
+    {
+        for (const HostName& host : kHosts)
+        {
+            if (!sdr.IsHostAvailable(host.type))
+                continue;
+
+            available += available.empty() ? "\"" : ",\"";
+            available += host.name;
+            available += "\"";
+        }
+    }
+    const double loaded = ElapsedUs(start);
+
+    const bool usable = sdr.IsHostAvailable(used->type);
+    const double ready = ElapsedUs(start);
+
+    const std::size_t devices = usable ? sdr.GetHostDevices(used->type).size() : 0;
+    const double listed = ElapsedUs(start);
+
+    std::printf("{\"mode\":\"%s\",\"host\":\"%s\",\"available\":%s,\"devices\":%zu,"
+                "\"construct_us\":%.1f,\"all_hosts_us\":%.1f,\"host_ready_us\":%.1f,\"devices_us\":%.1f%s%s}\n",
+                eager ? "eager" : "lazy", used->name, usable ? "true" : "false", devices,
+                constructed, loaded, ready, listed,
+                eager ? ",\"loaded\":[" : "", eager ? (available + "]").c_str() : "");
+    return usable ? 0 : 2;
+}
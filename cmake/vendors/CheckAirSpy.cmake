@@ -12,15 +12,18 @@ if (NOT AIRSPY_FOUND)
             GIT_TAG c6721000f19601512e9ba6b0340e5d9ced22a900
             WIN_LIB_PATH bin/libairspy.a
             UNIX_LIB_PATH lib/libairspy.a
-            TARGETS LibUSB::LibUSB
+            TARGETS LibUSB::LibUSB Threads::Threads
             EXTRA_CMAKE_ARGS
             -DLIBUSB_LIBRARIES:STRING=${LibUSB_LIBRARIES}
             -DLIBUSB_INCLUDE_DIR:STRING=${LibUSB_INCLUDE_DIR}
             -DTHREADS_PTHREADS_WIN32_LIBRARY=OFF
+            -DCMAKE_POSITION_INDEPENDENT_CODE:BOOL=ON
     )
 
     list(APPEND PortSDR_DEPENDENCIES AIRSPY::AIRSPY)
     set(AIRSPY_FOUND TRUE)
+    # Only built as a static library, linked in instead of loaded at runtime
+    set(AIRSPY_LINKED TRUE)
 endif ()
 
 if (NOT AIRSPYHF_FOUND)
@@ -34,12 +37,14 @@ if (NOT AIRSPYHF_FOUND)
             GIT_TAG 87cf12a30f3a0f10f313aab8e54999ca69b753af
             WIN_LIB_PATH bin/libairspyhf.a
             UNIX_LIB_PATH lib/libairspyhf.a
-            TARGETS LibUSB::LibUSB
+            TARGETS LibUSB::LibUSB Threads::Threads
             EXTRA_CMAKE_ARGS
             -DLIBUSB_LIBRARIES:STRING=${LibUSB_LIBRARIES}
             -DLIBUSB_INCLUDE_DIR:STRING=${LibUSB_INCLUDE_DIR}
             -DTHREADS_PTHREADS_WIN32_LIBRARY=OFF
+            -DCMAKE_POSITION_INDEPENDENT_CODE:BOOL=ON
     )
     list(APPEND PortSDR_DEPENDENCIES AIRSPYHF::AIRSPYHF)
     set(AIRSPYHF_FOUND TRUE)
+    set(AIRSPYHF_LINKED TRUE)
 endif ()
\ No newline at end of file
@@ -12,8 +12,11 @@ if (NOT RTLSDR_FOUND)
             TARGETS LibUSB::LibUSB
             EXTRA_CMAKE_ARGS
             -DCMAKE_C_FLAGS:STRING="-std=gnu17"
+            -DCMAKE_POSITION_INDEPENDENT_CODE:BOOL=ON
             -DLIBUSB_LIBRARIES:STRING=${LibUSB_LIBRARIES}
     )
     list(APPEND PortSDR_DEPENDENCIES RTLSDR::RTLSDR)
     set(RTLSDR_FOUND TRUE)
+    # Only built as a static library, linked in instead of loaded at runtime
+    set(RTLSDR_LINKED TRUE)
 endif ()
\ No newline at end of file
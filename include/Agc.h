@@ -0,0 +1,122 @@
+#ifndef PORTSDR_AGC_H
+#define PORTSDR_AGC_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Error.h"
+#include "Stream.h"
+
+namespace PortSDR
+{
+    struct AgcConfig
+    {
+        std::string stage; // Gain stage to drive, empty for the first stage of the stream
+        double target_dbfs = -12.0; // Average power to aim for, the difference to 0 dBFS is the headroom
+        double hysteresis_db = 3.0; // Power error that is tolerated before the gain is changed
+        double max_step_db = 6.0; // Largest gain change done at once
+        double max_clip_fraction = 0.001; // Fraction of clipped values that forces the gain down
+        std::chrono::milliseconds min_interval{100}; // Shortest time between two hardware writes
+    };
+
+    struct GainEvent
+    {
+        uint64_t sample_index; // Sample the gain tag of the stream is anchored to
+        double gain; // New gain in dB
+        double previous; // Gain in dB before the change
+    };
+
+    /**
+     * Automatic gain control that drives a gain stage of a stream.
+     *
+     * While running it is the callback of the stream. It measures the power and clipping of every transfer
+     * and hands the transfer on to the callback set with SetCallback(). The hardware itself is written
+     * from a worker thread, so the receiving thread never blocks on USB control transfers.
+     * Samples before the gain tag of a change are not measured.
+     */
+    class Agc
+    {
+    public:
+        using EVENT_CALLBACK = std::function<void(const GainEvent& event)>;
+
+        explicit Agc(Stream& stream);
+        ~Agc();
+
+        Agc(const Agc&) = delete;
+        Agc& operator=(const Agc&) = delete;
+
+        /**
+         * Starts driving the gain stage and installs the stream callback.
+         * The current gain of the stage is used as the starting point.
+         * @param config settings of the loop.
+         * @return ret code, INVALID_ARGUMENT if the stage doesn't exist.
+         */
+        ErrorCode Start(const AgcConfig& config = {});
+
+        /**
+         * Removes the stream callback and stops driving the gain stage.
+         */
+        void Stop();
+
+        /**
+         * Sets the function every transfer is handed to after it was measured.
+         * Must be set before Start().
+         * @param callback stream callback, empty for none.
+         */
+        void SetCallback(Stream::SDR_CALLBACK callback);
+
+        /**
+         * Sets the function called from the receiving thread when the gain tag of a change arrives.
+         * Changes made to the stage by anyone else are reported as well.
+         * Must be set before Start().
+         * @param callback function receiving the change.
+         */
+        void SetEventCallback(EVENT_CALLBACK callback);
+
+        /**
+         * @return gain in dB last written to the hardware.
+         */
+        [[nodiscard]] double GetGain() const;
+
+        /**
+         * @return smoothed power of the samples in dBFS.
+         */
+        [[nodiscard]] double GetPowerDbfs() const;
+
+    private:
+        void Process(SDRTransfer& transfer);
+        void Measure(const SDRTransfer& transfer, std::size_t offset);
+        void Worker();
+        [[nodiscard]] double Snap(double gain, double current) const;
+
+    private:
+        Stream& m_stream;
+        AgcConfig m_config;
+        std::vector<double> m_values;
+        Stream::SDR_CALLBACK m_callback;
+        EVENT_CALLBACK m_eventCallback;
+
+        // Callback thread only
+        double m_power = -1.0;
+
+        std::atomic<bool> m_pending{false}; // A change was requested and its gain tag didn't arrive yet
+        std::atomic<double> m_gain{0};
+        std::atomic<double> m_powerDbfs{-100.0};
+
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+        std::thread m_thread;
+        double m_request = 0;
+        bool m_hasRequest = false;
+        bool m_running = false;
+    };
+}
+
+#endif //PORTSDR_AGC_H
@@ -0,0 +1,149 @@
+#ifndef PORTSDR_ALLOCATOR_H
+#define PORTSDR_ALLOCATOR_H
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <unordered_set>
+#include <vector>
+
+namespace PortSDR
+{
+    /**
+     * Source of the sample buffers owned by the library:
+     * rings, conversion outputs and block pools.
+     */
+    class Allocator
+    {
+    public:
+        virtual ~Allocator() = default;
+
+        /**
+         * @param size size in bytes.
+         * @return memory aligned to at least 64 bytes, nullptr on failure.
+         */
+        virtual void* Allocate(std::size_t size) = 0;
+
+        /**
+         * @param ptr memory returned by Allocate().
+         * @param size the size given to Allocate().
+         */
+        virtual void Deallocate(void* ptr, std::size_t size) = 0;
+    };
+
+    /**
+     * Backs large buffers with 2 MiB huge pages, bound to a NUMA node.
+     *
+     * Buffers of at least 2 MiB are mapped from the huge page pool. When the pool is empty,
+     * or the platform has none, they are mapped with regular 4 KiB pages instead.
+     * Buffers of at least 64 KiB are mapped and bound to the node as well,
+     * smaller ones come from the heap. (Linux only, elsewhere everything comes from the heap)
+     */
+    class HugePageAllocator final : public Allocator
+    {
+    public:
+        /**
+         * @param numaNode node the memory is bound to, -1 leaves it to the first thread touching it.
+         */
+        explicit HugePageAllocator(int numaNode = -1);
+
+        void* Allocate(std::size_t size) override;
+        void Deallocate(void* ptr, std::size_t size) override;
+
+        [[nodiscard]] int GetNumaNode() const
+        {
+            return m_node;
+        }
+
+        /**
+         * @return bytes currently mapped with huge pages.
+         */
+        [[nodiscard]] std::size_t GetHugePageBytes() const;
+
+        /**
+         * @return bytes currently mapped with regular pages, because no huge pages were available.
+         */
+        [[nodiscard]] std::size_t GetFallbackBytes() const;
+
+    private:
+        int m_node;
+        std::mutex m_mutex;
+        std::unordered_set<void*> m_hugeMappings;
+        std::atomic<std::size_t> m_hugePageBytes{0};
+        std::atomic<std::size_t> m_fallbackBytes{0};
+    };
+
+    /**
+     * Gets the allocator used for new buffers of the library.
+     * @return allocator set with SetAllocator(), a HugePageAllocator without a node otherwise.
+     */
+    Allocator& GetAllocator();
+
+    /**
+     * Replaces the allocator used for new buffers of the library.
+     * Buffers keep the allocator they were created with, so it must outlive every stream
+     * and helper created while it was set. Set it before opening any device.
+     * @param allocator new allocator, nullptr restores the default.
+     */
+    void SetAllocator(Allocator* allocator);
+
+    /**
+     * Standard allocator forwarding to the allocator that was set when it was created.
+     */
+    template <typename T>
+    class BufferAllocator
+    {
+    public:
+        using value_type = T;
+
+        BufferAllocator() noexcept
+            : m_allocator(&PortSDR::GetAllocator())
+        {
+        }
+
+        template <typename U>
+        BufferAllocator(const BufferAllocator<U>& other) noexcept
+            : m_allocator(other.GetAllocator())
+        {
+        }
+
+        T* allocate(const std::size_t n)
+        {
+            void* ptr = m_allocator->Allocate(n * sizeof(T));
+            if (!ptr)
+                throw std::bad_alloc();
+            return static_cast<T*>(ptr);
+        }
+
+        void deallocate(T* ptr, const std::size_t n) noexcept
+        {
+            m_allocator->Deallocate(ptr, n * sizeof(T));
+        }
+
+        [[nodiscard]] Allocator* GetAllocator() const noexcept
+        {
+            return m_allocator;
+        }
+
+        template <typename U>
+        bool operator==(const BufferAllocator<U>& other) const noexcept
+        {
+            return m_allocator == other.GetAllocator();
+        }
+
+        template <typename U>
+        bool operator!=(const BufferAllocator<U>& other) const noexcept
+        {
+            return m_allocator != other.GetAllocator();
+        }
+
+    private:
+        Allocator* m_allocator;
+    };
+
+    template <typename T>
+    using Buffer = std::vector<T, BufferAllocator<T>>;
+}
+
+#endif //PORTSDR_ALLOCATOR_H
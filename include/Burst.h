@@ -0,0 +1,142 @@
+#ifndef PORTSDR_BURST_H
+#define PORTSDR_BURST_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Capture.h"
+#include "Error.h"
+#include "Stream.h"
+
+namespace PortSDR
+{
+    struct BurstConfig
+    {
+        double threshold_db = 10.0; // Power above the noise floor that starts a burst
+        std::size_t block_size = 256; // Samples the power is measured over
+        std::chrono::milliseconds pre_padding{10}; // Recorded before the first block above the threshold
+        std::chrono::milliseconds post_padding{50}; // Recorded after the last one, also the time a burst may fade
+        std::chrono::milliseconds max_burst{2000}; // Longer bursts are split into several
+        SampleFormat format = SAMPLE_FORMAT_IQ_UINT8; // Format the stream delivers, see CaptureConfig
+    };
+
+    struct BurstInfo
+    {
+        uint64_t start_sample; // Index of the first recorded sample, counted like CaptureRing
+        uint64_t samples; // Recorded samples, including the padding
+        uint64_t offset; // Byte offset in the data file
+        double frequency; // Center frequency in Hz
+        double peak_dbfs; // Power of the strongest block
+        double noise_dbfs; // Noise floor when the burst started
+    };
+
+    /**
+     * Records only the bursts of a stream.
+     *
+     * Process() measures the power of every block of samples and tracks the noise floor in between bursts.
+     * A block above the floor by the threshold starts a burst. Once the power stayed below it for
+     * the post padding, the burst and its padding are written from a CaptureRing to the data file
+     * by a background thread. Every burst is listed in an index next to it, <path>.csv.
+     */
+    class BurstRecorder
+    {
+    public:
+        using BURST_CALLBACK = std::function<void(const BurstInfo& burst)>;
+
+        explicit BurstRecorder(Stream& stream);
+        ~BurstRecorder();
+
+        BurstRecorder(const BurstRecorder&) = delete;
+        BurstRecorder& operator=(const BurstRecorder&) = delete;
+
+        /**
+         * Creates the data file and its index and starts detecting.
+         * @param path raw file the samples of the bursts are appended to.
+         * @param config settings of the detector.
+         * @return ret code, INVALID_ARGUMENT if the files can't be created or the sample rate isn't set.
+         */
+        ErrorCode Start(const std::string& path, const BurstConfig& config = {});
+
+        /**
+         * Writes a burst that is still going on, waits for pending writes and closes the files.
+         */
+        void Stop();
+
+        /**
+         * Measures a transfer.
+         * @param transfer transfer from the stream callback.
+         */
+        void Process(const SDRTransfer& transfer);
+
+        /**
+         * Sets the function called from the writing thread after every burst.
+         * Must be set before Start().
+         * @param callback function receiving the burst.
+         */
+        void SetBurstCallback(BURST_CALLBACK callback);
+
+        /**
+         * @return bursts written so far.
+         */
+        [[nodiscard]] std::vector<BurstInfo> GetBursts() const;
+
+        /**
+         * @return current noise floor in dBFS.
+         */
+        [[nodiscard]] double GetNoiseFloor() const;
+
+    private:
+        struct BurstJob
+        {
+            CaptureSnapshot snapshot;
+            BurstInfo info;
+        };
+
+        void Finish(uint64_t to);
+        void Writer();
+
+    private:
+        Stream& m_stream;
+        CaptureRing m_ring;
+        BurstConfig m_config;
+        BURST_CALLBACK m_burstCallback;
+
+        // Detector, guarded by m_stateMutex
+        mutable std::mutex m_stateMutex;
+        bool m_detecting = false;
+        uint64_t m_sampleIndex = 0;
+        double m_frequency = 0;
+        double m_floor = -1.0;
+        double m_threshold = 0;
+        std::size_t m_prePadding = 0;
+        std::size_t m_postPadding = 0;
+        std::size_t m_maxBurst = 0;
+        bool m_inBurst = false;
+        bool m_continued = false; // Split off a longer burst, without pre padding
+        uint64_t m_burstStart = 0;
+        uint64_t m_lastActive = 0;
+        double m_peak = 0;
+        double m_burstFloor = 0;
+
+        // Writer
+        mutable std::mutex m_mutex;
+        std::condition_variable m_cv;
+        std::thread m_writer;
+        std::deque<BurstJob> m_jobs;
+        bool m_writing = false;
+        FILE* m_data = nullptr;
+        FILE* m_index = nullptr;
+        uint64_t m_offset = 0;
+        std::vector<BurstInfo> m_bursts;
+    };
+}
+
+#endif //PORTSDR_BURST_H
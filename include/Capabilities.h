@@ -0,0 +1,114 @@
+#ifndef PORTSDR_CAPABILITIES_H
+#define PORTSDR_CAPABILITIES_H
+
+#include <cstdint>
+#include <future>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Device.h"
+#include "Error.h"
+#include "Ranges.h"
+#include "Stream.h"
+
+namespace PortSDR
+{
+    struct Capabilities
+    {
+        std::string tuner_type;
+        std::vector<uint32_t> sample_rates;
+        std::vector<SampleFormat> sample_formats;
+        std::vector<GainMode> gain_modes;
+        std::vector<std::vector<Gain>> gain_stages; // Stages of each of gain_modes
+    };
+
+    /**
+     * Queries everything Capabilities holds from an open stream.
+     * @param stream stream to query.
+     * @return capabilities of the stream.
+     */
+    Capabilities ProbeCapabilities(const Stream& stream);
+
+    /**
+     * Capabilities of devices cached in a file, keyed by host and serial.
+     *
+     * The file is memory mapped by Load() and only the entry that is looked up gets decoded,
+     * so Find() answers without opening the device. Refresh() probes an open stream on its control thread
+     * and rewrites the file when the device doesn't match its entry anymore.
+     * The file is replaced by renaming, processes that mapped it before keep reading the old one.
+     * Writers lock a file next to it, so concurrent processes each keep the entries of the other.
+     * A file of another version is ignored and replaced by the first Refresh().
+     * Streams don't consult the cache, it only answers Find() for devices that aren't open.
+     */
+    class CapabilityCache
+    {
+    public:
+        /**
+         * @param path file of the cache, created by the first Refresh().
+         */
+        explicit CapabilityCache(std::string path);
+        ~CapabilityCache();
+
+        CapabilityCache(const CapabilityCache&) = delete;
+        CapabilityCache& operator=(const CapabilityCache&) = delete;
+
+        /**
+         * Maps the file.
+         * @return ret code, OK if the file doesn't exist yet or is of another version, the cache is empty then.
+         */
+        ErrorCode Load();
+
+        /**
+         * Looks up the cached capabilities of a device.
+         * @param device device to look up.
+         * @param capabilities filled in if the device is cached.
+         * @return true if the device is cached.
+         */
+        bool Find(const Device& device, Capabilities& capabilities) const;
+
+        /**
+         * Queues a probe of the stream on its control thread, see Stream::Submit().
+         * The cache has to outlive the probe, wait on the future before destroying it.
+         * @param device device the stream was created from.
+         * @param stream open stream of the device.
+         * @return future of the ret code, OK if the entry was up to date or has been written.
+         */
+        std::future<ErrorCode> Refresh(const Device& device, Stream& stream);
+
+        /**
+         * Writes the capabilities of a device, replacing its entry.
+         * Entries other processes stored meanwhile are kept, the file is mapped again first.
+         * @param device device to store.
+         * @param capabilities capabilities of the device.
+         * @return ret code, FAILED_TO_INITIALIZE if the file can't be written.
+         */
+        ErrorCode Store(const Device& device, const Capabilities& capabilities);
+
+        /**
+         * @return amount of cached devices.
+         */
+        [[nodiscard]] std::size_t GetSize() const;
+
+    private:
+        ErrorCode Map();
+        void Unmap();
+
+        // Rewrites the file from the mapping, under the lock of the file
+        ErrorCode Write(const Device& device, const Capabilities& capabilities);
+
+        // Entry of the device in the mapping, empty if it isn't cached
+        [[nodiscard]] std::string_view FindEntry(const Device& device) const;
+
+    private:
+        std::string m_path;
+
+        mutable std::mutex m_mutex;
+        const uint8_t* m_data = nullptr;
+        std::size_t m_size = 0;
+        std::size_t m_count = 0;
+    };
+}
+
+#endif //PORTSDR_CAPABILITIES_H
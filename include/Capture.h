@@ -0,0 +1,238 @@
+#ifndef PORTSDR_CAPTURE_H
+#define PORTSDR_CAPTURE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Allocator.h"
+#include "Error.h"
+#include "Span.h"
+#include "Stream.h"
+
+namespace PortSDR
+{
+    struct CaptureConfig
+    {
+        std::chrono::milliseconds duration{10000}; // Time kept before the newest sample
+        std::size_t max_bytes = 256 * 1024 * 1024; // Upper bound of the memory, wins over duration
+        SampleFormat format = SAMPLE_FORMAT_IQ_UINT8; // Format the stream delivers, the ring is sized for it
+    };
+
+    class CaptureRing;
+
+    /**
+     * Window of a capture ring, read straight from the memory of the ring.
+     * The samples are pinned until the snapshot is destroyed or released, the ring doesn't overwrite them meanwhile.
+     * The window may wrap around the end of the ring, so it comes in two parts.
+     */
+    class CaptureSnapshot
+    {
+    public:
+        CaptureSnapshot() = default;
+        ~CaptureSnapshot();
+
+        CaptureSnapshot(CaptureSnapshot&& other) noexcept;
+        CaptureSnapshot& operator=(CaptureSnapshot&& other) noexcept;
+
+        CaptureSnapshot(const CaptureSnapshot&) = delete;
+        CaptureSnapshot& operator=(const CaptureSnapshot&) = delete;
+
+        /**
+         * Unpins the samples, the parts become invalid.
+         */
+        void Release();
+
+        /**
+         * @return oldest part of the window.
+         */
+        [[nodiscard]] Span<const uint8_t> GetFirst() const
+        {
+            return m_first;
+        }
+
+        /**
+         * @return rest of the window, empty if it doesn't wrap around.
+         */
+        [[nodiscard]] Span<const uint8_t> GetSecond() const
+        {
+            return m_second;
+        }
+
+        /**
+         * @return index of the first sample.
+         */
+        [[nodiscard]] uint64_t GetFrom() const
+        {
+            return m_from;
+        }
+
+        /**
+         * @return index after the last sample.
+         */
+        [[nodiscard]] uint64_t GetTo() const
+        {
+            return m_to;
+        }
+
+        [[nodiscard]] SampleFormat GetFormat() const
+        {
+            return m_format;
+        }
+
+        [[nodiscard]] bool IsValid() const
+        {
+            return m_ring != nullptr;
+        }
+
+    private:
+        friend class CaptureRing;
+
+        CaptureRing* m_ring = nullptr;
+        uint64_t m_pin = 0;
+        uint64_t m_from = 0;
+        uint64_t m_to = 0;
+        SampleFormat m_format = SAMPLE_FORMAT_IQ_UINT8;
+        Span<const uint8_t> m_first;
+        Span<const uint8_t> m_second;
+    };
+
+    /**
+     * Keeps the last seconds of a stream in memory, so the samples before a trigger can be looked at.
+     *
+     * While recording it is the callback of the stream. It copies every transfer into a ring allocated once
+     * by Start(), in the sample format of the stream, and hands the transfer on to the callback set with SetCallback().
+     * Snapshots and saves must not outlive the ring.
+     * Samples are addressed by their index, counted from the first transfer recorded
+     * including dropped samples, so a gap in the stream restarts the ring.
+     * Snapshots are taken without copying. While pinned samples would be overwritten,
+     * transfers aren't recorded, see GetBlockedSamples().
+     */
+    class CaptureRing
+    {
+    public:
+        using SAVE_CALLBACK = std::function<void(ErrorCode ret, const std::string& path)>;
+
+        explicit CaptureRing(Stream& stream);
+        ~CaptureRing();
+
+        CaptureRing(const CaptureRing&) = delete;
+        CaptureRing& operator=(const CaptureRing&) = delete;
+
+        /**
+         * Allocates the ring, installs the stream callback and starts recording.
+         * The size is taken from the current sample rate of the stream.
+         * Transfers of another format than the configured one fit more or less time into the same memory.
+         * @param config size of the ring.
+         * @return ret code, INVALID_ARGUMENT if the sample rate isn't set or the ring is still pinned.
+         */
+        ErrorCode Start(const CaptureConfig& config = {});
+
+        /**
+         * Removes the stream callback, stops recording and waits for pending saves.
+         * The ring keeps its samples for later snapshots.
+         */
+        void Stop();
+
+        /**
+         * Sets the function every transfer is handed to after it was recorded, e.g. a detector.
+         * Must be set before Start().
+         * @param callback stream callback, empty for none.
+         */
+        void SetCallback(Stream::SDR_CALLBACK callback);
+
+        /**
+         * Pins a window of the ring.
+         * The window is clamped to the samples the ring holds.
+         * @param from index of the first sample.
+         * @param to index after the last sample.
+         * @param snapshot receives the window.
+         * @return ret code, INVALID_ARGUMENT if none of the window is held.
+         */
+        ErrorCode Snapshot(uint64_t from, uint64_t to, CaptureSnapshot& snapshot);
+
+        /**
+         * Writes a window of the ring to a raw file in the background, pinned until it was written.
+         * @param from index of the first sample.
+         * @param to index after the last sample.
+         * @param path file to write.
+         * @param callback called from the writing thread once the file was written, may be empty.
+         * @return ret code, INVALID_ARGUMENT if none of the window is held.
+         */
+        ErrorCode Save(uint64_t from, uint64_t to, const std::string& path, SAVE_CALLBACK callback = {});
+
+        /**
+         * @return index of the oldest sample held.
+         */
+        [[nodiscard]] uint64_t GetOldestIndex() const;
+
+        /**
+         * @return index after the newest sample held.
+         */
+        [[nodiscard]] uint64_t GetNewestIndex() const;
+
+        /**
+         * @return amount of IQ samples the ring holds once full.
+         */
+        [[nodiscard]] std::size_t GetCapacity() const;
+
+        /**
+         * @return bytes allocated for the ring.
+         */
+        [[nodiscard]] std::size_t GetMemoryUsage() const;
+
+        /**
+         * @return samples not recorded because snapshots pinned the ones they would overwrite.
+         */
+        [[nodiscard]] uint64_t GetBlockedSamples() const;
+
+    private:
+        friend class CaptureSnapshot;
+        friend class BurstRecorder; // Records from its own callback
+
+        struct SaveJob
+        {
+            CaptureSnapshot snapshot;
+            std::string path;
+            SAVE_CALLBACK callback;
+        };
+
+        ErrorCode Allocate(const CaptureConfig& config);
+        void Process(SDRTransfer& transfer);
+        void Record(const SDRTransfer& transfer);
+        void Unpin(uint64_t pin);
+        void Writer();
+
+    private:
+        Stream& m_stream;
+        Stream::SDR_CALLBACK m_callback;
+        bool m_installed = false;
+        Buffer<uint8_t> m_buffer;
+
+        // Callback thread only
+        uint64_t m_sampleIndex = 0;
+
+        mutable std::mutex m_mutex;
+        bool m_recording = false;
+        SampleFormat m_format = SAMPLE_FORMAT_IQ_UINT8;
+        std::size_t m_capacity = 0;
+        uint64_t m_begin = 0;
+        uint64_t m_end = 0;
+        uint64_t m_blocked = 0;
+        uint64_t m_nextPin = 1;
+        std::vector<std::pair<uint64_t, uint64_t>> m_pins; // Pin and first pinned sample
+
+        std::condition_variable m_cv;
+        std::thread m_writer;
+        std::deque<SaveJob> m_jobs;
+        bool m_writing = false;
+    };
+}
+
+#endif //PORTSDR_CAPTURE_H
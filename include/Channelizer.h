@@ -0,0 +1,136 @@
+#ifndef PORTSDR_CHANNELIZER_H
+#define PORTSDR_CHANNELIZER_H
+
+#include <complex>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Allocator.h"
+#include "Error.h"
+#include "Stream.h"
+
+namespace PortSDR
+{
+    class Fft;
+
+    struct ChannelizerConfig
+    {
+        std::size_t channels = 64; // Power of two, each channel is sample rate / channels wide
+        std::size_t taps_per_channel = 16; // Length of the prototype filter divided by channels
+        std::size_t threads = 1; // Threads sharing the work, including the one calling Process()
+        SampleFormat format = SAMPLE_FORMAT_IQ_FLOAT32; // Sample format of the channels
+    };
+
+    /**
+     * Critically sampled polyphase filter bank.
+     *
+     * Splits a stream into uniformly spaced channels, each decimated by the amount of channels.
+     * Channel k is centered at k * sample rate / channels, channels in the upper half
+     * are the negative frequencies. Sample n of every channel lines up with input sample n * channels.
+     *
+     * The filter runs once for all channels, followed by an FFT, instead of a mixer and
+     * filter per channel. With more than one thread, the work is split in groups of channels
+     * and every group is delivered from its own thread.
+     */
+    class Channelizer
+    {
+    public:
+        using CHANNEL_CALLBACK = std::function<void(std::size_t channel, SDRTransfer& transfer)>;
+
+        Channelizer();
+        ~Channelizer();
+
+        Channelizer(const Channelizer&) = delete;
+        Channelizer& operator=(const Channelizer&) = delete;
+
+        /**
+         * Designs the filter bank and starts the worker threads.
+         * @param config layout of the channels.
+         * @return ret code, INVALID_ARGUMENT if channels isn't a power of two.
+         */
+        ErrorCode Create(const ChannelizerConfig& config);
+        void Close();
+
+        /**
+         * Sets the function receiving the samples of each channel.
+         * Channels of the same group are delivered in order from the same thread.
+         * Must be set before Create().
+         * @param callback function receiving the channel and its samples.
+         */
+        void SetCallback(CHANNEL_CALLBACK callback);
+
+        /**
+         * Splits a transfer into channels and returns once every channel was delivered.
+         * Samples that don't fill a whole output sample are kept for the next transfer.
+         * Tags move to the first output sample whose filter window reaches them,
+         * their sample_index still counts samples of the stream.
+         * @param transfer transfer from the stream callback.
+         * @return ret code, UNINITIALIZED before Create().
+         */
+        ErrorCode Process(const SDRTransfer& transfer);
+
+        /**
+         * Clears the filter history, call when the stream restarts.
+         */
+        void Reset();
+
+        /**
+         * Gets the center of a channel relative to the center frequency of the stream.
+         * @param channel index of the channel.
+         * @param sampleRate sample rate of the stream.
+         * @return offset in Hz.
+         */
+        [[nodiscard]] double GetChannelOffset(std::size_t channel, uint32_t sampleRate) const;
+
+        [[nodiscard]] std::size_t GetChannelCount() const
+        {
+            return m_config.channels;
+        }
+
+    private:
+        void Worker(std::size_t index);
+        void Run(std::size_t index);
+        void Sync();
+
+    private:
+        ChannelizerConfig m_config;
+        CHANNEL_CALLBACK m_callback;
+        std::unique_ptr<Fft> m_fft;
+        std::size_t m_history = 0;
+        std::size_t m_groupSize = 0;
+
+        // Prototype filter, per branch and duplicated for I and Q.
+        std::vector<float> m_taps;
+        // History followed by the samples not filtered yet, interleaved I and Q.
+        Buffer<float> m_input;
+        // Outputs of the branches and the channels, one row per output sample.
+        // Rows of the channels hold all real parts followed by all imaginary parts.
+        Buffer<float> m_branches;
+        Buffer<float> m_channels;
+        std::vector<Buffer<std::complex<float>>> m_gathered;
+        std::vector<Buffer<uint8_t>> m_converted;
+
+        // Tags not delivered yet, with offsets into m_input in IQ samples.
+        std::vector<StreamTag> m_pendingTags;
+
+        // Current job, written before the workers are woken up.
+        std::size_t m_steps = 0;
+        std::size_t m_dropped = 0;
+        std::vector<StreamTag> m_tags;
+
+        std::mutex m_mutex;
+        std::condition_variable m_cond;
+        std::vector<std::thread> m_threads;
+        uint64_t m_job = 0;
+        uint64_t m_syncGeneration = 0;
+        std::size_t m_syncArrived = 0;
+        bool m_running = false;
+    };
+}
+
+#endif //PORTSDR_CHANNELIZER_H
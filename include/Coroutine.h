@@ -0,0 +1,548 @@
+#ifndef PORTSDR_COROUTINE_H
+#define PORTSDR_COROUTINE_H
+
+#if !defined(__cpp_impl_coroutine)
+#error "Coroutine.h requires C++20 coroutines, the rest of PortSDR only needs C++17"
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <concepts>
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "Stream.h"
+
+namespace PortSDR
+{
+    /**
+     * Anything that can resume a coroutine, possibly on another thread.
+     * Post() is called from the receiving thread of the stream.
+     */
+    template<typename T>
+    concept Executor = requires(T& executor, std::coroutine_handle<> handle)
+    {
+        executor.Post(handle);
+    };
+
+    /**
+     * Resumes the coroutine right away on the receiving thread of the stream.
+     */
+    struct InlineExecutor
+    {
+        void Post(const std::coroutine_handle<> handle)
+        {
+            handle.resume();
+        }
+    };
+
+    /**
+     * Recycles coroutine frames by size class, so starting a coroutine
+     * doesn't reach the heap once a frame of its size has been freed before.
+     */
+    class FramePool
+    {
+    public:
+        static void* Allocate(const std::size_t size)
+        {
+            const std::size_t index = ClassIndex(size);
+            if (index >= kClassCount)
+                return ::operator new(size);
+
+            SizeClass& sizeClass = Classes()[index];
+            Lock(sizeClass);
+            FreeFrame* frame = sizeClass.head;
+            if (frame)
+                sizeClass.head = frame->next;
+            sizeClass.lock.clear(std::memory_order_release);
+
+            return frame ? frame : ::operator new((index + 1) * kGranularity);
+        }
+
+        static void Free(void* ptr, const std::size_t size)
+        {
+            const std::size_t index = ClassIndex(size);
+            if (index >= kClassCount)
+            {
+                ::operator delete(ptr);
+                return;
+            }
+
+            SizeClass& sizeClass = Classes()[index];
+            auto* frame = static_cast<FreeFrame*>(ptr);
+            Lock(sizeClass);
+            frame->next = sizeClass.head;
+            sizeClass.head = frame;
+            sizeClass.lock.clear(std::memory_order_release);
+        }
+
+    private:
+        static constexpr std::size_t kGranularity = 64;
+        static constexpr std::size_t kClassCount = 128; // Frames up to 8 KiB
+
+        struct FreeFrame
+        {
+            FreeFrame* next;
+        };
+
+        struct SizeClass
+        {
+            std::atomic_flag lock = ATOMIC_FLAG_INIT;
+            FreeFrame* head = nullptr;
+        };
+
+        static std::size_t ClassIndex(const std::size_t size)
+        {
+            return (size + kGranularity - 1) / kGranularity - 1;
+        }
+
+        static void Lock(SizeClass& sizeClass)
+        {
+            while (sizeClass.lock.test_and_set(std::memory_order_acquire))
+            {
+            }
+        }
+
+        static SizeClass* Classes()
+        {
+            // Never destroyed, frames may still be freed during static destruction.
+            static auto* classes = new SizeClass[kClassCount];
+            return classes;
+        }
+    };
+
+    /**
+     * Fire and forget coroutine with its frame taken from FramePool.
+     * Starts right away and destroys itself when it finishes.
+     */
+    struct Task
+    {
+        struct promise_type
+        {
+            Task get_return_object() noexcept
+            {
+                return {};
+            }
+
+            std::suspend_never initial_suspend() noexcept
+            {
+                return {};
+            }
+
+            std::suspend_never final_suspend() noexcept
+            {
+                return {};
+            }
+
+            void return_void() noexcept
+            {
+            }
+
+            void unhandled_exception() noexcept
+            {
+                std::terminate();
+            }
+
+            static void* operator new(const std::size_t size)
+            {
+                return FramePool::Allocate(size);
+            }
+
+            static void operator delete(void* ptr, const std::size_t size)
+            {
+                FramePool::Free(ptr, size);
+            }
+        };
+    };
+
+    /**
+     * Fixed ring of block indices between one producer and one consumer.
+     */
+    class BlockQueue
+    {
+    public:
+        explicit BlockQueue(const std::size_t count)
+        {
+            std::size_t capacity = 1;
+            while (capacity < count)
+                capacity <<= 1;
+            m_slots.resize(capacity);
+        }
+
+        bool Push(const uint32_t index)
+        {
+            const uint64_t head = m_head.load(std::memory_order_relaxed);
+            if (head - m_tail.load(std::memory_order_acquire) == m_slots.size())
+                return false;
+
+            m_slots[head & (m_slots.size() - 1)] = index;
+            m_head.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool Pop(uint32_t& index)
+        {
+            const uint64_t tail = m_tail.load(std::memory_order_relaxed);
+            if (tail == m_head.load(std::memory_order_acquire))
+                return false;
+
+            index = m_slots[tail & (m_slots.size() - 1)];
+            m_tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        [[nodiscard]] bool Empty() const
+        {
+            return m_tail.load(std::memory_order_acquire) == m_head.load(std::memory_order_acquire);
+        }
+
+    private:
+        std::vector<uint32_t> m_slots;
+        alignas(64) std::atomic<uint64_t> m_head{0};
+        alignas(64) std::atomic<uint64_t> m_tail{0};
+    };
+
+    class BlockPool;
+
+    /**
+     * Handle to a block of samples owned by a BlockPool.
+     * The block goes back to the pool when the handle is destroyed,
+     * it must not outlive the AsyncStream it came from.
+     */
+    class SampleBlock
+    {
+    public:
+        SampleBlock() = default;
+        SampleBlock(BlockPool* pool, uint32_t index);
+        ~SampleBlock();
+
+        SampleBlock(SampleBlock&& other) noexcept
+            : m_pool(std::exchange(other.m_pool, nullptr)), m_index(other.m_index)
+        {
+        }
+
+        SampleBlock& operator=(SampleBlock&& other) noexcept
+        {
+            if (this != &other)
+            {
+                Reset();
+                m_pool = std::exchange(other.m_pool, nullptr);
+                m_index = other.m_index;
+            }
+            return *this;
+        }
+
+        SampleBlock(const SampleBlock&) = delete;
+        SampleBlock& operator=(const SampleBlock&) = delete;
+
+        /**
+         * @return false once the stream has been closed.
+         */
+        explicit operator bool() const
+        {
+            return m_pool != nullptr;
+        }
+
+        [[nodiscard]] const void* data() const;
+        [[nodiscard]] std::size_t frame_size() const;
+        [[nodiscard]] std::size_t dropped_samples() const;
+        [[nodiscard]] SampleFormat format() const;
+        [[nodiscard]] uint64_t sample_index() const;
+
+        void Reset();
+
+    private:
+        BlockPool* m_pool = nullptr;
+        uint32_t m_index = 0;
+    };
+
+    /**
+     * Preallocated blocks handed from the receiving thread to a coroutine.
+     * Transfers are copied into free blocks, there are no allocations once constructed.
+     */
+    class BlockPool
+    {
+    public:
+        BlockPool(const std::size_t blockCount, const std::size_t blockFrames)
+            : m_storage(blockCount * blockFrames * GetSampleSize(SAMPLE_FORMAT_IQ_FLOAT32)),
+              m_blocks(blockCount),
+              m_ready(blockCount),
+              m_free(blockCount),
+              m_blockFrames(blockFrames)
+        {
+            const std::size_t blockBytes = blockFrames * GetSampleSize(SAMPLE_FORMAT_IQ_FLOAT32);
+            for (uint32_t i = 0; i < blockCount; i++)
+            {
+                m_blocks[i].data = m_storage.data() + i * blockBytes;
+                m_free.Push(i);
+            }
+        }
+
+        /**
+         * Copies a transfer into free blocks, splitting it when it is larger than a block.
+         * Samples that find no free block are dropped and reported with the next block.
+         * @param transfer transfer from the stream callback.
+         */
+        void Push(const SDRTransfer& transfer)
+        {
+            m_pendingDropped += transfer.dropped_samples;
+
+            std::size_t offset = 0;
+            while (offset < transfer.frame_size)
+            {
+                uint32_t index;
+                if (!PopFree(index))
+                {
+                    const std::size_t lost = transfer.frame_size - offset;
+                    m_pendingDropped += lost;
+                    m_droppedTotal.fetch_add(lost, std::memory_order_relaxed);
+                    m_sampleIndex += lost;
+                    break;
+                }
+
+                Block& block = m_blocks[index];
+                block.frames = std::min(m_blockFrames, transfer.frame_size - offset);
+                block.format = transfer.format;
+                block.dropped = m_pendingDropped;
+                block.sampleIndex = m_sampleIndex;
+                ConvertTransfer(transfer, offset, block.data, transfer.format, block.frames);
+
+                m_pendingDropped = 0;
+                m_sampleIndex += block.frames;
+                offset += block.frames;
+                m_ready.Push(index);
+            }
+        }
+
+        /**
+         * Takes the oldest filled block.
+         * @return empty handle if no block is ready.
+         */
+        SampleBlock Take()
+        {
+            uint32_t index;
+            if (!m_ready.Pop(index))
+                return {};
+            return {this, index};
+        }
+
+        [[nodiscard]] bool HasReady() const
+        {
+            return !m_ready.Empty();
+        }
+
+        [[nodiscard]] uint64_t GetDroppedSamples() const
+        {
+            return m_droppedTotal.load(std::memory_order_relaxed);
+        }
+
+    private:
+        friend class SampleBlock;
+
+        struct Block
+        {
+            uint8_t* data = nullptr;
+            std::size_t frames = 0;
+            std::size_t dropped = 0;
+            SampleFormat format = SAMPLE_FORMAT_IQ_UINT8;
+            uint64_t sampleIndex = 0;
+        };
+
+        bool PopFree(uint32_t& index)
+        {
+            return m_free.Pop(index);
+        }
+
+        void Release(const uint32_t index)
+        {
+            // Handles may be released from any thread, the queue expects one producer at a time.
+            Lock();
+            m_free.Push(index);
+            m_freeLock.clear(std::memory_order_release);
+        }
+
+        void Lock()
+        {
+            while (m_freeLock.test_and_set(std::memory_order_acquire))
+            {
+            }
+        }
+
+        Buffer<uint8_t> m_storage;
+        std::vector<Block> m_blocks;
+        BlockQueue m_ready;
+        BlockQueue m_free;
+        std::atomic_flag m_freeLock = ATOMIC_FLAG_INIT;
+        std::size_t m_blockFrames;
+        std::size_t m_pendingDropped = 0;
+        uint64_t m_sampleIndex = 0;
+        std::atomic<uint64_t> m_droppedTotal{0};
+    };
+
+    inline SampleBlock::SampleBlock(BlockPool* pool, const uint32_t index)
+        : m_pool(pool), m_index(index)
+    {
+    }
+
+    inline SampleBlock::~SampleBlock()
+    {
+        Reset();
+    }
+
+    inline void SampleBlock::Reset()
+    {
+        if (m_pool)
+            m_pool->Release(m_index);
+        m_pool = nullptr;
+    }
+
+    inline const void* SampleBlock::data() const
+    {
+        return m_pool->m_blocks[m_index].data;
+    }
+
+    inline std::size_t SampleBlock::frame_size() const
+    {
+        return m_pool->m_blocks[m_index].frames;
+    }
+
+    inline std::size_t SampleBlock::dropped_samples() const
+    {
+        return m_pool->m_blocks[m_index].dropped;
+    }
+
+    inline SampleFormat SampleBlock::format() const
+    {
+        return m_pool->m_blocks[m_index].format;
+    }
+
+    inline uint64_t SampleBlock::sample_index() const
+    {
+        return m_pool->m_blocks[m_index].sampleIndex;
+    }
+
+    /**
+     * Awaitable view of a stream for a single consuming coroutine.
+     *
+     * The stream callback copies every transfer into a pooled block and posts the
+     * waiting coroutine to the executor. The receiving thread never takes a lock,
+     * the suspended coroutine is handed over through an atomic.
+     *
+     * @code
+     * PortSDR::Task Receive(PortSDR::AsyncStream<Loop>& async)
+     * {
+     *     while (PortSDR::SampleBlock block = co_await async.Next())
+     *     {
+     *         // block.data(), block.frame_size() ...
+     *     }
+     * }
+     * @endcode
+     */
+    template<Executor E>
+    class AsyncStream
+    {
+    public:
+        /**
+         * Installs the stream callback.
+         * @param stream stream to receive from.
+         * @param executor resumes the coroutine waiting in Next().
+         * @param blockCount amount of blocks that can be in flight.
+         * @param blockFrames IQ samples per block, larger transfers are split.
+         */
+        AsyncStream(Stream& stream, E& executor, const std::size_t blockCount = 16,
+                    const std::size_t blockFrames = 65536)
+            : m_stream(stream), m_executor(executor), m_pool(blockCount, blockFrames)
+        {
+            m_stream.SetCallback([this](SDRTransfer& transfer)
+            {
+                m_pool.Push(transfer);
+                Wake();
+            });
+        }
+
+        /**
+         * Removes the stream callback, waiting for a transfer that is being pushed,
+         * so it can be destroyed while the stream is still running.
+         */
+        ~AsyncStream()
+        {
+            m_stream.SetCallback(nullptr);
+        }
+
+        AsyncStream(const AsyncStream&) = delete;
+        AsyncStream& operator=(const AsyncStream&) = delete;
+
+        struct NextAwaitable
+        {
+            AsyncStream& stream;
+
+            bool await_ready() const noexcept
+            {
+                return stream.m_pool.HasReady() || stream.m_closed.load(std::memory_order_acquire);
+            }
+
+            bool await_suspend(const std::coroutine_handle<> handle) noexcept
+            {
+                stream.m_waiter.store(handle.address(), std::memory_order_release);
+
+                // A block may have arrived before the handle was published.
+                if (await_ready())
+                    return stream.m_waiter.exchange(nullptr, std::memory_order_acq_rel) == nullptr;
+                return true;
+            }
+
+            SampleBlock await_resume() noexcept
+            {
+                return stream.m_pool.Take();
+            }
+        };
+
+        /**
+         * Waits for the next block.
+         * @return awaitable resolving to the block, an empty block once closed.
+         */
+        NextAwaitable Next()
+        {
+            return {*this};
+        }
+
+        /**
+         * Resumes a waiting coroutine with an empty block once the queued blocks are consumed.
+         * Call after stopping the stream.
+         */
+        void Close()
+        {
+            m_closed.store(true, std::memory_order_release);
+            Wake();
+        }
+
+        /**
+         * Gets the amount of IQ samples dropped because no block was free.
+         */
+        [[nodiscard]] uint64_t GetDroppedSamples() const
+        {
+            return m_pool.GetDroppedSamples();
+        }
+
+    private:
+        void Wake()
+        {
+            void* waiter = m_waiter.exchange(nullptr, std::memory_order_acq_rel);
+            if (waiter)
+                m_executor.Post(std::coroutine_handle<>::from_address(waiter));
+        }
+
+        Stream& m_stream;
+        E& m_executor;
+        BlockPool m_pool;
+        std::atomic<void*> m_waiter{nullptr};
+        std::atomic<bool> m_closed{false};
+    };
+}
+
+#endif //PORTSDR_COROUTINE_H
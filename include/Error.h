@@ -16,6 +16,9 @@ namespace PortSDR
         HOST_UNAVAILABLE = -4,
         LIBUSB_ERROR = -5,
         UNINITIALIZED = -6,
+        NETWORK_ERROR = -7,
+        TIMEOUT = -8,
+        STOPPED = -9,
         UNKNOWN = -100
     };
 }
@@ -14,6 +14,7 @@ namespace PortSDR
         RTL_SDR,
         AIRSPY,
         AIRSPY_HF,
+        RTL_TCP,
     };
 
 
@@ -29,6 +30,9 @@ namespace PortSDR
 
         case HostType::AIRSPY_HF:
             return "AirSpy HF";
+
+        case HostType::RTL_TCP:
+            return "RTL-TCP";
         }
 
         return "Unknown";
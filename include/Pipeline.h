@@ -0,0 +1,204 @@
+#ifndef PORTSDR_PIPELINE_H
+#define PORTSDR_PIPELINE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "Error.h"
+#include "Stream.h"
+
+namespace PortSDR
+{
+    /**
+     * Pool of threads shared by any amount of pipelines.
+     * Every thread has its own queue of tasks, tasks submitted from a thread of
+     * the pool stay on it, idle threads steal the oldest tasks of the others.
+     */
+    class ThreadPool
+    {
+    public:
+        using Task = std::function<void()>;
+
+        /**
+         * @param threads amount of threads, 0 for one per core.
+         */
+        explicit ThreadPool(std::size_t threads = 0);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        void Submit(Task task);
+
+        [[nodiscard]] std::size_t GetThreadCount() const
+        {
+            return m_threads.size();
+        }
+
+    private:
+        struct Queue
+        {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+        };
+
+        void Worker(std::size_t index);
+        bool TryPop(std::size_t index, Task& task);
+
+    private:
+        std::vector<std::unique_ptr<Queue>> m_queues;
+        std::vector<std::thread> m_threads;
+        std::atomic<std::size_t> m_next{0};
+
+        std::mutex m_mutex;
+        std::condition_variable m_cond;
+        std::size_t m_pending = 0;
+        bool m_running = true;
+    };
+
+    struct StageStats
+    {
+        std::string name;
+        uint64_t blocks; // Blocks processed
+        uint64_t samples; // IQ samples processed
+        uint64_t dropped; // IQ samples dropped because the queue of the stage was full
+        std::size_t queue_depth; // Blocks waiting in the queue
+        double samples_per_second; // Average since Start()
+        double busy; // Fraction of the time since Start() spent running the stage
+    };
+
+    class Pipeline;
+    struct PipelineStage;
+    struct PipelineBlock;
+    struct PipelineBlockPool;
+
+    /**
+     * Hands the output of a stage to the stages connected to it.
+     */
+    class Emitter
+    {
+    public:
+        /**
+         * Copies samples into a new block for the next stages.
+         * @param transfer samples to pass on.
+         */
+        void Emit(const SDRTransfer& transfer);
+
+        /**
+         * Passes the input of the stage on unchanged, without copying it.
+         */
+        void Forward();
+
+    private:
+        friend class Pipeline;
+
+        Emitter(Pipeline& pipeline, PipelineStage& stage, PipelineBlock* input)
+            : m_pipeline(pipeline), m_stage(stage), m_input(input)
+        {
+        }
+
+        Pipeline& m_pipeline;
+        PipelineStage& m_stage;
+        PipelineBlock* m_input;
+    };
+
+    /**
+     * Graph of processing stages fed by a stream.
+     *
+     * Stages are connected by bounded lock-free queues and run as tasks on a ThreadPool.
+     * A stage never runs on two threads at once and sees its blocks in order,
+     * different stages run in parallel. Blocks waiting in a queue are processed back to back
+     * in one task. Nothing ever waits on a full queue, the block is dropped and counted instead.
+     */
+    class Pipeline
+    {
+    public:
+        using StageId = std::size_t;
+        // The input is shared with other stages and must not be changed.
+        using StageFunction = std::function<void(const SDRTransfer& input, Emitter& emitter)>;
+
+        /**
+         * @param pool threads running the stages, must outlive the pipeline.
+         * @param batch most blocks a stage processes before giving other stages a turn.
+         */
+        explicit Pipeline(ThreadPool& pool, std::size_t batch = 8);
+        ~Pipeline();
+
+        Pipeline(const Pipeline&) = delete;
+        Pipeline& operator=(const Pipeline&) = delete;
+
+        /**
+         * Adds a stage, only while stopped.
+         * @param name name reported in the stats.
+         * @param function processes one block.
+         * @param queueDepth amount of blocks that can wait for the stage.
+         * @return id of the stage.
+         */
+        StageId AddStage(std::string_view name, StageFunction function, std::size_t queueDepth = 16);
+
+        /**
+         * Sends everything emitted by a stage to another stage, only while stopped.
+         * @return ret code, INVALID_ARGUMENT for unknown stages or a stage connected to itself.
+         */
+        ErrorCode Connect(StageId from, StageId to);
+
+        /**
+         * Feeds every transfer of a stream into a stage.
+         * This replaces the callback of the stream, it is removed again when the pipeline is destroyed
+         * or another stream becomes the source. The stream must outlive the pipeline.
+         * @return ret code, INVALID_ARGUMENT for an unknown stage.
+         */
+        ErrorCode SetSource(Stream& stream, StageId stage);
+
+        /**
+         * Copies a transfer into the queue of a stage, never blocks.
+         * @return ret code, STOPPED if the pipeline isn't running.
+         */
+        ErrorCode Push(StageId stage, const SDRTransfer& transfer);
+
+        ErrorCode Start();
+
+        /**
+         * Stops accepting transfers and waits for the queued blocks to be processed.
+         */
+        void Stop();
+
+        [[nodiscard]] std::vector<StageStats> GetStats() const;
+
+    private:
+        friend class Emitter;
+
+        PipelineBlock* Acquire(const SDRTransfer& transfer);
+        void Release(PipelineBlock* block);
+        void Send(PipelineStage& from, PipelineBlock* block);
+        void Enqueue(PipelineStage& stage, PipelineBlock* block);
+        void Schedule(PipelineStage& stage);
+        void Run(PipelineStage& stage);
+        void Leave();
+
+    private:
+        ThreadPool& m_pool;
+        std::size_t m_batch;
+        std::vector<std::unique_ptr<PipelineStage>> m_stages;
+        std::unique_ptr<PipelineBlockPool> m_blocks;
+        Stream* m_source = nullptr;
+
+        std::atomic<bool> m_running{false};
+        std::atomic<std::size_t> m_active{0};
+        std::mutex m_idleMutex;
+        std::condition_variable m_idleCond;
+        std::chrono::steady_clock::time_point m_start;
+    };
+}
+
+#endif //PORTSDR_PIPELINE_H
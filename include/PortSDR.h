@@ -2,6 +2,7 @@
 #define PORTSDR_LIBRARY_H
 
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 #include <optional>
@@ -24,7 +25,8 @@ namespace PortSDR
         static std::string GetVersion();
 
         /**
-         * Constructs a new PortSDR instance with all available hosts.
+         * Constructs a new PortSDR instance.
+         * Hosts are created the first time their type is used, loading their vendor library only then.
          */
         PortSDR();
 
@@ -56,9 +58,18 @@ namespace PortSDR
          * @return error code {@link ErrorCode}.
          */
         [[nodiscard]] ErrorCode CreateStream(const Device& device, std::unique_ptr<Stream>& stream) const;
+
+        /**
+         * Gets whether a host is compiled in and its vendor library can be loaded.
+         * @param type type of Host API.
+         * @return true if the host can be used.
+         */
+        [[nodiscard]] bool IsHostAvailable(HostType type) const;
     private:
         [[nodiscard]] const Host* GetHost(HostType type) const;
-        std::vector<std::unique_ptr<Host>> m_hosts;
+
+        mutable std::mutex m_hostMutex;
+        mutable std::vector<std::unique_ptr<Host>> m_hosts;
     };
 }
 #endif //PORTSDR_LIBRARY_H
@@ -51,6 +51,12 @@ namespace PortSDR
         [[nodiscard]] double Step() const;
         [[nodiscard]] double Min() const;
         [[nodiscard]] double Max() const;
+
+        /**
+         * Expands the ranges into every single value they allow.
+         * @return values in the order of the ranges.
+         */
+        [[nodiscard]] std::vector<double> Values() const;
     };
 
     struct Gain
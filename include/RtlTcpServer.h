@@ -0,0 +1,124 @@
+#ifndef PORTSDR_RTLTCPSERVER_H
+#define PORTSDR_RTLTCPSERVER_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "Allocator.h"
+#include "Error.h"
+#include "Stream.h"
+
+namespace PortSDR
+{
+    /**
+     * Serves an opened stream over TCP using the rtl_tcp wire protocol.
+     *
+     * Samples of any format are converted to offset binary uint8 inside the
+     * stream callback and written into a single ring shared by all clients.
+     * A single epoll thread sends from each client's position in the ring and
+     * applies incoming rtl_tcp commands to the stream.
+     * Clients that fall more than half of the ring behind skip ahead to the newest samples.
+     * The ring grows to fit transfers larger than half of it, the transfers received meanwhile are dropped.
+     * A transfer that would overwrite samples still being sent is dropped as well.
+     */
+    class RtlTcpServer
+    {
+    public:
+        explicit RtlTcpServer(Stream& stream);
+        ~RtlTcpServer();
+
+        RtlTcpServer(const RtlTcpServer&) = delete;
+        RtlTcpServer& operator=(const RtlTcpServer&) = delete;
+
+        /**
+         * Binds the listening socket, installs the stream callback and starts the stream.
+         * @param address IPv4 address to listen on.
+         * @param port TCP port, 0 picks any free port.
+         * @return ret code
+         */
+        ErrorCode Start(std::string_view address, uint16_t port);
+
+        /**
+         * Stops the stream, removes the stream callback and disconnects every client.
+         * @return ret code
+         */
+        ErrorCode Stop();
+
+        /**
+         * Sets the tuner type reported in the rtl_tcp header.
+         * Clients use it to pick their gain tables. Defaults to R820T.
+         * @param type value of enum rtlsdr_tuner
+         */
+        void SetTunerType(uint32_t type);
+
+        /**
+         * Sets the size of the sample ring shared between clients.
+         * Only takes effect before Start(). The ring still grows to at least twice the size of a transfer.
+         * @param size in bytes, rounded up to a power of two
+         */
+        void SetBufferSize(std::size_t size);
+
+        /**
+         * Gets the port the server is listening on.
+         * @return port, 0 if not started.
+         */
+        [[nodiscard]] uint16_t GetPort() const;
+
+        [[nodiscard]] std::size_t GetClientCount() const;
+
+        /**
+         * Gets the amount of IQ samples dropped instead of written into the ring.
+         * @return dropped samples since the server was created.
+         */
+        [[nodiscard]] uint64_t GetDroppedSamples() const;
+
+    private:
+        struct Client;
+
+        void OnTransfer(const SDRTransfer& transfer);
+        void Process();
+        void ResizeRing();
+        void UpdateGainTable();
+
+        void Accept();
+        void Flush(Client& client);
+        bool ReadCommands(Client& client);
+        void HandleCommand(uint8_t command, uint32_t param);
+        void RemoveClient(Client& client);
+        void SetWriteInterest(Client& client, bool enabled) const;
+
+    private:
+        Stream& m_stream;
+
+        int m_listenFd = -1;
+        int m_epollFd = -1;
+        int m_wakeFd = -1;
+        uint16_t m_port = 0;
+
+        std::thread m_thread;
+        std::atomic<bool> m_running{false};
+
+        Buffer<uint8_t> m_ring;
+        std::size_t m_ringMask = 0;
+        std::mutex m_ringMutex; // Held by the producer while writing, by the epoll thread while resizing
+        std::atomic<std::size_t> m_ringWanted{0};
+        std::atomic<uint64_t> m_head{0};
+        std::atomic<uint64_t> m_writeEnd{0}; // End of the samples the producer is writing
+        std::atomic<uint64_t> m_sendFrom; // Start of the samples being sent, kNotSending if none
+        std::atomic<uint64_t> m_dropped{0};
+
+        std::vector<std::unique_ptr<Client>> m_clients;
+        std::atomic<std::size_t> m_clientCount{0};
+
+        uint32_t m_tunerType;
+        std::string m_gainStage;
+        std::vector<double> m_gains;
+    };
+}
+
+#endif //PORTSDR_RTLTCPSERVER_H
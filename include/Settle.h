@@ -0,0 +1,93 @@
+#ifndef PORTSDR_SETTLE_H
+#define PORTSDR_SETTLE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "Error.h"
+#include "Stream.h"
+
+namespace PortSDR
+{
+    struct SettleConfig
+    {
+        std::chrono::milliseconds window{50}; // Samples captured after every retune
+        std::size_t block_size = 256; // Samples the power and the correlation are measured over
+        double power_tolerance_db = 1.0; // Power difference to the settled signal that still counts as settled
+        double correlation_tolerance = 0.25; // Same for the lag-1 autocorrelation, relative to the settled power
+        bool apply = true; // Sets the result as the settle skip of the stream
+    };
+
+    struct SettleResult
+    {
+        std::string tuner; // Tuner the time belongs to
+        std::chrono::microseconds settle_time{0}; // Longest settle time of all retunes
+        std::chrono::microseconds average{0};
+        std::size_t retunes = 0;
+    };
+
+    /**
+     * Measures how long the tuner of a stream takes to settle after a retune.
+     *
+     * Every frequency is tuned to once and the samples following its frequency tag are captured.
+     * The signal counts as settled once the power and the lag-1 autocorrelation of each block
+     * stay close to those of the end of the capture, PLL lock and filter transients move both.
+     * The time counts from the sample the frequency tag is anchored to, where SetSettleSkip() starts skipping,
+     * so it includes the samples the hardware had buffered when the retune was applied.
+     * Process() must be called from the stream callback of the running stream.
+     */
+    class RetuneCalibrator
+    {
+    public:
+        explicit RetuneCalibrator(Stream& stream);
+
+        RetuneCalibrator(const RetuneCalibrator&) = delete;
+        RetuneCalibrator& operator=(const RetuneCalibrator&) = delete;
+
+        /**
+         * Retunes to each frequency and measures the settle time.
+         * The result is remembered for the tuner of the stream, see GetCalibratedSettleTime().
+         * @param frequencies retuned to in order, consecutive ones should differ.
+         * @param result measured settle time.
+         * @param config settings of the measurement.
+         * @return ret code, TIMEOUT if the stream delivered no samples after a retune.
+         */
+        ErrorCode Calibrate(const std::vector<uint32_t>& frequencies, SettleResult& result,
+                            const SettleConfig& config = {});
+
+        /**
+         * Captures the samples after the retune being measured.
+         * @param transfer transfer from the stream callback.
+         */
+        void Process(const SDRTransfer& transfer);
+
+    private:
+        ErrorCode Measure(uint32_t freq, const SettleConfig& config, std::size_t& settle);
+
+    private:
+        Stream& m_stream;
+
+        std::atomic<bool> m_armed{false};
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+        uint32_t m_target = 0;
+        bool m_capturing = false;
+        std::size_t m_needed = 0;
+        std::vector<float> m_capture;
+    };
+
+    /**
+     * Gets the settle time last calibrated for a tuner in this process.
+     * @param tuner name from Stream::GetTunerType().
+     * @return settle time, empty if the tuner wasn't calibrated.
+     */
+    std::optional<std::chrono::microseconds> GetCalibratedSettleTime(const std::string& tuner);
+}
+
+#endif //PORTSDR_SETTLE_H
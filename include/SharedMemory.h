@@ -0,0 +1,153 @@
+#ifndef PORTSDR_SHAREDMEMORY_H
+#define PORTSDR_SHAREDMEMORY_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Error.h"
+#include "Stream.h"
+
+namespace PortSDR
+{
+    struct ShmHeader;
+    struct ShmSlot;
+
+    /**
+     * Block of samples living in shared memory.
+     * The data is only guaranteed to be intact if ShmSubscriber::IsValid()
+     * still returns true after it has been used.
+     */
+    struct ShmBlock
+    {
+        const void* data;
+        std::size_t frame_size;
+        std::size_t dropped_samples;
+        SampleFormat format;
+        uint64_t sample_index; // Index of the first sample since the publisher was created
+        uint64_t sequence; // Block number
+    };
+
+    struct ShmReaderInfo
+    {
+        int pid;
+        uint64_t lag; // Blocks published but not read yet
+        uint64_t lost; // Blocks overwritten before they were read
+    };
+
+    /**
+     * Publishes stream transfers into a POSIX shared memory ring for other processes.
+     *
+     * The publisher never waits on readers. Readers that lag behind lose the
+     * oldest blocks, readers that crash simply leave a stale cursor behind.
+     * Call Publish() from the stream callback.
+     */
+    class ShmPublisher
+    {
+    public:
+        ShmPublisher() = default;
+        ~ShmPublisher();
+
+        ShmPublisher(const ShmPublisher&) = delete;
+        ShmPublisher& operator=(const ShmPublisher&) = delete;
+
+        /**
+         * Creates the shared memory segment, replacing a stale one with the same name
+         * left behind by a publisher that died.
+         * @param name name of the segment, e.g. "/portsdr-rtl0".
+         * @param slotCount amount of blocks kept in the ring.
+         * @param slotSize maximum size of a block in bytes. Larger transfers are split.
+         * @return ret code, FAILED_TO_INITIALIZE if a publisher that is still alive owns the name.
+         */
+        ErrorCode Create(std::string_view name, std::size_t slotCount, std::size_t slotSize);
+
+        /**
+         * Removes the shared memory segment. Readers keep their mapping but receive no more blocks.
+         */
+        void Close();
+
+        /**
+         * Copies the transfer into the ring and wakes waiting readers.
+         * @param transfer transfer from the stream callback.
+         * @return ret code
+         */
+        ErrorCode Publish(const SDRTransfer& transfer);
+
+        /**
+         * Gets the readers which are currently attached and alive.
+         * @return reader information.
+         */
+        [[nodiscard]] std::vector<ShmReaderInfo> GetReaders() const;
+
+    private:
+        [[nodiscard]] ShmSlot* GetSlot(uint64_t block) const;
+
+    private:
+        std::string m_name;
+        int m_fd = -1;
+        void* m_map = nullptr;
+        std::size_t m_mapSize = 0;
+        ShmHeader* m_header = nullptr;
+    };
+
+    /**
+     * Reads blocks published by a ShmPublisher in another process without copying them.
+     */
+    class ShmSubscriber
+    {
+    public:
+        ShmSubscriber() = default;
+        ~ShmSubscriber();
+
+        ShmSubscriber(const ShmSubscriber&) = delete;
+        ShmSubscriber& operator=(const ShmSubscriber&) = delete;
+
+        /**
+         * Maps an existing segment and claims a reader slot.
+         * Reading starts at the newest block.
+         * @param name name given to ShmPublisher::Create().
+         * @return ret code
+         */
+        ErrorCode Open(std::string_view name);
+        void Close();
+
+        /**
+         * Waits for the next block.
+         * @param block filled with a view of the block in shared memory.
+         * @param timeout how long to wait for the publisher.
+         * @return ret code, TIMEOUT if nothing was published in time.
+         */
+        ErrorCode Next(ShmBlock& block, std::chrono::milliseconds timeout);
+
+        /**
+         * Checks that a block was not overwritten by the publisher.
+         * Call after the data of the block has been consumed.
+         * @param block block returned by Next().
+         * @return true if the data that was read is intact.
+         */
+        [[nodiscard]] bool IsValid(const ShmBlock& block) const;
+
+        /**
+         * Gets the amount of blocks that were overwritten before they could be read.
+         * @return lost blocks.
+         */
+        [[nodiscard]] uint64_t GetLostBlocks() const;
+
+    private:
+        [[nodiscard]] const ShmSlot* GetSlot(uint64_t block) const;
+        void AddLost(uint64_t count);
+
+    private:
+        int m_fd = -1;
+        void* m_map = nullptr;
+        std::size_t m_mapSize = 0;
+        ShmHeader* m_header = nullptr;
+        int m_reader = -1;
+        uint64_t m_cursor = 0;
+        uint64_t m_lost = 0;
+    };
+}
+
+#endif //PORTSDR_SHAREDMEMORY_H
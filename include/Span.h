@@ -0,0 +1,75 @@
+#ifndef PORTSDR_SPAN_H
+#define PORTSDR_SPAN_H
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+namespace PortSDR
+{
+    /**
+     * Non-owning view over contiguous memory, a minimal std::span for C++17.
+     * Constructs from a pointer and size, a C array, or any container with data() and size().
+     */
+    template<typename T>
+    class Span
+    {
+    public:
+        constexpr Span() = default;
+
+        constexpr Span(T* data, const std::size_t size)
+            : m_data(data), m_size(size)
+        {
+        }
+
+        template<std::size_t N>
+        constexpr Span(T (&array)[N])
+            : m_data(array), m_size(N)
+        {
+        }
+
+        template<typename Container,
+                 typename = std::enable_if_t<
+                     std::is_convertible_v<decltype(std::declval<Container&>().data()), T*>>>
+        constexpr Span(Container& container)
+            : m_data(container.data()), m_size(container.size())
+        {
+        }
+
+        [[nodiscard]] constexpr T* data() const
+        {
+            return m_data;
+        }
+
+        [[nodiscard]] constexpr std::size_t size() const
+        {
+            return m_size;
+        }
+
+        [[nodiscard]] constexpr bool empty() const
+        {
+            return m_size == 0;
+        }
+
+        constexpr T& operator[](const std::size_t index) const
+        {
+            return m_data[index];
+        }
+
+        [[nodiscard]] constexpr T* begin() const
+        {
+            return m_data;
+        }
+
+        [[nodiscard]] constexpr T* end() const
+        {
+            return m_data + m_size;
+        }
+
+    private:
+        T* m_data = nullptr;
+        std::size_t m_size = 0;
+    };
+}
+
+#endif //PORTSDR_SPAN_H
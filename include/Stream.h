@@ -5,11 +5,26 @@
 #ifndef PORTSDR_STREAM_H
 #define PORTSDR_STREAM_H
 
+#include <atomic>
+#include <chrono>
+#include <complex>
+#include <condition_variable>
 #include <cstdint>
+#include <cstddef>
 #include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
 
+#include "Allocator.h"
+#include "Device.h"
 #include "Error.h"
 #include "Ranges.h"
+#include "Span.h"
 
 namespace PortSDR
 {
@@ -20,6 +35,79 @@ namespace PortSDR
         SAMPLE_FORMAT_IQ_FLOAT32,
     };
 
+    /**
+     * Gets the size of a single IQ sample.
+     * @param format sample format.
+     * @return size in bytes of both I and Q.
+     */
+    constexpr std::size_t GetSampleSize(const SampleFormat format)
+    {
+        switch (format)
+        {
+        case SAMPLE_FORMAT_IQ_UINT8:
+            return 2 * sizeof(uint8_t);
+        case SAMPLE_FORMAT_IQ_INT16:
+            return 2 * sizeof(int16_t);
+        case SAMPLE_FORMAT_IQ_FLOAT32:
+            return 2 * sizeof(float);
+        }
+
+        return 0;
+    }
+
+    enum SampleLayout
+    {
+        SAMPLE_LAYOUT_INTERLEAVED, // I and Q alternate
+        SAMPLE_LAYOUT_PLANAR, // All I values, then all Q values
+    };
+
+    /**
+     * One IQ sample of an integer format, I and Q interleaved.
+     */
+    template<typename T>
+    struct IQ
+    {
+        T i;
+        T q;
+    };
+
+    /**
+     * Type of a single IQ sample of a sample format, and of its I or Q value.
+     */
+    template<SampleFormat Format>
+    struct SampleTraits;
+
+    template<>
+    struct SampleTraits<SAMPLE_FORMAT_IQ_UINT8>
+    {
+        using type = IQ<uint8_t>;
+        using value = uint8_t;
+    };
+
+    template<>
+    struct SampleTraits<SAMPLE_FORMAT_IQ_INT16>
+    {
+        using type = IQ<int16_t>;
+        using value = int16_t;
+    };
+
+    template<>
+    struct SampleTraits<SAMPLE_FORMAT_IQ_FLOAT32>
+    {
+        using type = std::complex<float>;
+        using value = float;
+    };
+
+    template<SampleFormat Format>
+    using SampleType = typename SampleTraits<Format>::type;
+
+    template<SampleFormat Format>
+    using SampleValue = typename SampleTraits<Format>::value;
+
+    static_assert(sizeof(SampleType<SAMPLE_FORMAT_IQ_UINT8>) == GetSampleSize(SAMPLE_FORMAT_IQ_UINT8));
+    static_assert(sizeof(SampleType<SAMPLE_FORMAT_IQ_INT16>) == GetSampleSize(SAMPLE_FORMAT_IQ_INT16));
+    static_assert(sizeof(SampleType<SAMPLE_FORMAT_IQ_FLOAT32>) == GetSampleSize(SAMPLE_FORMAT_IQ_FLOAT32));
+
     enum GainMode : int
     {
         GAIN_MODE_FREE = 0,
@@ -27,21 +115,153 @@ namespace PortSDR
         GAIN_MODE_SENSITIVITY,
     };
 
+    /**
+     * Health metrics of a block of samples, relative to full scale 1.0.
+     */
+    struct SignalHealth
+    {
+        float rms; // Square root of the average I² + Q²
+        float peak; // Largest |I| or |Q|
+        float saturation; // Fraction of I and Q values at the limits of the ADC
+        float dc_i; // Average of I
+        float dc_q; // Average of Q
+    };
+
+    enum StreamTagType
+    {
+        STREAM_TAG_FREQUENCY, // value is the center frequency in Hz
+        STREAM_TAG_GAIN, // value is the gain in dB, name holds the gain stage
+        STREAM_TAG_SAMPLE_RATE, // value is the sample rate in Hz
+        STREAM_TAG_FORMAT, // value is the SampleFormat
+        STREAM_TAG_OVERFLOW, // value is the amount of samples dropped right before this one
+        STREAM_TAG_RECOVERY, // value is the estimated amount of samples lost while recovering
+    };
+
+    /**
+     * Change of the stream, anchored to the first sample delivered after it was applied.
+     * Samples the hardware or its library had already buffered when the change was applied
+     * are delivered before the tag, so they may still reflect the old setting.
+     */
+    struct StreamTag
+    {
+        StreamTagType type;
+        double value;
+        std::size_t offset; // IQ sample within the transfer
+        uint64_t sample_index; // Same sample, counted from the first transfer including dropped samples
+        char name[16];
+    };
+
     struct SDRTransfer
     {
         void* data;
         std::size_t frame_size;
         std::size_t dropped_samples; // Some APIs may report dropped samples
         SampleFormat format; // Sample format of the data
+        const SignalHealth* health; // Only set while health monitoring is enabled
+        bool discontinuity; // First transfer after the stream was recovered, dropped_samples holds the gap
+        const StreamTag* tags; // Changes taking effect within this transfer, ordered by offset
+        std::size_t tag_count;
+        SampleLayout layout; // SAMPLE_LAYOUT_PLANAR holds the I values in data and the Q values in data_q
+        void* data_q;
+    };
+
+    /**
+     * Views the samples of a transfer.
+     * @tparam Format format of the transfer, it isn't checked.
+     * @param transfer transfer to view.
+     * @return frame_size IQ samples of the transfer.
+     */
+    template<SampleFormat Format>
+    Span<const SampleType<Format>> GetSamples(const SDRTransfer& transfer)
+    {
+        return {static_cast<const SampleType<Format>*>(transfer.data), transfer.frame_size};
+    }
+
+    /**
+     * Views the I values of a planar transfer.
+     * @tparam Format format of the transfer, it isn't checked.
+     * @param transfer transfer in SAMPLE_LAYOUT_PLANAR.
+     * @return frame_size I values of the transfer.
+     */
+    template<SampleFormat Format>
+    Span<const SampleValue<Format>> GetInPhase(const SDRTransfer& transfer)
+    {
+        return {static_cast<const SampleValue<Format>*>(transfer.data), transfer.frame_size};
+    }
+
+    /**
+     * Views the Q values of a planar transfer.
+     * @tparam Format format of the transfer, it isn't checked.
+     * @param transfer transfer in SAMPLE_LAYOUT_PLANAR.
+     * @return frame_size Q values of the transfer.
+     */
+    template<SampleFormat Format>
+    Span<const SampleValue<Format>> GetQuadrature(const SDRTransfer& transfer)
+    {
+        return {static_cast<const SampleValue<Format>*>(transfer.data_q), transfer.frame_size};
+    }
+
+    /**
+     * Copies samples of a transfer in either layout as interleaved values, converted in the same pass.
+     * @param transfer source transfer.
+     * @param from first IQ sample of the transfer to copy.
+     * @param dst destination, must hold count IQ samples of format.
+     * @param format sample format of dst.
+     * @param count amount of IQ samples.
+     */
+    void ConvertTransfer(const SDRTransfer& transfer, std::size_t from, void* dst, SampleFormat format,
+                         std::size_t count);
+
+    struct RecoveryConfig
+    {
+        std::chrono::milliseconds stall_timeout{2000}; // No transfer for this long counts as a failure
+        std::chrono::milliseconds retry_interval{500}; // Wait between attempts to reopen the hardware
+        uint32_t max_attempts = 0; // Attempts in a row before giving up, 0 never gives up
+    };
+
+    struct RecoveryEvent
+    {
+        ErrorCode cause; // TIMEOUT for a stall, otherwise the error reported by the hardware
+        uint32_t attempts; // Attempts it took to reopen the hardware
+        std::chrono::milliseconds downtime; // From the last transfer until streaming restarted
+        bool recovered; // false if max_attempts were used up, the stream stays down
     };
 
+    struct RecoveryStats
+    {
+        uint64_t recoveries;
+        uint64_t failures; // Times max_attempts were used up
+        std::chrono::milliseconds last_downtime;
+        std::chrono::milliseconds total_downtime;
+    };
+
+    struct StreamCommands;
+
+    /**
+     * Thread safety:
+     * The callback runs on the receiving thread of the stream. Start(), Stop() and the setters
+     * may be called from any other thread, the implementations serialize them on a control lock
+     * that the receiving thread never takes. The getters don't take it, they return values cached
+     * when the device was opened or last set, so they are safe from the callback too.
+     * The callback itself must not call Stop() or a blocking setter, those wait on the control lock
+     * that Stop() holds while it joins the receiving thread. The Async setters are safe from anywhere,
+     * they are pushed onto a mutex guarded queue and applied in the order they were submitted
+     * by the control thread of the stream. Use one or the other for a setting, a blocking setter isn't ordered against queued ones.
+     * SetCallback() and SetTypedCallback() may be called while streaming, they wait for a running callback
+     * to return, so state captured by the old callback can be destroyed right after.
+     */
     class Stream
     {
     public:
         using SDR_CALLBACK = std::function<void(SDRTransfer& transfer)>;
+        using RECOVERY_CALLBACK = std::function<void(const RecoveryEvent& event)>;
+        using COMMAND = std::function<ErrorCode(Stream& stream)>;
+
+        template<SampleFormat Format>
+        using TYPED_CALLBACK = std::function<void(Span<const SampleType<Format>> samples, SDRTransfer& transfer)>;
 
-        Stream() = default;
-        virtual ~Stream() = default;
+        Stream();
+        virtual ~Stream();
 
         /**
          * Gets
@@ -127,13 +347,418 @@ namespace PortSDR
 
         [[nodiscard]] virtual GainMode GetGainMode() const = 0;
 
+        /**
+         * Sets a hardware specific setting that has no dedicated setter.
+         * @param key name of the setting
+         * @param value new value of the setting
+         * @return ret code, INVALID_ARGUMENT if the hardware doesn't have the setting.
+         */
+        virtual ErrorCode SetSetting([[maybe_unused]] std::string_view key, [[maybe_unused]] std::string_view value)
+        {
+            return ErrorCode::INVALID_ARGUMENT;
+        }
+
+        /**
+         * Gets a hardware specific setting.
+         * @param key name of the setting
+         * @return value of the setting, empty if the hardware doesn't have the setting.
+         */
+        [[nodiscard]] virtual std::string GetSetting([[maybe_unused]] std::string_view key) const
+        {
+            return {};
+        }
+
+        /**
+         * Gets the tuner chip of the hardware, settle times are calibrated per tuner.
+         * @return name of the tuner, empty if unknown.
+         */
+        [[nodiscard]] virtual std::string GetTunerType() const
+        {
+            return {};
+        }
+
+        /**
+         * Sets the callback called for every transfer on the receiving thread.
+         * Waits for the previous callback to return if it is running on another thread.
+         * @param sdr_callback callback, empty to remove it.
+         * @return 0
+         */
         int SetCallback(SDR_CALLBACK sdr_callback)
         {
-            m_callback = std::move(sdr_callback);
+            SwapCallback(std::move(sdr_callback));
+            m_boundFormat = -1;
             return 0;
         }
+
+        /**
+         * Sets a callback that gets the samples of each transfer already typed as Format,
+         * so it doesn't have to branch on SDRTransfer::format.
+         * The stream is switched to Format and bound to it, SetSampleFormat() rejects every other format
+         * until SetCallback() or another SetTypedCallback() replaces the callback.
+         * Transfers received in the old format before the switch are skipped.
+         *
+         * @param callback callback, the transfer is passed along for its tags and health.
+         * @return ret code of switching to Format, the previous callback stays if it failed.
+         *  INVALID_ARGUMENT if the stream is in SAMPLE_LAYOUT_PLANAR.
+         */
+        template<SampleFormat Format>
+        ErrorCode SetTypedCallback(TYPED_CALLBACK<Format> callback)
+        {
+            if (GetSampleLayout() != SAMPLE_LAYOUT_INTERLEAVED)
+                return ErrorCode::INVALID_ARGUMENT;
+
+            const int bound = m_boundFormat.exchange(-1);
+
+            const ErrorCode ret = SetSampleFormat(Format);
+            if (ret != ErrorCode::OK)
+            {
+                m_boundFormat = bound;
+                return ret;
+            }
+
+            SwapCallback([callback = std::move(callback)](SDRTransfer& transfer)
+            {
+                if (transfer.format == Format)
+                    callback(GetSamples<Format>(transfer), transfer);
+            });
+            m_boundFormat = Format;
+            return ErrorCode::OK;
+        }
+
+        /**
+         * Sets how the I and Q values are laid out for the callback, ReadInto() and Drain().
+         * In SAMPLE_LAYOUT_PLANAR the callback gets the I values in SDRTransfer::data
+         * and the Q values in SDRTransfer::data_q. They are split in the same pass that converts the samples
+         * of the hardware. Transfers received while switching may still have the old SDRTransfer::layout.
+         * Helpers that set the callback themselves take either layout.
+         * @param layout new layout.
+         * @return ret code, INVALID_ARGUMENT if a typed callback is set, it only takes interleaved samples.
+         */
+        ErrorCode SetSampleLayout(SampleLayout layout);
+
+        [[nodiscard]] SampleLayout GetSampleLayout() const
+        {
+            return m_layout.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * Reads samples straight into a caller owned buffer.
+         * A transfer that arrives while a reader waits is converted from the buffer of the hardware
+         * into dst in a single pass, without any copies or allocations in between.
+         *
+         * Once used, transfers that arrive while no reader waits, and the part of a transfer a reader
+         * had no room for, are copied into a bounded buffer that is read first. The receiving thread never
+         * waits for a reader to come back, what doesn't fit is dropped and counted by GetReadOverflows().
+         * The callback still gets every transfer first.
+         * Values are interleaved I and Q. In SAMPLE_LAYOUT_PLANAR the first half of dst receives the I values
+         * and the second half the Q values, split in the same pass as the conversion.
+         * std::complex is always interleaved.
+         *
+         * @param dst destination buffer.
+         * @param frames amount of IQ samples written into dst.
+         * @param timeout how long to wait for samples.
+         * @return ret code, TIMEOUT if no samples arrived, STOPPED if the stream stopped while waiting.
+         */
+        ErrorCode ReadInto(Span<uint8_t> dst, std::size_t& frames,
+                           std::chrono::milliseconds timeout = std::chrono::milliseconds(1000));
+        ErrorCode ReadInto(Span<int16_t> dst, std::size_t& frames,
+                           std::chrono::milliseconds timeout = std::chrono::milliseconds(1000));
+        ErrorCode ReadInto(Span<float> dst, std::size_t& frames,
+                           std::chrono::milliseconds timeout = std::chrono::milliseconds(1000));
+        ErrorCode ReadInto(Span<std::complex<float>> dst, std::size_t& frames,
+                           std::chrono::milliseconds timeout = std::chrono::milliseconds(1000));
+
+        /**
+         * Gets the amount of IQ samples dropped because ReadInto() didn't keep up.
+         * @return dropped samples since the stream was created.
+         */
+        [[nodiscard]] uint64_t GetReadOverflows() const;
+
+        /**
+         * Buffers transfers for an event loop, GetPollFd() becomes readable
+         * once at least watermark samples are buffered.
+         * The buffer is created on the first call, later calls only change the watermark.
+         * @param watermark amount of IQ samples to buffer before waking up, at least 1.
+         * @param capacity amount of IQ samples the buffer holds, 0 picks 4 times the watermark.
+         *                 Should hold several transfers, a larger transfer is always dropped.
+         * @return ret code, HOST_UNAVAILABLE if the platform doesn't have eventfd.
+         */
+        ErrorCode SetPollWatermark(std::size_t watermark, std::size_t capacity = 0);
+
+        /**
+         * Gets the file descriptor to poll for readability, see SetPollWatermark().
+         * @return eventfd, -1 if polling isn't enabled.
+         */
+        [[nodiscard]] int GetPollFd() const;
+
+        /**
+         * Takes buffered samples without blocking, converted into the element type of dst.
+         * Laid out like ReadInto().
+         * @param dst destination buffer.
+         * @param frames amount of IQ samples written into dst, 0 if nothing is buffered.
+         * @return ret code, UNINITIALIZED if polling isn't enabled.
+         */
+        ErrorCode Drain(Span<uint8_t> dst, std::size_t& frames);
+        ErrorCode Drain(Span<int16_t> dst, std::size_t& frames);
+        ErrorCode Drain(Span<float> dst, std::size_t& frames);
+        ErrorCode Drain(Span<std::complex<float>> dst, std::size_t& frames);
+
+        /**
+         * Gets the amount of IQ samples dropped because the poll buffer was full.
+         * Transfers that don't fit are dropped as a whole, so the samples drained are only
+         * discontinuous at the boundaries of transfers.
+         * @return dropped samples since polling was enabled.
+         */
+        [[nodiscard]] uint64_t GetPollOverflows() const;
+
+        /**
+         * Measures the health of every transfer before it is handed out,
+         * see SDRTransfer::health.
+         * @param enable true to measure.
+         */
+        void SetHealthMonitor(bool enable);
+
+        /**
+         * Gets the health metrics averaged over the last transfers.
+         * The peak is held and decays slowly instead.
+         * @return rolling health metrics, all zero until a transfer was measured.
+         */
+        [[nodiscard]] SignalHealth GetHealth() const;
+
+        /**
+         * Supervises the stream once it delivered its first transfer. When the hardware reports an error
+         * or no transfer arrives within the stall timeout, the same device is opened again by its serial,
+         * the last frequency, sample rate, gain and format are applied and streaming restarts.
+         * Readers keep waiting meanwhile. The first transfer afterward is marked with SDRTransfer::discontinuity.
+         * @param config timeouts of the supervisor.
+         * @return ret code, HOST_UNAVAILABLE if the hardware can't be reopened.
+         */
+        ErrorCode SetRecovery(const RecoveryConfig& config);
+
+        /**
+         * Stops supervising the stream.
+         */
+        void DisableRecovery();
+
+        /**
+         * Sets the callback called from the supervising thread after each recovery or when it gives up.
+         * @param callback callback, empty to remove it.
+         */
+        void SetRecoveryCallback(RECOVERY_CALLBACK callback);
+
+        /**
+         * @return counts and downtime of the recoveries so far.
+         */
+        [[nodiscard]] RecoveryStats GetRecoveryStats() const;
+
+        /**
+         * Drops the samples received while the tuner settles after each retune.
+         * The first sample after them carries the frequency tag, dropped_samples counts the skipped samples.
+         * See RetuneCalibrator to measure the time.
+         * @param time skipped after each frequency tag, 0 disables skipping.
+         */
+        void SetSettleSkip(std::chrono::microseconds time);
+
+        [[nodiscard]] std::chrono::microseconds GetSettleSkip() const;
+
+        /**
+         * Queues a command for the control thread of the stream, which is started by the first one.
+         * Commands run one at a time, in the order they were submitted.
+         * @param command function applied to this stream.
+         * @return future of the ret code of the command, STOPPED if the stream is destroyed before it ran.
+         */
+        std::future<ErrorCode> Submit(COMMAND command);
+
+        /**
+         * Queued versions of the setters, see Submit().
+         * @return future of the ret code of the setter.
+         */
+        std::future<ErrorCode> SetSampleRateAsync(uint32_t sampleRate);
+        std::future<ErrorCode> SetCenterFrequencyAsync(uint32_t freq);
+        std::future<ErrorCode> SetSampleFormatAsync(SampleFormat format);
+        std::future<ErrorCode> SetGainAsync(double gain, std::string_view name);
+        std::future<ErrorCode> SetGainModeAsync(GainMode mode);
+
     protected:
-        SDR_CALLBACK m_callback;
+        /**
+         * Hands a transfer to the callback and to ReadInto().
+         * Implementations call this from their receiving thread for every transfer.
+         * @param transfer samples received from the hardware.
+         */
+        void Deliver(SDRTransfer& transfer);
+
+        /**
+         * Wakes up ReadInto() and releases a held transfer.
+         * Implementations call this before stopping their receiving thread.
+         */
+        void CancelReads();
+
+        /**
+         * @return true if Deliver() expects planar transfers.
+         * Implementations split the values in their own conversion, see PreparePlanar().
+         * Interleaved transfers are split by Deliver() instead.
+         */
+        [[nodiscard]] bool IsPlanar() const
+        {
+            return GetSampleLayout() == SAMPLE_LAYOUT_PLANAR;
+        }
+
+        /**
+         * Points a transfer at planes for the I and Q values, in a buffer owned by the stream.
+         * Only for the receiving thread, the planes stay valid until the next call.
+         * @param transfer gets data, data_q, format and layout.
+         * @param frames amount of IQ samples.
+         * @param format sample format of the values.
+         */
+        void PreparePlanar(SDRTransfer& transfer, std::size_t frames, SampleFormat format);
+
+        /**
+         * @return true if Deliver() expects SDRTransfer::health to be filled in.
+         */
+        [[nodiscard]] bool IsHealthMonitored() const
+        {
+            return m_healthEnabled.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * Closes the hardware, opens the same device again, applies the last settings and restarts streaming.
+         * Called from the supervising thread while the stream is supposed to be running.
+         * @return ret code, STOPPED if the stream was stopped meanwhile.
+         */
+        virtual ErrorCode Reopen()
+        {
+            return ErrorCode::HOST_UNAVAILABLE;
+        }
+
+        /**
+         * @return true if Reopen() is implemented.
+         */
+        [[nodiscard]] virtual bool CanReopen() const
+        {
+            return false;
+        }
+
+        /**
+         * Wakes up the supervisor to recover right away.
+         * Implementations call this when the hardware reports an error while streaming.
+         * @param error cause of the failure.
+         */
+        void ReportFailure(ErrorCode error);
+
+        /**
+         * Tags the stream with a change that was just applied to the hardware.
+         * The tag is anchored to the count of samples delivered so far, so it lands on the first sample
+         * of the next transfer.
+         * Implementations call this after each successful setter.
+         * @param type kind of change.
+         * @param value new value.
+         * @param name gain stage of STREAM_TAG_GAIN.
+         */
+        void PostTag(StreamTagType type, double value, std::string_view name = {});
+
+        /**
+         * Stops the control thread, commands that didn't run yet complete with STOPPED.
+         * Implementations call this first in their destructor, before the hardware is closed.
+         */
+        void StopCommands();
+
+        /**
+         * Implementations call this first in SetSampleFormat().
+         * @param format requested format.
+         * @return ret code, INVALID_ARGUMENT if a typed callback bound the stream to another format.
+         */
+        [[nodiscard]] ErrorCode CheckSampleFormat(SampleFormat format) const;
+
+    private:
+        void SwapCallback(SDR_CALLBACK callback);
+
+        ErrorCode Read(void* dst, SampleFormat format, std::size_t capacity, bool planar, std::size_t& frames,
+                       std::chrono::milliseconds timeout);
+        void PushRead(const SDRTransfer& transfer, std::size_t offset);
+
+        void PushPoll(const SDRTransfer& transfer);
+        ErrorCode DrainPoll(void* dst, SampleFormat format, std::size_t capacity, bool planar, std::size_t& frames);
+        void SignalPoll();
+
+        void UpdateHealth(const SignalHealth& health);
+
+        void AttachTags(SDRTransfer& transfer);
+        void SkipSettling(SDRTransfer& transfer);
+        void Dispatch(SDRTransfer& transfer);
+
+        /* Held by the receiving thread while the callback runs. Recursive, so the callback can replace itself,
+         * the receiving thread keeps its own reference until it returns. */
+        std::recursive_mutex m_callbackMutex;
+        std::shared_ptr<SDR_CALLBACK> m_callback;
+
+        std::atomic<int> m_boundFormat{-1}; // SampleFormat of the typed callback, -1 if there is none
+        std::atomic<SampleLayout> m_layout{SAMPLE_LAYOUT_INTERLEAVED};
+        Buffer<uint8_t> m_planar; // Planes of PreparePlanar(), owned by the receiving thread
+
+        std::mutex m_readMutex;
+        std::condition_variable m_readCond;
+        SDRTransfer* m_pending = nullptr;
+        std::size_t m_pendingOffset = 0;
+        uint64_t m_readGeneration = 0;
+        std::size_t m_readers = 0; // Threads waiting in ReadInto()
+        bool m_readEnabled = false; // Transfers are buffered for ReadInto() once it was used
+
+        /* Ring of interleaved bytes in m_readFormat, guarded by m_readMutex */
+        Buffer<uint8_t> m_readRing;
+        uint64_t m_readHead = 0;
+        uint64_t m_readTail = 0;
+        SampleFormat m_readFormat = SAMPLE_FORMAT_IQ_UINT8;
+        std::atomic<uint64_t> m_readOverflows{0};
+
+        /* Single producer, single consumer ring of interleaved bytes in m_pollFormat */
+        Buffer<uint8_t> m_pollRing;
+        std::atomic<uint64_t> m_pollHead{0};
+        std::atomic<uint64_t> m_pollTail{0};
+        std::atomic<std::size_t> m_pollWatermark{0};
+        std::atomic<uint64_t> m_pollOverflows{0};
+        std::atomic<bool> m_pollSignalled{false};
+        std::atomic<bool> m_pollEnabled{false};
+        std::atomic<SampleFormat> m_pollFormat{SAMPLE_FORMAT_IQ_UINT8};
+        bool m_pollFormatSet = false;
+        int m_pollFd = -1;
+
+        std::atomic<bool> m_healthEnabled{false};
+        mutable std::mutex m_healthMutex;
+        SignalHealth m_health{};
+        bool m_healthMeasured = false;
+
+        std::mutex m_tagMutex;
+        std::vector<StreamTag> m_pendingTags; // sample_index is the count of delivered samples when posted
+        std::atomic<bool> m_tagsPending{false};
+        std::vector<StreamTag> m_tags; // Owned by the receiving thread
+        std::atomic<uint64_t> m_sampleIndex{0}; // Samples delivered so far, written by the receiving thread
+
+        /* Settle window after the last retune, in sample indices of the receiving thread */
+        std::atomic<int64_t> m_settleSkip{0}; // Microseconds
+        uint64_t m_skipFrom = 0;
+        uint64_t m_skipUntil = 0;
+        std::size_t m_skipped = 0;
+        std::vector<StreamTag> m_skippedTags;
+
+        void Supervise();
+        bool Recover(ErrorCode cause);
+
+        void RunCommands();
+
+        mutable std::mutex m_recoveryMutex;
+        std::condition_variable m_recoveryCond;
+        std::thread m_recoveryThread;
+        RecoveryConfig m_recoveryConfig;
+        RECOVERY_CALLBACK m_recoveryCallback;
+        RecoveryStats m_recoveryStats{};
+        bool m_recoveryExit = false;
+        std::atomic<bool> m_recoveryEnabled{false};
+        std::atomic<bool> m_supervised{false}; // Armed by a transfer, disarmed by CancelReads()
+        std::atomic<ErrorCode> m_failure{ErrorCode::OK};
+        std::atomic<int64_t> m_lastTransfer{0}; // steady_clock nanoseconds
+        std::atomic<int64_t> m_gapStart{0}; // Last transfer before a recovery, 0 if none is pending
+
+        std::unique_ptr<StreamCommands> m_commands;
     };
 }
 
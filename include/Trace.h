@@ -0,0 +1,118 @@
+#ifndef PORTSDR_TRACE_H
+#define PORTSDR_TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "Error.h"
+
+namespace PortSDR
+{
+    namespace detail
+    {
+        extern std::atomic<bool> gTraceEnabled;
+    }
+
+    /**
+     * Starts or stops recording trace events.
+     * Events are kept in a ring per thread, the oldest ones are overwritten.
+     * @param enable true to record.
+     */
+    void SetTracing(bool enable);
+
+    /**
+     * @return true while trace events are recorded.
+     */
+    inline bool IsTracing()
+    {
+        return detail::gTraceEnabled.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Forgets all events recorded so far.
+     */
+    void ClearTrace();
+
+    /**
+     * Gets the recorded events in the Chrome trace event format,
+     * which chrome://tracing and ui.perfetto.dev open.
+     * Stop tracing first, events recorded while dumping may be skipped.
+     * @return JSON document.
+     */
+    std::string GetTraceJson();
+
+    /**
+     * Writes GetTraceJson() to a file.
+     * @param path file to write.
+     * @return ret code, INVALID_ARGUMENT if the file can't be written.
+     */
+    ErrorCode WriteTrace(const std::string& path);
+
+    /**
+     * Gets the clock all events are timed with.
+     * @return nanoseconds since the library was loaded.
+     */
+    uint64_t TraceClock();
+
+    /**
+     * Records an event without duration.
+     * @param name string literal, it is only stored by its pointer.
+     * @param value shown as the argument of the event.
+     */
+    void TraceInstant(const char* name, int64_t value);
+
+    /**
+     * Records an event that lasted from start until now.
+     * @param name string literal, it is only stored by its pointer.
+     * @param start TraceClock() at the start.
+     * @param value shown as the argument of the event.
+     */
+    void TraceComplete(const char* name, uint64_t start, int64_t value);
+
+    /**
+     * Records the lifetime of the scope it is created in, if tracing was enabled when it was created.
+     */
+    class TraceScope
+    {
+    public:
+        explicit TraceScope(const char* name, const int64_t value = 0)
+            : m_name(IsTracing() ? name : nullptr), m_value(value), m_start(m_name ? TraceClock() : 0)
+        {
+        }
+
+        ~TraceScope()
+        {
+            if (m_name)
+                TraceComplete(m_name, m_start, m_value);
+        }
+
+        TraceScope(const TraceScope&) = delete;
+        TraceScope& operator=(const TraceScope&) = delete;
+
+    private:
+        const char* m_name;
+        int64_t m_value;
+        uint64_t m_start;
+    };
+}
+
+#define PORTSDR_TRACE_CONCAT_INNER(a, b) a##b
+#define PORTSDR_TRACE_CONCAT(a, b) PORTSDR_TRACE_CONCAT_INNER(a, b)
+
+// Without PORTSDR_TRACING (LIBRARY_TRACING in CMake) the instrumentation compiles away.
+// The functions above still exist to record events explicitly.
+#ifdef PORTSDR_TRACING
+#define PORTSDR_TRACE_SCOPE(name) \
+    PortSDR::TraceScope PORTSDR_TRACE_CONCAT(portsdr_trace_, __LINE__)(name)
+#define PORTSDR_TRACE_SCOPE_VALUE(name, value) \
+    PortSDR::TraceScope PORTSDR_TRACE_CONCAT(portsdr_trace_, __LINE__)(name, static_cast<int64_t>(value))
+#define PORTSDR_TRACE_INSTANT(name, value) \
+    do { if (PortSDR::IsTracing()) PortSDR::TraceInstant(name, static_cast<int64_t>(value)); } while (0)
+#else
+#define PORTSDR_TRACE_SCOPE(name) do { } while (0)
+#define PORTSDR_TRACE_SCOPE_VALUE(name, value) do { } while (0)
+#define PORTSDR_TRACE_INSTANT(name, value) do { } while (0)
+#endif
+
+#endif //PORTSDR_TRACE_H
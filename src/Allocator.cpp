@@ -0,0 +1,134 @@
+#include "Allocator.h"
+
+#include <new>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#define ALLOCATOR_ALIGNMENT 64
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+#define PAGE_SIZE_4K 4096
+// Below this, buffers come from the heap and a whole mapping isn't worth it.
+#define MAP_THRESHOLD (64 * 1024)
+
+// From linux/mempolicy.h, which isn't always installed.
+#define ALLOCATOR_MPOL_PREFERRED 1
+
+static std::atomic<PortSDR::Allocator*> sAllocator{nullptr};
+
+static std::size_t RoundUp(const std::size_t size, const std::size_t multiple)
+{
+    return (size + multiple - 1) / multiple * multiple;
+}
+
+/**
+ * Gets the length a buffer is mapped with, the same for huge and regular pages
+ * so Deallocate() doesn't have to know which one was used.
+ */
+static std::size_t MappedSize(const std::size_t size)
+{
+    return size >= HUGE_PAGE_SIZE ? RoundUp(size, HUGE_PAGE_SIZE) : RoundUp(size, PAGE_SIZE_4K);
+}
+
+PortSDR::HugePageAllocator::HugePageAllocator(const int numaNode)
+    : m_node(numaNode)
+{
+}
+
+void* PortSDR::HugePageAllocator::Allocate(const std::size_t size)
+{
+#ifdef __linux__
+    if (size >= MAP_THRESHOLD)
+    {
+        const std::size_t length = MappedSize(size);
+
+        void* ptr = MAP_FAILED;
+        bool huge = false;
+        if (size >= HUGE_PAGE_SIZE)
+        {
+            ptr = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            huge = ptr != MAP_FAILED;
+        }
+        if (ptr == MAP_FAILED)
+        {
+            ptr = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (ptr == MAP_FAILED)
+                return nullptr;
+
+#ifdef MADV_HUGEPAGE
+            // Transparent huge pages may still back the mapping when the reserved pool is empty.
+            if (size >= HUGE_PAGE_SIZE)
+                madvise(ptr, length, MADV_HUGEPAGE);
+#endif
+        }
+
+        // Nothing was touched yet, so every page is placed on the node once used.
+        if (m_node >= 0 && m_node < static_cast<int>(sizeof(unsigned long) * 8))
+        {
+            const unsigned long mask = 1ul << m_node;
+            syscall(SYS_mbind, ptr, length, ALLOCATOR_MPOL_PREFERRED, &mask, sizeof(mask) * 8 + 1, 0);
+        }
+
+        if (huge)
+        {
+            std::lock_guard lock(m_mutex);
+            m_hugeMappings.insert(ptr);
+        }
+        (huge ? m_hugePageBytes : m_fallbackBytes).fetch_add(length, std::memory_order_relaxed);
+        return ptr;
+    }
+#endif
+
+    return ::operator new(size, std::align_val_t(ALLOCATOR_ALIGNMENT), std::nothrow);
+}
+
+void PortSDR::HugePageAllocator::Deallocate(void* ptr, const std::size_t size)
+{
+    if (!ptr)
+        return;
+
+#ifdef __linux__
+    if (size >= MAP_THRESHOLD)
+    {
+        const std::size_t length = MappedSize(size);
+
+        bool huge;
+        {
+            std::lock_guard lock(m_mutex);
+            huge = m_hugeMappings.erase(ptr) > 0;
+        }
+        (huge ? m_hugePageBytes : m_fallbackBytes).fetch_sub(length, std::memory_order_relaxed);
+
+        munmap(ptr, length);
+        return;
+    }
+#endif
+
+    ::operator delete(ptr, std::align_val_t(ALLOCATOR_ALIGNMENT));
+}
+
+std::size_t PortSDR::HugePageAllocator::GetHugePageBytes() const
+{
+    return m_hugePageBytes.load(std::memory_order_relaxed);
+}
+
+std::size_t PortSDR::HugePageAllocator::GetFallbackBytes() const
+{
+    return m_fallbackBytes.load(std::memory_order_relaxed);
+}
+
+PortSDR::Allocator& PortSDR::GetAllocator()
+{
+    static HugePageAllocator defaultAllocator;
+
+    Allocator* allocator = sAllocator.load(std::memory_order_acquire);
+    return allocator ? *allocator : defaultAllocator;
+}
+
+void PortSDR::SetAllocator(Allocator* allocator)
+{
+    sAllocator.store(allocator, std::memory_order_release);
+}
@@ -0,0 +1,278 @@
+#include "Burst.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+
+#include "Trace.h"
+#include "dsp/Level.h"
+
+// Ring time on top of the longest burst, for the writer to keep up
+#define BURST_RING_SLACK_MS 1000
+// Weight of a block in the noise floor, it follows falling power faster than rising power
+#define BURST_FLOOR_RISE 0.01
+#define BURST_FLOOR_FALL 0.1
+#define BURST_POWER_FLOOR 1e-12
+
+static double PowerToDb(const double power)
+{
+    return 10.0 * std::log10(std::max(power, BURST_POWER_FLOOR));
+}
+
+PortSDR::BurstRecorder::BurstRecorder(Stream& stream)
+    : m_stream(stream), m_ring(stream)
+{
+}
+
+PortSDR::BurstRecorder::~BurstRecorder()
+{
+    Stop();
+}
+
+PortSDR::ErrorCode PortSDR::BurstRecorder::Start(const std::string& path, const BurstConfig& config)
+{
+    const uint32_t sampleRate = m_stream.GetSampleRate();
+    if (sampleRate == 0 || config.block_size == 0 || m_writer.joinable())
+        return ErrorCode::INVALID_ARGUMENT;
+
+    CaptureConfig capture;
+    capture.duration = config.pre_padding + config.max_burst + config.post_padding
+        + std::chrono::milliseconds(BURST_RING_SLACK_MS);
+    capture.format = config.format;
+
+    ErrorCode ret = m_ring.Allocate(capture);
+    if (ret != ErrorCode::OK)
+        return ret;
+
+    m_data = std::fopen(path.c_str(), "wb");
+    m_index = std::fopen((path + ".csv").c_str(), "w");
+    if (!m_data || !m_index)
+    {
+        if (m_data)
+            std::fclose(m_data);
+        if (m_index)
+            std::fclose(m_index);
+        m_data = nullptr;
+        m_index = nullptr;
+        m_ring.Stop();
+        return ErrorCode::INVALID_ARGUMENT;
+    }
+    std::fputs("start_sample,samples,offset,frequency,peak_dbfs,noise_dbfs\n", m_index);
+
+    const auto toSamples = [sampleRate](const std::chrono::milliseconds time)
+    {
+        return static_cast<std::size_t>(std::chrono::duration<double>(time).count() * sampleRate);
+    };
+
+    {
+        std::lock_guard lock(m_mutex);
+        m_offset = 0;
+        m_bursts.clear();
+        m_writing = true;
+    }
+    m_writer = std::thread(&BurstRecorder::Writer, this);
+
+    std::lock_guard lock(m_stateMutex);
+    m_config = config;
+    m_frequency = m_stream.GetCenterFrequency();
+    m_floor = -1.0;
+    m_threshold = std::pow(10.0, config.threshold_db / 10.0);
+    m_prePadding = toSamples(config.pre_padding);
+    m_postPadding = std::max<std::size_t>(toSamples(config.post_padding), 1);
+    m_maxBurst = std::max<std::size_t>(toSamples(config.max_burst), config.block_size);
+    m_inBurst = false;
+    m_detecting = true;
+    return ErrorCode::OK;
+}
+
+void PortSDR::BurstRecorder::Stop()
+{
+    {
+        std::lock_guard lock(m_stateMutex);
+        if (m_inBurst)
+            Finish(std::min(m_lastActive + m_postPadding, m_sampleIndex));
+        m_detecting = false;
+    }
+
+    {
+        std::lock_guard lock(m_mutex);
+        m_writing = false;
+    }
+    m_cv.notify_one();
+
+    if (m_writer.joinable())
+        m_writer.join();
+
+    if (m_data)
+        std::fclose(m_data);
+    if (m_index)
+        std::fclose(m_index);
+    m_data = nullptr;
+    m_index = nullptr;
+
+    m_ring.Stop();
+}
+
+void PortSDR::BurstRecorder::Process(const SDRTransfer& transfer)
+{
+    std::lock_guard lock(m_stateMutex);
+
+    const uint64_t first = m_sampleIndex + transfer.dropped_samples;
+    const uint64_t previous = m_sampleIndex;
+    m_sampleIndex = first + transfer.frame_size;
+
+    // The ring starts over at a gap, so the burst so far is written first.
+    if (m_detecting && m_inBurst && transfer.dropped_samples != 0)
+        Finish(previous);
+
+    m_ring.Record(transfer);
+
+    if (!m_detecting)
+        return;
+
+    for (std::size_t i = 0; i < transfer.tag_count; i++)
+    {
+        if (transfer.tags[i].type == STREAM_TAG_FREQUENCY)
+            m_frequency = transfer.tags[i].value;
+    }
+
+    for (std::size_t pos = 0; pos < transfer.frame_size; pos += m_config.block_size)
+    {
+        const std::size_t count = std::min(m_config.block_size, transfer.frame_size - pos);
+        const double power = MeasureLevel(transfer, pos, count).Power();
+        const uint64_t end = first + pos + count;
+
+        if (!m_inBurst)
+        {
+            if (m_floor < 0)
+            {
+                m_floor = std::max(power, BURST_POWER_FLOOR);
+            }
+            else if (power > m_floor * m_threshold)
+            {
+                m_inBurst = true;
+                m_continued = false;
+                m_burstStart = end - count;
+                m_lastActive = end;
+                m_peak = power;
+                m_burstFloor = m_floor;
+            }
+            else
+            {
+                const double weight = power < m_floor ? BURST_FLOOR_FALL : BURST_FLOOR_RISE;
+                m_floor = std::max(m_floor + weight * (power - m_floor), BURST_POWER_FLOOR);
+            }
+            continue;
+        }
+
+        // The floor is held while a burst goes on.
+        if (power > m_burstFloor * m_threshold)
+        {
+            m_lastActive = end;
+            m_peak = std::max(m_peak, power);
+        }
+
+        if (end - m_lastActive >= m_postPadding)
+        {
+            Finish(m_lastActive + m_postPadding);
+        }
+        else if (end - m_burstStart >= m_maxBurst)
+        {
+            Finish(end);
+
+            m_inBurst = true;
+            m_continued = true;
+            m_burstStart = end;
+            m_lastActive = end;
+            m_peak = 0;
+        }
+    }
+}
+
+void PortSDR::BurstRecorder::SetBurstCallback(BURST_CALLBACK callback)
+{
+    m_burstCallback = std::move(callback);
+}
+
+std::vector<PortSDR::BurstInfo> PortSDR::BurstRecorder::GetBursts() const
+{
+    std::lock_guard lock(m_mutex);
+    return m_bursts;
+}
+
+double PortSDR::BurstRecorder::GetNoiseFloor() const
+{
+    std::lock_guard lock(m_stateMutex);
+    return m_floor < 0 ? PowerToDb(0) : PowerToDb(m_floor);
+}
+
+void PortSDR::BurstRecorder::Finish(const uint64_t to)
+{
+    m_inBurst = false;
+
+    const uint64_t from = m_continued || m_burstStart < m_prePadding ? m_burstStart : m_burstStart - m_prePadding;
+
+    BurstJob job;
+    if (m_ring.Snapshot(from, to, job.snapshot) != ErrorCode::OK)
+        return;
+
+    job.info.start_sample = job.snapshot.GetFrom();
+    job.info.samples = job.snapshot.GetTo() - job.snapshot.GetFrom();
+    job.info.offset = 0;
+    job.info.frequency = m_frequency;
+    job.info.peak_dbfs = PowerToDb(m_peak);
+    job.info.noise_dbfs = PowerToDb(m_burstFloor);
+
+    PORTSDR_TRACE_INSTANT("burst", job.info.samples);
+
+    {
+        std::lock_guard lock(m_mutex);
+        m_jobs.push_back(std::move(job));
+    }
+    m_cv.notify_one();
+}
+
+void PortSDR::BurstRecorder::Writer()
+{
+    std::unique_lock lock(m_mutex);
+    while (true)
+    {
+        // Pending bursts are written before stopping.
+        m_cv.wait(lock, [this] { return !m_writing || !m_jobs.empty(); });
+        if (m_jobs.empty())
+            break;
+
+        BurstJob job = std::move(m_jobs.front());
+        m_jobs.pop_front();
+        job.info.offset = m_offset;
+        lock.unlock();
+
+        std::size_t written = 0;
+        {
+            PORTSDR_TRACE_SCOPE_VALUE("burst_write", job.info.samples);
+
+            const Span<const uint8_t> first = job.snapshot.GetFirst();
+            const Span<const uint8_t> second = job.snapshot.GetSecond();
+            written += std::fwrite(first.data(), 1, first.size(), m_data);
+            written += std::fwrite(second.data(), 1, second.size(), m_data);
+
+            std::fprintf(m_index, "%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%.0f,%.2f,%.2f\n",
+                         job.info.start_sample, job.info.samples, job.info.offset,
+                         job.info.frequency, job.info.peak_dbfs, job.info.noise_dbfs);
+            std::fflush(m_index);
+        }
+
+        // Unpinning takes the lock of the ring.
+        job.snapshot.Release();
+
+        lock.lock();
+        m_offset += written;
+        m_bursts.push_back(job.info);
+        lock.unlock();
+
+        if (m_burstCallback)
+            m_burstCallback(job.info);
+
+        lock.lock();
+    }
+}
@@ -0,0 +1,430 @@
+#include "Capabilities.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * Layout of the file, in native byte order:
+ *   magic | version | count | reserved | entry 0 | entry 1 | ...
+ * Every entry starts with its size, so the ones that aren't looked up are skipped without decoding them.
+ * Strings and lists are prefixed with their length.
+ */
+#define CAPABILITY_MAGIC 0x43445350 // "PSDC"
+#define CAPABILITY_VERSION 1
+#define CAPABILITY_HEADER_SIZE 16
+
+namespace
+{
+    class CapabilityWriter
+    {
+    public:
+        void U32(const uint32_t value)
+        {
+            m_bytes.append(reinterpret_cast<const char*>(&value), sizeof(value));
+        }
+
+        void F64(const double value)
+        {
+            m_bytes.append(reinterpret_cast<const char*>(&value), sizeof(value));
+        }
+
+        void Str(const std::string_view value)
+        {
+            U32(static_cast<uint32_t>(value.size()));
+            m_bytes.append(value);
+        }
+
+        void Bytes(const std::string_view value)
+        {
+            m_bytes.append(value);
+        }
+
+        [[nodiscard]] const std::string& Get() const
+        {
+            return m_bytes;
+        }
+
+    private:
+        std::string m_bytes;
+    };
+
+    class CapabilityReader
+    {
+    public:
+        explicit CapabilityReader(const std::string_view bytes)
+            : m_bytes(bytes)
+        {
+        }
+
+        bool U32(uint32_t& value)
+        {
+            return Copy(&value, sizeof(value));
+        }
+
+        bool F64(double& value)
+        {
+            return Copy(&value, sizeof(value));
+        }
+
+        bool Str(std::string_view& value)
+        {
+            uint32_t size;
+            if (!U32(size) || size > m_bytes.size() - m_pos)
+                return false;
+
+            value = m_bytes.substr(m_pos, size);
+            m_pos += size;
+            return true;
+        }
+
+        bool Str(std::string& value)
+        {
+            std::string_view view;
+            if (!Str(view))
+                return false;
+
+            value = std::string(view);
+            return true;
+        }
+
+        /**
+         * Reads the length of a list whose elements take at least elementSize bytes.
+         */
+        bool Count(uint32_t& count, const std::size_t elementSize)
+        {
+            return U32(count) && count <= (m_bytes.size() - m_pos) / elementSize;
+        }
+
+    private:
+        bool Copy(void* value, const std::size_t size)
+        {
+            if (size > m_bytes.size() - m_pos)
+                return false;
+
+            std::memcpy(value, m_bytes.data() + m_pos, size);
+            m_pos += size;
+            return true;
+        }
+
+        std::string_view m_bytes;
+        std::size_t m_pos = 0;
+    };
+
+    std::string EncodeEntry(const PortSDR::Device& device, const PortSDR::Capabilities& capabilities)
+    {
+        CapabilityWriter writer;
+        writer.U32(static_cast<uint32_t>(device.type));
+        writer.Str(device.serial);
+        writer.Str(capabilities.tuner_type);
+
+        writer.U32(static_cast<uint32_t>(capabilities.sample_rates.size()));
+        for (const uint32_t rate : capabilities.sample_rates)
+            writer.U32(rate);
+
+        writer.U32(static_cast<uint32_t>(capabilities.sample_formats.size()));
+        for (const PortSDR::SampleFormat format : capabilities.sample_formats)
+            writer.U32(format);
+
+        writer.U32(static_cast<uint32_t>(capabilities.gain_modes.size()));
+        for (std::size_t i = 0; i < capabilities.gain_modes.size(); i++)
+        {
+            static const std::vector<PortSDR::Gain> none;
+            const std::vector<PortSDR::Gain>& stages = i < capabilities.gain_stages.size()
+                                                           ? capabilities.gain_stages[i]
+                                                           : none;
+
+            writer.U32(capabilities.gain_modes[i]);
+            writer.U32(static_cast<uint32_t>(stages.size()));
+            for (const PortSDR::Gain& gain : stages)
+            {
+                writer.Str(gain.stage);
+                writer.U32(static_cast<uint32_t>(gain.range.size()));
+                for (const PortSDR::Range& range : gain.range)
+                {
+                    writer.F64(range.start);
+                    writer.F64(range.stop);
+                    writer.F64(range.step);
+                }
+            }
+        }
+        return writer.Get();
+    }
+
+    bool DecodeEntry(const std::string_view entry, PortSDR::Capabilities& capabilities)
+    {
+        CapabilityReader reader(entry);
+
+        uint32_t type;
+        std::string_view serial;
+        if (!reader.U32(type) || !reader.Str(serial) || !reader.Str(capabilities.tuner_type))
+            return false;
+
+        uint32_t count;
+        if (!reader.Count(count, sizeof(uint32_t)))
+            return false;
+        capabilities.sample_rates.resize(count);
+        for (uint32_t& rate : capabilities.sample_rates)
+            reader.U32(rate);
+
+        if (!reader.Count(count, sizeof(uint32_t)))
+            return false;
+        capabilities.sample_formats.clear();
+        for (uint32_t i = 0; i < count; i++)
+        {
+            uint32_t format = 0;
+            reader.U32(format);
+            capabilities.sample_formats.push_back(static_cast<PortSDR::SampleFormat>(format));
+        }
+
+        if (!reader.Count(count, 2 * sizeof(uint32_t)))
+            return false;
+        capabilities.gain_modes.clear();
+        capabilities.gain_stages.assign(count, {});
+        for (uint32_t i = 0; i < count; i++)
+        {
+            uint32_t mode, stages;
+            if (!reader.U32(mode) || !reader.Count(stages, 2 * sizeof(uint32_t)))
+                return false;
+            capabilities.gain_modes.push_back(static_cast<PortSDR::GainMode>(mode));
+
+            for (uint32_t j = 0; j < stages; j++)
+            {
+                PortSDR::Gain gain;
+                uint32_t ranges;
+                if (!reader.Str(gain.stage) || !reader.Count(ranges, 3 * sizeof(double)))
+                    return false;
+
+                for (uint32_t k = 0; k < ranges; k++)
+                {
+                    double start = 0, stop = 0, step = 0;
+                    reader.F64(start);
+                    reader.F64(stop);
+                    reader.F64(step);
+                    gain.range.emplace_back(start, stop, step);
+                }
+                capabilities.gain_stages[i].push_back(std::move(gain));
+            }
+        }
+        return true;
+    }
+
+    bool IsEntryOf(const std::string_view entry, const PortSDR::Device& device)
+    {
+        CapabilityReader reader(entry);
+
+        uint32_t type;
+        std::string_view serial;
+        return reader.U32(type) && reader.Str(serial)
+            && type == static_cast<uint32_t>(device.type) && serial == device.serial;
+    }
+
+    /**
+     * Splits the mapped file into its entries, stops at the first one that is cut off.
+     */
+    std::vector<std::string_view> SplitEntries(const uint8_t* data, const std::size_t size)
+    {
+        std::vector<std::string_view> entries;
+        if (!data)
+            return entries;
+
+        CapabilityReader reader({reinterpret_cast<const char*>(data) + CAPABILITY_HEADER_SIZE,
+                                 size - CAPABILITY_HEADER_SIZE});
+        std::string_view entry;
+        while (reader.Str(entry))
+            entries.push_back(entry);
+        return entries;
+    }
+}
+
+PortSDR::Capabilities PortSDR::ProbeCapabilities(const Stream& stream)
+{
+    Capabilities capabilities;
+    capabilities.tuner_type = stream.GetTunerType();
+    capabilities.sample_rates = stream.GetSampleRates();
+    capabilities.sample_formats = stream.GetSampleFormats();
+    capabilities.gain_modes = stream.GetGainModes();
+    for (const GainMode mode : capabilities.gain_modes)
+        capabilities.gain_stages.push_back(stream.GetGainStages(mode));
+    return capabilities;
+}
+
+PortSDR::CapabilityCache::CapabilityCache(std::string path)
+    : m_path(std::move(path))
+{
+}
+
+PortSDR::CapabilityCache::~CapabilityCache()
+{
+    Unmap();
+}
+
+PortSDR::ErrorCode PortSDR::CapabilityCache::Load()
+{
+    std::lock_guard lock(m_mutex);
+    Unmap();
+    return Map();
+}
+
+bool PortSDR::CapabilityCache::Find(const Device& device, Capabilities& capabilities) const
+{
+    std::lock_guard lock(m_mutex);
+
+    const std::string_view entry = FindEntry(device);
+    return !entry.empty() && DecodeEntry(entry, capabilities);
+}
+
+std::future<PortSDR::ErrorCode> PortSDR::CapabilityCache::Refresh(const Device& device, Stream& stream)
+{
+    return stream.Submit([this, device](Stream& target)
+    {
+        const Capabilities capabilities = ProbeCapabilities(target);
+        {
+            std::lock_guard lock(m_mutex);
+            if (FindEntry(device) == EncodeEntry(device, capabilities))
+                return ErrorCode::OK;
+        }
+        return Store(device, capabilities);
+    });
+}
+
+PortSDR::ErrorCode PortSDR::CapabilityCache::Store(const Device& device, const Capabilities& capabilities)
+{
+    std::lock_guard lock(m_mutex);
+
+    // Held from reading the newest file until it is replaced, so entries of other processes aren't lost.
+    // The cache file itself can't be locked, renaming replaces it.
+    const int lockFd = open((m_path + ".lock").c_str(), O_CREAT | O_RDWR | O_CLOEXEC, 0644);
+    if (lockFd < 0)
+        return ErrorCode::FAILED_TO_INITIALIZE;
+
+    int ret = flock(lockFd, LOCK_EX);
+    while (ret < 0 && errno == EINTR)
+        ret = flock(lockFd, LOCK_EX);
+
+    ErrorCode code = ErrorCode::FAILED_TO_INITIALIZE;
+    if (ret == 0)
+    {
+        Unmap();
+        code = Map();
+        if (code == ErrorCode::OK)
+            code = Write(device, capabilities);
+    }
+
+    // Closing releases the lock.
+    close(lockFd);
+    return code;
+}
+
+PortSDR::ErrorCode PortSDR::CapabilityCache::Write(const Device& device, const Capabilities& capabilities)
+{
+    CapabilityWriter writer;
+    uint32_t count = 0;
+
+    for (const std::string_view entry : SplitEntries(m_data, m_size))
+    {
+        if (IsEntryOf(entry, device))
+            continue;
+
+        writer.Str(entry);
+        count++;
+    }
+    writer.Str(EncodeEntry(device, capabilities));
+    count++;
+
+    CapabilityWriter header;
+    header.U32(CAPABILITY_MAGIC);
+    header.U32(CAPABILITY_VERSION);
+    header.U32(count);
+    header.U32(0);
+    header.Bytes(writer.Get());
+    const std::string& bytes = header.Get();
+
+    // Renamed over the old file, so no process ever maps a half written one.
+    const std::string temporary = m_path + ".tmp." + std::to_string(getpid());
+    const int fd = open(temporary.c_str(), O_CREAT | O_TRUNC | O_WRONLY | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return ErrorCode::FAILED_TO_INITIALIZE;
+
+    std::size_t written = 0;
+    while (written < bytes.size())
+    {
+        const ssize_t ret = write(fd, bytes.data() + written, bytes.size() - written);
+        if (ret <= 0)
+            break;
+        written += ret;
+    }
+    close(fd);
+
+    if (written != bytes.size() || rename(temporary.c_str(), m_path.c_str()) != 0)
+    {
+        unlink(temporary.c_str());
+        return ErrorCode::FAILED_TO_INITIALIZE;
+    }
+
+    Unmap();
+    return Map();
+}
+
+std::size_t PortSDR::CapabilityCache::GetSize() const
+{
+    std::lock_guard lock(m_mutex);
+    return m_count;
+}
+
+PortSDR::ErrorCode PortSDR::CapabilityCache::Map()
+{
+    const int fd = open(m_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return errno == ENOENT ? ErrorCode::OK : ErrorCode::FAILED_TO_INITIALIZE;
+
+    struct stat info{};
+    if (fstat(fd, &info) < 0 || info.st_size < CAPABILITY_HEADER_SIZE)
+    {
+        close(fd);
+        return ErrorCode::OK;
+    }
+
+    void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return ErrorCode::FAILED_TO_INITIALIZE;
+
+    uint32_t header[4];
+    std::memcpy(header, data, sizeof(header));
+    if (header[0] != CAPABILITY_MAGIC || header[1] != CAPABILITY_VERSION)
+    {
+        munmap(data, info.st_size);
+        return ErrorCode::OK;
+    }
+
+    m_data = static_cast<const uint8_t*>(data);
+    m_size = info.st_size;
+    m_count = header[2];
+    return ErrorCode::OK;
+}
+
+void PortSDR::CapabilityCache::Unmap()
+{
+    if (m_data)
+        munmap(const_cast<uint8_t*>(m_data), m_size);
+
+    m_data = nullptr;
+    m_size = 0;
+    m_count = 0;
+}
+
+std::string_view PortSDR::CapabilityCache::FindEntry(const Device& device) const
+{
+    for (const std::string_view entry : SplitEntries(m_data, m_size))
+    {
+        if (IsEntryOf(entry, device))
+            return entry;
+    }
+    return {};
+}
@@ -0,0 +1,340 @@
+#include "Capture.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "Trace.h"
+
+PortSDR::CaptureSnapshot::~CaptureSnapshot()
+{
+    Release();
+}
+
+PortSDR::CaptureSnapshot::CaptureSnapshot(CaptureSnapshot&& other) noexcept
+{
+    *this = std::move(other);
+}
+
+PortSDR::CaptureSnapshot& PortSDR::CaptureSnapshot::operator=(CaptureSnapshot&& other) noexcept
+{
+    if (this == &other)
+        return *this;
+
+    Release();
+
+    m_ring = other.m_ring;
+    m_pin = other.m_pin;
+    m_from = other.m_from;
+    m_to = other.m_to;
+    m_format = other.m_format;
+    m_first = other.m_first;
+    m_second = other.m_second;
+
+    other.m_ring = nullptr;
+    other.m_first = {};
+    other.m_second = {};
+    return *this;
+}
+
+void PortSDR::CaptureSnapshot::Release()
+{
+    if (!m_ring)
+        return;
+
+    m_ring->Unpin(m_pin);
+    m_ring = nullptr;
+    m_first = {};
+    m_second = {};
+}
+
+PortSDR::CaptureRing::CaptureRing(Stream& stream)
+    : m_stream(stream)
+{
+}
+
+PortSDR::CaptureRing::~CaptureRing()
+{
+    Stop();
+}
+
+PortSDR::ErrorCode PortSDR::CaptureRing::Start(const CaptureConfig& config)
+{
+    const ErrorCode ret = Allocate(config);
+    if (ret != ErrorCode::OK)
+        return ret;
+
+    m_installed = true;
+    m_stream.SetCallback([this](SDRTransfer& transfer)
+    {
+        Process(transfer);
+    });
+    return ErrorCode::OK;
+}
+
+void PortSDR::CaptureRing::Stop()
+{
+    if (m_installed)
+    {
+        m_stream.SetCallback({});
+        m_installed = false;
+    }
+
+    {
+        std::lock_guard lock(m_mutex);
+        m_recording = false;
+        m_writing = false;
+    }
+    m_cv.notify_one();
+
+    if (m_writer.joinable())
+        m_writer.join();
+}
+
+void PortSDR::CaptureRing::SetCallback(Stream::SDR_CALLBACK callback)
+{
+    m_callback = std::move(callback);
+}
+
+PortSDR::ErrorCode PortSDR::CaptureRing::Allocate(const CaptureConfig& config)
+{
+    const uint32_t sampleRate = m_stream.GetSampleRate();
+    if (sampleRate == 0)
+        return ErrorCode::INVALID_ARGUMENT;
+
+    const std::size_t sampleSize = GetSampleSize(config.format);
+    const double seconds = std::chrono::duration<double>(config.duration).count();
+    const std::size_t bytes = std::min(static_cast<std::size_t>(seconds * sampleRate) * sampleSize,
+                                       config.max_bytes / sampleSize * sampleSize);
+    if (bytes == 0)
+        return ErrorCode::INVALID_ARGUMENT;
+
+    std::lock_guard lock(m_mutex);
+    if (m_recording || !m_pins.empty())
+        return ErrorCode::INVALID_ARGUMENT;
+
+    // Every page is touched here, not on the receiving thread.
+    if (m_buffer.size() != bytes)
+    {
+        Buffer<uint8_t> buffer(bytes);
+        m_buffer.swap(buffer);
+    }
+
+    m_format = config.format;
+    m_capacity = bytes / sampleSize;
+    m_begin = 0;
+    m_end = 0;
+    m_blocked = 0;
+    m_recording = true;
+    return ErrorCode::OK;
+}
+
+void PortSDR::CaptureRing::Process(SDRTransfer& transfer)
+{
+    Record(transfer);
+
+    if (m_callback)
+        m_callback(transfer);
+}
+
+void PortSDR::CaptureRing::Record(const SDRTransfer& transfer)
+{
+    const uint64_t first = m_sampleIndex + transfer.dropped_samples;
+    m_sampleIndex = first + transfer.frame_size;
+
+    std::lock_guard lock(m_mutex);
+    if (!m_recording || transfer.frame_size == 0)
+        return;
+
+    const std::size_t sampleSize = GetSampleSize(transfer.format);
+    if (transfer.format != m_format)
+    {
+        // The ring is laid out for one format, pinned samples keep the old layout.
+        if (!m_pins.empty())
+        {
+            m_blocked += transfer.frame_size;
+            return;
+        }
+
+        m_format = transfer.format;
+        m_capacity = m_buffer.size() / sampleSize;
+        m_begin = first;
+        m_end = first;
+        if (m_capacity == 0)
+            return;
+    }
+
+    // Only the newest samples of a transfer larger than the ring are kept.
+    std::size_t skip = 0;
+    uint64_t start = first;
+    std::size_t count = transfer.frame_size;
+    if (count > m_capacity)
+    {
+        skip = count - m_capacity;
+        start += skip;
+        count = m_capacity;
+    }
+
+    // Sample i is always stored at i modulo the capacity, so the write evicts everything before this.
+    const uint64_t evict = start + count > m_capacity ? start + count - m_capacity : 0;
+    for (const auto& [pin, from] : m_pins)
+    {
+        if (from < evict)
+        {
+            PORTSDR_TRACE_INSTANT("capture_blocked", transfer.frame_size);
+            m_blocked += transfer.frame_size;
+            return;
+        }
+    }
+
+    if (start != m_end)
+    {
+        m_begin = start;
+        m_end = start;
+    }
+    m_begin = std::max(m_begin, evict);
+
+    const std::size_t pos = start % m_capacity;
+    const std::size_t firstCount = std::min(count, m_capacity - pos);
+    ConvertTransfer(transfer, skip, m_buffer.data() + pos * sampleSize, m_format, firstCount);
+    ConvertTransfer(transfer, skip + firstCount, m_buffer.data(), m_format, count - firstCount);
+    m_end = start + count;
+}
+
+PortSDR::ErrorCode PortSDR::CaptureRing::Snapshot(uint64_t from, uint64_t to, CaptureSnapshot& snapshot)
+{
+    snapshot.Release();
+
+    std::lock_guard lock(m_mutex);
+    if (m_capacity == 0)
+        return ErrorCode::UNINITIALIZED;
+
+    from = std::max(from, m_begin);
+    to = std::min(to, m_end);
+    if (from >= to)
+        return ErrorCode::INVALID_ARGUMENT;
+
+    const std::size_t sampleSize = GetSampleSize(m_format);
+    const std::size_t pos = from % m_capacity;
+    const std::size_t count = to - from;
+    const std::size_t firstCount = std::min(count, m_capacity - pos);
+
+    snapshot.m_ring = this;
+    snapshot.m_pin = m_nextPin++;
+    snapshot.m_from = from;
+    snapshot.m_to = to;
+    snapshot.m_format = m_format;
+    snapshot.m_first = Span<const uint8_t>(m_buffer.data() + pos * sampleSize, firstCount * sampleSize);
+    snapshot.m_second = Span<const uint8_t>(m_buffer.data(), (count - firstCount) * sampleSize);
+
+    m_pins.emplace_back(snapshot.m_pin, from);
+    return ErrorCode::OK;
+}
+
+PortSDR::ErrorCode PortSDR::CaptureRing::Save(const uint64_t from, const uint64_t to, const std::string& path,
+                                              SAVE_CALLBACK callback)
+{
+    CaptureSnapshot snapshot;
+    const ErrorCode ret = Snapshot(from, to, snapshot);
+    if (ret != ErrorCode::OK)
+        return ret;
+
+    {
+        std::lock_guard lock(m_mutex);
+        m_jobs.push_back({std::move(snapshot), path, std::move(callback)});
+
+        if (!m_writer.joinable())
+        {
+            m_writing = true;
+            m_writer = std::thread(&CaptureRing::Writer, this);
+        }
+    }
+    m_cv.notify_one();
+    return ErrorCode::OK;
+}
+
+uint64_t PortSDR::CaptureRing::GetOldestIndex() const
+{
+    std::lock_guard lock(m_mutex);
+    return m_begin;
+}
+
+uint64_t PortSDR::CaptureRing::GetNewestIndex() const
+{
+    std::lock_guard lock(m_mutex);
+    return m_end;
+}
+
+std::size_t PortSDR::CaptureRing::GetCapacity() const
+{
+    std::lock_guard lock(m_mutex);
+    return m_capacity;
+}
+
+std::size_t PortSDR::CaptureRing::GetMemoryUsage() const
+{
+    std::lock_guard lock(m_mutex);
+    return m_buffer.size();
+}
+
+uint64_t PortSDR::CaptureRing::GetBlockedSamples() const
+{
+    std::lock_guard lock(m_mutex);
+    return m_blocked;
+}
+
+void PortSDR::CaptureRing::Unpin(const uint64_t pin)
+{
+    std::lock_guard lock(m_mutex);
+
+    const auto it = std::find_if(m_pins.begin(), m_pins.end(), [pin](const auto& entry)
+    {
+        return entry.first == pin;
+    });
+    if (it != m_pins.end())
+        m_pins.erase(it);
+}
+
+void PortSDR::CaptureRing::Writer()
+{
+    std::unique_lock lock(m_mutex);
+    while (true)
+    {
+        // Pending saves are finished before stopping.
+        m_cv.wait(lock, [this] { return !m_writing || !m_jobs.empty(); });
+        if (m_jobs.empty())
+            break;
+
+        SaveJob job = std::move(m_jobs.front());
+        m_jobs.pop_front();
+        lock.unlock();
+
+        ErrorCode ret = ErrorCode::OK;
+        {
+            PORTSDR_TRACE_SCOPE_VALUE("capture_save", job.snapshot.GetTo() - job.snapshot.GetFrom());
+
+            FILE* file = std::fopen(job.path.c_str(), "wb");
+            if (file)
+            {
+                const Span<const uint8_t> first = job.snapshot.GetFirst();
+                const Span<const uint8_t> second = job.snapshot.GetSecond();
+
+                if (std::fwrite(first.data(), 1, first.size(), file) != first.size()
+                    || std::fwrite(second.data(), 1, second.size(), file) != second.size())
+                    ret = ErrorCode::UNKNOWN;
+                if (std::fclose(file) != 0)
+                    ret = ErrorCode::UNKNOWN;
+            }
+            else
+            {
+                ret = ErrorCode::INVALID_ARGUMENT;
+            }
+        }
+
+        // Unpinning takes the lock.
+        job.snapshot.Release();
+        if (job.callback)
+            job.callback(ret, job.path);
+
+        lock.lock();
+    }
+}
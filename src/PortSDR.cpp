@@ -19,34 +19,87 @@
 #include "vendors/AirSpyHf.h"
 #endif
 
+#ifdef RTLTCP_SUPPORT
+#include "vendors/RtlTcp.h"
+#endif
+
 std::string PortSDR::PortSDR::GetVersion()
 {
     return kGitHash;
 }
 
-PortSDR::PortSDR::PortSDR()
+// Every compiled in host, in the order devices are listed
+static std::vector<PortSDR::HostType> GetHostTypes()
+{
+    std::vector<PortSDR::HostType> types;
+#ifdef RTLSDR_SUPPORT
+    types.push_back(PortSDR::HostType::RTL_SDR);
+#endif
+
+#ifdef AIRSPY_SUPPORT
+    types.push_back(PortSDR::HostType::AIRSPY);
+#endif
+
+#ifdef AIRSPYHF_SUPPORT
+    types.push_back(PortSDR::HostType::AIRSPY_HF);
+#endif
+
+#ifdef RTLTCP_SUPPORT
+    types.push_back(PortSDR::HostType::RTL_TCP);
+#endif
+    return types;
+}
+
+static std::unique_ptr<PortSDR::Host> CreateHost(const PortSDR::HostType type)
 {
-    // Store all our supported SDR vendors
+    switch (type)
+    {
 #ifdef RTLSDR_SUPPORT
-    m_hosts.emplace_back(std::make_unique<RTLHost>());
+    case PortSDR::HostType::RTL_SDR:
+        if (const PortSDR::RTLApi* api = PortSDR::RTLApi::Get())
+            return std::make_unique<PortSDR::RTLHost>(*api);
+        break;
 #endif
 
 #ifdef AIRSPY_SUPPORT
-    m_hosts.emplace_back(std::make_unique<AirSpyHost>());
+    case PortSDR::HostType::AIRSPY:
+        if (const PortSDR::AirSpyApi* api = PortSDR::AirSpyApi::Get())
+            return std::make_unique<PortSDR::AirSpyHost>(*api);
+        break;
 #endif
 
 #ifdef AIRSPYHF_SUPPORT
-    m_hosts.emplace_back(std::make_unique<AirSpyHfHost>());
+    case PortSDR::HostType::AIRSPY_HF:
+        if (const PortSDR::AirSpyHfApi* api = PortSDR::AirSpyHfApi::Get())
+            return std::make_unique<PortSDR::AirSpyHfHost>(*api);
+        break;
 #endif
+
+#ifdef RTLTCP_SUPPORT
+    case PortSDR::HostType::RTL_TCP:
+        return std::make_unique<PortSDR::RtlTcpHost>();
+#endif
+
+    default:
+        break;
+    }
+    return nullptr;
 }
 
+PortSDR::PortSDR::PortSDR()
+= default;
+
 PortSDR::PortSDR::~PortSDR()
 = default;
 
 std::optional<PortSDR::Device> PortSDR::PortSDR::GetFirstAvailableSDR() const
 {
-    for (const auto& host : m_hosts)
+    for (const HostType type : GetHostTypes())
     {
+        const Host* host = GetHost(type);
+        if (!host)
+            continue;
+
         const std::vector<Device> devices = host->AvailableDevices();
         if (!devices.empty())
         {
@@ -59,8 +112,12 @@ std::optional<PortSDR::Device> PortSDR::PortSDR::GetFirstAvailableSDR() const
 std::vector<PortSDR::Device> PortSDR::PortSDR::GetDevices() const
 {
     std::vector<Device> total_devices;
-    for (const auto& host : m_hosts)
+    for (const HostType type : GetHostTypes())
     {
+        const Host* host = GetHost(type);
+        if (!host)
+            continue;
+
         const auto host_devices = host->AvailableDevices();
         total_devices.insert(
             total_devices.end(),
@@ -89,6 +146,11 @@ PortSDR::ErrorCode PortSDR::PortSDR::CreateStream(const Device& device, std::uni
     return ErrorCode::HOST_UNAVAILABLE;
 }
 
+bool PortSDR::PortSDR::IsHostAvailable(const HostType type) const
+{
+    return GetHost(type) != nullptr;
+}
+
 PortSDR::ErrorCode PortSDR::Host::CreateAndInitializeStream(const Device& device, std::unique_ptr<Stream>& stream) const
 {
     auto new_stream = CreateStream();
@@ -105,6 +167,8 @@ PortSDR::ErrorCode PortSDR::Host::CreateAndInitializeStream(const Device& device
 
 const PortSDR::Host* PortSDR::PortSDR::GetHost(HostType type) const
 {
+    std::lock_guard lock(m_hostMutex);
+
     const auto iter =
        std::find_if(m_hosts.begin(), m_hosts.end(),
                     [type](const std::unique_ptr<Host>& key)
@@ -112,10 +176,16 @@ const PortSDR::Host* PortSDR::PortSDR::GetHost(HostType type) const
                         return key->GetType() == type;
                     });
 
-    if (iter == m_hosts.end())
+    if (iter != m_hosts.end())
+        return iter->get();
+
+    // A missing vendor library is remembered by its loader, trying again is cheap.
+    std::unique_ptr<Host> host = CreateHost(type);
+    if (!host)
         return {};
 
-    return iter->get();
+    m_hosts.push_back(std::move(host));
+    return m_hosts.back().get();
 }
 
 double PortSDR::MetaRange::Max() const
@@ -155,3 +225,20 @@ double PortSDR::MetaRange::Step() const
     if (non_zero_steps.empty()) return 0; //all zero steps, its zero...
     return *std::min_element(non_zero_steps.begin(), non_zero_steps.end());
 }
+
+std::vector<double> PortSDR::MetaRange::Values() const
+{
+    std::vector<double> values;
+    for (const Range& r : *this)
+    {
+        if (r.step <= 0)
+        {
+            values.push_back(r.start);
+            continue;
+        }
+
+        for (double v = r.start; v <= r.stop + r.step / 2; v += r.step)
+            values.push_back(v);
+    }
+    return values;
+}
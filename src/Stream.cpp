@@ -0,0 +1,1090 @@
+#include "Stream.h"
+
+#include <algorithm>
+#include <deque>
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+#include "Trace.h"
+#include "dsp/Convert.h"
+#include "dsp/Level.h"
+
+// Room for the largest sample format
+#define POLL_MAX_SAMPLE_SIZE 8
+
+// Bytes buffered for ReadInto() while no reader waits, a power of two
+#define READ_BUFFER_SIZE (8 * 1024 * 1024)
+
+// Weight of a new transfer in the rolling health metrics
+#define HEALTH_SMOOTHING 0.1f
+#define HEALTH_PEAK_DECAY 0.99f
+
+namespace PortSDR
+{
+    struct StreamCommand
+    {
+        Stream::COMMAND function;
+        std::promise<ErrorCode> done;
+    };
+
+    struct StreamCommands
+    {
+        // Everything below is guarded by the mutex, the control thread sleeps on cond while queue is empty.
+        std::mutex mutex;
+        std::condition_variable cond;
+        std::deque<StreamCommand> queue;
+        bool stopped = false;
+        std::thread thread;
+    };
+}
+
+static int64_t SteadyNow()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * Converts count IQ samples of transfer, starting at sample from, into dst, starting at sample at of dst.
+ * Planar destinations hold capacity I values followed by capacity Q values.
+ */
+static void ConvertInto(const PortSDR::SDRTransfer& transfer,
+                        const std::size_t from,
+                        void* dst,
+                        const PortSDR::SampleFormat format,
+                        const std::size_t capacity,
+                        const bool planar,
+                        const std::size_t at,
+                        const std::size_t count)
+{
+    if (!planar)
+    {
+        PortSDR::ConvertTransfer(transfer, from, static_cast<uint8_t*>(dst) + at * PortSDR::GetSampleSize(format),
+                                 format, count);
+        return;
+    }
+
+    const std::size_t valueSize = PortSDR::GetSampleSize(format) / 2;
+    uint8_t* dstI = static_cast<uint8_t*>(dst) + at * valueSize;
+    uint8_t* dstQ = dstI + capacity * valueSize;
+
+    if (transfer.layout == PortSDR::SAMPLE_LAYOUT_PLANAR)
+    {
+        // Each plane converts on its own.
+        const std::size_t offset = from * PortSDR::GetSampleSize(transfer.format) / 2;
+        PortSDR::ConvertSamples(static_cast<const uint8_t*>(transfer.data) + offset, transfer.format,
+                                dstI, format, count);
+        PortSDR::ConvertSamples(static_cast<const uint8_t*>(transfer.data_q) + offset, transfer.format,
+                                dstQ, format, count);
+        return;
+    }
+
+    PortSDR::ConvertSamplesPlanar(static_cast<const uint8_t*>(transfer.data) + from * PortSDR::GetSampleSize(transfer.format),
+                                  transfer.format, dstI, dstQ, format, count * 2);
+}
+
+/**
+ * Views the interleaved samples of a buffer as a transfer.
+ */
+static PortSDR::SDRTransfer Interleaved(void* data, const PortSDR::SampleFormat format, const std::size_t frames)
+{
+    PortSDR::SDRTransfer transfer{};
+    transfer.data = data;
+    transfer.format = format;
+    transfer.frame_size = frames;
+    return transfer;
+}
+
+/**
+ * Moves the start of transfer forward by samples, in both planes of a planar transfer.
+ */
+static void Advance(PortSDR::SDRTransfer& transfer, const std::size_t samples)
+{
+    if (transfer.layout != PortSDR::SAMPLE_LAYOUT_PLANAR)
+    {
+        transfer.data = static_cast<uint8_t*>(transfer.data) + samples * PortSDR::GetSampleSize(transfer.format);
+        return;
+    }
+
+    const std::size_t offset = samples * PortSDR::GetSampleSize(transfer.format) / 2;
+    transfer.data = static_cast<uint8_t*>(transfer.data) + offset;
+    transfer.data_q = static_cast<uint8_t*>(transfer.data_q) + offset;
+}
+
+PortSDR::Stream::Stream()
+    : m_commands(std::make_unique<StreamCommands>())
+{
+}
+
+PortSDR::Stream::~Stream()
+{
+    // Implementations disable it before closing their hardware, this only catches the ones that can't reopen.
+    DisableRecovery();
+    StopCommands();
+
+#ifdef __linux__
+    if (m_pollFd >= 0)
+        close(m_pollFd);
+#endif
+}
+
+PortSDR::ErrorCode PortSDR::Stream::ReadInto(const Span<uint8_t> dst,
+                                             std::size_t& frames,
+                                             const std::chrono::milliseconds timeout)
+{
+    return Read(dst.data(), SAMPLE_FORMAT_IQ_UINT8, dst.size() / 2, IsPlanar(), frames, timeout);
+}
+
+PortSDR::ErrorCode PortSDR::Stream::ReadInto(const Span<int16_t> dst,
+                                             std::size_t& frames,
+                                             const std::chrono::milliseconds timeout)
+{
+    return Read(dst.data(), SAMPLE_FORMAT_IQ_INT16, dst.size() / 2, IsPlanar(), frames, timeout);
+}
+
+PortSDR::ErrorCode PortSDR::Stream::ReadInto(const Span<float> dst,
+                                             std::size_t& frames,
+                                             const std::chrono::milliseconds timeout)
+{
+    return Read(dst.data(), SAMPLE_FORMAT_IQ_FLOAT32, dst.size() / 2, IsPlanar(), frames, timeout);
+}
+
+PortSDR::ErrorCode PortSDR::Stream::ReadInto(const Span<std::complex<float>> dst,
+                                             std::size_t& frames,
+                                             const std::chrono::milliseconds timeout)
+{
+    // std::complex<float> is guaranteed to be laid out as two floats.
+    return Read(dst.data(), SAMPLE_FORMAT_IQ_FLOAT32, dst.size(), false, frames, timeout);
+}
+
+PortSDR::ErrorCode PortSDR::Stream::Drain(const Span<uint8_t> dst, std::size_t& frames)
+{
+    return DrainPoll(dst.data(), SAMPLE_FORMAT_IQ_UINT8, dst.size() / 2, IsPlanar(), frames);
+}
+
+PortSDR::ErrorCode PortSDR::Stream::Drain(const Span<int16_t> dst, std::size_t& frames)
+{
+    return DrainPoll(dst.data(), SAMPLE_FORMAT_IQ_INT16, dst.size() / 2, IsPlanar(), frames);
+}
+
+PortSDR::ErrorCode PortSDR::Stream::Drain(const Span<float> dst, std::size_t& frames)
+{
+    return DrainPoll(dst.data(), SAMPLE_FORMAT_IQ_FLOAT32, dst.size() / 2, IsPlanar(), frames);
+}
+
+PortSDR::ErrorCode PortSDR::Stream::Drain(const Span<std::complex<float>> dst, std::size_t& frames)
+{
+    return DrainPoll(dst.data(), SAMPLE_FORMAT_IQ_FLOAT32, dst.size(), false, frames);
+}
+
+PortSDR::ErrorCode PortSDR::Stream::SetPollWatermark(const std::size_t watermark, std::size_t capacity)
+{
+    if (watermark == 0)
+        return ErrorCode::INVALID_ARGUMENT;
+
+#ifdef __linux__
+    if (!m_pollEnabled)
+    {
+        if (capacity == 0)
+            capacity = watermark * 4;
+        if (capacity < watermark)
+            return ErrorCode::INVALID_ARGUMENT;
+
+        std::size_t bytes = 1;
+        while (bytes < capacity * POLL_MAX_SAMPLE_SIZE)
+            bytes <<= 1;
+
+        m_pollFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (m_pollFd < 0)
+            return ErrorCode::UNKNOWN;
+
+        m_pollRing.resize(bytes);
+        m_pollWatermark = watermark;
+        m_pollEnabled = true;
+        return ErrorCode::OK;
+    }
+
+    if (watermark * POLL_MAX_SAMPLE_SIZE > m_pollRing.size())
+        return ErrorCode::INVALID_ARGUMENT;
+
+    m_pollWatermark = watermark;
+    SignalPoll();
+    return ErrorCode::OK;
+#else
+    return ErrorCode::HOST_UNAVAILABLE;
+#endif
+}
+
+int PortSDR::Stream::GetPollFd() const
+{
+    return m_pollEnabled ? m_pollFd : -1;
+}
+
+uint64_t PortSDR::Stream::GetPollOverflows() const
+{
+    return m_pollOverflows;
+}
+
+void PortSDR::Stream::SignalPoll()
+{
+#ifdef __linux__
+    const uint64_t buffered = m_pollHead.load(std::memory_order_acquire) - m_pollTail.load(std::memory_order_acquire);
+    const std::size_t watermark = m_pollWatermark * GetSampleSize(m_pollFormat);
+
+    // Only write once per crossing, so the event loop isn't woken for every transfer.
+    if (buffered >= watermark && !m_pollSignalled.exchange(true))
+    {
+        const uint64_t one = 1;
+        [[maybe_unused]] const ssize_t ret = write(m_pollFd, &one, sizeof(one));
+    }
+#endif
+}
+
+void PortSDR::Stream::PushPoll(const SDRTransfer& transfer)
+{
+    // Everything is buffered in the format of the first transfer.
+    if (!m_pollFormatSet)
+    {
+        m_pollFormat = transfer.format;
+        m_pollFormatSet = true;
+    }
+
+    const std::size_t sampleSize = GetSampleSize(m_pollFormat);
+    const std::size_t bytes = transfer.frame_size * sampleSize;
+    const std::size_t mask = m_pollRing.size() - 1;
+    const uint64_t head = m_pollHead.load(std::memory_order_relaxed);
+    const uint64_t tail = m_pollTail.load(std::memory_order_acquire);
+
+    // A transfer that doesn't fit is dropped as a whole, so gaps only fall between transfers.
+    // The reader owns the tail.
+    if (bytes > m_pollRing.size() - (head - tail))
+    {
+        m_pollOverflows.fetch_add(transfer.frame_size, std::memory_order_relaxed);
+        PORTSDR_TRACE_INSTANT("poll_overflow", transfer.frame_size);
+        return;
+    }
+
+    // Converted and interleaved straight into the ring, in up to two segments.
+    const std::size_t offset = head & mask;
+    const std::size_t first = std::min(bytes, m_pollRing.size() - offset) / sampleSize;
+    ConvertTransfer(transfer, 0, m_pollRing.data() + offset, m_pollFormat, first);
+    ConvertTransfer(transfer, first, m_pollRing.data(), m_pollFormat, transfer.frame_size - first);
+
+    m_pollHead.store(head + bytes, std::memory_order_release);
+    SignalPoll();
+}
+
+PortSDR::ErrorCode PortSDR::Stream::DrainPoll(void* dst,
+                                              const SampleFormat format,
+                                              const std::size_t capacity,
+                                              const bool planar,
+                                              std::size_t& frames)
+{
+    frames = 0;
+
+    if (!m_pollEnabled)
+        return ErrorCode::UNINITIALIZED;
+    if (capacity == 0)
+        return ErrorCode::INVALID_ARGUMENT;
+
+    const uint64_t head = m_pollHead.load(std::memory_order_acquire);
+    const uint64_t tail = m_pollTail.load(std::memory_order_relaxed);
+
+    if (head != tail)
+    {
+        const std::size_t sampleSize = GetSampleSize(m_pollFormat);
+        const std::size_t mask = m_pollRing.size() - 1;
+        const std::size_t count = std::min(capacity, static_cast<std::size_t>(head - tail) / sampleSize);
+
+        // Converted straight out of the ring in up to two segments.
+        const std::size_t offset = tail & mask;
+        const std::size_t first = std::min(count, (m_pollRing.size() - offset) / sampleSize);
+        ConvertInto(Interleaved(m_pollRing.data() + offset, m_pollFormat, first), 0,
+                    dst, format, capacity, planar, 0, first);
+        ConvertInto(Interleaved(m_pollRing.data(), m_pollFormat, count - first), 0,
+                    dst, format, capacity, planar, first, count - first);
+
+        m_pollTail.store(tail + count * sampleSize, std::memory_order_release);
+        frames = count;
+    }
+
+#ifdef __linux__
+    // Rearm once below the watermark, then check again for a transfer that raced with us.
+    const uint64_t buffered = m_pollHead.load(std::memory_order_acquire) - m_pollTail.load(std::memory_order_relaxed);
+    if (buffered < m_pollWatermark * GetSampleSize(m_pollFormat) && m_pollSignalled)
+    {
+        uint64_t value;
+        [[maybe_unused]] const ssize_t ret = read(m_pollFd, &value, sizeof(value));
+        m_pollSignalled = false;
+        SignalPoll();
+    }
+#endif
+
+    return ErrorCode::OK;
+}
+
+void PortSDR::Stream::SetHealthMonitor(const bool enable)
+{
+    m_healthEnabled = enable;
+}
+
+PortSDR::SignalHealth PortSDR::Stream::GetHealth() const
+{
+    std::lock_guard lock(m_healthMutex);
+    return m_health;
+}
+
+void PortSDR::Stream::UpdateHealth(const SignalHealth& health)
+{
+    const auto smooth = [](float& value, const float sample)
+    {
+        value += HEALTH_SMOOTHING * (sample - value);
+    };
+
+    std::lock_guard lock(m_healthMutex);
+    if (!m_healthMeasured)
+    {
+        m_health = health;
+        m_healthMeasured = true;
+        return;
+    }
+
+    smooth(m_health.rms, health.rms);
+    smooth(m_health.saturation, health.saturation);
+    smooth(m_health.dc_i, health.dc_i);
+    smooth(m_health.dc_q, health.dc_q);
+    m_health.peak = std::max(health.peak, m_health.peak * HEALTH_PEAK_DECAY);
+}
+
+void PortSDR::Stream::Deliver(SDRTransfer& transfer)
+{
+    transfer.discontinuity = false;
+    if (m_recoveryEnabled.load(std::memory_order_relaxed))
+    {
+        const int64_t now = SteadyNow();
+        m_lastTransfer.store(now, std::memory_order_relaxed);
+        m_supervised.store(true, std::memory_order_relaxed);
+
+        if (m_gapStart.load(std::memory_order_relaxed) != 0)
+        {
+            // The last transfer before the failure ended at gapStart, this one started frame_size samples ago.
+            const int64_t gapStart = m_gapStart.exchange(0);
+            const double gap = static_cast<double>(now - gapStart) * 1e-9 * GetSampleRate();
+            transfer.discontinuity = true;
+            transfer.dropped_samples += static_cast<std::size_t>(
+                std::max(gap - static_cast<double>(transfer.frame_size), 0.0));
+        }
+    }
+
+    AttachTags(transfer);
+
+    if (m_settleSkip.load(std::memory_order_relaxed) != 0 || m_skipUntil != 0)
+    {
+        SkipSettling(transfer);
+        return;
+    }
+
+    Dispatch(transfer);
+}
+
+void PortSDR::Stream::SkipSettling(SDRTransfer& transfer)
+{
+    const uint64_t end = m_sampleIndex.load(std::memory_order_relaxed);
+    const uint64_t first = end - transfer.frame_size;
+
+    // A window starts at every retune, a later retune replaces the window of an earlier one.
+    for (std::size_t i = 0; i < transfer.tag_count; i++)
+    {
+        if (transfer.tags[i].type != STREAM_TAG_FREQUENCY)
+            continue;
+
+        const double samples = static_cast<double>(m_settleSkip.load(std::memory_order_relaxed)) * 1e-6 * GetSampleRate();
+        m_skipFrom = transfer.tags[i].sample_index;
+        m_skipUntil = m_skipFrom + static_cast<uint64_t>(samples);
+    }
+
+    const uint64_t from = std::max(first, m_skipFrom);
+    const uint64_t until = std::min(end, m_skipUntil);
+    if (until <= from)
+    {
+        if (m_skipUntil <= first)
+            m_skipUntil = 0;
+
+        if (m_skipped != 0 || !m_skippedTags.empty())
+        {
+            // The window ended right with the previous transfer.
+            transfer.dropped_samples += m_skipped;
+            m_skipped = 0;
+            m_skippedTags.insert(m_skippedTags.end(), transfer.tags, transfer.tags + transfer.tag_count);
+            transfer.tags = m_skippedTags.data();
+            transfer.tag_count = m_skippedTags.size();
+        }
+
+        Dispatch(transfer);
+        m_skippedTags.clear();
+        return;
+    }
+
+    const std::size_t headSize = from - first;
+    const std::size_t tailOffset = until - first;
+
+    // Tags are ordered by offset, the ones within the skipped samples move to the first sample after them.
+    std::size_t headTags = 0;
+    while (headTags < transfer.tag_count && transfer.tags[headTags].offset < headSize)
+        headTags++;
+    for (std::size_t i = headTags; i < transfer.tag_count; i++)
+        m_skippedTags.push_back(transfer.tags[i]);
+
+    if (headSize > 0)
+    {
+        // Still at the old frequency.
+        SDRTransfer head = transfer;
+        head.frame_size = headSize;
+        head.tags = headTags > 0 ? transfer.tags : nullptr;
+        head.tag_count = headTags;
+        head.health = nullptr;
+        head.dropped_samples += m_skipped;
+        m_skipped = 0;
+        Dispatch(head);
+    }
+    else
+    {
+        m_skipped += transfer.dropped_samples;
+    }
+
+    m_skipped += until - from;
+    if (until == end)
+    {
+        // Everything else is skipped, the tags go to the first sample of a later transfer.
+        for (StreamTag& tag : m_skippedTags)
+            tag.offset = 0;
+        return;
+    }
+
+    SDRTransfer tail = transfer;
+    Advance(tail, tailOffset);
+    tail.frame_size = end - until;
+    tail.dropped_samples = m_skipped;
+    tail.discontinuity = transfer.discontinuity && headSize == 0;
+    tail.health = nullptr;
+    m_skipped = 0;
+    m_skipUntil = 0;
+
+    for (StreamTag& tag : m_skippedTags)
+        tag.offset = tag.offset > tailOffset ? tag.offset - tailOffset : 0;
+    tail.tags = m_skippedTags.data();
+    tail.tag_count = m_skippedTags.size();
+
+    Dispatch(tail);
+    m_skippedTags.clear();
+}
+
+void PortSDR::Stream::Dispatch(SDRTransfer& transfer)
+{
+    PORTSDR_TRACE_INSTANT("transfer", transfer.frame_size);
+    if (transfer.dropped_samples != 0)
+        PORTSDR_TRACE_INSTANT("overrun", transfer.dropped_samples);
+
+    // Implementations that see the raw ADC values measure those instead.
+    SignalHealth health;
+    if (IsHealthMonitored())
+    {
+        if (!transfer.health)
+        {
+            health = MeasureLevel(transfer, 0, transfer.frame_size).Health();
+            transfer.health = &health;
+        }
+        UpdateHealth(*transfer.health);
+    }
+    else
+    {
+        transfer.health = nullptr;
+    }
+
+    std::unique_lock callbackLock(m_callbackMutex);
+    if (m_callback)
+    {
+        const std::shared_ptr<SDR_CALLBACK> callback = m_callback;
+
+        PORTSDR_TRACE_SCOPE("callback");
+        if (IsPlanar() && transfer.layout != SAMPLE_LAYOUT_PLANAR)
+        {
+            // Only for implementations that don't split the values in their own conversion.
+            SDRTransfer planar = transfer;
+            PreparePlanar(planar, transfer.frame_size, transfer.format);
+            ConvertSamplesPlanar(transfer.data, transfer.format, planar.data, planar.data_q, transfer.format,
+                                 transfer.frame_size * 2);
+            (*callback)(planar);
+        }
+        else
+        {
+            (*callback)(transfer);
+        }
+    }
+    callbackLock.unlock();
+
+    if (m_pollEnabled)
+        PushPoll(transfer);
+
+    std::unique_lock lock(m_readMutex);
+    if (!m_readEnabled)
+        return;
+
+    // Handed straight to a waiting reader, unless older samples are still buffered.
+    std::size_t offset = 0;
+    if (m_readers > 0 && m_readHead == m_readTail)
+    {
+        const uint64_t generation = m_readGeneration;
+        m_pending = &transfer;
+        m_pendingOffset = 0;
+        m_readCond.notify_all();
+
+        // Only held while readers convert it, what they had no room for is buffered.
+        m_readCond.wait(lock, [this, &transfer, generation]
+        {
+            return m_pendingOffset >= transfer.frame_size || m_readers == 0 || m_readGeneration != generation;
+        });
+        m_pending = nullptr;
+
+        if (m_readGeneration != generation)
+            return;
+        offset = m_pendingOffset;
+    }
+
+    PushRead(transfer, offset);
+}
+
+void PortSDR::Stream::PushRead(const SDRTransfer& transfer, const std::size_t offset)
+{
+    const std::size_t frames = transfer.frame_size - offset;
+    if (frames == 0)
+        return;
+
+    // Buffered in the format of the oldest transfer, so starting over when empty keeps samples aligned.
+    if (m_readHead == m_readTail)
+    {
+        m_readHead = 0;
+        m_readTail = 0;
+        m_readFormat = transfer.format;
+    }
+
+    const std::size_t sampleSize = GetSampleSize(m_readFormat);
+    const std::size_t space = m_readRing.size() - (m_readHead - m_readTail);
+    const std::size_t count = std::min(frames, space / sampleSize);
+    const std::size_t bytes = count * sampleSize;
+
+    if (count < frames)
+    {
+        m_readOverflows.fetch_add(frames - count, std::memory_order_relaxed);
+        PORTSDR_TRACE_INSTANT("read_overflow", frames - count);
+    }
+
+    // Converted and interleaved straight into the ring, in up to two segments.
+    const std::size_t mask = m_readRing.size() - 1;
+    const std::size_t position = m_readHead & mask;
+    const std::size_t first = std::min(bytes, m_readRing.size() - position) / sampleSize;
+    ConvertTransfer(transfer, offset, m_readRing.data() + position, m_readFormat, first);
+    ConvertTransfer(transfer, offset + first, m_readRing.data(), m_readFormat, count - first);
+
+    m_readHead += bytes;
+    m_readCond.notify_all();
+}
+
+uint64_t PortSDR::Stream::GetReadOverflows() const
+{
+    return m_readOverflows.load(std::memory_order_relaxed);
+}
+
+void PortSDR::Stream::SwapCallback(SDR_CALLBACK callback)
+{
+    std::shared_ptr<SDR_CALLBACK> next;
+    if (callback)
+        next = std::make_shared<SDR_CALLBACK>(std::move(callback));
+
+    // Waits for the receiving thread to leave the old callback.
+    std::lock_guard lock(m_callbackMutex);
+    m_callback.swap(next);
+}
+
+void PortSDR::Stream::SetSettleSkip(const std::chrono::microseconds time)
+{
+    m_settleSkip = std::max<int64_t>(time.count(), 0);
+}
+
+std::chrono::microseconds PortSDR::Stream::GetSettleSkip() const
+{
+    return std::chrono::microseconds(m_settleSkip.load(std::memory_order_relaxed));
+}
+
+std::future<PortSDR::ErrorCode> PortSDR::Stream::Submit(COMMAND command)
+{
+    StreamCommands& commands = *m_commands;
+
+    std::promise<ErrorCode> done;
+    std::future<ErrorCode> result = done.get_future();
+
+    {
+        // Checked and pushed under the lock StopCommands() drains under, so no command is left behind.
+        std::lock_guard lock(commands.mutex);
+        if (commands.stopped)
+        {
+            done.set_value(ErrorCode::STOPPED);
+            return result;
+        }
+
+        if (!commands.thread.joinable())
+            commands.thread = std::thread(&Stream::RunCommands, this);
+
+        commands.queue.push_back({std::move(command), std::move(done)});
+    }
+    commands.cond.notify_one();
+
+    return result;
+}
+
+std::future<PortSDR::ErrorCode> PortSDR::Stream::SetSampleRateAsync(const uint32_t sampleRate)
+{
+    return Submit([sampleRate](Stream& stream)
+    {
+        return stream.SetSampleRate(sampleRate);
+    });
+}
+
+std::future<PortSDR::ErrorCode> PortSDR::Stream::SetCenterFrequencyAsync(const uint32_t freq)
+{
+    return Submit([freq](Stream& stream)
+    {
+        return stream.SetCenterFrequency(freq);
+    });
+}
+
+std::future<PortSDR::ErrorCode> PortSDR::Stream::SetSampleFormatAsync(const SampleFormat format)
+{
+    return Submit([format](Stream& stream)
+    {
+        return stream.SetSampleFormat(format);
+    });
+}
+
+std::future<PortSDR::ErrorCode> PortSDR::Stream::SetGainAsync(const double gain, const std::string_view name)
+{
+    return Submit([gain, name = std::string(name)](Stream& stream)
+    {
+        return stream.SetGain(gain, name);
+    });
+}
+
+std::future<PortSDR::ErrorCode> PortSDR::Stream::SetGainModeAsync(const GainMode mode)
+{
+    return Submit([mode](Stream& stream)
+    {
+        return stream.SetGainMode(mode);
+    });
+}
+
+void PortSDR::Stream::StopCommands()
+{
+    StreamCommands& commands = *m_commands;
+
+    {
+        std::lock_guard lock(commands.mutex);
+        commands.stopped = true;
+    }
+    commands.cond.notify_one();
+
+    if (commands.thread.joinable())
+        commands.thread.join();
+
+    std::lock_guard lock(commands.mutex);
+    for (StreamCommand& command : commands.queue)
+        command.done.set_value(ErrorCode::STOPPED);
+    commands.queue.clear();
+}
+
+void PortSDR::Stream::RunCommands()
+{
+    StreamCommands& commands = *m_commands;
+
+    std::unique_lock lock(commands.mutex);
+    while (true)
+    {
+        commands.cond.wait(lock, [&commands]
+        {
+            return !commands.queue.empty() || commands.stopped;
+        });
+
+        if (commands.stopped)
+            break;
+
+        StreamCommand command = std::move(commands.queue.front());
+        commands.queue.pop_front();
+
+        // Run without the lock, so callers can keep queueing meanwhile.
+        lock.unlock();
+        {
+            PORTSDR_TRACE_SCOPE("command");
+            try
+            {
+                command.done.set_value(command.function(*this));
+            }
+            catch (...)
+            {
+                command.done.set_exception(std::current_exception());
+            }
+        }
+        lock.lock();
+    }
+}
+
+PortSDR::ErrorCode PortSDR::Stream::SetSampleLayout(const SampleLayout layout)
+{
+    if (layout != SAMPLE_LAYOUT_INTERLEAVED && layout != SAMPLE_LAYOUT_PLANAR)
+        return ErrorCode::INVALID_ARGUMENT;
+    if (layout == SAMPLE_LAYOUT_PLANAR && m_boundFormat.load() >= 0)
+        return ErrorCode::INVALID_ARGUMENT;
+
+    m_layout = layout;
+    return ErrorCode::OK;
+}
+
+void PortSDR::Stream::PreparePlanar(SDRTransfer& transfer, const std::size_t frames, const SampleFormat format)
+{
+    // Q starts on a cache line of its own.
+    const std::size_t planeSize = frames * GetSampleSize(format) / 2;
+    const std::size_t offset = (planeSize + 63) & ~static_cast<std::size_t>(63);
+    m_planar.resize(offset + planeSize);
+
+    transfer.format = format;
+    transfer.layout = SAMPLE_LAYOUT_PLANAR;
+    transfer.data = m_planar.data();
+    transfer.data_q = m_planar.data() + offset;
+}
+
+PortSDR::ErrorCode PortSDR::Stream::CheckSampleFormat(const SampleFormat format) const
+{
+    const int bound = m_boundFormat.load();
+    return bound < 0 || bound == format ? ErrorCode::OK : ErrorCode::INVALID_ARGUMENT;
+}
+
+void PortSDR::Stream::PostTag(const StreamTagType type, const double value, const std::string_view name)
+{
+    StreamTag tag{};
+    tag.type = type;
+    tag.value = value;
+    tag.sample_index = m_sampleIndex.load(std::memory_order_acquire);
+    name.copy(tag.name, sizeof(tag.name) - 1);
+
+    std::lock_guard lock(m_tagMutex);
+    m_pendingTags.push_back(tag);
+    m_tagsPending.store(true, std::memory_order_release);
+}
+
+void PortSDR::Stream::AttachTags(SDRTransfer& transfer)
+{
+    m_tags.clear();
+
+    const uint64_t first = m_sampleIndex.load(std::memory_order_relaxed) + transfer.dropped_samples;
+    const uint64_t end = first + transfer.frame_size;
+    m_sampleIndex.store(end, std::memory_order_release);
+
+    if (transfer.discontinuity || transfer.dropped_samples != 0)
+    {
+        StreamTag tag{};
+        tag.type = transfer.discontinuity ? STREAM_TAG_RECOVERY : STREAM_TAG_OVERFLOW;
+        tag.value = static_cast<double>(transfer.dropped_samples);
+        tag.sample_index = first;
+        m_tags.push_back(tag);
+    }
+
+    if (m_tagsPending.load(std::memory_order_acquire))
+    {
+        std::lock_guard lock(m_tagMutex);
+        std::size_t kept = 0;
+        for (StreamTag& tag : m_pendingTags)
+        {
+            // Posted after this transfer was counted, so it belongs to the next one.
+            if (tag.sample_index >= end)
+            {
+                m_pendingTags[kept++] = tag;
+                continue;
+            }
+
+            // Lands after the samples dropped right before this transfer.
+            tag.sample_index = std::max(tag.sample_index, first);
+            tag.offset = tag.sample_index - first;
+            m_tags.push_back(tag);
+        }
+        m_pendingTags.resize(kept);
+        m_tagsPending.store(kept != 0, std::memory_order_relaxed);
+    }
+
+    transfer.tags = m_tags.empty() ? nullptr : m_tags.data();
+    transfer.tag_count = m_tags.size();
+}
+
+void PortSDR::Stream::CancelReads()
+{
+    // Stopping on purpose isn't a failure.
+    m_supervised = false;
+
+    {
+        std::lock_guard lock(m_readMutex);
+        m_readEnabled = false;
+        m_pending = nullptr;
+        m_readHead = 0;
+        m_readTail = 0;
+        m_readGeneration++;
+    }
+    m_readCond.notify_all();
+}
+
+PortSDR::ErrorCode PortSDR::Stream::Read(void* dst,
+                                         const SampleFormat format,
+                                         const std::size_t capacity,
+                                         const bool planar,
+                                         std::size_t& frames,
+                                         const std::chrono::milliseconds timeout)
+{
+    frames = 0;
+
+    if (capacity == 0)
+        return ErrorCode::INVALID_ARGUMENT;
+
+    std::unique_lock lock(m_readMutex);
+    if (!m_readEnabled)
+    {
+        if (m_readRing.empty())
+            m_readRing.resize(READ_BUFFER_SIZE);
+        m_readEnabled = true;
+    }
+
+    const uint64_t generation = m_readGeneration;
+    m_readers++;
+
+    const bool ready = m_readCond.wait_for(lock, timeout, [this, generation]
+    {
+        return m_readHead != m_readTail
+            || (m_pending && m_pendingOffset < m_pending->frame_size)
+            || m_readGeneration != generation;
+    });
+
+    ErrorCode ret = ErrorCode::OK;
+    if (m_readGeneration != generation)
+    {
+        ret = ErrorCode::STOPPED;
+    }
+    else if (!ready)
+    {
+        ret = ErrorCode::TIMEOUT;
+    }
+    else if (m_readHead != m_readTail)
+    {
+        // Buffered samples are older than a held transfer.
+        const std::size_t sampleSize = GetSampleSize(m_readFormat);
+        const std::size_t mask = m_readRing.size() - 1;
+        const std::size_t count = std::min(capacity, static_cast<std::size_t>(m_readHead - m_readTail) / sampleSize);
+
+        const std::size_t position = m_readTail & mask;
+        const std::size_t first = std::min(count, (m_readRing.size() - position) / sampleSize);
+        ConvertInto(Interleaved(m_readRing.data() + position, m_readFormat, first), 0,
+                    dst, format, capacity, planar, 0, first);
+        ConvertInto(Interleaved(m_readRing.data(), m_readFormat, count - first), 0,
+                    dst, format, capacity, planar, first, count - first);
+
+        m_readTail += count * sampleSize;
+        frames = count;
+    }
+    else
+    {
+        // The receiving thread waits, so the transfer stays valid while converting.
+        const SDRTransfer& transfer = *m_pending;
+        const std::size_t count = std::min(capacity, transfer.frame_size - m_pendingOffset);
+
+        ConvertInto(transfer, m_pendingOffset, dst, format, capacity, planar, 0, count);
+
+        m_pendingOffset += count;
+        frames = count;
+    }
+
+    // The receiving thread buffers the rest of a held transfer once no reader is left.
+    m_readers--;
+    m_readCond.notify_all();
+    return ret;
+}
+
+PortSDR::ErrorCode PortSDR::Stream::SetRecovery(const RecoveryConfig& config)
+{
+    if (!CanReopen())
+        return ErrorCode::HOST_UNAVAILABLE;
+    if (config.stall_timeout.count() <= 0 || config.retry_interval.count() < 0)
+        return ErrorCode::INVALID_ARGUMENT;
+
+    std::lock_guard lock(m_recoveryMutex);
+    m_recoveryConfig = config;
+    m_recoveryEnabled = true;
+
+    if (!m_recoveryThread.joinable())
+    {
+        m_recoveryExit = false;
+        m_recoveryThread = std::thread(&Stream::Supervise, this);
+    }
+    return ErrorCode::OK;
+}
+
+void PortSDR::Stream::DisableRecovery()
+{
+    {
+        std::lock_guard lock(m_recoveryMutex);
+        m_recoveryExit = true;
+        m_recoveryEnabled = false;
+    }
+    m_recoveryCond.notify_all();
+
+    if (m_recoveryThread.joinable())
+        m_recoveryThread.join();
+
+    m_supervised = false;
+    m_gapStart = 0;
+}
+
+void PortSDR::Stream::SetRecoveryCallback(RECOVERY_CALLBACK callback)
+{
+    std::lock_guard lock(m_recoveryMutex);
+    m_recoveryCallback = std::move(callback);
+}
+
+PortSDR::RecoveryStats PortSDR::Stream::GetRecoveryStats() const
+{
+    std::lock_guard lock(m_recoveryMutex);
+    return m_recoveryStats;
+}
+
+void PortSDR::Stream::ReportFailure(const ErrorCode error)
+{
+    if (!m_recoveryEnabled)
+        return;
+
+    {
+        std::lock_guard lock(m_recoveryMutex);
+        m_failure = error;
+    }
+    m_recoveryCond.notify_all();
+}
+
+void PortSDR::Stream::Supervise()
+{
+    std::unique_lock lock(m_recoveryMutex);
+    while (!m_recoveryExit)
+    {
+        // Checked a few times per timeout, so a stall is noticed at most a quarter of it late.
+        const auto interval = std::max(m_recoveryConfig.stall_timeout / 4, std::chrono::milliseconds(1));
+        m_recoveryCond.wait_for(lock, interval, [this]
+        {
+            return m_recoveryExit || m_failure != ErrorCode::OK;
+        });
+        if (m_recoveryExit)
+            break;
+
+        ErrorCode cause = m_failure.exchange(ErrorCode::OK);
+        if (!m_supervised)
+            continue;
+
+        if (cause == ErrorCode::OK)
+        {
+            const int64_t idle = SteadyNow() - m_lastTransfer.load(std::memory_order_relaxed);
+            if (idle < std::chrono::nanoseconds(m_recoveryConfig.stall_timeout).count())
+                continue;
+            cause = ErrorCode::TIMEOUT;
+        }
+
+        // Unlocked, so Reopen() and the callback can use the stream.
+        lock.unlock();
+        Recover(cause);
+        lock.lock();
+    }
+}
+
+bool PortSDR::Stream::Recover(const ErrorCode cause)
+{
+    RecoveryConfig config;
+    {
+        std::lock_guard lock(m_recoveryMutex);
+        config = m_recoveryConfig;
+    }
+
+    const int64_t lastTransfer = m_lastTransfer.load(std::memory_order_relaxed);
+
+    PORTSDR_TRACE_SCOPE_VALUE("recovery", cause);
+
+    uint32_t attempts = 0;
+    ErrorCode ret;
+    while (true)
+    {
+        attempts++;
+        ret = Reopen();
+        if (ret == ErrorCode::OK || ret == ErrorCode::STOPPED)
+            break;
+        if (config.max_attempts != 0 && attempts >= config.max_attempts)
+            break;
+
+        std::unique_lock lock(m_recoveryMutex);
+        if (m_recoveryCond.wait_for(lock, config.retry_interval, [this]
+        {
+            return m_recoveryExit || !m_supervised;
+        }))
+        {
+            ret = ErrorCode::STOPPED;
+            break;
+        }
+    }
+
+    if (ret == ErrorCode::STOPPED)
+    {
+        m_supervised = false;
+        return false;
+    }
+
+    const int64_t now = SteadyNow();
+
+    RecoveryEvent event{};
+    event.cause = cause;
+    event.attempts = attempts;
+    event.downtime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::nanoseconds(now - lastTransfer));
+    event.recovered = ret == ErrorCode::OK;
+
+    if (event.recovered)
+    {
+        // Errors of the old stream were reported while tearing it down.
+        m_failure = ErrorCode::OK;
+        m_gapStart = lastTransfer;
+        // A new stall is timed from the restart.
+        m_lastTransfer.store(now, std::memory_order_relaxed);
+    }
+    else
+    {
+        m_supervised = false;
+    }
+
+    RECOVERY_CALLBACK callback;
+    {
+        std::lock_guard lock(m_recoveryMutex);
+        if (event.recovered)
+        {
+            m_recoveryStats.recoveries++;
+            m_recoveryStats.last_downtime = event.downtime;
+            m_recoveryStats.total_downtime += event.downtime;
+        }
+        else
+        {
+            m_recoveryStats.failures++;
+        }
+        callback = m_recoveryCallback;
+    }
+
+    if (callback)
+        callback(event);
+    return event.recovered;
+}
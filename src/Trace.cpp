@@ -0,0 +1,197 @@
+#include "Trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "Utils.h"
+
+// Events kept per thread, 40 bytes each
+#define TRACE_BUFFER_EVENTS (1 << 15)
+// Skipped from the oldest end while dumping, they may be overwritten meanwhile
+#define TRACE_DUMP_MARGIN 1024
+
+std::atomic<bool> PortSDR::detail::gTraceEnabled{false};
+
+namespace
+{
+    struct TraceEvent
+    {
+        const char* name;
+        uint64_t start;
+        uint64_t duration; // UINT64_MAX for instant events
+        int64_t value;
+        uint64_t tid;
+    };
+
+    /**
+     * Single producer ring of the events of one thread.
+     * Kept after the thread exits, so the events can still be dumped, and continued by the next thread.
+     */
+    struct TraceBuffer
+    {
+        std::unique_ptr<TraceEvent[]> events{new TraceEvent[TRACE_BUFFER_EVENTS]};
+        std::atomic<uint64_t> head{0};
+        std::atomic<bool> inUse{false};
+    };
+
+    struct TraceThread
+    {
+        TraceBuffer* buffer = nullptr;
+        uint64_t tid = 0;
+
+        ~TraceThread()
+        {
+            if (buffer)
+                buffer->inUse.store(false, std::memory_order_release);
+        }
+    };
+
+    std::mutex sBuffersMutex;
+    std::vector<std::unique_ptr<TraceBuffer>> sBuffers;
+    std::atomic<uint64_t> sClearedAt{0};
+    thread_local TraceThread tThread;
+
+    const std::chrono::steady_clock::time_point sEpoch = std::chrono::steady_clock::now();
+
+    uint64_t CurrentThreadId()
+    {
+#ifdef __linux__
+        return static_cast<uint64_t>(syscall(SYS_gettid));
+#else
+        static std::atomic<uint64_t> next{1};
+        return next.fetch_add(1, std::memory_order_relaxed);
+#endif
+    }
+
+    TraceBuffer* GetThreadBuffer()
+    {
+        if (tThread.buffer)
+            return tThread.buffer;
+
+        // Only the first event of a thread takes the lock.
+        std::lock_guard lock(sBuffersMutex);
+
+        TraceBuffer* buffer = nullptr;
+        for (const auto& candidate : sBuffers)
+        {
+            if (!candidate->inUse.load(std::memory_order_acquire))
+            {
+                buffer = candidate.get();
+                break;
+            }
+        }
+        if (!buffer)
+            buffer = sBuffers.emplace_back(std::make_unique<TraceBuffer>()).get();
+
+        buffer->inUse.store(true, std::memory_order_relaxed);
+
+        tThread.buffer = buffer;
+        tThread.tid = CurrentThreadId();
+        return buffer;
+    }
+
+    void Record(const char* name, const uint64_t start, const uint64_t duration, const int64_t value)
+    {
+        TraceBuffer* buffer = GetThreadBuffer();
+
+        const uint64_t head = buffer->head.load(std::memory_order_relaxed);
+        buffer->events[head & (TRACE_BUFFER_EVENTS - 1)] = {name, start, duration, value, tThread.tid};
+        buffer->head.store(head + 1, std::memory_order_release);
+    }
+}
+
+void PortSDR::SetTracing(const bool enable)
+{
+    detail::gTraceEnabled.store(enable, std::memory_order_relaxed);
+}
+
+void PortSDR::ClearTrace()
+{
+    sClearedAt.store(TraceClock(), std::memory_order_relaxed);
+}
+
+uint64_t PortSDR::TraceClock()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - sEpoch).count();
+}
+
+void PortSDR::TraceInstant(const char* name, const int64_t value)
+{
+    Record(name, TraceClock(), UINT64_MAX, value);
+}
+
+void PortSDR::TraceComplete(const char* name, const uint64_t start, const int64_t value)
+{
+    Record(name, start, TraceClock() - start, value);
+}
+
+std::string PortSDR::GetTraceJson()
+{
+    const uint64_t clearedAt = sClearedAt.load(std::memory_order_relaxed);
+    const bool tracing = IsTracing();
+
+    std::string json = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+
+    std::lock_guard lock(sBuffersMutex);
+    for (const auto& buffer : sBuffers)
+    {
+        const uint64_t head = buffer->head.load(std::memory_order_acquire);
+
+        uint64_t count = std::min<uint64_t>(head, TRACE_BUFFER_EVENTS);
+        if (tracing && count == TRACE_BUFFER_EVENTS)
+            count -= TRACE_DUMP_MARGIN;
+
+        for (uint64_t i = head - count; i < head; i++)
+        {
+            const TraceEvent& event = buffer->events[i & (TRACE_BUFFER_EVENTS - 1)];
+            if (event.start < clearedAt)
+                continue;
+
+            json += first ? "" : ",";
+            first = false;
+
+            // Chrome expects microseconds.
+            if (event.duration == UINT64_MAX)
+            {
+                json += string_format(
+                    R"({"name":"%s","ph":"i","s":"t","pid":1,"tid":%llu,"ts":%.3f,"args":{"value":%lld}})",
+                    event.name, static_cast<unsigned long long>(event.tid), event.start / 1000.0,
+                    static_cast<long long>(event.value));
+            }
+            else
+            {
+                json += string_format(
+                    R"({"name":"%s","ph":"X","pid":1,"tid":%llu,"ts":%.3f,"dur":%.3f,"args":{"value":%lld}})",
+                    event.name, static_cast<unsigned long long>(event.tid), event.start / 1000.0,
+                    event.duration / 1000.0, static_cast<long long>(event.value));
+            }
+        }
+    }
+
+    json += "]}";
+    return json;
+}
+
+PortSDR::ErrorCode PortSDR::WriteTrace(const std::string& path)
+{
+    const std::string json = GetTraceJson();
+
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file)
+        return ErrorCode::INVALID_ARGUMENT;
+
+    const std::size_t written = std::fwrite(json.data(), 1, json.size(), file);
+    std::fclose(file);
+
+    return written == json.size() ? ErrorCode::OK : ErrorCode::UNKNOWN;
+}
@@ -0,0 +1,215 @@
+#include "Agc.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Level.h"
+
+// Weight of a new transfer in the smoothed power
+#define AGC_SMOOTHING 0.25
+#define AGC_POWER_FLOOR 1e-10
+
+PortSDR::Agc::Agc(Stream& stream)
+    : m_stream(stream)
+{
+}
+
+PortSDR::Agc::~Agc()
+{
+    Stop();
+}
+
+PortSDR::ErrorCode PortSDR::Agc::Start(const AgcConfig& config)
+{
+    if (m_thread.joinable())
+        return ErrorCode::INVALID_ARGUMENT;
+
+    const std::vector<Gain> stages = m_stream.GetGainStages(m_stream.GetGainMode());
+    const auto stage = std::find_if(stages.begin(), stages.end(), [&config](const Gain& gain)
+    {
+        return config.stage.empty() || gain.stage == config.stage;
+    });
+    if (stage == stages.end())
+        return ErrorCode::INVALID_ARGUMENT;
+
+    m_values = stage->range.Values();
+    std::sort(m_values.begin(), m_values.end());
+    m_values.erase(std::unique(m_values.begin(), m_values.end()), m_values.end());
+    if (m_values.empty())
+        return ErrorCode::INVALID_ARGUMENT;
+
+    m_config = config;
+    m_config.stage = stage->stage;
+    m_gain = m_stream.GetGain(m_config.stage);
+    m_power = -1.0;
+    m_pending = false;
+
+    m_running = true;
+    m_hasRequest = false;
+    m_thread = std::thread(&Agc::Worker, this);
+
+    m_stream.SetCallback([this](SDRTransfer& transfer)
+    {
+        Process(transfer);
+    });
+    return ErrorCode::OK;
+}
+
+void PortSDR::Agc::Stop()
+{
+    if (!m_thread.joinable())
+        return;
+
+    m_stream.SetCallback({});
+    {
+        std::lock_guard lock(m_mutex);
+        m_running = false;
+    }
+    m_cv.notify_one();
+    m_thread.join();
+}
+
+void PortSDR::Agc::Process(SDRTransfer& transfer)
+{
+    // The gain tag of a change marks the first sample to measure again.
+    std::size_t measured = 0;
+    for (std::size_t i = 0; i < transfer.tag_count; i++)
+    {
+        const StreamTag& tag = transfer.tags[i];
+        if (tag.type != STREAM_TAG_GAIN || m_config.stage != tag.name)
+            continue;
+
+        const GainEvent event{tag.sample_index, tag.value, m_gain.load(std::memory_order_relaxed)};
+        m_gain.store(tag.value, std::memory_order_relaxed);
+        m_pending.store(false, std::memory_order_release);
+        m_power = -1.0;
+        measured = tag.offset;
+
+        if (m_eventCallback && event.gain != event.previous)
+            m_eventCallback(event);
+    }
+
+    Measure(transfer, measured);
+
+    if (m_callback)
+        m_callback(transfer);
+}
+
+void PortSDR::Agc::Measure(const SDRTransfer& transfer, const std::size_t offset)
+{
+    if (m_pending.load(std::memory_order_acquire))
+    {
+        m_power = -1.0;
+        return;
+    }
+
+    if (offset >= transfer.frame_size)
+        return;
+
+    // The stream may have measured the transfer already.
+    const SignalHealth health = transfer.health && offset == 0
+                                    ? *transfer.health
+                                    : MeasureLevel(transfer, offset, transfer.frame_size - offset).Health();
+
+    const double power = static_cast<double>(health.rms) * health.rms;
+    m_power = m_power < 0 ? power : m_power + AGC_SMOOTHING * (power - m_power);
+
+    const double powerDbfs = 10.0 * std::log10(std::max(m_power, AGC_POWER_FLOOR));
+    m_powerDbfs.store(powerDbfs, std::memory_order_relaxed);
+
+    double step = 0;
+    if (health.saturation > m_config.max_clip_fraction)
+    {
+        // Clipping destroys the measurement, back off right away.
+        step = -m_config.max_step_db;
+    }
+    else
+    {
+        const double error = m_config.target_dbfs - powerDbfs;
+        if (std::fabs(error) > m_config.hysteresis_db)
+            step = std::clamp(error, -m_config.max_step_db, m_config.max_step_db);
+    }
+
+    if (step == 0)
+        return;
+
+    const double current = m_gain.load(std::memory_order_relaxed);
+    const double gain = Snap(current + step, current);
+    if (gain == current)
+        return;
+
+    m_pending.store(true, std::memory_order_release);
+    {
+        std::lock_guard lock(m_mutex);
+        m_request = gain;
+        m_hasRequest = true;
+    }
+    m_cv.notify_one();
+}
+
+void PortSDR::Agc::SetCallback(Stream::SDR_CALLBACK callback)
+{
+    m_callback = std::move(callback);
+}
+
+void PortSDR::Agc::SetEventCallback(EVENT_CALLBACK callback)
+{
+    m_eventCallback = std::move(callback);
+}
+
+double PortSDR::Agc::GetGain() const
+{
+    return m_gain.load(std::memory_order_relaxed);
+}
+
+double PortSDR::Agc::GetPowerDbfs() const
+{
+    return m_powerDbfs.load(std::memory_order_relaxed);
+}
+
+void PortSDR::Agc::Worker()
+{
+    std::chrono::steady_clock::time_point lastWrite{};
+
+    std::unique_lock lock(m_mutex);
+    while (true)
+    {
+        m_cv.wait(lock, [this] { return !m_running || m_hasRequest; });
+        if (!m_running)
+            break;
+
+        // Keep the control traffic on the bus bounded.
+        if (m_cv.wait_until(lock, lastWrite + m_config.min_interval, [this] { return !m_running; }))
+            break;
+
+        const double gain = m_request;
+        m_hasRequest = false;
+        lock.unlock();
+
+        // The receiving thread takes the change over once its gain tag arrives.
+        const ErrorCode ret = m_stream.SetGain(gain, m_config.stage);
+        lastWrite = std::chrono::steady_clock::now();
+
+        if (ret != ErrorCode::OK)
+            m_pending.store(false, std::memory_order_release);
+
+        lock.lock();
+    }
+}
+
+double PortSDR::Agc::Snap(const double gain, const double current) const
+{
+    // Nearest value the stage allows, but always at least one value in the wanted direction.
+    auto it = std::lower_bound(m_values.begin(), m_values.end(), gain);
+    if (it == m_values.end() || (it != m_values.begin() && gain - *(it - 1) < *it - gain))
+        --it;
+
+    if (*it == current)
+    {
+        if (gain > current && it + 1 != m_values.end())
+            ++it;
+        else if (gain < current && it != m_values.begin())
+            --it;
+    }
+    return *it;
+}
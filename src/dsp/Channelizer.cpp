@@ -0,0 +1,333 @@
+#include "Channelizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "Convert.h"
+#include "Cpu.h"
+#include "Fft.h"
+
+// Channels per group, keeps the groups aligned to the vector kernels.
+#define CHANNEL_GROUP_ALIGN 4
+
+static constexpr double kPi = 3.14159265358979323846;
+
+PortSDR::Channelizer::Channelizer() = default;
+
+PortSDR::Channelizer::~Channelizer()
+{
+    Close();
+}
+
+/*
+ * Branch r of the filter bank sees every channels-th sample, starting at the newest one
+ * of each block of channels samples, going back in time. Keeping the taps of the branches
+ * side by side makes the inputs of all branches for one tap a contiguous block of samples,
+ * so all branches are filtered in a single pass. The inverse FFT over the branches
+ * then mixes every channel down to zero.
+ */
+PortSDR::ErrorCode PortSDR::Channelizer::Create(const ChannelizerConfig& config)
+{
+    const std::size_t m = config.channels;
+    const std::size_t p = config.taps_per_channel;
+
+    if (m < 2 || (m & (m - 1)) != 0 || p == 0)
+        return ErrorCode::INVALID_ARGUMENT;
+
+    Close();
+
+    m_config = config;
+    m_config.threads = std::clamp<std::size_t>(config.threads, 1, std::max<std::size_t>(1, m / CHANNEL_GROUP_ALIGN));
+    m_groupSize = (m / m_config.threads + CHANNEL_GROUP_ALIGN - 1) / CHANNEL_GROUP_ALIGN * CHANNEL_GROUP_ALIGN;
+    m_fft = std::make_unique<Fft>(m);
+    m_history = (p - 1) * m;
+
+    // Windowed sinc cut off at half the channel spacing, Blackman-Harris window.
+    const std::size_t length = m * p;
+    std::vector<double> prototype(length);
+    double sum = 0;
+    for (std::size_t l = 0; l < length; l++)
+    {
+        const double x = (static_cast<double>(l) - static_cast<double>(length - 1) / 2) / static_cast<double>(m);
+        const double sinc = x == 0 ? 1.0 : std::sin(kPi * x) / (kPi * x);
+        const double phase = 2 * kPi * static_cast<double>(l) / static_cast<double>(length - 1);
+        const double window = 0.35875 - 0.48829 * std::cos(phase) + 0.14128 * std::cos(2 * phase)
+            - 0.01168 * std::cos(3 * phase);
+
+        prototype[l] = sinc * window;
+        sum += prototype[l];
+    }
+
+    m_taps.resize(length * 2);
+    for (std::size_t q = 0; q < p; q++)
+    {
+        for (std::size_t r = 0; r < m; r++)
+        {
+            // Unity gain in the passband of every channel.
+            const auto tap = static_cast<float>(prototype[q * m + m - 1 - r] / sum);
+            m_taps[q * m * 2 + r * 2] = tap;
+            m_taps[q * m * 2 + r * 2 + 1] = tap;
+        }
+    }
+
+    m_gathered.assign(m, {});
+    m_converted.assign(m, {});
+    Reset();
+
+    m_running = true;
+    for (std::size_t i = 1; i < m_config.threads; i++)
+        m_threads.emplace_back(&Channelizer::Worker, this, i);
+
+    return ErrorCode::OK;
+}
+
+void PortSDR::Channelizer::Close()
+{
+    {
+        std::lock_guard lock(m_mutex);
+        m_running = false;
+    }
+    m_cond.notify_all();
+
+    for (std::thread& thread : m_threads)
+        thread.join();
+    m_threads.clear();
+    m_fft.reset();
+}
+
+void PortSDR::Channelizer::SetCallback(CHANNEL_CALLBACK callback)
+{
+    m_callback = std::move(callback);
+}
+
+void PortSDR::Channelizer::Reset()
+{
+    // The extra samples line the newest sample of each block up with a multiple of channels.
+    m_input.assign((m_history + m_config.channels - 1) * 2, 0.0f);
+    m_pendingTags.clear();
+}
+
+double PortSDR::Channelizer::GetChannelOffset(const std::size_t channel, const uint32_t sampleRate) const
+{
+    const auto m = static_cast<double>(m_config.channels);
+    const auto k = static_cast<double>(channel);
+    return (channel < m_config.channels / 2 ? k : k - m) * sampleRate / m;
+}
+
+PortSDR::ErrorCode PortSDR::Channelizer::Process(const SDRTransfer& transfer)
+{
+    if (!m_fft)
+        return ErrorCode::UNINITIALIZED;
+
+    const std::size_t m = m_config.channels;
+    const std::size_t offset = m_input.size();
+
+    m_input.resize(offset + transfer.frame_size * 2);
+    ConvertTransfer(transfer, 0, m_input.data() + offset, SAMPLE_FORMAT_IQ_FLOAT32, transfer.frame_size);
+
+    for (std::size_t i = 0; i < transfer.tag_count; i++)
+    {
+        StreamTag tag = transfer.tags[i];
+        tag.offset += offset / 2;
+        m_pendingTags.push_back(tag);
+    }
+
+    m_steps = (m_input.size() / 2 - m_history) / m;
+    m_dropped = transfer.dropped_samples / m;
+    if (m_steps == 0)
+        return ErrorCode::OK;
+
+    // The newest sample filtered into output n is m_history + n * m + m - 1.
+    const std::size_t newest = m_history + m - 1;
+    const std::size_t consumed = m_steps * m;
+    m_tags.clear();
+    std::size_t kept = 0;
+    for (const StreamTag& pending : m_pendingTags)
+    {
+        StreamTag tag = pending;
+        if (tag.offset > newest + (m_steps - 1) * m)
+        {
+            tag.offset -= consumed;
+            m_pendingTags[kept++] = tag;
+            continue;
+        }
+
+        tag.offset = tag.offset > newest ? (tag.offset - newest + m - 1) / m : 0;
+        m_tags.push_back(tag);
+    }
+    m_pendingTags.resize(kept);
+
+    m_branches.resize(m_steps * m * 2);
+    m_channels.resize(m_steps * m * 2);
+
+    {
+        std::lock_guard lock(m_mutex);
+        m_job++;
+    }
+    m_cond.notify_all();
+
+    // The calling thread takes the first group and waits for the others at the end.
+    Run(0);
+
+    m_input.erase(m_input.begin(), m_input.begin() + static_cast<std::ptrdiff_t>(consumed * 2));
+    return ErrorCode::OK;
+}
+
+void PortSDR::Channelizer::Worker(const std::size_t index)
+{
+    uint64_t job = 0;
+    while (true)
+    {
+        {
+            std::unique_lock lock(m_mutex);
+            m_cond.wait(lock, [this, job] { return !m_running || m_job != job; });
+            if (!m_running)
+                return;
+            job = m_job;
+        }
+        Run(index);
+    }
+}
+
+void PortSDR::Channelizer::Sync()
+{
+    std::unique_lock lock(m_mutex);
+    const uint64_t generation = m_syncGeneration;
+    if (++m_syncArrived == m_config.threads)
+    {
+        m_syncArrived = 0;
+        m_syncGeneration++;
+        lock.unlock();
+        m_cond.notify_all();
+        return;
+    }
+    m_cond.wait(lock, [this, generation] { return m_syncGeneration != generation; });
+}
+
+static void FilterScalar(const float* input,
+                         const float* taps,
+                         const std::size_t stride,
+                         const std::size_t tapCount,
+                         const std::size_t begin,
+                         const std::size_t end,
+                         float* out)
+{
+    for (std::size_t j = begin; j < end; j++)
+    {
+        float acc = 0;
+        for (std::size_t q = 0; q < tapCount; q++)
+            acc += taps[q * stride + j] * input[j - q * stride];
+        out[j] = acc;
+    }
+}
+
+#ifdef PORTSDR_X86_DISPATCH
+PORTSDR_TARGET("avx2,fma")
+static std::size_t FilterAvx2(const float* input,
+                              const float* taps,
+                              const std::size_t stride,
+                              const std::size_t tapCount,
+                              const std::size_t begin,
+                              const std::size_t end,
+                              float* out)
+{
+    std::size_t j = begin;
+    for (; j + 16 <= end; j += 16)
+    {
+        // Two accumulators hide the latency of the FMA.
+        __m256 acc0 = _mm256_setzero_ps();
+        __m256 acc1 = _mm256_setzero_ps();
+        for (std::size_t q = 0; q < tapCount; q++)
+        {
+            const float* t = taps + q * stride + j;
+            const float* x = input + j - q * stride;
+            acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(t), _mm256_loadu_ps(x), acc0);
+            acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(t + 8), _mm256_loadu_ps(x + 8), acc1);
+        }
+        _mm256_storeu_ps(out + j, acc0);
+        _mm256_storeu_ps(out + j + 8, acc1);
+    }
+    for (; j + 8 <= end; j += 8)
+    {
+        __m256 acc = _mm256_setzero_ps();
+        for (std::size_t q = 0; q < tapCount; q++)
+            acc = _mm256_fmadd_ps(_mm256_loadu_ps(taps + q * stride + j), _mm256_loadu_ps(input + j - q * stride), acc);
+        _mm256_storeu_ps(out + j, acc);
+    }
+    return j;
+}
+#endif
+
+void PortSDR::Channelizer::Run(const std::size_t index)
+{
+    const std::size_t m = m_config.channels;
+    const std::size_t stride = m * 2;
+    const std::size_t first = std::min(index * m_groupSize, m);
+    const std::size_t last = std::min(first + m_groupSize, m);
+
+    // Branches of this group, for every output sample.
+    for (std::size_t n = 0; n < m_steps; n++)
+    {
+        const float* input = m_input.data() + (m_history + n * m) * 2;
+        float* out = m_branches.data() + n * stride;
+
+        std::size_t j = first * 2;
+#ifdef PORTSDR_X86_DISPATCH
+        if (CpuHasAvx2())
+            j = FilterAvx2(input, m_taps.data(), stride, m_config.taps_per_channel, j, last * 2, out);
+#endif
+        FilterScalar(input, m_taps.data(), stride, m_config.taps_per_channel, j, last * 2, out);
+    }
+
+    Sync();
+
+    // FFT of a slice of the output samples, needing every branch.
+    const std::size_t begin = m_steps * index / m_config.threads;
+    const std::size_t end = m_steps * (index + 1) / m_config.threads;
+    for (std::size_t n = begin; n < end; n++)
+    {
+        const float* branches = m_branches.data() + n * stride;
+        float* re = m_channels.data() + n * stride;
+        float* im = re + m;
+
+        for (std::size_t p = 0; p < m; p++)
+        {
+            re[p] = branches[(m - 1 - p) * 2];
+            im[p] = branches[(m - 1 - p) * 2 + 1];
+        }
+        m_fft->Inverse(re, im);
+    }
+
+    Sync();
+
+    // Channels of this group.
+    for (std::size_t k = first; k < last; k++)
+    {
+        Buffer<std::complex<float>>& gathered = m_gathered[k];
+        gathered.resize(m_steps);
+        for (std::size_t n = 0; n < m_steps; n++)
+            gathered[n] = {m_channels[n * stride + k], m_channels[n * stride + m + k]};
+
+        SDRTransfer transfer{};
+        transfer.data = gathered.data();
+        transfer.frame_size = m_steps;
+        transfer.dropped_samples = m_dropped;
+        transfer.format = m_config.format;
+        transfer.tags = m_tags.empty() ? nullptr : m_tags.data();
+        transfer.tag_count = m_tags.size();
+
+        if (m_config.format != SAMPLE_FORMAT_IQ_FLOAT32)
+        {
+            Buffer<uint8_t>& converted = m_converted[k];
+            converted.resize(m_steps * GetSampleSize(m_config.format));
+            ConvertSamples(gathered.data(), SAMPLE_FORMAT_IQ_FLOAT32, converted.data(), m_config.format, m_steps * 2);
+            transfer.data = converted.data();
+        }
+
+        if (m_callback)
+            m_callback(k, transfer);
+    }
+
+    Sync();
+}
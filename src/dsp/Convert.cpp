@@ -0,0 +1,488 @@
+#include "Convert.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define PORTSDR_CONVERT_SSE2
+#endif
+
+// Values converted at a time before they are split, small enough to stay in L1
+#define PLANAR_BLOCK 1024
+
+static void Int16ToUInt8(const int16_t* src, uint8_t* dst, std::size_t count)
+{
+    std::size_t i = 0;
+
+#ifdef PORTSDR_CONVERT_SSE2
+    const __m128i bias = _mm_set1_epi8(static_cast<char>(0x80));
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 8));
+
+        // Keep the upper byte, then move from two's complement to offset binary.
+        lo = _mm_srai_epi16(lo, 8);
+        hi = _mm_srai_epi16(hi, 8);
+
+        const __m128i packed = _mm_xor_si128(_mm_packs_epi16(lo, hi), bias);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), packed);
+    }
+#endif
+
+    for (; i < count; i++)
+    {
+        dst[i] = static_cast<uint8_t>((src[i] >> 8) + 128);
+    }
+}
+
+static void Float32ToUInt8(const float* src, uint8_t* dst, std::size_t count)
+{
+    std::size_t i = 0;
+
+#ifdef PORTSDR_CONVERT_SSE2
+    const __m128 scale = _mm_set1_ps(127.5f);
+    const __m128 offset = _mm_set1_ps(127.5f);
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i v[4];
+        for (int j = 0; j < 4; j++)
+        {
+            const __m128 f = _mm_loadu_ps(src + i + j * 4);
+            v[j] = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(f, scale), offset));
+        }
+
+        // Saturating packs clamp anything outside of [-1.0, 1.0].
+        const __m128i lo = _mm_packs_epi32(v[0], v[1]);
+        const __m128i hi = _mm_packs_epi32(v[2], v[3]);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(lo, hi));
+    }
+#endif
+
+    for (; i < count; i++)
+    {
+        const float value = src[i] * 127.5f + 127.5f;
+        dst[i] = static_cast<uint8_t>(std::clamp(value + 0.5f, 0.0f, 255.0f));
+    }
+}
+
+static void UInt8ToInt16(const uint8_t* src, int16_t* dst, std::size_t count)
+{
+    std::size_t i = 0;
+
+#ifdef PORTSDR_CONVERT_SSE2
+    const __m128i bias = _mm_set1_epi8(static_cast<char>(0x80));
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= count; i += 16)
+    {
+        const __m128i v = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)), bias);
+
+        // Placing the signed byte in the upper half scales it by 256.
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_unpacklo_epi8(zero, v));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 8), _mm_unpackhi_epi8(zero, v));
+    }
+#endif
+
+    for (; i < count; i++)
+    {
+        dst[i] = static_cast<int16_t>((src[i] - 128) * 256);
+    }
+}
+
+static void UInt8ToFloat32(const uint8_t* src, float* dst, std::size_t count)
+{
+    std::size_t i = 0;
+    constexpr float scale = 1.0f / 127.5f;
+
+#ifdef PORTSDR_CONVERT_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 vscale = _mm_set1_ps(scale);
+    const __m128 offset = _mm_set1_ps(-1.0f);
+    for (; i + 16 <= count; i += 16)
+    {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        const __m128i lo = _mm_unpacklo_epi8(v, zero);
+        const __m128i hi = _mm_unpackhi_epi8(v, zero);
+
+        const __m128i words[4] = {
+            _mm_unpacklo_epi16(lo, zero), _mm_unpackhi_epi16(lo, zero),
+            _mm_unpacklo_epi16(hi, zero), _mm_unpackhi_epi16(hi, zero),
+        };
+
+        for (int j = 0; j < 4; j++)
+        {
+            const __m128 f = _mm_cvtepi32_ps(words[j]);
+            _mm_storeu_ps(dst + i + j * 4, _mm_add_ps(_mm_mul_ps(f, vscale), offset));
+        }
+    }
+#endif
+
+    for (; i < count; i++)
+    {
+        dst[i] = src[i] * scale - 1.0f;
+    }
+}
+
+static void Int16ToFloat32(const int16_t* src, float* dst, std::size_t count)
+{
+    std::size_t i = 0;
+    constexpr float scale = 1.0f / 32768.0f;
+
+#ifdef PORTSDR_CONVERT_SSE2
+    const __m128 vscale = _mm_set1_ps(scale);
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+
+        // Duplicate each value into a 32-bit lane, then shift down to sign extend.
+        const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), vscale));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), vscale));
+    }
+#endif
+
+    for (; i < count; i++)
+    {
+        dst[i] = src[i] * scale;
+    }
+}
+
+static void Float32ToInt16(const float* src, int16_t* dst, std::size_t count)
+{
+    std::size_t i = 0;
+
+#ifdef PORTSDR_CONVERT_SSE2
+    const __m128 scale = _mm_set1_ps(32768.0f);
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m128i lo = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(src + i), scale));
+        const __m128i hi = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(src + i + 4), scale));
+
+        // Saturating pack clamps 1.0 to 32767.
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packs_epi32(lo, hi));
+    }
+#endif
+
+    for (; i < count; i++)
+    {
+        const float value = std::clamp(src[i] * 32768.0f, -32768.0f, 32767.0f);
+        dst[i] = static_cast<int16_t>(std::lrint(value));
+    }
+}
+
+static void SplitUInt8(const uint8_t* src, uint8_t* dstI, uint8_t* dstQ, std::size_t count)
+{
+    std::size_t i = 0;
+
+#ifdef PORTSDR_CONVERT_SSE2
+    const __m128i low = _mm_set1_epi16(0x00ff);
+    for (; i + 32 <= count; i += 32)
+    {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 16));
+
+        // I is the low byte of every 16-bit pair, Q the high byte.
+        const __m128i in = _mm_packus_epi16(_mm_and_si128(a, low), _mm_and_si128(b, low));
+        const __m128i quad = _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dstI + i / 2), in);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dstQ + i / 2), quad);
+    }
+#endif
+
+    for (; i + 1 < count; i += 2)
+    {
+        dstI[i / 2] = src[i];
+        dstQ[i / 2] = src[i + 1];
+    }
+}
+
+static void SplitInt16(const int16_t* src, int16_t* dstI, int16_t* dstQ, std::size_t count)
+{
+    std::size_t i = 0;
+
+#ifdef PORTSDR_CONVERT_SSE2
+    for (; i + 16 <= count; i += 16)
+    {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 8));
+
+        // Sign extend the low half of every 32-bit pair for I, shift the high half down for Q.
+        const __m128i in = _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(a, 16), 16),
+                                           _mm_srai_epi32(_mm_slli_epi32(b, 16), 16));
+        const __m128i quad = _mm_packs_epi32(_mm_srai_epi32(a, 16), _mm_srai_epi32(b, 16));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dstI + i / 2), in);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dstQ + i / 2), quad);
+    }
+#endif
+
+    for (; i + 1 < count; i += 2)
+    {
+        dstI[i / 2] = src[i];
+        dstQ[i / 2] = src[i + 1];
+    }
+}
+
+static void SplitFloat32(const float* src, float* dstI, float* dstQ, std::size_t count)
+{
+    std::size_t i = 0;
+
+#ifdef PORTSDR_CONVERT_SSE2
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m128 a = _mm_loadu_ps(src + i);
+        const __m128 b = _mm_loadu_ps(src + i + 4);
+
+        _mm_storeu_ps(dstI + i / 2, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm_storeu_ps(dstQ + i / 2, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+#endif
+
+    for (; i + 1 < count; i += 2)
+    {
+        dstI[i / 2] = src[i];
+        dstQ[i / 2] = src[i + 1];
+    }
+}
+
+static void MergeUInt8(const uint8_t* srcI, const uint8_t* srcQ, uint8_t* dst, std::size_t count)
+{
+    std::size_t i = 0;
+
+#ifdef PORTSDR_CONVERT_SSE2
+    for (; i + 32 <= count; i += 32)
+    {
+        const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(srcI + i / 2));
+        const __m128i quad = _mm_loadu_si128(reinterpret_cast<const __m128i*>(srcQ + i / 2));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_unpacklo_epi8(in, quad));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 16), _mm_unpackhi_epi8(in, quad));
+    }
+#endif
+
+    for (; i + 1 < count; i += 2)
+    {
+        dst[i] = srcI[i / 2];
+        dst[i + 1] = srcQ[i / 2];
+    }
+}
+
+static void MergeInt16(const int16_t* srcI, const int16_t* srcQ, int16_t* dst, std::size_t count)
+{
+    std::size_t i = 0;
+
+#ifdef PORTSDR_CONVERT_SSE2
+    for (; i + 16 <= count; i += 16)
+    {
+        const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(srcI + i / 2));
+        const __m128i quad = _mm_loadu_si128(reinterpret_cast<const __m128i*>(srcQ + i / 2));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_unpacklo_epi16(in, quad));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 8), _mm_unpackhi_epi16(in, quad));
+    }
+#endif
+
+    for (; i + 1 < count; i += 2)
+    {
+        dst[i] = srcI[i / 2];
+        dst[i + 1] = srcQ[i / 2];
+    }
+}
+
+static void MergeFloat32(const float* srcI, const float* srcQ, float* dst, std::size_t count)
+{
+    std::size_t i = 0;
+
+#ifdef PORTSDR_CONVERT_SSE2
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m128 in = _mm_loadu_ps(srcI + i / 2);
+        const __m128 quad = _mm_loadu_ps(srcQ + i / 2);
+
+        _mm_storeu_ps(dst + i, _mm_unpacklo_ps(in, quad));
+        _mm_storeu_ps(dst + i + 4, _mm_unpackhi_ps(in, quad));
+    }
+#endif
+
+    for (; i + 1 < count; i += 2)
+    {
+        dst[i] = srcI[i / 2];
+        dst[i + 1] = srcQ[i / 2];
+    }
+}
+
+static void MergeSamples(const void* srcI, const void* srcQ, const PortSDR::SampleFormat format,
+                         void* dst, const std::size_t count)
+{
+    switch (format)
+    {
+    case PortSDR::SAMPLE_FORMAT_IQ_UINT8:
+        MergeUInt8(static_cast<const uint8_t*>(srcI), static_cast<const uint8_t*>(srcQ),
+                   static_cast<uint8_t*>(dst), count);
+        break;
+    case PortSDR::SAMPLE_FORMAT_IQ_INT16:
+        MergeInt16(static_cast<const int16_t*>(srcI), static_cast<const int16_t*>(srcQ),
+                   static_cast<int16_t*>(dst), count);
+        break;
+    case PortSDR::SAMPLE_FORMAT_IQ_FLOAT32:
+        MergeFloat32(static_cast<const float*>(srcI), static_cast<const float*>(srcQ),
+                     static_cast<float*>(dst), count);
+        break;
+    }
+}
+
+static void SplitSamples(const void* src, const PortSDR::SampleFormat format,
+                         void* dstI, void* dstQ, const std::size_t count)
+{
+    switch (format)
+    {
+    case PortSDR::SAMPLE_FORMAT_IQ_UINT8:
+        SplitUInt8(static_cast<const uint8_t*>(src), static_cast<uint8_t*>(dstI), static_cast<uint8_t*>(dstQ), count);
+        break;
+    case PortSDR::SAMPLE_FORMAT_IQ_INT16:
+        SplitInt16(static_cast<const int16_t*>(src), static_cast<int16_t*>(dstI), static_cast<int16_t*>(dstQ), count);
+        break;
+    case PortSDR::SAMPLE_FORMAT_IQ_FLOAT32:
+        SplitFloat32(static_cast<const float*>(src), static_cast<float*>(dstI), static_cast<float*>(dstQ), count);
+        break;
+    }
+}
+
+void PortSDR::ConvertToUInt8(const void* src, const SampleFormat format, uint8_t* dst, const std::size_t count)
+{
+    switch (format)
+    {
+    case SAMPLE_FORMAT_IQ_UINT8:
+        std::memcpy(dst, src, count);
+        break;
+    case SAMPLE_FORMAT_IQ_INT16:
+        Int16ToUInt8(static_cast<const int16_t*>(src), dst, count);
+        break;
+    case SAMPLE_FORMAT_IQ_FLOAT32:
+        Float32ToUInt8(static_cast<const float*>(src), dst, count);
+        break;
+    }
+}
+
+void PortSDR::ConvertFromUInt8(const uint8_t* src, const SampleFormat format, void* dst, const std::size_t count)
+{
+    switch (format)
+    {
+    case SAMPLE_FORMAT_IQ_UINT8:
+        std::memcpy(dst, src, count);
+        break;
+    case SAMPLE_FORMAT_IQ_INT16:
+        UInt8ToInt16(src, static_cast<int16_t*>(dst), count);
+        break;
+    case SAMPLE_FORMAT_IQ_FLOAT32:
+        UInt8ToFloat32(src, static_cast<float*>(dst), count);
+        break;
+    }
+}
+
+void PortSDR::ConvertSamples(const void* src,
+                             const SampleFormat srcFormat,
+                             void* dst,
+                             const SampleFormat dstFormat,
+                             const std::size_t count)
+{
+    if (srcFormat == dstFormat)
+    {
+        std::memcpy(dst, src, count * GetSampleSize(srcFormat) / 2);
+    }
+    else if (dstFormat == SAMPLE_FORMAT_IQ_UINT8)
+    {
+        ConvertToUInt8(src, srcFormat, static_cast<uint8_t*>(dst), count);
+    }
+    else if (srcFormat == SAMPLE_FORMAT_IQ_UINT8)
+    {
+        ConvertFromUInt8(static_cast<const uint8_t*>(src), dstFormat, dst, count);
+    }
+    else if (srcFormat == SAMPLE_FORMAT_IQ_INT16)
+    {
+        Int16ToFloat32(static_cast<const int16_t*>(src), static_cast<float*>(dst), count);
+    }
+    else
+    {
+        Float32ToInt16(static_cast<const float*>(src), static_cast<int16_t*>(dst), count);
+    }
+}
+
+void PortSDR::ConvertSamplesPlanar(const void* src,
+                                   const SampleFormat srcFormat,
+                                   void* dstI,
+                                   void* dstQ,
+                                   const SampleFormat dstFormat,
+                                   const std::size_t count)
+{
+    if (srcFormat == dstFormat)
+    {
+        SplitSamples(src, srcFormat, dstI, dstQ, count);
+        return;
+    }
+
+    // Converted block by block, each block is split while it is still in the cache.
+    alignas(16) float block[PLANAR_BLOCK];
+    const std::size_t srcSize = GetSampleSize(srcFormat) / 2;
+    const std::size_t dstSize = GetSampleSize(dstFormat) / 2;
+
+    for (std::size_t i = 0; i < count; i += PLANAR_BLOCK)
+    {
+        const std::size_t n = std::min<std::size_t>(PLANAR_BLOCK, count - i);
+        const std::size_t plane = i / 2 * dstSize;
+
+        ConvertSamples(static_cast<const uint8_t*>(src) + i * srcSize, srcFormat, block, dstFormat, n);
+        SplitSamples(block, dstFormat, static_cast<uint8_t*>(dstI) + plane, static_cast<uint8_t*>(dstQ) + plane, n);
+    }
+}
+
+void PortSDR::ConvertSamplesInterleaved(const void* srcI,
+                                        const void* srcQ,
+                                        const SampleFormat srcFormat,
+                                        void* dst,
+                                        const SampleFormat dstFormat,
+                                        const std::size_t count)
+{
+    if (srcFormat == dstFormat)
+    {
+        MergeSamples(srcI, srcQ, srcFormat, dst, count);
+        return;
+    }
+
+    // Interleaved block by block, each block is converted while it is still in the cache.
+    alignas(16) float block[PLANAR_BLOCK];
+    const std::size_t srcSize = GetSampleSize(srcFormat) / 2;
+    const std::size_t dstSize = GetSampleSize(dstFormat) / 2;
+
+    for (std::size_t i = 0; i < count; i += PLANAR_BLOCK)
+    {
+        const std::size_t n = std::min<std::size_t>(PLANAR_BLOCK, count - i);
+        const std::size_t plane = i / 2 * srcSize;
+
+        MergeSamples(static_cast<const uint8_t*>(srcI) + plane, static_cast<const uint8_t*>(srcQ) + plane,
+                     srcFormat, block, n);
+        ConvertSamples(block, srcFormat, static_cast<uint8_t*>(dst) + i * dstSize, dstFormat, n);
+    }
+}
+
+void PortSDR::ConvertTransfer(const SDRTransfer& transfer,
+                              const std::size_t from,
+                              void* dst,
+                              const SampleFormat format,
+                              const std::size_t count)
+{
+    if (transfer.layout == SAMPLE_LAYOUT_PLANAR)
+    {
+        const std::size_t offset = from * GetSampleSize(transfer.format) / 2;
+        ConvertSamplesInterleaved(static_cast<const uint8_t*>(transfer.data) + offset,
+                                  static_cast<const uint8_t*>(transfer.data_q) + offset,
+                                  transfer.format, dst, format, count * 2);
+        return;
+    }
+
+    ConvertSamples(static_cast<const uint8_t*>(transfer.data) + from * GetSampleSize(transfer.format),
+                   transfer.format, dst, format, count * 2);
+}
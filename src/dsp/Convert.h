@@ -0,0 +1,66 @@
+#ifndef PORTSDR_CONVERT_H
+#define PORTSDR_CONVERT_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Stream.h"
+
+namespace PortSDR
+{
+    /**
+     * Converts interleaved IQ values of any sample format into
+     * offset binary unsigned 8-bit values (the rtl_tcp wire format).
+     * @param src source values.
+     * @param format sample format of the source.
+     * @param dst destination, must hold count values.
+     * @param count amount of values (two per IQ sample).
+     */
+    void ConvertToUInt8(const void* src, SampleFormat format, uint8_t* dst, std::size_t count);
+
+    /**
+     * Converts offset binary unsigned 8-bit values into any sample format.
+     * @param src source values.
+     * @param format sample format of the destination.
+     * @param dst destination, must hold count values of format.
+     * @param count amount of values (two per IQ sample).
+     */
+    void ConvertFromUInt8(const uint8_t* src, SampleFormat format, void* dst, std::size_t count);
+
+    /**
+     * Converts interleaved IQ values between any two sample formats in a single pass.
+     * @param src source values.
+     * @param srcFormat sample format of the source.
+     * @param dst destination, must hold count values of dstFormat.
+     * @param dstFormat sample format of the destination.
+     * @param count amount of values (two per IQ sample).
+     */
+    void ConvertSamples(const void* src, SampleFormat srcFormat, void* dst, SampleFormat dstFormat, std::size_t count);
+
+    /**
+     * Converts interleaved IQ values between any two sample formats and splits them
+     * into separate I and Q values in the same pass.
+     * @param src source values.
+     * @param srcFormat sample format of the source.
+     * @param dstI destination of the I values, must hold count / 2 values of dstFormat.
+     * @param dstQ destination of the Q values, must hold count / 2 values of dstFormat.
+     * @param dstFormat sample format of the destination.
+     * @param count amount of source values (two per IQ sample).
+     */
+    void ConvertSamplesPlanar(const void* src, SampleFormat srcFormat,
+                              void* dstI, void* dstQ, SampleFormat dstFormat, std::size_t count);
+
+    /**
+     * Converts separate I and Q values between any two sample formats and interleaves them in the same pass.
+     * @param srcI source I values, count / 2 values of srcFormat.
+     * @param srcQ source Q values, count / 2 values of srcFormat.
+     * @param srcFormat sample format of the source.
+     * @param dst destination, must hold count values of dstFormat.
+     * @param dstFormat sample format of the destination.
+     * @param count amount of destination values (two per IQ sample).
+     */
+    void ConvertSamplesInterleaved(const void* srcI, const void* srcQ, SampleFormat srcFormat,
+                                   void* dst, SampleFormat dstFormat, std::size_t count);
+}
+
+#endif //PORTSDR_CONVERT_H
@@ -0,0 +1,38 @@
+#ifndef PORTSDR_CPU_H
+#define PORTSDR_CPU_H
+
+/*
+ * Kernels using instruction sets beyond the compiler baseline are compiled
+ * with function level target attributes and picked at runtime,
+ * so a single binary runs on any x86-64 CPU.
+ */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PORTSDR_X86_DISPATCH
+#define PORTSDR_TARGET(isa) __attribute__((target(isa)))
+#include <immintrin.h>
+#endif
+
+namespace PortSDR
+{
+    inline bool CpuHasSsse3()
+    {
+#ifdef PORTSDR_X86_DISPATCH
+        static const bool supported = __builtin_cpu_supports("ssse3");
+        return supported;
+#else
+        return false;
+#endif
+    }
+
+    inline bool CpuHasAvx2()
+    {
+#ifdef PORTSDR_X86_DISPATCH
+        static const bool supported = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+        return supported;
+#else
+        return false;
+#endif
+    }
+}
+
+#endif //PORTSDR_CPU_H
@@ -0,0 +1,182 @@
+#include "Fft.h"
+#include "Cpu.h"
+
+#include <cmath>
+#include <utility>
+
+static constexpr double kPi = 3.14159265358979323846;
+
+PortSDR::Fft::Fft(const std::size_t size) : m_size(size)
+{
+    std::size_t bits = 0;
+    while ((static_cast<std::size_t>(1) << bits) < size)
+        bits++;
+
+    // Only the pairs that need swapping, so the reordering doesn't branch.
+    for (std::size_t i = 0; i < size; i++)
+    {
+        std::size_t reversed = 0;
+        for (std::size_t b = 0; b < bits; b++)
+            reversed |= (i >> b & 1) << (bits - 1 - b);
+
+        if (i < reversed)
+        {
+            m_swaps.push_back(i);
+            m_swaps.push_back(reversed);
+        }
+    }
+
+    m_twiddleRe.resize(size > 1 ? size - 1 : 0);
+    m_twiddleIm.resize(m_twiddleRe.size());
+    for (std::size_t half = 1; half < size; half *= 2)
+    {
+        for (std::size_t k = 0; k < half; k++)
+        {
+            const double phase = kPi * static_cast<double>(k) / static_cast<double>(half);
+            m_twiddleRe[half - 1 + k] = static_cast<float>(std::cos(phase));
+            m_twiddleIm[half - 1 + k] = static_cast<float>(std::sin(phase));
+        }
+    }
+}
+
+/*
+ * The first three stages only use the twiddles 1, j and the diagonals,
+ * done together as 8 point transforms without any calls or tables.
+ */
+static void First8Scalar(float* re, float* im, const std::size_t size)
+{
+    constexpr float r = 0.70710678118654752f;
+
+    for (std::size_t start = 0; start < size; start += 8)
+    {
+        float* x = re + start;
+        float* y = im + start;
+
+        // Stage 1, pairs
+        for (std::size_t k = 0; k < 8; k += 2)
+        {
+            const float aRe = x[k], aIm = y[k];
+            x[k] = aRe + x[k + 1];
+            y[k] = aIm + y[k + 1];
+            x[k + 1] = aRe - x[k + 1];
+            y[k + 1] = aIm - y[k + 1];
+        }
+
+        // Stage 2, twiddles 1 and j
+        for (std::size_t k = 0; k < 8; k += 4)
+        {
+            float aRe = x[k], aIm = y[k];
+            float bRe = x[k + 2], bIm = y[k + 2];
+            x[k] = aRe + bRe;
+            y[k] = aIm + bIm;
+            x[k + 2] = aRe - bRe;
+            y[k + 2] = aIm - bIm;
+
+            aRe = x[k + 1];
+            aIm = y[k + 1];
+            bRe = -y[k + 3];
+            bIm = x[k + 3];
+            x[k + 1] = aRe + bRe;
+            y[k + 1] = aIm + bIm;
+            x[k + 3] = aRe - bRe;
+            y[k + 3] = aIm - bIm;
+        }
+
+        // Stage 3, twiddles 1, (1 + j) / sqrt(2), j and (-1 + j) / sqrt(2)
+        const float tRe[4] = {x[4], r * (x[5] - y[5]), -y[6], -r * (x[7] + y[7])};
+        const float tIm[4] = {y[4], r * (x[5] + y[5]), x[6], r * (x[7] - y[7])};
+        for (std::size_t k = 0; k < 4; k++)
+        {
+            const float aRe = x[k], aIm = y[k];
+            x[k] = aRe + tRe[k];
+            y[k] = aIm + tIm[k];
+            x[k + 4] = aRe - tRe[k];
+            y[k + 4] = aIm - tIm[k];
+        }
+    }
+}
+
+static void ButterfliesScalar(float* re,
+                              float* im,
+                              const float* wRe,
+                              const float* wIm,
+                              const std::size_t half,
+                              const std::size_t begin)
+{
+    for (std::size_t k = begin; k < half; k++)
+    {
+        const float tRe = wRe[k] * re[k + half] - wIm[k] * im[k + half];
+        const float tIm = wRe[k] * im[k + half] + wIm[k] * re[k + half];
+
+        re[k + half] = re[k] - tRe;
+        im[k + half] = im[k] - tIm;
+        re[k] += tRe;
+        im[k] += tIm;
+    }
+}
+
+#ifdef PORTSDR_X86_DISPATCH
+PORTSDR_TARGET("avx2,fma")
+static std::size_t ButterfliesAvx2(float* re,
+                                   float* im,
+                                   const float* wRe,
+                                   const float* wIm,
+                                   const std::size_t half)
+{
+    std::size_t k = 0;
+    for (; k + 8 <= half; k += 8)
+    {
+        const __m256 cRe = _mm256_loadu_ps(wRe + k);
+        const __m256 cIm = _mm256_loadu_ps(wIm + k);
+        const __m256 bRe = _mm256_loadu_ps(re + k + half);
+        const __m256 bIm = _mm256_loadu_ps(im + k + half);
+        const __m256 aRe = _mm256_loadu_ps(re + k);
+        const __m256 aIm = _mm256_loadu_ps(im + k);
+
+        const __m256 tRe = _mm256_fmsub_ps(cRe, bRe, _mm256_mul_ps(cIm, bIm));
+        const __m256 tIm = _mm256_fmadd_ps(cRe, bIm, _mm256_mul_ps(cIm, bRe));
+
+        _mm256_storeu_ps(re + k + half, _mm256_sub_ps(aRe, tRe));
+        _mm256_storeu_ps(im + k + half, _mm256_sub_ps(aIm, tIm));
+        _mm256_storeu_ps(re + k, _mm256_add_ps(aRe, tRe));
+        _mm256_storeu_ps(im + k, _mm256_add_ps(aIm, tIm));
+    }
+    return k;
+}
+#endif
+
+void PortSDR::Fft::Inverse(float* re, float* im) const
+{
+    for (std::size_t i = 0; i < m_swaps.size(); i += 2)
+    {
+        std::swap(re[m_swaps[i]], re[m_swaps[i + 1]]);
+        std::swap(im[m_swaps[i]], im[m_swaps[i + 1]]);
+    }
+
+#ifdef PORTSDR_X86_DISPATCH
+    const bool avx2 = CpuHasAvx2();
+#endif
+
+    std::size_t half = 1;
+    if (m_size >= 8)
+    {
+        First8Scalar(re, im, m_size);
+        half = 8;
+    }
+
+    for (; half < m_size; half *= 2)
+    {
+        const float* wRe = m_twiddleRe.data() + half - 1;
+        const float* wIm = m_twiddleIm.data() + half - 1;
+
+        for (std::size_t start = 0; start < m_size; start += half * 2)
+        {
+            std::size_t k = 0;
+#ifdef PORTSDR_X86_DISPATCH
+            if (avx2)
+                k = ButterfliesAvx2(re + start, im + start, wRe, wIm, half);
+#endif
+            ButterfliesScalar(re + start, im + start, wRe, wIm, half, k);
+        }
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef PORTSDR_FFT_H
+#define PORTSDR_FFT_H
+
+#include <cstddef>
+#include <vector>
+
+namespace PortSDR
+{
+    /**
+     * In-place radix-2 FFT of a fixed power of two size.
+     * Works on split real and imaginary arrays, so the butterflies vectorize without shuffles.
+     * The tables are read only, so one instance can be used from several threads at once.
+     */
+    class Fft
+    {
+    public:
+        /**
+         * @param size amount of points, must be a power of two.
+         */
+        explicit Fft(std::size_t size);
+
+        /**
+         * Computes the unscaled inverse transform, sum of x[n] * e^(+j2πnk/N).
+         * @param re real parts of size points, replaced by the result.
+         * @param im imaginary parts of size points, replaced by the result.
+         */
+        void Inverse(float* re, float* im) const;
+
+        [[nodiscard]] std::size_t GetSize() const
+        {
+            return m_size;
+        }
+
+    private:
+        std::size_t m_size;
+        // Pairs of indices swapped into bit reversed order.
+        std::vector<std::size_t> m_swaps;
+        // Twiddles of each stage back to back, the stage with half size h starts at h - 1.
+        std::vector<float> m_twiddleRe;
+        std::vector<float> m_twiddleIm;
+    };
+}
+
+#endif //PORTSDR_FFT_H
@@ -0,0 +1,305 @@
+#include "IQConverter.h"
+#include "Cpu.h"
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Taps of the half-band branch, the full filter has HALFBAND_TAPS * 2 - 1 taps.
+#define HALFBAND_TAPS 24
+#define DC_ALPHA 0.01f
+
+static constexpr double kPi = 3.14159265358979323846;
+
+/*
+ * Shifting by fs/4 multiplies the samples by 1, -j, -1, j, ...
+ * so even samples only end up in I and odd samples only in Q, with alternating signs.
+ * After decimating by 2, only the center tap of the half-band filter lands on I,
+ * which becomes a plain delay, while the odd taps interpolate Q half a sample.
+ * Both branches get the same sign, which mirrors the spectrum the same way libairspy does.
+ */
+PortSDR::IQConverter::IQConverter(const bool simd) : m_simd(simd)
+{
+    constexpr int length = HALFBAND_TAPS * 2 - 1;
+    constexpr int center = HALFBAND_TAPS - 1;
+
+    m_taps.resize(HALFBAND_TAPS);
+
+    double sum = 0;
+    for (int j = 0; j < HALFBAND_TAPS; j++)
+    {
+        // Odd offsets from the center of the full filter.
+        const int d = 2 * j - HALFBAND_TAPS + 1;
+        const double n = d + center;
+        const double window = 0.42 - 0.5 * std::cos(2 * kPi * n / (length - 1))
+            + 0.08 * std::cos(4 * kPi * n / (length - 1));
+        const double tap = std::sin(kPi * d / 2) / (kPi * d) * window;
+
+        m_taps[j] = static_cast<float>(tap);
+        sum += tap;
+    }
+
+    // I only sees the center tap, scale both branches to unity gain.
+    for (float& tap : m_taps)
+        tap = static_cast<float>(tap / sum);
+
+    Reset();
+}
+
+static int64_t Sum(const int16_t* src, const std::size_t count)
+{
+    std::size_t k = 0;
+    int64_t sum = 0;
+
+#ifdef __SSE2__
+    {
+        // Pairs of int16 summed into int32, flushed well before they could overflow.
+        const __m128i ones = _mm_set1_epi16(1);
+        while (k + 8 <= count)
+        {
+            __m128i acc = _mm_setzero_si128();
+            const std::size_t end = std::min(count & ~static_cast<std::size_t>(7), k + 8 * 4096);
+            for (; k < end; k += 8)
+                acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + k)), ones));
+
+            int32_t lanes[4];
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), acc);
+            sum += static_cast<int64_t>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+        }
+    }
+#endif
+
+    for (; k < count; k++)
+        sum += src[k];
+    return sum;
+}
+
+void PortSDR::IQConverter::Reset()
+{
+    m_i.assign(HALFBAND_TAPS / 2, 0.0f);
+    m_q.assign(HALFBAND_TAPS, 0.0f);
+    m_dc = 0;
+    m_negate = false;
+}
+
+static void SplitScalar(const int16_t* src,
+                        float* i,
+                        float* q,
+                        const std::size_t n,
+                        const float dc,
+                        bool negate)
+{
+    for (std::size_t k = 0; k < n; k++)
+    {
+        const float sign = negate ? -1.0f : 1.0f;
+        i[k] = sign * (src[2 * k] - dc);
+        q[k] = sign * (src[2 * k + 1] - dc);
+        negate = !negate;
+    }
+}
+
+/*
+ * The filter kernels write interleaved IQ samples into dst, or the I values into dst
+ * and the Q values into dstQ when dstQ is set.
+ */
+static void FilterScalar(const float* i,
+                         const float* q,
+                         const float* taps,
+                         const std::size_t n,
+                         const PortSDR::SampleFormat format,
+                         void* dst,
+                         void* dstQ)
+{
+    // Distance between two I values and from an I value to its Q value, in values.
+    const std::size_t stride = dstQ ? 1 : 2;
+    auto* outFloat = static_cast<float*>(dst);
+    auto* outInt16 = static_cast<int16_t*>(dst);
+    auto* outFloatQ = dstQ ? static_cast<float*>(dstQ) : outFloat + 1;
+    auto* outInt16Q = dstQ ? static_cast<int16_t*>(dstQ) : outInt16 + 1;
+
+    for (std::size_t k = 0; k < n; k++)
+    {
+        float filtered = 0;
+        for (std::size_t j = 0; j < HALFBAND_TAPS; j++)
+            filtered += taps[j] * q[k + j];
+
+        if (format == PortSDR::SAMPLE_FORMAT_IQ_FLOAT32)
+        {
+            outFloat[stride * k] = i[k] * (1.0f / 32768.0f);
+            outFloatQ[stride * k] = filtered * (1.0f / 32768.0f);
+        }
+        else
+        {
+            outInt16[stride * k] = static_cast<int16_t>(std::clamp(std::lrint(i[k]), -32768l, 32767l));
+            outInt16Q[stride * k] = static_cast<int16_t>(std::clamp(std::lrint(filtered), -32768l, 32767l));
+        }
+    }
+}
+
+#ifdef PORTSDR_X86_DISPATCH
+PORTSDR_TARGET("avx2,fma")
+static std::size_t SplitAvx2(const int16_t* src,
+                             float* i,
+                             float* q,
+                             const std::size_t n,
+                             const float dc,
+                             const bool negate)
+{
+    // Eight IQ samples per iteration, so the sign pattern is the same for every iteration.
+    const __m256 sign = negate
+                            ? _mm256_setr_ps(-1, 1, -1, 1, -1, 1, -1, 1)
+                            : _mm256_setr_ps(1, -1, 1, -1, 1, -1, 1, -1);
+    const __m256 offset = _mm256_set1_ps(dc);
+
+    std::size_t k = 0;
+    for (; k + 8 <= n; k += 8)
+    {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 2 * k));
+
+        // Sign extend the even and odd 16-bit values out of each 32-bit pair.
+        const __m256i even = _mm256_srai_epi32(_mm256_slli_epi32(v, 16), 16);
+        const __m256i odd = _mm256_srai_epi32(v, 16);
+
+        _mm256_storeu_ps(i + k, _mm256_mul_ps(_mm256_sub_ps(_mm256_cvtepi32_ps(even), offset), sign));
+        _mm256_storeu_ps(q + k, _mm256_mul_ps(_mm256_sub_ps(_mm256_cvtepi32_ps(odd), offset), sign));
+    }
+    return k;
+}
+
+PORTSDR_TARGET("avx2,fma")
+static std::size_t FilterAvx2(const float* i,
+                              const float* q,
+                              const float* taps,
+                              const std::size_t n,
+                              const PortSDR::SampleFormat format,
+                              void* dst,
+                              void* dstQ)
+{
+    const __m256 scale = _mm256_set1_ps(1.0f / 32768.0f);
+
+    std::size_t k = 0;
+    for (; k + 8 <= n; k += 8)
+    {
+        // The half-band is symmetric, fold both halves before multiplying.
+        __m256 acc = _mm256_setzero_ps();
+        for (std::size_t j = 0; j < HALFBAND_TAPS / 2; j++)
+        {
+            const __m256 pair = _mm256_add_ps(_mm256_loadu_ps(q + k + j),
+                                              _mm256_loadu_ps(q + k + HALFBAND_TAPS - 1 - j));
+            acc = _mm256_fmadd_ps(_mm256_set1_ps(taps[j]), pair, acc);
+        }
+
+        const __m256 inPhase = _mm256_loadu_ps(i + k);
+
+        if (dstQ && format == PortSDR::SAMPLE_FORMAT_IQ_FLOAT32)
+        {
+            _mm256_storeu_ps(static_cast<float*>(dst) + k, _mm256_mul_ps(inPhase, scale));
+            _mm256_storeu_ps(static_cast<float*>(dstQ) + k, _mm256_mul_ps(acc, scale));
+            continue;
+        }
+        if (dstQ)
+        {
+            // Packed per lane into I0-3 Q0-3 | I4-7 Q4-7, the middle halves are swapped to get I and Q in order.
+            const __m256i packed = _mm256_permute4x64_epi64(
+                _mm256_packs_epi32(_mm256_cvtps_epi32(inPhase), _mm256_cvtps_epi32(acc)), 0xd8);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(static_cast<int16_t*>(dst) + k),
+                             _mm256_castsi256_si128(packed));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(static_cast<int16_t*>(dstQ) + k),
+                             _mm256_extracti128_si256(packed, 1));
+            continue;
+        }
+
+        // Interleaved within each 128-bit lane: I0 Q0 I1 Q1 | I4 Q4 I5 Q5 and I2 Q2 I3 Q3 | I6 Q6 I7 Q7
+        const __m256 lo = _mm256_unpacklo_ps(inPhase, acc);
+        const __m256 hi = _mm256_unpackhi_ps(inPhase, acc);
+
+        if (format == PortSDR::SAMPLE_FORMAT_IQ_FLOAT32)
+        {
+            float* out = static_cast<float*>(dst) + 2 * k;
+            _mm256_storeu_ps(out, _mm256_mul_ps(_mm256_permute2f128_ps(lo, hi, 0x20), scale));
+            _mm256_storeu_ps(out + 8, _mm256_mul_ps(_mm256_permute2f128_ps(lo, hi, 0x31), scale));
+        }
+        else
+        {
+            // Packing works per lane as well, which puts the samples back in order while saturating.
+            const __m256i packed = _mm256_packs_epi32(_mm256_cvtps_epi32(lo), _mm256_cvtps_epi32(hi));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(static_cast<int16_t*>(dst) + 2 * k), packed);
+        }
+    }
+    return k;
+}
+#endif
+
+PortSDR::ErrorCode PortSDR::IQConverter::Process(const int16_t* src,
+                                                 const std::size_t count,
+                                                 const SampleFormat format,
+                                                 void* dst)
+{
+    return Convert(src, count, format, dst, nullptr);
+}
+
+PortSDR::ErrorCode PortSDR::IQConverter::Process(const int16_t* src,
+                                                 const std::size_t count,
+                                                 const SampleFormat format,
+                                                 void* dstI,
+                                                 void* dstQ)
+{
+    return Convert(src, count, format, dstI, dstQ);
+}
+
+PortSDR::ErrorCode PortSDR::IQConverter::Convert(const int16_t* src,
+                                                 const std::size_t count,
+                                                 const SampleFormat format,
+                                                 void* dst,
+                                                 void* dstQ)
+{
+    if (format != SAMPLE_FORMAT_IQ_INT16 && format != SAMPLE_FORMAT_IQ_FLOAT32)
+        return ErrorCode::INVALID_ARGUMENT;
+
+    const std::size_t n = count / 2;
+    const std::size_t iHistory = HALFBAND_TAPS / 2;
+    const std::size_t qHistory = HALFBAND_TAPS;
+
+    if (n == 0)
+        return ErrorCode::OK;
+
+    const float dc = m_dc;
+    m_dc += DC_ALPHA * (static_cast<float>(Sum(src, count)) / static_cast<float>(count) - m_dc);
+
+    m_i.resize(iHistory + n);
+    m_q.resize(qHistory + n);
+
+    float* i = m_i.data();
+    float* q = m_q.data();
+    // Planar output advances by a single value per sample.
+    const std::size_t step = dstQ ? GetSampleSize(format) / 2 : GetSampleSize(format);
+
+    std::size_t split = 0;
+    std::size_t filtered = 0;
+
+#ifdef PORTSDR_X86_DISPATCH
+    if (m_simd && CpuHasAvx2())
+    {
+        split = SplitAvx2(src, i + iHistory, q + qHistory, n, dc, m_negate);
+        filtered = FilterAvx2(i, q, m_taps.data(), n, format, dst, dstQ);
+    }
+#endif
+
+    // Vector kernels process multiples of 8, the sign pattern continues unchanged.
+    SplitScalar(src + 2 * split, i + iHistory + split, q + qHistory + split, n - split, dc, m_negate);
+    FilterScalar(i + filtered, q + filtered, m_taps.data(), n - filtered, format,
+                 static_cast<uint8_t*>(dst) + filtered * step,
+                 dstQ ? static_cast<uint8_t*>(dstQ) + filtered * step : nullptr);
+
+    if (n % 2 == 1)
+        m_negate = !m_negate;
+
+    std::copy(m_i.end() - iHistory, m_i.end(), m_i.begin());
+    std::copy(m_q.end() - qHistory, m_q.end(), m_q.begin());
+    m_i.resize(iHistory);
+    m_q.resize(qHistory);
+    return ErrorCode::OK;
+}
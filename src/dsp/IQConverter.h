@@ -0,0 +1,66 @@
+#ifndef PORTSDR_IQCONVERTER_H
+#define PORTSDR_IQCONVERTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Allocator.h"
+#include "Stream.h"
+
+namespace PortSDR
+{
+    /**
+     * Turns real samples with the signal centered at fs/4 into IQ samples at half the rate.
+     * The signal is shifted down by fs/4, low passed by a half-band filter and decimated by 2.
+     * A slow DC tracker removes the offset of the ADC first.
+     */
+    class IQConverter
+    {
+    public:
+        /**
+         * @param simd false forces the plain C kernels, used to compare against.
+         */
+        explicit IQConverter(bool simd = true);
+
+        /**
+         * Clears the filter history, call when the stream restarts.
+         */
+        void Reset();
+
+        /**
+         * Converts a block of real samples.
+         * @param src signed 16-bit real samples.
+         * @param count amount of real samples, must be even.
+         * @param format sample format of dst, INT16 or FLOAT32.
+         * @param dst destination, must hold count / 2 IQ samples.
+         * @return ret code
+         */
+        ErrorCode Process(const int16_t* src, std::size_t count, SampleFormat format, void* dst);
+
+        /**
+         * Converts a block of real samples into separate I and Q values.
+         * @param src signed 16-bit real samples.
+         * @param count amount of real samples, must be even.
+         * @param format sample format of dstI and dstQ, INT16 or FLOAT32.
+         * @param dstI destination of the I values, must hold count / 2 values.
+         * @param dstQ destination of the Q values, must hold count / 2 values.
+         * @return ret code
+         */
+        ErrorCode Process(const int16_t* src, std::size_t count, SampleFormat format, void* dstI, void* dstQ);
+
+    private:
+        ErrorCode Convert(const int16_t* src, std::size_t count, SampleFormat format, void* dst, void* dstQ);
+
+    private:
+        std::vector<float> m_taps;
+        // History followed by the current block, for the I and Q branch.
+        Buffer<float> m_i;
+        Buffer<float> m_q;
+        float m_dc = 0;
+        bool m_negate = false;
+        bool m_simd;
+    };
+}
+
+#endif //PORTSDR_IQCONVERTER_H
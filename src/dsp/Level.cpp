@@ -0,0 +1,295 @@
+#include "Level.h"
+
+#include <algorithm>
+#include <bitset>
+#include <cmath>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define PORTSDR_LEVEL_SSE2
+#endif
+
+// Keeps the 32-bit accumulators of the integer paths from overflowing.
+#define LEVEL_CHUNK 16384
+
+static std::size_t CountBits(const int mask)
+{
+    return std::bitset<32>(static_cast<uint32_t>(mask)).count();
+}
+
+#ifdef PORTSDR_LEVEL_SSE2
+static int64_t SumLanes(const __m128i v)
+{
+    int32_t lanes[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), v);
+    return static_cast<int64_t>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+}
+#endif
+
+static PortSDR::LevelStats MeasureUInt8(const uint8_t* src, const std::size_t count)
+{
+    uint64_t sumSquares = 0;
+    int64_t sum[2] = {0, 0};
+    int peak = 0;
+    std::size_t clipped = 0;
+    std::size_t i = 0;
+
+#ifdef PORTSDR_LEVEL_SSE2
+    const __m128i bias = _mm_set1_epi8(static_cast<char>(0x80));
+    const __m128i low = _mm_setzero_si128();
+    const __m128i high = _mm_set1_epi8(static_cast<char>(0xff));
+    const __m128i selectI = _mm_set1_epi32(1);
+    __m128i maxv = _mm_setzero_si128();
+    __m128i minv = _mm_setzero_si128();
+
+    while (i + 16 <= count)
+    {
+        __m128i acc = _mm_setzero_si128();
+        __m128i accI = _mm_setzero_si128();
+        __m128i accQ = _mm_setzero_si128();
+        const std::size_t end = std::min(count & ~static_cast<std::size_t>(15), i + LEVEL_CHUNK);
+        for (; i < end; i += 16)
+        {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+
+            // Offset binary to signed, then sign extend into 16-bit lanes.
+            const __m128i s = _mm_xor_si128(v, bias);
+            const __m128i lo = _mm_srai_epi16(_mm_unpacklo_epi8(s, s), 8);
+            const __m128i hi = _mm_srai_epi16(_mm_unpackhi_epi8(s, s), 8);
+
+            acc = _mm_add_epi32(acc, _mm_add_epi32(_mm_madd_epi16(lo, lo), _mm_madd_epi16(hi, hi)));
+            maxv = _mm_max_epi16(maxv, _mm_max_epi16(lo, hi));
+            minv = _mm_min_epi16(minv, _mm_min_epi16(lo, hi));
+
+            // Even lanes hold I, odd lanes Q.
+            const __m128i pairs = _mm_add_epi16(lo, hi);
+            accI = _mm_add_epi32(accI, _mm_madd_epi16(pairs, selectI));
+            accQ = _mm_add_epi32(accQ, _mm_madd_epi16(pairs, _mm_slli_epi32(selectI, 16)));
+
+            const __m128i clip = _mm_or_si128(_mm_cmpeq_epi8(v, low), _mm_cmpeq_epi8(v, high));
+            clipped += CountBits(_mm_movemask_epi8(clip));
+        }
+
+        sumSquares += SumLanes(acc);
+        sum[0] += SumLanes(accI);
+        sum[1] += SumLanes(accQ);
+    }
+
+    int16_t maxLanes[8], minLanes[8];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(maxLanes), maxv);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(minLanes), minv);
+    for (int j = 0; j < 8; j++)
+        peak = std::max({peak, static_cast<int>(maxLanes[j]), -static_cast<int>(minLanes[j])});
+#endif
+
+    for (; i < count; i++)
+    {
+        const int value = src[i] - 128;
+        sumSquares += value * value;
+        sum[i & 1] += value;
+        peak = std::max(peak, std::abs(value));
+        clipped += src[i] == 0 || src[i] == 255;
+    }
+
+    PortSDR::LevelStats stats;
+    stats.sumSquares = static_cast<double>(sumSquares) / (128.0 * 128.0);
+    stats.sumI = static_cast<double>(sum[0]) / 128.0;
+    stats.sumQ = static_cast<double>(sum[1]) / 128.0;
+    stats.peak = static_cast<float>(peak) / 128.0f;
+    stats.clipped = clipped;
+    stats.count = count;
+    return stats;
+}
+
+static PortSDR::LevelStats MeasureInt16(const int16_t* src, const std::size_t count)
+{
+    constexpr int clipLevel = static_cast<int>(PortSDR::kClipLevel * 32768.0f);
+
+    uint64_t sumSquares = 0;
+    int64_t sum[2] = {0, 0};
+    int peak = 0;
+    std::size_t clipped = 0;
+    std::size_t i = 0;
+
+#ifdef PORTSDR_LEVEL_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i high = _mm_set1_epi16(static_cast<short>(clipLevel - 1));
+    const __m128i low = _mm_set1_epi16(static_cast<short>(-clipLevel + 1));
+    const __m128i selectI = _mm_set1_epi32(1);
+    const __m128i selectQ = _mm_set1_epi32(1 << 16);
+    __m128i acc = _mm_setzero_si128();
+    __m128i maxv = zero;
+    __m128i minv = zero;
+
+    while (i + 8 <= count)
+    {
+        __m128i accI = _mm_setzero_si128();
+        __m128i accQ = _mm_setzero_si128();
+        const std::size_t end = std::min(count & ~static_cast<std::size_t>(7), i + LEVEL_CHUNK);
+        for (; i < end; i += 8)
+        {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+
+            // A pair of squares fits in 32 unsigned bits, widen before summing.
+            const __m128i squares = _mm_madd_epi16(v, v);
+            acc = _mm_add_epi64(acc, _mm_add_epi64(_mm_unpacklo_epi32(squares, zero),
+                                                   _mm_unpackhi_epi32(squares, zero)));
+            maxv = _mm_max_epi16(maxv, v);
+            minv = _mm_min_epi16(minv, v);
+
+            accI = _mm_add_epi32(accI, _mm_madd_epi16(v, selectI));
+            accQ = _mm_add_epi32(accQ, _mm_madd_epi16(v, selectQ));
+
+            const __m128i clip = _mm_or_si128(_mm_cmpgt_epi16(v, high), _mm_cmplt_epi16(v, low));
+            clipped += CountBits(_mm_movemask_epi8(clip)) / 2;
+        }
+
+        sum[0] += SumLanes(accI);
+        sum[1] += SumLanes(accQ);
+    }
+
+    uint64_t lanes[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), acc);
+    sumSquares = lanes[0] + lanes[1];
+
+    int16_t maxLanes[8], minLanes[8];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(maxLanes), maxv);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(minLanes), minv);
+    for (int j = 0; j < 8; j++)
+        peak = std::max({peak, static_cast<int>(maxLanes[j]), -static_cast<int>(minLanes[j])});
+#endif
+
+    for (; i < count; i++)
+    {
+        const int value = src[i];
+        sumSquares += static_cast<uint64_t>(value * value);
+        sum[i & 1] += value;
+        peak = std::max(peak, std::abs(value));
+        clipped += std::abs(value) >= clipLevel;
+    }
+
+    PortSDR::LevelStats stats;
+    stats.sumSquares = static_cast<double>(sumSquares) / (32768.0 * 32768.0);
+    stats.sumI = static_cast<double>(sum[0]) / 32768.0;
+    stats.sumQ = static_cast<double>(sum[1]) / 32768.0;
+    stats.peak = static_cast<float>(peak) / 32768.0f;
+    stats.clipped = clipped;
+    stats.count = count;
+    return stats;
+}
+
+static PortSDR::LevelStats MeasureFloat32(const float* src, const std::size_t count)
+{
+    double sumSquares = 0;
+    double sum[2] = {0, 0};
+    float peak = 0;
+    std::size_t clipped = 0;
+    std::size_t i = 0;
+
+#ifdef PORTSDR_LEVEL_SSE2
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128 clipLevel = _mm_set1_ps(PortSDR::kClipLevel);
+    __m128 maxv = _mm_setzero_ps();
+
+    while (i + 4 <= count)
+    {
+        // Float sums are flushed into double every chunk to keep precision.
+        __m128 acc = _mm_setzero_ps();
+        __m128 accIQ = _mm_setzero_ps();
+        const std::size_t end = std::min(count & ~static_cast<std::size_t>(3), i + LEVEL_CHUNK);
+        for (; i < end; i += 4)
+        {
+            const __m128 v = _mm_loadu_ps(src + i);
+            const __m128 magnitude = _mm_and_ps(v, absMask);
+
+            acc = _mm_add_ps(acc, _mm_mul_ps(v, v));
+            accIQ = _mm_add_ps(accIQ, v);
+            maxv = _mm_max_ps(maxv, magnitude);
+            clipped += CountBits(_mm_movemask_ps(_mm_cmpge_ps(magnitude, clipLevel)));
+        }
+
+        float lanes[4];
+        _mm_storeu_ps(lanes, acc);
+        sumSquares += static_cast<double>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+
+        _mm_storeu_ps(lanes, accIQ);
+        sum[0] += static_cast<double>(lanes[0]) + lanes[2];
+        sum[1] += static_cast<double>(lanes[1]) + lanes[3];
+    }
+
+    float maxLanes[4];
+    _mm_storeu_ps(maxLanes, maxv);
+    peak = std::max({maxLanes[0], maxLanes[1], maxLanes[2], maxLanes[3]});
+#endif
+
+    for (; i < count; i++)
+    {
+        sumSquares += static_cast<double>(src[i]) * src[i];
+        sum[i & 1] += src[i];
+        peak = std::max(peak, std::fabs(src[i]));
+        clipped += std::fabs(src[i]) >= PortSDR::kClipLevel;
+    }
+
+    PortSDR::LevelStats stats;
+    stats.sumSquares = sumSquares;
+    stats.sumI = sum[0];
+    stats.sumQ = sum[1];
+    stats.peak = peak;
+    stats.clipped = clipped;
+    stats.count = count;
+    return stats;
+}
+
+PortSDR::LevelStats PortSDR::MeasureLevel(const void* data, const SampleFormat format, const std::size_t count)
+{
+    switch (format)
+    {
+    case SAMPLE_FORMAT_IQ_UINT8:
+        return MeasureUInt8(static_cast<const uint8_t*>(data), count);
+    case SAMPLE_FORMAT_IQ_INT16:
+        return MeasureInt16(static_cast<const int16_t*>(data), count);
+    case SAMPLE_FORMAT_IQ_FLOAT32:
+        return MeasureFloat32(static_cast<const float*>(data), count);
+    }
+    return {};
+}
+
+PortSDR::LevelStats PortSDR::MeasureLevel(const SDRTransfer& transfer, const std::size_t from, const std::size_t count)
+{
+    if (transfer.layout != SAMPLE_LAYOUT_PLANAR)
+    {
+        return MeasureLevel(static_cast<const uint8_t*>(transfer.data) + from * GetSampleSize(transfer.format),
+                            transfer.format, count * 2);
+    }
+
+    // Each plane on its own, the kernels split the sums of a plane into even and odd values.
+    const std::size_t offset = from * GetSampleSize(transfer.format) / 2;
+    const LevelStats in = MeasureLevel(static_cast<const uint8_t*>(transfer.data) + offset, transfer.format, count);
+    const LevelStats quad = MeasureLevel(static_cast<const uint8_t*>(transfer.data_q) + offset, transfer.format, count);
+
+    LevelStats stats;
+    stats.sumSquares = in.sumSquares + quad.sumSquares;
+    stats.sumI = in.sumI + in.sumQ;
+    stats.sumQ = quad.sumI + quad.sumQ;
+    stats.peak = std::max(in.peak, quad.peak);
+    stats.clipped = in.clipped + quad.clipped;
+    stats.count = in.count + quad.count;
+    return stats;
+}
+
+PortSDR::SignalHealth PortSDR::LevelStats::Health() const
+{
+    if (count == 0)
+        return {};
+
+    const double frames = static_cast<double>(count) / 2.0;
+
+    SignalHealth health{};
+    health.rms = static_cast<float>(std::sqrt(Power()));
+    health.peak = peak;
+    health.saturation = static_cast<float>(static_cast<double>(clipped) / static_cast<double>(count));
+    health.dc_i = static_cast<float>(sumI / frames);
+    health.dc_q = static_cast<float>(sumQ / frames);
+    return health;
+}
@@ -0,0 +1,56 @@
+#ifndef PORTSDR_LEVEL_H
+#define PORTSDR_LEVEL_H
+
+#include <cstddef>
+
+#include "Stream.h"
+
+namespace PortSDR
+{
+    // Values at or above this fraction of full scale count as clipped.
+    // 8-bit values only clip at 0 and 255, which is below this level.
+    constexpr float kClipLevel = 0.99f;
+
+    struct LevelStats
+    {
+        double sumSquares = 0; // I² + Q² summed, normalized to full scale 1.0
+        double sumI = 0; // I summed, normalized
+        double sumQ = 0; // Q summed, normalized
+        float peak = 0; // Largest |I| or |Q|, normalized
+        std::size_t clipped = 0; // Values at or above kClipLevel
+        std::size_t count = 0; // Values measured (two per IQ sample)
+
+        /**
+         * @return average power of the IQ samples relative to full scale.
+         */
+        [[nodiscard]] double Power() const
+        {
+            return count ? sumSquares * 2.0 / static_cast<double>(count) : 0.0;
+        }
+
+        /**
+         * @return stats as the health metrics of a transfer.
+         */
+        [[nodiscard]] SignalHealth Health() const;
+    };
+
+    /**
+     * Measures the level of interleaved IQ values in a single pass.
+     * @param data values.
+     * @param format sample format of data.
+     * @param count amount of values (two per IQ sample).
+     * @return stats of the values.
+     */
+    LevelStats MeasureLevel(const void* data, SampleFormat format, std::size_t count);
+
+    /**
+     * Measures the level of samples of a transfer in either layout.
+     * @param transfer source transfer.
+     * @param from first IQ sample to measure.
+     * @param count amount of IQ samples.
+     * @return stats of the samples.
+     */
+    LevelStats MeasureLevel(const SDRTransfer& transfer, std::size_t from, std::size_t count);
+}
+
+#endif //PORTSDR_LEVEL_H
@@ -0,0 +1,210 @@
+#include "Settle.h"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <map>
+
+#include "Convert.h"
+
+// Time a stream may take to deliver the capture on top of the window itself
+#define SETTLE_TIMEOUT_MS 1000
+#define SETTLE_POWER_FLOOR 1e-20
+
+namespace
+{
+    std::mutex sSettleMutex;
+    std::map<std::string, std::chrono::microseconds> sSettleTimes;
+
+    /**
+     * Finds the end of the last block that differs from the settled end of the capture.
+     * @return settle time in samples.
+     */
+    std::size_t FindSettled(const std::vector<float>& capture, const PortSDR::SettleConfig& config)
+    {
+        const std::size_t blockSize = std::max<std::size_t>(config.block_size, 2);
+        const std::size_t blocks = capture.size() / 2 / blockSize;
+        if (blocks < 4)
+            return blocks * blockSize;
+
+        const auto* samples = reinterpret_cast<const std::complex<float>*>(capture.data());
+
+        std::vector<double> power(blocks);
+        std::vector<std::complex<double>> correlation(blocks);
+        for (std::size_t b = 0; b < blocks; b++)
+        {
+            const std::complex<float>* block = samples + b * blockSize;
+
+            double p = std::norm(block[0]);
+            std::complex<double> r = 0;
+            for (std::size_t i = 1; i < blockSize; i++)
+            {
+                p += std::norm(block[i]);
+                r += std::complex<double>(block[i] * std::conj(block[i - 1]));
+            }
+            power[b] = p / blockSize;
+            correlation[b] = r / static_cast<double>(blockSize - 1);
+        }
+
+        // The last quarter of the capture is taken as settled.
+        const std::size_t reference = blocks - blocks / 4;
+        double refPower = 0;
+        std::complex<double> refCorrelation = 0;
+        for (std::size_t b = reference; b < blocks; b++)
+        {
+            refPower += power[b];
+            refCorrelation += correlation[b];
+        }
+        refPower = std::max(refPower / static_cast<double>(blocks - reference), SETTLE_POWER_FLOOR);
+        refCorrelation /= static_cast<double>(blocks - reference);
+
+        std::size_t settled = 0;
+        for (std::size_t b = 0; b < blocks; b++)
+        {
+            const double powerDb = 10.0 * std::log10(std::max(power[b], SETTLE_POWER_FLOOR) / refPower);
+            const double correlationError = std::abs(correlation[b] - refCorrelation) / refPower;
+
+            if (std::fabs(powerDb) > config.power_tolerance_db || correlationError > config.correlation_tolerance)
+                settled = b + 1;
+        }
+        return settled * blockSize;
+    }
+}
+
+PortSDR::RetuneCalibrator::RetuneCalibrator(Stream& stream)
+    : m_stream(stream)
+{
+}
+
+PortSDR::ErrorCode PortSDR::RetuneCalibrator::Calibrate(const std::vector<uint32_t>& frequencies,
+                                                        SettleResult& result,
+                                                        const SettleConfig& config)
+{
+    const uint32_t sampleRate = m_stream.GetSampleRate();
+    if (frequencies.empty() || sampleRate == 0)
+        return ErrorCode::INVALID_ARGUMENT;
+
+    // The skipped samples are the ones to measure.
+    const std::chrono::microseconds previousSkip = m_stream.GetSettleSkip();
+    m_stream.SetSettleSkip(std::chrono::microseconds(0));
+
+    std::size_t longest = 0;
+    double total = 0;
+    for (const uint32_t freq : frequencies)
+    {
+        std::size_t settle = 0;
+        const ErrorCode ret = Measure(freq, config, settle);
+        if (ret != ErrorCode::OK)
+        {
+            m_stream.SetSettleSkip(previousSkip);
+            return ret;
+        }
+
+        longest = std::max(longest, settle);
+        total += static_cast<double>(settle);
+    }
+
+    const auto toTime = [sampleRate](const double samples)
+    {
+        return std::chrono::microseconds(static_cast<int64_t>(std::ceil(samples * 1e6 / sampleRate)));
+    };
+
+    result.tuner = m_stream.GetTunerType();
+    result.settle_time = toTime(static_cast<double>(longest));
+    result.average = toTime(total / static_cast<double>(frequencies.size()));
+    result.retunes = frequencies.size();
+
+    {
+        std::lock_guard lock(sSettleMutex);
+        sSettleTimes[result.tuner] = result.settle_time;
+    }
+
+    m_stream.SetSettleSkip(config.apply ? result.settle_time : previousSkip);
+    return ErrorCode::OK;
+}
+
+PortSDR::ErrorCode PortSDR::RetuneCalibrator::Measure(const uint32_t freq, const SettleConfig& config,
+                                                      std::size_t& settle)
+{
+    const double samples = std::chrono::duration<double>(config.window).count() * m_stream.GetSampleRate();
+
+    {
+        std::lock_guard lock(m_mutex);
+        m_target = freq;
+        m_capturing = false;
+        m_needed = static_cast<std::size_t>(samples) * 2;
+        m_capture.clear();
+        m_capture.reserve(m_needed);
+    }
+    m_armed.store(true, std::memory_order_release);
+
+    ErrorCode ret = m_stream.SetCenterFrequency(freq);
+    if (ret != ErrorCode::OK)
+    {
+        m_armed = false;
+        return ret;
+    }
+
+    std::unique_lock lock(m_mutex);
+    const bool captured = m_cv.wait_for(lock, config.window + std::chrono::milliseconds(SETTLE_TIMEOUT_MS), [this]
+    {
+        return m_capture.size() >= m_needed;
+    });
+    m_armed = false;
+
+    if (!captured)
+        return ErrorCode::TIMEOUT;
+
+    settle = FindSettled(m_capture, config);
+    return ErrorCode::OK;
+}
+
+void PortSDR::RetuneCalibrator::Process(const SDRTransfer& transfer)
+{
+    if (!m_armed.load(std::memory_order_acquire))
+        return;
+
+    std::unique_lock lock(m_mutex);
+
+    std::size_t start = 0;
+    if (!m_capturing)
+    {
+        // Capturing starts at the tag of the retune, not at an earlier one to the same frequency.
+        const StreamTag* tag = nullptr;
+        for (std::size_t i = 0; i < transfer.tag_count; i++)
+        {
+            if (transfer.tags[i].type == STREAM_TAG_FREQUENCY && transfer.tags[i].value == m_target)
+                tag = &transfer.tags[i];
+        }
+        if (!tag)
+            return;
+
+        m_capturing = true;
+        start = tag->offset;
+    }
+
+    const std::size_t size = m_capture.size();
+    const std::size_t count = std::min((transfer.frame_size - start) * 2, m_needed - size);
+    if (count == 0)
+        return;
+
+    m_capture.resize(size + count);
+    ConvertTransfer(transfer, start, m_capture.data() + size, SAMPLE_FORMAT_IQ_FLOAT32, count / 2);
+
+    if (m_capture.size() >= m_needed)
+    {
+        m_armed.store(false, std::memory_order_release);
+        lock.unlock();
+        m_cv.notify_one();
+    }
+}
+
+std::optional<std::chrono::microseconds> PortSDR::GetCalibratedSettleTime(const std::string& tuner)
+{
+    std::lock_guard lock(sSettleMutex);
+
+    const auto it = sSettleTimes.find(tuner);
+    if (it == sSettleTimes.end())
+        return std::nullopt;
+    return it->second;
+}
@@ -0,0 +1,125 @@
+#include "Unpack.h"
+#include "Cpu.h"
+
+#include <cstring>
+
+static uint32_t LoadWord(const uint8_t* src)
+{
+    uint32_t word;
+    std::memcpy(&word, src, sizeof(word));
+    return word;
+}
+
+static int16_t ToSigned(const uint32_t value)
+{
+    return static_cast<int16_t>((static_cast<int32_t>(value) - 2048) << 4);
+}
+
+#ifdef PORTSDR_X86_DISPATCH
+/*
+ * Each group of 12 bytes holds 8 samples. Every sample is gathered into a 16-bit lane
+ * as (high byte << 8 | low byte); even samples sit in the upper 12 bits of their lane,
+ * odd samples in the lower 12 bits.
+ */
+#define AIRSPY_UNPACK_SHUFFLE 2, 3, 1, 2, 7, 0, 6, 7, 4, 5, 11, 4, 9, 10, 8, 9
+
+PORTSDR_TARGET("ssse3")
+static std::size_t UnpackAirSpy12Ssse3(const uint8_t* src, int16_t* dst, const std::size_t count)
+{
+    const __m128i shuffle = _mm_setr_epi8(AIRSPY_UNPACK_SHUFFLE);
+    const __m128i oddMask = _mm_setr_epi16(0, 0x0fff, 0, 0x0fff, 0, 0x0fff, 0, 0x0fff);
+    const __m128i evenMask = _mm_setr_epi16(-1, 0, -1, 0, -1, 0, -1, 0);
+    const __m128i bias = _mm_set1_epi16(static_cast<short>(0x8000));
+
+    const std::size_t bytes = count / 8 * 12;
+
+    std::size_t i = 0;
+    // 16 byte loads of 12 byte groups, stop early enough to never read past the end.
+    for (; i / 8 * 12 + 16 <= bytes; i += 8)
+    {
+        const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i / 8 * 12));
+        const __m128i lanes = _mm_shuffle_epi8(in, shuffle);
+
+        const __m128i even = _mm_and_si128(_mm_srli_epi16(lanes, 4), evenMask);
+        const __m128i odd = _mm_and_si128(lanes, oddMask);
+
+        // (x - 2048) << 4 is x << 4 with the top bit flipped.
+        const __m128i out = _mm_xor_si128(_mm_slli_epi16(_mm_or_si128(even, odd), 4), bias);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), out);
+    }
+    return i;
+}
+
+PORTSDR_TARGET("avx2")
+static std::size_t UnpackAirSpy12Avx2(const uint8_t* src, int16_t* dst, const std::size_t count)
+{
+    const __m256i shuffle = _mm256_setr_epi8(AIRSPY_UNPACK_SHUFFLE, AIRSPY_UNPACK_SHUFFLE);
+    const __m256i oddMask = _mm256_setr_epi16(0, 0x0fff, 0, 0x0fff, 0, 0x0fff, 0, 0x0fff,
+                                              0, 0x0fff, 0, 0x0fff, 0, 0x0fff, 0, 0x0fff);
+    const __m256i evenMask = _mm256_setr_epi16(-1, 0, -1, 0, -1, 0, -1, 0,
+                                               -1, 0, -1, 0, -1, 0, -1, 0);
+    const __m256i bias = _mm256_set1_epi16(static_cast<short>(0x8000));
+
+    const std::size_t bytes = count / 8 * 12;
+
+    std::size_t i = 0;
+    // Two 12 byte groups per iteration, one in each 128-bit lane.
+    for (; i / 8 * 12 + 28 <= bytes; i += 16)
+    {
+        const uint8_t* in = src + i / 8 * 12;
+        const __m256i packed = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in))),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 12)), 1);
+        const __m256i lanes = _mm256_shuffle_epi8(packed, shuffle);
+
+        const __m256i even = _mm256_and_si256(_mm256_srli_epi16(lanes, 4), evenMask);
+        const __m256i odd = _mm256_and_si256(lanes, oddMask);
+
+        const __m256i out = _mm256_xor_si256(_mm256_slli_epi16(_mm256_or_si256(even, odd), 4), bias);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), out);
+    }
+    return i;
+}
+#endif
+
+void PortSDR::UnpackAirSpy12Scalar(const uint8_t* src, int16_t* dst, const std::size_t count)
+{
+    for (std::size_t i = 0; i + 8 <= count; i += 8)
+    {
+        const uint32_t w0 = LoadWord(src);
+        const uint32_t w1 = LoadWord(src + 4);
+        const uint32_t w2 = LoadWord(src + 8);
+        src += 12;
+
+        dst[i + 0] = ToSigned((w0 >> 20) & 0xfff);
+        dst[i + 1] = ToSigned((w0 >> 8) & 0xfff);
+        dst[i + 2] = ToSigned(((w0 & 0xff) << 4) | ((w1 >> 28) & 0xf));
+        dst[i + 3] = ToSigned((w1 & 0xfff0000) >> 16);
+        dst[i + 4] = ToSigned((w1 & 0xfff0) >> 4);
+        dst[i + 5] = ToSigned(((w1 & 0xf) << 8) | ((w2 & 0xff000000) >> 24));
+        dst[i + 6] = ToSigned((w2 >> 12) & 0xfff);
+        dst[i + 7] = ToSigned(w2 & 0xfff);
+    }
+}
+
+void PortSDR::UnpackAirSpy12(const uint8_t* src, int16_t* dst, const std::size_t count)
+{
+    std::size_t done = 0;
+
+#ifdef PORTSDR_X86_DISPATCH
+    if (CpuHasAvx2())
+        done = UnpackAirSpy12Avx2(src, dst, count);
+    else if (CpuHasSsse3())
+        done = UnpackAirSpy12Ssse3(src, dst, count);
+#endif
+
+    UnpackAirSpy12Scalar(src + done / 8 * 12, dst + done, count - done);
+}
+
+void PortSDR::ConvertAirSpy12(const uint16_t* src, int16_t* dst, const std::size_t count)
+{
+    for (std::size_t i = 0; i < count; i++)
+    {
+        dst[i] = ToSigned(src[i]);
+    }
+}
@@ -0,0 +1,33 @@
+#ifndef PORTSDR_UNPACK_H
+#define PORTSDR_UNPACK_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace PortSDR
+{
+    /**
+     * Unpacks AirSpy packed 12-bit samples (8 samples in three 32-bit words)
+     * into signed 16-bit real samples, identical to libairspy's INT16_REAL output.
+     * @param src packed samples, count * 3 / 2 bytes.
+     * @param dst destination, must hold count samples.
+     * @param count amount of samples, multiple of 8.
+     */
+    void UnpackAirSpy12(const uint8_t* src, int16_t* dst, std::size_t count);
+
+    /**
+     * Plain C version of UnpackAirSpy12(), used as reference and for the tail.
+     */
+    void UnpackAirSpy12Scalar(const uint8_t* src, int16_t* dst, std::size_t count);
+
+    /**
+     * Converts unpacked 12-bit samples into signed 16-bit real samples.
+     * This is the work done on the unpacked transport.
+     * @param src unpacked samples.
+     * @param dst destination, must hold count samples.
+     * @param count amount of samples.
+     */
+    void ConvertAirSpy12(const uint16_t* src, int16_t* dst, std::size_t count);
+}
+
+#endif //PORTSDR_UNPACK_H
@@ -0,0 +1,442 @@
+#include "SharedMemory.h"
+
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <new>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "ShmLayout.h"
+
+static std::string GetSegmentName(const std::string_view name)
+{
+    if (!name.empty() && name.front() == '/')
+        return std::string(name);
+    return "/" + std::string(name);
+}
+
+static std::size_t AlignUp(const std::size_t value, const std::size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static bool IsProcessAlive(const int32_t pid)
+{
+    return pid > 0 && (kill(pid, 0) == 0 || errno != ESRCH);
+}
+
+/**
+ * @return true if the segment was created by a publisher that is still alive.
+ */
+static bool IsOwnedByLivePublisher(const std::string& segment)
+{
+    const int fd = shm_open(segment.c_str(), O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0)
+        return false;
+
+    bool alive = false;
+
+    struct stat st{};
+    if (fstat(fd, &st) == 0 && static_cast<std::size_t>(st.st_size) >= sizeof(PortSDR::ShmHeader))
+    {
+        void* map = mmap(nullptr, sizeof(PortSDR::ShmHeader), PROT_READ, MAP_SHARED, fd, 0);
+        if (map != MAP_FAILED)
+        {
+            const auto* header = static_cast<const PortSDR::ShmHeader*>(map);
+
+            // Segments of an older layout have no owner, they can't be in use by this version.
+            alive = header->magic.load(std::memory_order_acquire) == PortSDR::kShmMagic
+                && header->version == PortSDR::kShmVersion
+                && IsProcessAlive(header->owner.load(std::memory_order_relaxed));
+
+            munmap(map, sizeof(PortSDR::ShmHeader));
+        }
+    }
+
+    close(fd);
+    return alive;
+}
+
+static int FutexWait(std::atomic<uint32_t>* addr, const uint32_t expected, const timespec* timeout)
+{
+    // Not FUTEX_PRIVATE, the word is shared between processes.
+    return static_cast<int>(syscall(SYS_futex, addr, FUTEX_WAIT, expected, timeout, nullptr, 0));
+}
+
+static void FutexWake(std::atomic<uint32_t>* addr)
+{
+    syscall(SYS_futex, addr, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+PortSDR::ShmPublisher::~ShmPublisher()
+{
+    Close();
+}
+
+PortSDR::ErrorCode PortSDR::ShmPublisher::Create(const std::string_view name,
+                                                 const std::size_t slotCount,
+                                                 const std::size_t slotSize)
+{
+    if (m_header)
+        return ErrorCode::INVALID_ARGUMENT;
+
+    if (slotCount == 0 || slotSize == 0 || slotSize > UINT32_MAX || slotCount > UINT32_MAX)
+        return ErrorCode::INVALID_ARGUMENT;
+
+    const std::string segment = GetSegmentName(name);
+    const std::size_t stride = AlignUp(sizeof(ShmSlot) + slotSize, kShmAlignment);
+    const std::size_t size = AlignUp(sizeof(ShmHeader), kShmAlignment) + stride * slotCount;
+
+    // A segment left behind by a crashed publisher is replaced, its readers keep their old mapping.
+    if (IsOwnedByLivePublisher(segment))
+        return ErrorCode::FAILED_TO_INITIALIZE;
+
+    shm_unlink(segment.c_str());
+
+    m_fd = shm_open(segment.c_str(), O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0660);
+    if (m_fd < 0)
+        return ErrorCode::FAILED_TO_INITIALIZE;
+
+    if (ftruncate(m_fd, static_cast<off_t>(size)) < 0)
+    {
+        shm_unlink(segment.c_str());
+        Close();
+        return ErrorCode::FAILED_TO_INITIALIZE;
+    }
+
+    m_map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (m_map == MAP_FAILED)
+    {
+        m_map = nullptr;
+        shm_unlink(segment.c_str());
+        Close();
+        return ErrorCode::FAILED_TO_INITIALIZE;
+    }
+
+    m_name = segment;
+    m_mapSize = size;
+    m_header = new(m_map) ShmHeader{};
+    m_header->version = kShmVersion;
+    m_header->slotCount = static_cast<uint32_t>(slotCount);
+    m_header->slotSize = static_cast<uint32_t>(slotSize);
+    m_header->slotStride = stride;
+    m_header->owner.store(getpid(), std::memory_order_relaxed);
+
+    for (uint64_t i = 0; i < slotCount; i++)
+        new(GetSlot(i)) ShmSlot{};
+
+    // Readers only accept the segment once the magic is visible.
+    m_header->magic.store(kShmMagic, std::memory_order_release);
+
+    return ErrorCode::OK;
+}
+
+void PortSDR::ShmPublisher::Close()
+{
+    if (!m_name.empty())
+    {
+        shm_unlink(m_name.c_str());
+        m_name.clear();
+    }
+
+    if (m_map)
+    {
+        munmap(m_map, m_mapSize);
+        m_map = nullptr;
+    }
+
+    if (m_fd >= 0)
+    {
+        close(m_fd);
+        m_fd = -1;
+    }
+
+    m_header = nullptr;
+    m_mapSize = 0;
+}
+
+PortSDR::ErrorCode PortSDR::ShmPublisher::Publish(const SDRTransfer& transfer)
+{
+    if (!m_header)
+        return ErrorCode::UNINITIALIZED;
+
+    const std::size_t sampleSize = GetSampleSize(transfer.format);
+    if (sampleSize == 0)
+        return ErrorCode::INVALID_ARGUMENT;
+
+    const std::size_t framesPerSlot = m_header->slotSize / sampleSize;
+    if (framesPerSlot == 0)
+        return ErrorCode::INVALID_ARGUMENT;
+
+    std::size_t offset = 0;
+    uint64_t sampleIndex = m_header->sampleIndex.load(std::memory_order_relaxed);
+    uint64_t block = m_header->head.load(std::memory_order_relaxed);
+
+    std::size_t remaining = transfer.frame_size;
+    bool first = true;
+
+    while (remaining > 0)
+    {
+        const std::size_t frames = std::min(remaining, framesPerSlot);
+        ShmSlot* slot = GetSlot(block);
+
+        slot->sequence.store(WritingSequence(block), std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        // Readers always get interleaved samples.
+        ConvertTransfer(transfer, offset, GetSlotPayload(slot), transfer.format, frames);
+        slot->block = block;
+        slot->sampleIndex = sampleIndex;
+        slot->droppedSamples = first ? transfer.dropped_samples : 0;
+        slot->frameSize = static_cast<uint32_t>(frames);
+        slot->format = transfer.format;
+
+        slot->sequence.store(WrittenSequence(block), std::memory_order_release);
+
+        block++;
+        m_header->head.store(block, std::memory_order_release);
+
+        offset += frames;
+        sampleIndex += frames;
+        remaining -= frames;
+        first = false;
+    }
+
+    m_header->sampleIndex.store(sampleIndex, std::memory_order_relaxed);
+
+    m_header->sequence.fetch_add(1, std::memory_order_seq_cst);
+    if (m_header->waiters.load(std::memory_order_seq_cst) > 0)
+        FutexWake(&m_header->sequence);
+
+    return ErrorCode::OK;
+}
+
+std::vector<PortSDR::ShmReaderInfo> PortSDR::ShmPublisher::GetReaders() const
+{
+    std::vector<ShmReaderInfo> readers;
+    if (!m_header)
+        return readers;
+
+    const uint64_t head = m_header->head.load(std::memory_order_acquire);
+
+    for (const ShmReaderSlot& reader : m_header->readers)
+    {
+        const int32_t pid = reader.pid.load(std::memory_order_acquire);
+        if (!IsProcessAlive(pid))
+            continue;
+
+        const uint64_t cursor = reader.cursor.load(std::memory_order_relaxed);
+        readers.push_back({pid, head > cursor ? head - cursor : 0, reader.lost.load(std::memory_order_relaxed)});
+    }
+
+    return readers;
+}
+
+PortSDR::ShmSlot* PortSDR::ShmPublisher::GetSlot(const uint64_t block) const
+{
+    auto* base = static_cast<uint8_t*>(m_map) + AlignUp(sizeof(ShmHeader), kShmAlignment);
+    return reinterpret_cast<ShmSlot*>(base + (block % m_header->slotCount) * m_header->slotStride);
+}
+
+PortSDR::ShmSubscriber::~ShmSubscriber()
+{
+    Close();
+}
+
+PortSDR::ErrorCode PortSDR::ShmSubscriber::Open(const std::string_view name)
+{
+    if (m_header)
+        return ErrorCode::INVALID_ARGUMENT;
+
+    const std::string segment = GetSegmentName(name);
+
+    m_fd = shm_open(segment.c_str(), O_RDWR | O_CLOEXEC, 0);
+    if (m_fd < 0)
+        return ErrorCode::DEVICE_NOT_FOUND;
+
+    struct stat st{};
+    if (fstat(m_fd, &st) < 0 || static_cast<std::size_t>(st.st_size) < sizeof(ShmHeader))
+    {
+        Close();
+        return ErrorCode::FAILED_TO_INITIALIZE;
+    }
+
+    m_mapSize = st.st_size;
+    m_map = mmap(nullptr, m_mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (m_map == MAP_FAILED)
+    {
+        m_map = nullptr;
+        Close();
+        return ErrorCode::FAILED_TO_INITIALIZE;
+    }
+
+    auto* header = static_cast<ShmHeader*>(m_map);
+    const uint32_t magic = header->magic.load(std::memory_order_acquire);
+    const std::size_t expected = AlignUp(sizeof(ShmHeader), kShmAlignment)
+        + header->slotStride * header->slotCount;
+
+    if (magic != kShmMagic || header->version != kShmVersion || expected != m_mapSize)
+    {
+        Close();
+        return ErrorCode::FAILED_TO_INITIALIZE;
+    }
+
+    m_header = header;
+
+    // Claim a free reader slot, or one left behind by a reader that died.
+    const int32_t self = getpid();
+    for (int i = 0; i < static_cast<int>(kShmMaxReaders) && m_reader < 0; i++)
+    {
+        ShmReaderSlot& reader = m_header->readers[i];
+        int32_t pid = reader.pid.load(std::memory_order_acquire);
+
+        if (pid != 0 && IsProcessAlive(pid))
+            continue;
+
+        if (reader.pid.compare_exchange_strong(pid, self, std::memory_order_acq_rel))
+            m_reader = i;
+    }
+
+    if (m_reader < 0)
+    {
+        Close();
+        return ErrorCode::UNKNOWN;
+    }
+
+    m_cursor = m_header->head.load(std::memory_order_acquire);
+    m_lost = 0;
+
+    ShmReaderSlot& reader = m_header->readers[m_reader];
+    reader.cursor.store(m_cursor, std::memory_order_relaxed);
+    reader.lost.store(0, std::memory_order_relaxed);
+
+    return ErrorCode::OK;
+}
+
+void PortSDR::ShmSubscriber::Close()
+{
+    if (m_header && m_reader >= 0)
+        m_header->readers[m_reader].pid.store(0, std::memory_order_release);
+
+    if (m_map)
+    {
+        munmap(m_map, m_mapSize);
+        m_map = nullptr;
+    }
+
+    if (m_fd >= 0)
+    {
+        close(m_fd);
+        m_fd = -1;
+    }
+
+    m_header = nullptr;
+    m_reader = -1;
+    m_mapSize = 0;
+}
+
+PortSDR::ErrorCode PortSDR::ShmSubscriber::Next(ShmBlock& block, const std::chrono::milliseconds timeout)
+{
+    if (!m_header)
+        return ErrorCode::UNINITIALIZED;
+
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    const uint64_t slotCount = m_header->slotCount;
+    const std::size_t slotSize = m_header->slotSize;
+
+    while (true)
+    {
+        const uint32_t sequence = m_header->sequence.load(std::memory_order_seq_cst);
+        const uint64_t head = m_header->head.load(std::memory_order_acquire);
+
+        if (m_cursor < head)
+        {
+            // The publisher is writing the slot of block head - slotCount.
+            const uint64_t oldest = head >= slotCount ? head - slotCount + 1 : 0;
+            if (m_cursor < oldest)
+            {
+                AddLost(oldest - m_cursor);
+                m_cursor = oldest;
+            }
+
+            const ShmSlot* slot = GetSlot(m_cursor);
+            bool intact = slot->sequence.load(std::memory_order_acquire) == WrittenSequence(m_cursor);
+
+            // Copied out first, the publisher may rewrite the slot meanwhile.
+            const uint32_t frameSize = slot->frameSize;
+            const uint64_t droppedSamples = slot->droppedSamples;
+            const auto format = static_cast<SampleFormat>(slot->format);
+            const uint64_t sampleIndex = slot->sampleIndex;
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            intact = intact && slot->sequence.load(std::memory_order_relaxed) == WrittenSequence(m_cursor);
+
+            const std::size_t sampleSize = GetSampleSize(format);
+            if (!intact || sampleSize == 0 || static_cast<std::size_t>(frameSize) * sampleSize > slotSize)
+            {
+                // Lapped by the publisher between reading head and the slot.
+                AddLost(1);
+                m_cursor++;
+                continue;
+            }
+
+            block.data = GetSlotPayload(slot);
+            block.frame_size = frameSize;
+            block.dropped_samples = droppedSamples;
+            block.format = format;
+            block.sample_index = sampleIndex;
+            block.sequence = m_cursor;
+
+            m_cursor++;
+            m_header->readers[m_reader].cursor.store(m_cursor, std::memory_order_relaxed);
+            return ErrorCode::OK;
+        }
+
+        const auto now = std::chrono::steady_clock::now();
+        if (now >= deadline)
+            return ErrorCode::TIMEOUT;
+
+        const auto left = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - now);
+        timespec ts{};
+        ts.tv_sec = static_cast<time_t>(left.count() / 1000000000);
+        ts.tv_nsec = static_cast<long>(left.count() % 1000000000);
+
+        // Returns immediately if anything was published after sequence was read.
+        m_header->waiters.fetch_add(1, std::memory_order_seq_cst);
+        FutexWait(&m_header->sequence, sequence, &ts);
+        m_header->waiters.fetch_sub(1, std::memory_order_seq_cst);
+    }
+}
+
+bool PortSDR::ShmSubscriber::IsValid(const ShmBlock& block) const
+{
+    if (!m_header)
+        return false;
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return GetSlot(block.sequence)->sequence.load(std::memory_order_relaxed) == WrittenSequence(block.sequence);
+}
+
+uint64_t PortSDR::ShmSubscriber::GetLostBlocks() const
+{
+    return m_lost;
+}
+
+const PortSDR::ShmSlot* PortSDR::ShmSubscriber::GetSlot(const uint64_t block) const
+{
+    const auto* base = static_cast<const uint8_t*>(m_map) + AlignUp(sizeof(ShmHeader), kShmAlignment);
+    return reinterpret_cast<const ShmSlot*>(base + (block % m_header->slotCount) * m_header->slotStride);
+}
+
+void PortSDR::ShmSubscriber::AddLost(const uint64_t count)
+{
+    m_lost += count;
+    m_header->readers[m_reader].lost.store(m_lost, std::memory_order_relaxed);
+}
@@ -0,0 +1,84 @@
+#ifndef PORTSDR_SHMLAYOUT_H
+#define PORTSDR_SHMLAYOUT_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace PortSDR
+{
+    /*
+     * Layout of the shared memory segment:
+     *   ShmHeader | ShmSlot 0 + payload | ShmSlot 1 + payload | ...
+     *
+     * The publisher never waits on readers. Each slot carries a sequence
+     * number which is odd while the publisher writes it, so a reader can
+     * detect that a block was overwritten while it was reading it.
+     */
+    constexpr uint32_t kShmMagic = 0x52445350; // "PSDR"
+    constexpr uint32_t kShmVersion = 2;
+    constexpr std::size_t kShmMaxReaders = 64;
+    constexpr std::size_t kShmAlignment = 64;
+
+    struct alignas(kShmAlignment) ShmReaderSlot
+    {
+        std::atomic<int32_t> pid;
+        std::atomic<uint64_t> cursor;
+        std::atomic<uint64_t> lost;
+    };
+
+    struct alignas(kShmAlignment) ShmHeader
+    {
+        std::atomic<uint32_t> magic;
+        uint32_t version;
+        uint32_t slotCount;
+        uint32_t slotSize;
+        uint64_t slotStride;
+        std::atomic<int32_t> owner; // pid of the publisher
+
+        alignas(kShmAlignment) std::atomic<uint64_t> head;
+        std::atomic<uint64_t> sampleIndex;
+
+        /* Futex word, bumped on every publish */
+        alignas(kShmAlignment) std::atomic<uint32_t> sequence;
+        std::atomic<uint32_t> waiters;
+
+        ShmReaderSlot readers[kShmMaxReaders];
+    };
+
+    struct alignas(kShmAlignment) ShmSlot
+    {
+        std::atomic<uint64_t> sequence;
+        uint64_t block;
+        uint64_t sampleIndex;
+        uint64_t droppedSamples;
+        uint32_t frameSize;
+        uint32_t format;
+    };
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free);
+    static_assert(std::atomic<uint32_t>::is_always_lock_free);
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex word must be 32-bit");
+
+    inline uint8_t* GetSlotPayload(ShmSlot* slot)
+    {
+        return reinterpret_cast<uint8_t*>(slot) + sizeof(ShmSlot);
+    }
+
+    inline const uint8_t* GetSlotPayload(const ShmSlot* slot)
+    {
+        return reinterpret_cast<const uint8_t*>(slot) + sizeof(ShmSlot);
+    }
+
+    constexpr uint64_t WritingSequence(const uint64_t block)
+    {
+        return block * 2 + 1;
+    }
+
+    constexpr uint64_t WrittenSequence(const uint64_t block)
+    {
+        return block * 2 + 2;
+    }
+}
+
+#endif //PORTSDR_SHMLAYOUT_H
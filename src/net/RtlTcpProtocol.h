@@ -0,0 +1,112 @@
+#ifndef PORTSDR_RTLTCPPROTOCOL_H
+#define PORTSDR_RTLTCPPROTOCOL_H
+
+#include <cstdint>
+#include <cstring>
+
+namespace PortSDR
+{
+    /**
+     * Wire format used by rtl_tcp from librtlsdr.
+     * The server greets with a header, then sends raw offset binary uint8 IQ.
+     * The client sends fixed size commands with a big endian parameter.
+     */
+    enum RtlTcpCommand : uint8_t
+    {
+        RTL_TCP_SET_FREQUENCY = 0x01,
+        RTL_TCP_SET_SAMPLE_RATE = 0x02,
+        RTL_TCP_SET_GAIN_MODE = 0x03,
+        RTL_TCP_SET_GAIN = 0x04,
+        RTL_TCP_SET_FREQ_CORRECTION = 0x05,
+        RTL_TCP_SET_IF_GAIN = 0x06,
+        RTL_TCP_SET_TEST_MODE = 0x07,
+        RTL_TCP_SET_AGC_MODE = 0x08,
+        RTL_TCP_SET_DIRECT_SAMPLING = 0x09,
+        RTL_TCP_SET_OFFSET_TUNING = 0x0a,
+        RTL_TCP_SET_RTL_XTAL = 0x0b,
+        RTL_TCP_SET_TUNER_XTAL = 0x0c,
+        RTL_TCP_SET_GAIN_BY_INDEX = 0x0d,
+        RTL_TCP_SET_BIAS_TEE = 0x0e,
+    };
+
+    constexpr std::size_t kRtlTcpHeaderSize = 12;
+    constexpr std::size_t kRtlTcpCommandSize = 5;
+    constexpr char kRtlTcpMagic[4] = {'R', 'T', 'L', '0'};
+
+    /* Values of enum rtlsdr_tuner */
+    constexpr uint32_t kRtlTcpTunerUnknown = 0;
+    constexpr uint32_t kRtlTcpTunerE4000 = 1;
+    constexpr uint32_t kRtlTcpTunerFC0012 = 2;
+    constexpr uint32_t kRtlTcpTunerFC0013 = 3;
+    constexpr uint32_t kRtlTcpTunerFC2580 = 4;
+    constexpr uint32_t kRtlTcpTunerR820T = 5;
+    constexpr uint32_t kRtlTcpTunerR828D = 6;
+
+    inline const char* RtlTcpTunerName(const uint32_t type)
+    {
+        switch (type)
+        {
+        case kRtlTcpTunerE4000:
+            return "E4000";
+        case kRtlTcpTunerFC0012:
+            return "FC0012";
+        case kRtlTcpTunerFC0013:
+            return "FC0013";
+        case kRtlTcpTunerFC2580:
+            return "FC2580";
+        case kRtlTcpTunerR820T:
+            return "R820T";
+        case kRtlTcpTunerR828D:
+            return "R828D";
+        default:
+            return "";
+        }
+    }
+
+    struct RtlTcpHeader
+    {
+        uint32_t tunerType;
+        uint32_t gainCount;
+    };
+
+    inline void WriteBigEndian(uint8_t* dst, const uint32_t value)
+    {
+        dst[0] = static_cast<uint8_t>(value >> 24);
+        dst[1] = static_cast<uint8_t>(value >> 16);
+        dst[2] = static_cast<uint8_t>(value >> 8);
+        dst[3] = static_cast<uint8_t>(value);
+    }
+
+    inline uint32_t ReadBigEndian(const uint8_t* src)
+    {
+        return static_cast<uint32_t>(src[0]) << 24
+            | static_cast<uint32_t>(src[1]) << 16
+            | static_cast<uint32_t>(src[2]) << 8
+            | static_cast<uint32_t>(src[3]);
+    }
+
+    inline void EncodeRtlTcpHeader(uint8_t (&dst)[kRtlTcpHeaderSize], const RtlTcpHeader& header)
+    {
+        std::memcpy(dst, kRtlTcpMagic, sizeof(kRtlTcpMagic));
+        WriteBigEndian(dst + 4, header.tunerType);
+        WriteBigEndian(dst + 8, header.gainCount);
+    }
+
+    inline bool DecodeRtlTcpHeader(const uint8_t (&src)[kRtlTcpHeaderSize], RtlTcpHeader& header)
+    {
+        if (std::memcmp(src, kRtlTcpMagic, sizeof(kRtlTcpMagic)) != 0)
+            return false;
+
+        header.tunerType = ReadBigEndian(src + 4);
+        header.gainCount = ReadBigEndian(src + 8);
+        return true;
+    }
+
+    inline void EncodeRtlTcpCommand(uint8_t (&dst)[kRtlTcpCommandSize], const RtlTcpCommand command, const uint32_t param)
+    {
+        dst[0] = command;
+        WriteBigEndian(dst + 1, param);
+    }
+}
+
+#endif //PORTSDR_RTLTCPPROTOCOL_H
@@ -0,0 +1,546 @@
+#include "RtlTcpServer.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <limits>
+#include <string>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "RtlTcpProtocol.h"
+#include "../dsp/Convert.h"
+
+#define DEFAULT_RING_SIZE (16 * 1024 * 1024)
+#define MAX_CLIENTS 16
+#define MAX_EVENTS 32
+
+static constexpr uint64_t kNotSending = std::numeric_limits<uint64_t>::max();
+
+struct PortSDR::RtlTcpServer::Client
+{
+    int fd = -1;
+    uint64_t cursor = 0;
+    bool writeInterest = false;
+
+    uint8_t header[kRtlTcpHeaderSize]{};
+    std::size_t headerSent = 0;
+
+    uint8_t command[kRtlTcpCommandSize]{};
+    std::size_t commandSize = 0;
+};
+
+static std::size_t RoundUpPowerOfTwo(const std::size_t value)
+{
+    std::size_t size = 1;
+    while (size < value)
+        size <<= 1;
+    return size;
+}
+
+PortSDR::RtlTcpServer::RtlTcpServer(Stream& stream)
+    : m_stream(stream), m_sendFrom(kNotSending), m_tunerType(kRtlTcpTunerR820T)
+{
+    SetBufferSize(DEFAULT_RING_SIZE);
+}
+
+PortSDR::RtlTcpServer::~RtlTcpServer()
+{
+    Stop();
+}
+
+void PortSDR::RtlTcpServer::SetTunerType(const uint32_t type)
+{
+    m_tunerType = type;
+}
+
+void PortSDR::RtlTcpServer::SetBufferSize(const std::size_t size)
+{
+    if (m_running)
+        return;
+
+    m_ring.resize(RoundUpPowerOfTwo(std::max<std::size_t>(size, 4096)));
+    m_ringMask = m_ring.size() - 1;
+}
+
+uint16_t PortSDR::RtlTcpServer::GetPort() const
+{
+    return m_port;
+}
+
+std::size_t PortSDR::RtlTcpServer::GetClientCount() const
+{
+    return m_clientCount;
+}
+
+uint64_t PortSDR::RtlTcpServer::GetDroppedSamples() const
+{
+    return m_dropped.load(std::memory_order_relaxed);
+}
+
+PortSDR::ErrorCode PortSDR::RtlTcpServer::Start(const std::string_view address, const uint16_t port)
+{
+    if (m_running)
+        return ErrorCode::INVALID_ARGUMENT;
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+
+    const std::string host(address);
+    if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1)
+        return ErrorCode::INVALID_ARGUMENT;
+
+    m_listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (m_listenFd < 0)
+        return ErrorCode::NETWORK_ERROR;
+
+    constexpr int enable = 1;
+    setsockopt(m_listenFd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+    if (bind(m_listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0
+        || listen(m_listenFd, MAX_CLIENTS) < 0)
+    {
+        Stop();
+        return ErrorCode::NETWORK_ERROR;
+    }
+
+    socklen_t addrLen = sizeof(addr);
+    getsockname(m_listenFd, reinterpret_cast<sockaddr*>(&addr), &addrLen);
+    m_port = ntohs(addr.sin_port);
+
+    m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+    m_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_epollFd < 0 || m_wakeFd < 0)
+    {
+        Stop();
+        return ErrorCode::NETWORK_ERROR;
+    }
+
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.ptr = &m_listenFd;
+    epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_listenFd, &ev);
+
+    ev.data.ptr = &m_wakeFd;
+    epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_wakeFd, &ev);
+
+    UpdateGainTable();
+
+    m_running = true;
+    m_thread = std::thread(&RtlTcpServer::Process, this);
+
+    m_stream.SetCallback([this](SDRTransfer& transfer)
+    {
+        OnTransfer(transfer);
+    });
+
+    const ErrorCode ret = m_stream.Start();
+    if (ret != ErrorCode::OK)
+    {
+        Stop();
+        return ret;
+    }
+
+    return ErrorCode::OK;
+}
+
+PortSDR::ErrorCode PortSDR::RtlTcpServer::Stop()
+{
+    if (m_running)
+    {
+        m_stream.Stop();
+        m_stream.SetCallback({});
+
+        m_running = false;
+
+        constexpr uint64_t one = 1;
+        [[maybe_unused]] const ssize_t ret = write(m_wakeFd, &one, sizeof(one));
+
+        if (m_thread.joinable())
+            m_thread.join();
+    }
+
+    for (const auto& client : m_clients)
+    {
+        if (client->fd >= 0)
+            close(client->fd);
+    }
+    m_clients.clear();
+    m_clientCount = 0;
+
+    for (int* fd : {&m_listenFd, &m_epollFd, &m_wakeFd})
+    {
+        if (*fd >= 0)
+            close(*fd);
+        *fd = -1;
+    }
+
+    m_port = 0;
+    return ErrorCode::OK;
+}
+
+void PortSDR::RtlTcpServer::OnTransfer(const SDRTransfer& transfer)
+{
+    const std::size_t count = transfer.frame_size * 2;
+
+    constexpr uint64_t one = 1;
+
+    // Only contended while the epoll thread grows the ring.
+    const std::unique_lock lock(m_ringMutex, std::try_to_lock);
+    if (!lock.owns_lock())
+    {
+        m_dropped.fetch_add(transfer.frame_size, std::memory_order_relaxed);
+        return;
+    }
+
+    // Anything larger than half of the ring could overwrite data being sent.
+    if (count > m_ring.size() / 2)
+    {
+        m_ringWanted.store(RoundUpPowerOfTwo(count * 2), std::memory_order_relaxed);
+        m_dropped.fetch_add(transfer.frame_size, std::memory_order_relaxed);
+
+        [[maybe_unused]] const ssize_t ret = write(m_wakeFd, &one, sizeof(one));
+        return;
+    }
+
+    const uint64_t head = m_head.load(std::memory_order_relaxed);
+
+    // Pairs with Flush(), either the sender sees this write or this sees the samples being sent.
+    m_writeEnd.store(head + count);
+    const uint64_t sendFrom = m_sendFrom.load();
+    if (sendFrom != kNotSending && head + count > sendFrom + m_ring.size())
+    {
+        m_writeEnd.store(head, std::memory_order_relaxed);
+        m_dropped.fetch_add(transfer.frame_size, std::memory_order_relaxed);
+        return;
+    }
+
+    // Both counts are even, a sample never wraps around. Planar transfers are interleaved in the same pass.
+    const std::size_t pos = head & m_ringMask;
+    const std::size_t first = std::min(count, m_ring.size() - pos);
+    ConvertTransfer(transfer, 0, m_ring.data() + pos, SAMPLE_FORMAT_IQ_UINT8, first / 2);
+    ConvertTransfer(transfer, first / 2, m_ring.data(), SAMPLE_FORMAT_IQ_UINT8, (count - first) / 2);
+
+    m_head.store(head + count, std::memory_order_release);
+
+    [[maybe_unused]] const ssize_t ret = write(m_wakeFd, &one, sizeof(one));
+}
+
+void PortSDR::RtlTcpServer::Process()
+{
+    epoll_event events[MAX_EVENTS];
+
+    while (m_running)
+    {
+        const int count = epoll_wait(m_epollFd, events, MAX_EVENTS, -1);
+        if (count < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        for (int i = 0; i < count; i++)
+        {
+            const epoll_event& ev = events[i];
+
+            if (ev.data.ptr == &m_listenFd)
+            {
+                Accept();
+            }
+            else if (ev.data.ptr == &m_wakeFd)
+            {
+                uint64_t value;
+                [[maybe_unused]] const ssize_t ret = read(m_wakeFd, &value, sizeof(value));
+
+                ResizeRing();
+
+                for (const auto& client : m_clients)
+                {
+                    if (!client->writeInterest)
+                        Flush(*client);
+                }
+            }
+            else
+            {
+                auto* client = static_cast<Client*>(ev.data.ptr);
+
+                if (ev.events & (EPOLLERR | EPOLLHUP) || (ev.events & EPOLLIN && !ReadCommands(*client)))
+                {
+                    RemoveClient(*client);
+                    continue;
+                }
+
+                if (ev.events & EPOLLOUT)
+                    Flush(*client);
+            }
+        }
+
+        m_clients.erase(std::remove_if(m_clients.begin(), m_clients.end(),
+                                       [](const std::unique_ptr<Client>& client)
+                                       {
+                                           return client->fd < 0;
+                                       }),
+                        m_clients.end());
+        m_clientCount = m_clients.size();
+    }
+}
+
+void PortSDR::RtlTcpServer::ResizeRing()
+{
+    const std::size_t size = m_ringWanted.exchange(0, std::memory_order_relaxed);
+    if (size <= m_ring.size())
+        return;
+
+    std::lock_guard lock(m_ringMutex);
+
+    m_ring.resize(size);
+    m_ringMask = m_ring.size() - 1;
+
+    // Positions map to other bytes of the larger ring, continue from the newest samples.
+    const uint64_t head = m_head.load(std::memory_order_relaxed);
+    for (const auto& client : m_clients)
+        client->cursor = head;
+}
+
+void PortSDR::RtlTcpServer::UpdateGainTable()
+{
+    // Advertise the gain table of the primary stage, RTL-SDR names it LNA.
+    const std::vector<Gain> stages = m_stream.GetGainStages(m_stream.GetGainMode());
+    const auto stage = std::find_if(stages.begin(), stages.end(),
+                                    [](const Gain& gain)
+                                    {
+                                        return gain.stage == "LNA";
+                                    });
+
+    m_gainStage.clear();
+    m_gains.clear();
+
+    if (stage != stages.end())
+    {
+        m_gainStage = stage->stage;
+        m_gains = stage->range.Values();
+    }
+    else if (!stages.empty())
+    {
+        m_gainStage = stages.front().stage;
+        m_gains = stages.front().range.Values();
+    }
+}
+
+void PortSDR::RtlTcpServer::Accept()
+{
+    while (true)
+    {
+        const int fd = accept4(m_listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+            return;
+
+        if (m_clients.size() >= MAX_CLIENTS)
+        {
+            close(fd);
+            continue;
+        }
+
+        constexpr int enable = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+        auto client = std::make_unique<Client>();
+        client->fd = fd;
+        client->cursor = m_head.load(std::memory_order_acquire);
+
+        const RtlTcpHeader header{m_tunerType, static_cast<uint32_t>(m_gains.size())};
+        EncodeRtlTcpHeader(client->header, header);
+
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.ptr = client.get();
+        epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &ev);
+
+        Flush(*client);
+
+        m_clients.emplace_back(std::move(client));
+        m_clientCount = m_clients.size();
+    }
+}
+
+void PortSDR::RtlTcpServer::Flush(Client& client)
+{
+    if (client.fd < 0)
+        return;
+
+    uint64_t head = m_head.load(std::memory_order_acquire);
+
+    while (true)
+    {
+        // Too far behind, the producer is about to overwrite what we would send.
+        if (head - client.cursor > m_ring.size() / 2)
+            client.cursor = head;
+
+        // Reserve the samples until sendmsg() returned, the producer drops transfers that would overwrite them.
+        m_sendFrom.store(client.cursor);
+        if (m_writeEnd.load() <= client.cursor + m_ring.size())
+            break;
+
+        // The producer started overwriting them before it saw the reservation.
+        head = m_head.load(std::memory_order_acquire);
+        client.cursor = head;
+    }
+
+    iovec iov[3];
+    int iovCount = 0;
+
+    const std::size_t headerLeft = kRtlTcpHeaderSize - client.headerSent;
+    if (headerLeft > 0)
+    {
+        iov[iovCount++] = {client.header + client.headerSent, headerLeft};
+    }
+
+    const std::size_t available = head - client.cursor;
+    const std::size_t pos = client.cursor & m_ringMask;
+    const std::size_t first = std::min(available, m_ring.size() - pos);
+
+    if (first > 0)
+        iov[iovCount++] = {m_ring.data() + pos, first};
+    if (available > first)
+        iov[iovCount++] = {m_ring.data(), available - first};
+
+    if (iovCount == 0)
+    {
+        m_sendFrom.store(kNotSending, std::memory_order_release);
+        SetWriteInterest(client, false);
+        return;
+    }
+
+    msghdr msg{};
+    msg.msg_iov = iov;
+    msg.msg_iovlen = iovCount;
+
+    const ssize_t sent = sendmsg(client.fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+    m_sendFrom.store(kNotSending, std::memory_order_release);
+
+    if (sent < 0)
+    {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+            SetWriteInterest(client, true);
+        else
+            RemoveClient(client);
+        return;
+    }
+
+    std::size_t remaining = sent;
+
+    const std::size_t headerPart = std::min(remaining, headerLeft);
+    client.headerSent += headerPart;
+    remaining -= headerPart;
+
+    client.cursor += remaining;
+
+    // Wait for the socket to drain if the kernel did not take everything.
+    SetWriteInterest(client, client.headerSent < kRtlTcpHeaderSize || client.cursor != head);
+}
+
+bool PortSDR::RtlTcpServer::ReadCommands(Client& client)
+{
+    while (true)
+    {
+        const ssize_t ret = recv(client.fd,
+                                 client.command + client.commandSize,
+                                 kRtlTcpCommandSize - client.commandSize,
+                                 MSG_DONTWAIT);
+        if (ret == 0)
+            return false;
+
+        if (ret < 0)
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+
+        client.commandSize += ret;
+        if (client.commandSize == kRtlTcpCommandSize)
+        {
+            HandleCommand(client.command[0], ReadBigEndian(client.command + 1));
+            client.commandSize = 0;
+        }
+    }
+}
+
+void PortSDR::RtlTcpServer::HandleCommand(const uint8_t command, const uint32_t param)
+{
+    switch (command)
+    {
+    case RTL_TCP_SET_FREQUENCY:
+        m_stream.SetCenterFrequency(param);
+        break;
+    case RTL_TCP_SET_SAMPLE_RATE:
+        m_stream.SetSampleRate(param);
+        break;
+    case RTL_TCP_SET_GAIN_MODE:
+        {
+            // 0 lets the hardware pick the gain of each stage, the closest are the modes with a single combined gain.
+            const std::vector<GainMode> modes = m_stream.GetGainModes();
+            const auto combined = std::find_if(modes.begin(), modes.end(),
+                                               [](const GainMode mode)
+                                               {
+                                                   return mode != GAIN_MODE_FREE;
+                                               });
+            const GainMode mode = param == 0 && combined != modes.end() ? *combined : GAIN_MODE_FREE;
+
+            if (m_stream.SetGainMode(mode) == ErrorCode::OK)
+                UpdateGainTable();
+            break;
+        }
+    case RTL_TCP_SET_GAIN:
+        {
+            if (m_gains.empty())
+                break;
+
+            // Gain is in tenths of a dB, pick the closest supported value.
+            const double gain = static_cast<int32_t>(param) / 10.0;
+            const auto closest = std::min_element(m_gains.begin(), m_gains.end(),
+                                                  [gain](const double a, const double b)
+                                                  {
+                                                      return std::abs(a - gain) < std::abs(b - gain);
+                                                  });
+            m_stream.SetGain(*closest, m_gainStage);
+            break;
+        }
+    case RTL_TCP_SET_GAIN_BY_INDEX:
+        if (param < m_gains.size())
+            m_stream.SetGain(m_gains[param], m_gainStage);
+        break;
+    default:
+        // Tuner specific commands have no equivalent in Stream.
+        break;
+    }
+}
+
+void PortSDR::RtlTcpServer::RemoveClient(Client& client)
+{
+    if (client.fd < 0)
+        return;
+
+    epoll_ctl(m_epollFd, EPOLL_CTL_DEL, client.fd, nullptr);
+    close(client.fd);
+
+    // Erased after the current batch of events, which may still point to it.
+    client.fd = -1;
+}
+
+void PortSDR::RtlTcpServer::SetWriteInterest(Client& client, const bool enabled) const
+{
+    if (client.fd < 0 || client.writeInterest == enabled)
+        return;
+
+    epoll_event ev{};
+    ev.events = enabled ? EPOLLIN | EPOLLOUT : EPOLLIN;
+    ev.data.ptr = &client;
+    epoll_ctl(m_epollFd, EPOLL_CTL_MOD, client.fd, &ev);
+
+    client.writeInterest = enabled;
+}
@@ -0,0 +1,121 @@
+#ifndef PORTSDR_BOUNDEDQUEUE_H
+#define PORTSDR_BOUNDEDQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace PortSDR
+{
+    /**
+     * Bounded lock-free queue for any amount of producers and consumers.
+     * Every cell carries a sequence number telling whether it is free for the
+     * producer of a position or filled for its consumer (Vyukov's design).
+     */
+    template <typename T>
+    class BoundedQueue
+    {
+    public:
+        /**
+         * @param capacity rounded up to a power of two.
+         */
+        explicit BoundedQueue(const std::size_t capacity)
+        {
+            std::size_t size = 2;
+            while (size < capacity)
+                size *= 2;
+
+            m_cells = std::make_unique<Cell[]>(size);
+            m_mask = size - 1;
+            for (std::size_t i = 0; i < size; i++)
+                m_cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+
+        bool TryPush(const T& value)
+        {
+            Cell* cell;
+            std::size_t pos = m_enqueue.load(std::memory_order_relaxed);
+            while (true)
+            {
+                cell = &m_cells[pos & m_mask];
+                const std::size_t sequence = cell->sequence.load(std::memory_order_acquire);
+                const auto diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+
+                if (diff == 0)
+                {
+                    if (m_enqueue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                }
+                else if (diff < 0)
+                {
+                    return false;
+                }
+                else
+                {
+                    pos = m_enqueue.load(std::memory_order_relaxed);
+                }
+            }
+
+            cell->value = value;
+            cell->sequence.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool TryPop(T& value)
+        {
+            Cell* cell;
+            std::size_t pos = m_dequeue.load(std::memory_order_relaxed);
+            while (true)
+            {
+                cell = &m_cells[pos & m_mask];
+                const std::size_t sequence = cell->sequence.load(std::memory_order_acquire);
+                const auto diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+
+                if (diff == 0)
+                {
+                    if (m_dequeue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                }
+                else if (diff < 0)
+                {
+                    return false;
+                }
+                else
+                {
+                    pos = m_dequeue.load(std::memory_order_relaxed);
+                }
+            }
+
+            value = cell->value;
+            cell->sequence.store(pos + m_mask + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * @return amount of values in the queue, only exact while nothing is pushed or popped.
+         */
+        [[nodiscard]] std::size_t Size() const
+        {
+            const std::size_t dequeue = m_dequeue.load(std::memory_order_acquire);
+            const std::size_t enqueue = m_enqueue.load(std::memory_order_acquire);
+            return enqueue > dequeue ? enqueue - dequeue : 0;
+        }
+
+    private:
+        struct Cell
+        {
+            std::atomic<std::size_t> sequence;
+            T value;
+        };
+
+        std::unique_ptr<Cell[]> m_cells;
+        std::size_t m_mask = 0;
+
+        // Producers and consumers on their own cache lines.
+        alignas(64) std::atomic<std::size_t> m_enqueue{0};
+        alignas(64) std::atomic<std::size_t> m_dequeue{0};
+    };
+}
+
+#endif //PORTSDR_BOUNDEDQUEUE_H
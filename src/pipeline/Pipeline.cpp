@@ -0,0 +1,288 @@
+#include "Pipeline.h"
+
+#include <algorithm>
+
+#include "BoundedQueue.h"
+#include "Trace.h"
+
+// Blocks kept for reuse, beyond that they are freed.
+#define PIPELINE_FREE_BLOCKS 256
+
+namespace PortSDR
+{
+    struct PipelineBlock
+    {
+        Buffer<uint8_t> data;
+        SDRTransfer transfer{};
+        std::vector<StreamTag> tags;
+        std::atomic<std::size_t> references{0};
+    };
+
+    struct PipelineBlockPool
+    {
+        BoundedQueue<PipelineBlock*> free{PIPELINE_FREE_BLOCKS};
+    };
+
+    struct PipelineStage
+    {
+        PipelineStage(std::string name, Pipeline::StageFunction function, const std::size_t queueDepth)
+            : name(std::move(name)), function(std::move(function)), queue(queueDepth)
+        {
+        }
+
+        std::string name;
+        Pipeline::StageFunction function;
+        std::vector<PipelineStage*> outputs;
+        BoundedQueue<PipelineBlock*> queue;
+
+        // Set while a task for the stage is submitted or running.
+        std::atomic<bool> scheduled{false};
+
+        std::atomic<uint64_t> blocks{0};
+        std::atomic<uint64_t> samples{0};
+        std::atomic<uint64_t> dropped{0};
+        std::atomic<uint64_t> busyNs{0};
+    };
+}
+
+void PortSDR::Emitter::Emit(const SDRTransfer& transfer)
+{
+    if (m_stage.outputs.empty())
+        return;
+
+    m_pipeline.Send(m_stage, m_pipeline.Acquire(transfer));
+}
+
+void PortSDR::Emitter::Forward()
+{
+    if (m_stage.outputs.empty())
+        return;
+
+    m_input->references.fetch_add(1, std::memory_order_relaxed);
+    m_pipeline.Send(m_stage, m_input);
+}
+
+PortSDR::Pipeline::Pipeline(ThreadPool& pool, const std::size_t batch)
+    : m_pool(pool), m_batch(std::max<std::size_t>(1, batch)), m_blocks(std::make_unique<PipelineBlockPool>())
+{
+}
+
+PortSDR::Pipeline::~Pipeline()
+{
+    // Waits for a running callback, so nothing is pushed once it returns.
+    if (m_source)
+        m_source->SetCallback({});
+    Stop();
+
+    PipelineBlock* block;
+    while (m_blocks->free.TryPop(block))
+        delete block;
+}
+
+PortSDR::Pipeline::StageId PortSDR::Pipeline::AddStage(const std::string_view name,
+                                                       StageFunction function,
+                                                       const std::size_t queueDepth)
+{
+    m_stages.push_back(std::make_unique<PipelineStage>(std::string(name), std::move(function), queueDepth));
+    return m_stages.size() - 1;
+}
+
+PortSDR::ErrorCode PortSDR::Pipeline::Connect(const StageId from, const StageId to)
+{
+    if (m_running || from >= m_stages.size() || to >= m_stages.size() || from == to)
+        return ErrorCode::INVALID_ARGUMENT;
+
+    m_stages[from]->outputs.push_back(m_stages[to].get());
+    return ErrorCode::OK;
+}
+
+PortSDR::ErrorCode PortSDR::Pipeline::SetSource(Stream& stream, const StageId stage)
+{
+    if (stage >= m_stages.size())
+        return ErrorCode::INVALID_ARGUMENT;
+
+    if (m_source && m_source != &stream)
+        m_source->SetCallback({});
+
+    stream.SetCallback([this, stage](SDRTransfer& transfer)
+    {
+        Push(stage, transfer);
+    });
+    m_source = &stream;
+    return ErrorCode::OK;
+}
+
+PortSDR::ErrorCode PortSDR::Pipeline::Push(const StageId stage, const SDRTransfer& transfer)
+{
+    if (stage >= m_stages.size())
+        return ErrorCode::INVALID_ARGUMENT;
+
+    // Counted as active, so Stop() can't return while the transfer is being queued.
+    m_active.fetch_add(1);
+    if (!m_running.load())
+    {
+        Leave();
+        return ErrorCode::STOPPED;
+    }
+
+    Enqueue(*m_stages[stage], Acquire(transfer));
+    Leave();
+    return ErrorCode::OK;
+}
+
+PortSDR::ErrorCode PortSDR::Pipeline::Start()
+{
+    if (m_running)
+        return ErrorCode::OK;
+
+    for (const auto& stage : m_stages)
+    {
+        stage->blocks = 0;
+        stage->samples = 0;
+        stage->dropped = 0;
+        stage->busyNs = 0;
+    }
+
+    m_start = std::chrono::steady_clock::now();
+    m_running = true;
+    return ErrorCode::OK;
+}
+
+void PortSDR::Pipeline::Stop()
+{
+    m_running.store(false);
+
+    // Queued blocks keep flowing through the stages until every stage is idle.
+    std::unique_lock lock(m_idleMutex);
+    m_idleCond.wait(lock, [this] { return m_active.load(std::memory_order_acquire) == 0; });
+}
+
+std::vector<PortSDR::StageStats> PortSDR::Pipeline::GetStats() const
+{
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+
+    std::vector<StageStats> stats;
+    for (const auto& stage : m_stages)
+    {
+        StageStats stat{};
+        stat.name = stage->name;
+        stat.blocks = stage->blocks.load(std::memory_order_relaxed);
+        stat.samples = stage->samples.load(std::memory_order_relaxed);
+        stat.dropped = stage->dropped.load(std::memory_order_relaxed);
+        stat.queue_depth = stage->queue.Size();
+        if (elapsed > 0)
+        {
+            stat.samples_per_second = static_cast<double>(stat.samples) / elapsed;
+            stat.busy = static_cast<double>(stage->busyNs.load(std::memory_order_relaxed)) / 1e9 / elapsed;
+        }
+        stats.push_back(std::move(stat));
+    }
+    return stats;
+}
+
+PortSDR::PipelineBlock* PortSDR::Pipeline::Acquire(const SDRTransfer& transfer)
+{
+    PipelineBlock* block;
+    if (!m_blocks->free.TryPop(block))
+        block = new PipelineBlock();
+
+    // The buffers keep their size, so after the first blocks nothing is allocated anymore.
+    const std::size_t size = transfer.frame_size * GetSampleSize(transfer.format);
+    block->data.resize(size);
+    ConvertTransfer(transfer, 0, block->data.data(), transfer.format, transfer.frame_size);
+
+    // Stages always see interleaved samples.
+    block->transfer = transfer;
+    block->transfer.data = block->data.data();
+    block->transfer.data_q = nullptr;
+    block->transfer.layout = SAMPLE_LAYOUT_INTERLEAVED;
+    block->transfer.health = nullptr;
+    block->tags.assign(transfer.tags, transfer.tags + transfer.tag_count);
+    block->transfer.tags = block->tags.empty() ? nullptr : block->tags.data();
+    block->references.store(1, std::memory_order_relaxed);
+    return block;
+}
+
+void PortSDR::Pipeline::Release(PipelineBlock* block)
+{
+    if (block->references.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+
+    if (!m_blocks->free.TryPush(block))
+        delete block;
+}
+
+void PortSDR::Pipeline::Send(PipelineStage& from, PipelineBlock* block)
+{
+    // One reference for every stage it goes to, the caller already holds one.
+    block->references.fetch_add(from.outputs.size() - 1, std::memory_order_relaxed);
+    for (PipelineStage* stage : from.outputs)
+        Enqueue(*stage, block);
+}
+
+void PortSDR::Pipeline::Enqueue(PipelineStage& stage, PipelineBlock* block)
+{
+    if (!stage.queue.TryPush(block))
+    {
+        stage.dropped.fetch_add(block->transfer.frame_size, std::memory_order_relaxed);
+        PORTSDR_TRACE_INSTANT("pipeline_drop", block->transfer.frame_size);
+        Release(block);
+        return;
+    }
+
+    // Pairs with the fence in Run(), either this sees the stage idle or Run() sees the block.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    Schedule(stage);
+}
+
+void PortSDR::Pipeline::Schedule(PipelineStage& stage)
+{
+    if (stage.scheduled.exchange(true, std::memory_order_acq_rel))
+        return;
+
+    m_active.fetch_add(1, std::memory_order_acq_rel);
+    m_pool.Submit([this, &stage]
+    {
+        Run(stage);
+    });
+}
+
+void PortSDR::Pipeline::Run(PipelineStage& stage)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    PipelineBlock* block;
+    std::size_t count = 0;
+    while (count < m_batch && stage.queue.TryPop(block))
+    {
+        Emitter emitter(*this, stage, block);
+        stage.function(block->transfer, emitter);
+
+        stage.blocks.fetch_add(1, std::memory_order_relaxed);
+        stage.samples.fetch_add(block->transfer.frame_size, std::memory_order_relaxed);
+        Release(block);
+        count++;
+    }
+
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    stage.busyNs.fetch_add(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()),
+                           std::memory_order_relaxed);
+
+    stage.scheduled.store(false, std::memory_order_release);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    // Blocks pushed while the stage was still marked as scheduled, or left over from the batch.
+    if (stage.queue.Size() > 0)
+        Schedule(stage);
+
+    Leave();
+}
+
+void PortSDR::Pipeline::Leave()
+{
+    if (m_active.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        std::lock_guard lock(m_idleMutex);
+        m_idleCond.notify_all();
+    }
+}
@@ -0,0 +1,102 @@
+#include "Pipeline.h"
+
+#include <algorithm>
+
+namespace
+{
+    // Queue of the pool thread running the caller, if any.
+    thread_local const PortSDR::ThreadPool* tPool = nullptr;
+    thread_local std::size_t tIndex = 0;
+}
+
+PortSDR::ThreadPool::ThreadPool(std::size_t threads)
+{
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    for (std::size_t i = 0; i < threads; i++)
+        m_queues.push_back(std::make_unique<Queue>());
+
+    for (std::size_t i = 0; i < threads; i++)
+        m_threads.emplace_back(&ThreadPool::Worker, this, i);
+}
+
+PortSDR::ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard lock(m_mutex);
+        m_running = false;
+    }
+    m_cond.notify_all();
+
+    for (std::thread& thread : m_threads)
+        thread.join();
+}
+
+void PortSDR::ThreadPool::Submit(Task task)
+{
+    // Tasks of a pool thread stay local, others are spread over the threads.
+    const std::size_t index = tPool == this
+                                  ? tIndex
+                                  : m_next.fetch_add(1, std::memory_order_relaxed) % m_queues.size();
+    {
+        std::lock_guard lock(m_queues[index]->mutex);
+        m_queues[index]->tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard lock(m_mutex);
+        m_pending++;
+    }
+    m_cond.notify_one();
+}
+
+bool PortSDR::ThreadPool::TryPop(const std::size_t index, Task& task)
+{
+    // Newest task of its own first, it likely still has the data in cache.
+    {
+        Queue& own = *m_queues[index];
+        std::lock_guard lock(own.mutex);
+        if (!own.tasks.empty())
+        {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+
+    for (std::size_t i = 1; i < m_queues.size(); i++)
+    {
+        Queue& victim = *m_queues[(index + i) % m_queues.size()];
+        std::lock_guard lock(victim.mutex);
+        if (!victim.tasks.empty())
+        {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void PortSDR::ThreadPool::Worker(const std::size_t index)
+{
+    tPool = this;
+    tIndex = index;
+
+    while (true)
+    {
+        {
+            std::unique_lock lock(m_mutex);
+            m_cond.wait(lock, [this] { return m_pending > 0 || !m_running; });
+            if (m_pending == 0)
+                return;
+            m_pending--;
+        }
+
+        // The task may already have been taken by another thread, the count only says one exists.
+        Task task;
+        while (!TryPop(index, task))
+            std::this_thread::yield();
+        task();
+    }
+}
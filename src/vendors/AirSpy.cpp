@@ -4,11 +4,16 @@
 
 #include "AirSpy.h"
 
-#include <cassert>
+#include <algorithm>
 
 #include "libairspy/airspy.h"
 
+#include "Trace.h"
 #include "../Utils.h"
+#include "VendorLibrary.h"
+#include "../dsp/Convert.h"
+#include "../dsp/Level.h"
+#include "../dsp/Unpack.h"
 
 #define AIRSPY_MAX_DEVICE 32
 
@@ -29,7 +34,79 @@ static PortSDR::ErrorCode ConvertRetToErrorCode(const int airspy)
     }
 }
 
-PortSDR::AirSpyHost::AirSpyHost() : Host(HostType::AIRSPY)
+#ifdef _WIN32
+#define AIRSPY_LIBRARY_NAMES {"airspy.dll", "libairspy.dll"}
+#elif defined(__APPLE__)
+#define AIRSPY_LIBRARY_NAMES {"libairspy.0.dylib", "libairspy.dylib"}
+#else
+#define AIRSPY_LIBRARY_NAMES {"libairspy.so.0", "libairspy.so"}
+#endif
+
+#ifdef AIRSPY_LINKED
+static std::unique_ptr<PortSDR::AirSpyApi> LoadApi()
+{
+    // Built from source as a static library and linked in, there is nothing to load.
+    auto api = std::make_unique<PortSDR::AirSpyApi>();
+    api->list_devices = airspy_list_devices;
+    api->open_sn = airspy_open_sn;
+    api->close = airspy_close;
+    api->board_id_read = airspy_board_id_read;
+    api->board_id_name = airspy_board_id_name;
+    api->board_partid_serialno_read = airspy_board_partid_serialno_read;
+    api->get_samplerates = airspy_get_samplerates;
+    api->set_samplerate = airspy_set_samplerate;
+    api->set_sample_type = airspy_set_sample_type;
+    api->set_packing = airspy_set_packing;
+    api->set_freq = airspy_set_freq;
+    api->set_lna_gain = airspy_set_lna_gain;
+    api->set_mixer_gain = airspy_set_mixer_gain;
+    api->set_vga_gain = airspy_set_vga_gain;
+    api->set_linearity_gain = airspy_set_linearity_gain;
+    api->set_sensitivity_gain = airspy_set_sensitivity_gain;
+    api->start_rx = airspy_start_rx;
+    api->stop_rx = airspy_stop_rx;
+    api->is_streaming = airspy_is_streaming;
+    return api;
+}
+#else
+static std::unique_ptr<PortSDR::AirSpyApi> LoadApi()
+{
+    PortSDR::VendorLibrary library;
+    if (!library.Open(AIRSPY_LIBRARY_NAMES))
+        return nullptr;
+
+    auto api = std::make_unique<PortSDR::AirSpyApi>();
+    const bool resolved = library.Resolve("airspy_list_devices", api->list_devices)
+        && library.Resolve("airspy_open_sn", api->open_sn)
+        && library.Resolve("airspy_close", api->close)
+        && library.Resolve("airspy_board_id_read", api->board_id_read)
+        && library.Resolve("airspy_board_id_name", api->board_id_name)
+        && library.Resolve("airspy_board_partid_serialno_read", api->board_partid_serialno_read)
+        && library.Resolve("airspy_get_samplerates", api->get_samplerates)
+        && library.Resolve("airspy_set_samplerate", api->set_samplerate)
+        && library.Resolve("airspy_set_sample_type", api->set_sample_type)
+        && library.Resolve("airspy_set_packing", api->set_packing)
+        && library.Resolve("airspy_set_freq", api->set_freq)
+        && library.Resolve("airspy_set_lna_gain", api->set_lna_gain)
+        && library.Resolve("airspy_set_mixer_gain", api->set_mixer_gain)
+        && library.Resolve("airspy_set_vga_gain", api->set_vga_gain)
+        && library.Resolve("airspy_set_linearity_gain", api->set_linearity_gain)
+        && library.Resolve("airspy_set_sensitivity_gain", api->set_sensitivity_gain)
+        && library.Resolve("airspy_start_rx", api->start_rx)
+        && library.Resolve("airspy_stop_rx", api->stop_rx)
+        && library.Resolve("airspy_is_streaming", api->is_streaming);
+
+    return resolved ? std::move(api) : nullptr;
+}
+#endif
+
+const PortSDR::AirSpyApi* PortSDR::AirSpyApi::Get()
+{
+    static const std::unique_ptr<AirSpyApi> api = LoadApi();
+    return api.get();
+}
+
+PortSDR::AirSpyHost::AirSpyHost(const AirSpyApi& api) : Host(HostType::AIRSPY), m_api(api)
 {
 }
 
@@ -38,7 +115,7 @@ std::vector<PortSDR::Device> PortSDR::AirSpyHost::AvailableDevices() const
     std::vector<Device> devices;
 
     uint64_t serials[AIRSPY_MAX_DEVICE + 1];
-    int device_count = airspy_list_devices(serials, AIRSPY_MAX_DEVICE);
+    int device_count = m_api.list_devices(serials, AIRSPY_MAX_DEVICE);
     if (device_count < 0)
         return {};
 
@@ -57,13 +134,20 @@ std::vector<PortSDR::Device> PortSDR::AirSpyHost::AvailableDevices() const
 
 std::unique_ptr<PortSDR::StreamImpl> PortSDR::AirSpyHost::CreateStream() const
 {
-    return std::make_unique<AirSpyStream>();
+    return std::make_unique<AirSpyStream>(m_api);
+}
+
+PortSDR::AirSpyStream::AirSpyStream(const AirSpyApi& api) : m_api(api)
+{
 }
 
 PortSDR::AirSpyStream::~AirSpyStream()
 {
+    StopCommands();
+    DisableRecovery();
+
     if (m_device)
-        airspy_close(m_device);
+        m_api.close(m_device);
 }
 
 PortSDR::ErrorCode PortSDR::AirSpyStream::Initialize(const Device& device)
@@ -79,35 +163,48 @@ PortSDR::ErrorCode PortSDR::AirSpyStream::Initialize(const Device& device)
         nullptr,
         16);
 
-    int ret = airspy_open_sn(&m_device, num);
+    int ret = m_api.open_sn(&m_device, num);
     if (ret != AIRSPY_SUCCESS)
+    {
+        m_device = nullptr;
         return ConvertRetToErrorCode(ret);
+    }
+
+    m_serial = num;
 
     ErrorCode code = SetSampleFormat(SAMPLE_FORMAT_IQ_INT16);
     if (code != ErrorCode::OK)
         return code;
 
+    // Reopen() opens the same device again, so these stay valid.
+    m_usbStrings = QueryUSBStrings();
+    m_sampleRates = QuerySampleRates();
     return ErrorCode::OK;
 }
 
 PortSDR::DeviceInfo PortSDR::AirSpyStream::GetUSBStrings()
+{
+    return m_usbStrings;
+}
+
+PortSDR::DeviceInfo PortSDR::AirSpyStream::QueryUSBStrings() const
 {
     DeviceInfo device;
 
     uint8_t board_id;
     airspy_read_partid_serialno_t read_partid_serialno;
 
-    if (airspy_board_id_read(
+    if (m_api.board_id_read(
         m_device, &board_id) == AIRSPY_SUCCESS)
     {
-        device.name = airspy_board_id_name(static_cast<airspy_board_id>(board_id));
+        device.name = m_api.board_id_name(static_cast<airspy_board_id>(board_id));
     }
     else
     {
         device.name = "AIRSPY";
     }
 
-    if (airspy_board_partid_serialno_read(
+    if (m_api.board_partid_serialno_read(
         m_device, &read_partid_serialno) == AIRSPY_SUCCESS)
     {
         device.serial = string_format("%08X%08X",
@@ -121,45 +218,121 @@ PortSDR::DeviceInfo PortSDR::AirSpyStream::GetUSBStrings()
 
 PortSDR::ErrorCode PortSDR::AirSpyStream::Start()
 {
+    PORTSDR_TRACE_SCOPE("start");
+
+    std::lock_guard lock(m_controlMutex);
+
     if (!m_device)
         return ErrorCode::INVALID_ARGUMENT;
 
-    return ConvertRetToErrorCode(airspy_start_rx(m_device, AirSpySDRCallback, this));
+    m_converter.Reset();
+
+    const int ret = m_api.start_rx(m_device, AirSpySDRCallback, this);
+    if (ret == AIRSPY_SUCCESS)
+        m_streaming = true;
+    return ConvertRetToErrorCode(ret);
 }
 
 PortSDR::ErrorCode PortSDR::AirSpyStream::Stop()
 {
-    if (!m_device)
-        return ErrorCode::INVALID_ARGUMENT;
+    PORTSDR_TRACE_SCOPE("stop");
 
-    if (airspy_is_streaming(m_device) != AIRSPY_TRUE)
+    std::lock_guard lock(m_controlMutex);
+
+    // libairspy stops streaming on its own when the device is unplugged.
+    if (!m_streaming)
         return ErrorCode::INVALID_ARGUMENT;
 
-    return ConvertRetToErrorCode(airspy_stop_rx(m_device));
+    CancelReads();
+    m_streaming = false;
+
+    if (!m_device)
+        return ErrorCode::OK;
+    return ConvertRetToErrorCode(m_api.stop_rx(m_device));
+}
+
+PortSDR::ErrorCode PortSDR::AirSpyStream::Reopen()
+{
+    std::lock_guard lock(m_controlMutex);
+
+    if (!m_streaming)
+        return ErrorCode::STOPPED;
+
+    if (m_device)
+    {
+        m_api.stop_rx(m_device);
+        m_api.close(m_device);
+        m_device = nullptr;
+    }
+
+    int ret = m_api.open_sn(&m_device, m_serial);
+    if (ret != AIRSPY_SUCCESS)
+    {
+        m_device = nullptr;
+        return ConvertRetToErrorCode(ret);
+    }
+
+    ret = m_api.set_packing(m_device, m_packing ? 1 : 0);
+    if (ret == AIRSPY_SUCCESS)
+        ret = m_api.set_sample_type(m_device, GetDeviceSampleType(m_packing, m_libraryDdc));
+    if (ret == AIRSPY_SUCCESS && m_sampleRate != 0)
+        ret = m_api.set_samplerate(m_device, m_sampleRate);
+    if (ret == AIRSPY_SUCCESS && m_freq != 0)
+        ret = m_api.set_freq(m_device, m_freq);
+
+    if (m_gainMode == GAIN_MODE_FREE)
+    {
+        if (ret == AIRSPY_SUCCESS && m_lnaGain >= 0)
+            ret = m_api.set_lna_gain(m_device, m_lnaGain);
+        if (ret == AIRSPY_SUCCESS && m_mixGain >= 0)
+            ret = m_api.set_mixer_gain(m_device, m_mixGain);
+        if (ret == AIRSPY_SUCCESS && m_ifGain >= 0)
+            ret = m_api.set_vga_gain(m_device, m_ifGain);
+    }
+    else if (ret == AIRSPY_SUCCESS && m_gain >= 0)
+    {
+        ret = m_gainMode == GAIN_MODE_LINEARITY
+                  ? m_api.set_linearity_gain(m_device, m_gain)
+                  : m_api.set_sensitivity_gain(m_device, m_gain);
+    }
+
+    if (ret != AIRSPY_SUCCESS)
+        return ConvertRetToErrorCode(ret);
+
+    m_converter.Reset();
+    return ConvertRetToErrorCode(m_api.start_rx(m_device, AirSpySDRCallback, this));
 }
 
 PortSDR::ErrorCode PortSDR::AirSpyStream::SetCenterFrequency(uint32_t freq)
 {
+    PORTSDR_TRACE_SCOPE_VALUE("retune", freq);
+
+    std::lock_guard lock(m_controlMutex);
+
     if (!m_device)
         return ErrorCode::INVALID_ARGUMENT;
 
-    int ret = airspy_set_freq(m_device, freq);
+    int ret = m_api.set_freq(m_device, freq);
     if (ret == AIRSPY_SUCCESS)
     {
         m_freq = freq;
+        PostTag(STREAM_TAG_FREQUENCY, freq);
     }
     return ConvertRetToErrorCode(ret);
 }
 
 PortSDR::ErrorCode PortSDR::AirSpyStream::SetSampleRate(uint32_t sampleRate)
 {
+    std::lock_guard lock(m_controlMutex);
+
     if (!m_device)
         return ErrorCode::INVALID_ARGUMENT;
 
-    int ret = airspy_set_samplerate(m_device, sampleRate);
+    int ret = m_api.set_samplerate(m_device, sampleRate);
     if (ret == AIRSPY_SUCCESS)
     {
         m_sampleRate = sampleRate;
+        PostTag(STREAM_TAG_SAMPLE_RATE, sampleRate);
     }
 
     return ConvertRetToErrorCode(ret);
@@ -167,6 +340,11 @@ PortSDR::ErrorCode PortSDR::AirSpyStream::SetSampleRate(uint32_t sampleRate)
 
 PortSDR::ErrorCode PortSDR::AirSpyStream::SetSampleFormat(SampleFormat format)
 {
+    if (CheckSampleFormat(format) != ErrorCode::OK)
+        return ErrorCode::INVALID_ARGUMENT;
+
+    std::lock_guard lock(m_controlMutex);
+
     if (!m_device)
         return ErrorCode::UNINITIALIZED;
 
@@ -174,54 +352,144 @@ PortSDR::ErrorCode PortSDR::AirSpyStream::SetSampleFormat(SampleFormat format)
     if (sampleType == AIRSPY_SAMPLE_END)
         return ErrorCode::INVALID_ARGUMENT; // Invalid sample format
 
-    const int ret = airspy_set_sample_type(m_device, sampleType);
+    if (m_packing || m_libraryDdc)
+    {
+        // Real samples are converted by the library.
+        m_sampleType = format;
+        PostTag(STREAM_TAG_FORMAT, format);
+        return ErrorCode::OK;
+    }
+
+    const int ret = m_api.set_sample_type(m_device, sampleType);
     if (ret != AIRSPY_SUCCESS)
         return ConvertRetToErrorCode(ret);
 
     m_sampleType = format;
+    PostTag(STREAM_TAG_FORMAT, format);
     return ErrorCode::OK;
 }
 
 PortSDR::ErrorCode PortSDR::AirSpyStream::SetLnaGain(double gain)
 {
-    assert(m_device);
+    std::lock_guard lock(m_controlMutex);
+
+    if (!m_device)
+        return ErrorCode::INVALID_ARGUMENT;
 
-    int ret = airspy_set_lna_gain(m_device, static_cast<uint8_t>(gain));
+    const uint8_t value = static_cast<uint8_t>(gain);
+    int ret = m_api.set_lna_gain(m_device, value);
     if (ret == AIRSPY_SUCCESS)
     {
-        m_lnaGain = static_cast<uint8_t>(gain);
+        m_lnaGain = value;
+        PostTag(STREAM_TAG_GAIN, value, "LNA");
     }
     return ConvertRetToErrorCode(ret);
 }
 
 PortSDR::ErrorCode PortSDR::AirSpyStream::SetMixGain(double gain)
 {
+    std::lock_guard lock(m_controlMutex);
+
     if (!m_device)
         return ErrorCode::INVALID_ARGUMENT;
 
-    int ret = airspy_set_mixer_gain(m_device, static_cast<uint8_t>(gain));
+    const uint8_t value = static_cast<uint8_t>(gain);
+    int ret = m_api.set_mixer_gain(m_device, value);
     if (ret == AIRSPY_SUCCESS)
     {
-        m_mixGain = static_cast<uint8_t>(gain);
+        m_mixGain = value;
+        PostTag(STREAM_TAG_GAIN, value, "MIX");
     }
     return ConvertRetToErrorCode(ret);
 }
 
 PortSDR::ErrorCode PortSDR::AirSpyStream::SetIfGain(double gain)
 {
-    assert(m_device);
+    std::lock_guard lock(m_controlMutex);
 
-    int ret = airspy_set_vga_gain(m_device, static_cast<uint8_t>(gain));
+    if (!m_device)
+        return ErrorCode::INVALID_ARGUMENT;
+
+    const uint8_t value = static_cast<uint8_t>(gain);
+    int ret = m_api.set_vga_gain(m_device, value);
     if (ret == AIRSPY_SUCCESS)
     {
-        m_ifGain = static_cast<uint8_t>(gain);
+        m_ifGain = value;
+        PostTag(STREAM_TAG_GAIN, value, "IF");
     }
     return ConvertRetToErrorCode(ret);
 }
 
+PortSDR::ErrorCode PortSDR::AirSpyStream::SetPacking(const bool enabled)
+{
+    std::lock_guard lock(m_controlMutex);
+
+    if (!m_device)
+        return ErrorCode::UNINITIALIZED;
+
+    if (m_api.is_streaming(m_device) == AIRSPY_TRUE)
+        return ErrorCode::INVALID_ARGUMENT;
+
+    int ret = m_api.set_packing(m_device, enabled ? 1 : 0);
+    if (ret != AIRSPY_SUCCESS)
+        return ConvertRetToErrorCode(ret);
+
+    ret = m_api.set_sample_type(m_device, GetDeviceSampleType(enabled, m_libraryDdc));
+    if (ret != AIRSPY_SUCCESS)
+        return ConvertRetToErrorCode(ret);
+
+    m_packing = enabled;
+    return ErrorCode::OK;
+}
+
+PortSDR::ErrorCode PortSDR::AirSpyStream::SetLibraryDdc(const bool enabled)
+{
+    std::lock_guard lock(m_controlMutex);
+
+    if (!m_device)
+        return ErrorCode::UNINITIALIZED;
+
+    if (m_api.is_streaming(m_device) == AIRSPY_TRUE)
+        return ErrorCode::INVALID_ARGUMENT;
+
+    const int ret = m_api.set_sample_type(m_device, GetDeviceSampleType(m_packing, enabled));
+    if (ret != AIRSPY_SUCCESS)
+        return ConvertRetToErrorCode(ret);
+
+    m_libraryDdc = enabled;
+    return ErrorCode::OK;
+}
+
+PortSDR::ErrorCode PortSDR::AirSpyStream::SetSetting(std::string_view key, std::string_view value)
+{
+    bool enabled;
+    if (value == "true" || value == "1")
+        enabled = true;
+    else if (value == "false" || value == "0")
+        enabled = false;
+    else
+        return ErrorCode::INVALID_ARGUMENT;
+
+    if ("packing" == key)
+        return SetPacking(enabled);
+    if ("library_ddc" == key)
+        return SetLibraryDdc(enabled);
+    return ErrorCode::INVALID_ARGUMENT;
+}
+
+std::string PortSDR::AirSpyStream::GetSetting(std::string_view key) const
+{
+    if ("packing" == key)
+        return m_packing ? "true" : "false";
+    if ("library_ddc" == key)
+        return m_libraryDdc ? "true" : "false";
+    return {};
+}
 
 PortSDR::ErrorCode PortSDR::AirSpyStream::SetRegularGain(const double gain)
 {
+    std::lock_guard lock(m_controlMutex);
+
     if (!m_device)
         return ErrorCode::INVALID_ARGUMENT;
 
@@ -230,22 +498,27 @@ PortSDR::ErrorCode PortSDR::AirSpyStream::SetRegularGain(const double gain)
     int ret = AIRSPY_ERROR_INVALID_PARAM;
     if (m_gainMode == GAIN_MODE_LINEARITY)
     {
-        ret = airspy_set_linearity_gain(m_device, uint_gain);
+        ret = m_api.set_linearity_gain(m_device, uint_gain);
     }
     else if (m_gainMode == GAIN_MODE_SENSITIVITY)
     {
-        ret = airspy_set_sensitivity_gain(m_device, uint_gain);
+        ret = m_api.set_sensitivity_gain(m_device, uint_gain);
     }
 
     if (ret == AIRSPY_SUCCESS)
     {
         m_gain = uint_gain;
+        PostTag(STREAM_TAG_GAIN, uint_gain, "Regular");
     }
     return ErrorCode::OK;
 }
 
 PortSDR::ErrorCode PortSDR::AirSpyStream::SetGain(double gain, std::string_view name)
 {
+    PORTSDR_TRACE_SCOPE_VALUE("gain", gain * 10);
+
+    std::lock_guard lock(m_controlMutex);
+
     if (!m_device)
         return ErrorCode::UNINITIALIZED;
 
@@ -275,19 +548,22 @@ PortSDR::ErrorCode PortSDR::AirSpyStream::SetGainMode(const GainMode mode)
         && mode != GAIN_MODE_SENSITIVITY)
         return ErrorCode::INVALID_ARGUMENT;
 
+    std::lock_guard lock(m_controlMutex);
     m_gainMode = mode;
     return ErrorCode::OK;
 }
 
 std::vector<uint32_t> PortSDR::AirSpyStream::GetSampleRates() const
 {
-    if (!m_device)
-        return {};
+    return m_sampleRates;
+}
 
+std::vector<uint32_t> PortSDR::AirSpyStream::QuerySampleRates() const
+{
     std::vector<uint32_t> sampleRates;
     uint32_t count;
 
-    int ret = airspy_get_samplerates(m_device, &count, 0);
+    int ret = m_api.get_samplerates(m_device, &count, 0);
     if (ret != AIRSPY_SUCCESS)
     {
         return {};
@@ -296,7 +572,7 @@ std::vector<uint32_t> PortSDR::AirSpyStream::GetSampleRates() const
     if (count > 0)
     {
         sampleRates.resize(count);
-        airspy_get_samplerates(m_device, sampleRates.data(), count);
+        m_api.get_samplerates(m_device, sampleRates.data(), count);
     }
 
     return sampleRates;
@@ -331,6 +607,11 @@ std::vector<PortSDR::Gain> PortSDR::AirSpyStream::GetGainStages(const GainMode m
     return ranges;
 }
 
+std::string PortSDR::AirSpyStream::GetTunerType() const
+{
+    return "R820T2";
+}
+
 std::vector<PortSDR::SampleFormat> PortSDR::AirSpyStream::GetSampleFormats() const
 {
     return {SAMPLE_FORMAT_IQ_INT16, SAMPLE_FORMAT_IQ_FLOAT32};
@@ -348,15 +629,16 @@ uint32_t PortSDR::AirSpyStream::GetSampleRate() const
 
 double PortSDR::AirSpyStream::GetGain(std::string_view name) const
 {
+    int gain = -1;
     if (name == "LNA")
-        return m_lnaGain;
-    if (name == "MIX")
-        return m_mixGain;
-    if (name == "IF")
-        return m_ifGain;
-    if (name == "Regular")
-        return m_gain;
-    return 0.0;
+        gain = m_lnaGain;
+    else if (name == "MIX")
+        gain = m_mixGain;
+    else if (name == "IF")
+        gain = m_ifGain;
+    else if (name == "Regular")
+        gain = m_gain;
+    return std::max(gain, 0);
 }
 
 PortSDR::GainMode PortSDR::AirSpyStream::GetGainMode() const
@@ -377,9 +659,71 @@ airspy_sample_type PortSDR::AirSpyStream::ConvertToSampleType(const SampleFormat
     }
 }
 
+airspy_sample_type PortSDR::AirSpyStream::GetDeviceSampleType(const bool packing, const bool libraryDdc) const
+{
+    if (packing)
+        return AIRSPY_SAMPLE_RAW;
+    if (libraryDdc)
+        return AIRSPY_SAMPLE_INT16_REAL;
+    return ConvertToSampleType(m_sampleType);
+}
+
+void PortSDR::AirSpyStream::ProcessReal(const airspy_transfer* transfer)
+{
+    // Two real samples per IQ sample, packed samples come in groups of 8.
+    const std::size_t count = transfer->sample_count & ~static_cast<std::size_t>(7);
+    const std::size_t frames = count / 2;
+
+    const auto* real = static_cast<const int16_t*>(transfer->samples);
+    if (m_packing)
+    {
+        m_unpacked.resize(count);
+        UnpackAirSpy12(static_cast<const uint8_t*>(transfer->samples), m_unpacked.data(), count);
+        real = m_unpacked.data();
+    }
+
+    const SampleFormat format = m_sampleType;
+
+    SDRTransfer sdr_transfer{};
+    sdr_transfer.frame_size = frames;
+    sdr_transfer.dropped_samples = transfer->dropped_samples / 2;
+    sdr_transfer.format = format;
+
+    // The converter writes I and Q on their own anyway, so planes cost nothing extra.
+    if (IsPlanar())
+    {
+        PreparePlanar(sdr_transfer, frames, format);
+        if (m_converter.Process(real, count, format, sdr_transfer.data, sdr_transfer.data_q) != ErrorCode::OK)
+            return;
+    }
+    else
+    {
+        m_converted.resize(frames * GetSampleSize(format));
+        if (m_converter.Process(real, count, format, m_converted.data()) != ErrorCode::OK)
+            return;
+        sdr_transfer.data = m_converted.data();
+    }
+
+    // Measured on the ADC values while they are still in cache, so saturation is exact.
+    SignalHealth health;
+    if (IsHealthMonitored())
+    {
+        health = MeasureLevel(real, SAMPLE_FORMAT_IQ_INT16, count).Health();
+        sdr_transfer.health = &health;
+    }
+
+    Deliver(sdr_transfer);
+}
+
 int PortSDR::AirSpyStream::AirSpySDRCallback(airspy_transfer* transfer)
 {
-    const auto* obj = static_cast<AirSpyStream*>(transfer->ctx);
+    auto* obj = static_cast<AirSpyStream*>(transfer->ctx);
+
+    if (obj->m_packing || obj->m_libraryDdc)
+    {
+        obj->ProcessReal(transfer);
+        return 0;
+    }
 
     SDRTransfer sdr_transfer{};
     sdr_transfer.data = transfer->samples;
@@ -387,7 +731,15 @@ int PortSDR::AirSpyStream::AirSpySDRCallback(airspy_transfer* transfer)
     sdr_transfer.dropped_samples = transfer->dropped_samples;
     sdr_transfer.format = obj->m_sampleType;
 
-    obj->m_callback(sdr_transfer);
+    // Split while copying out of the buffer of libairspy.
+    if (obj->IsPlanar())
+    {
+        obj->PreparePlanar(sdr_transfer, sdr_transfer.frame_size, sdr_transfer.format);
+        ConvertSamplesPlanar(transfer->samples, sdr_transfer.format, sdr_transfer.data, sdr_transfer.data_q,
+                             sdr_transfer.format, sdr_transfer.frame_size * 2);
+    }
+
+    obj->Deliver(sdr_transfer);
     return 0;
 }
 
@@ -5,23 +5,63 @@
 #ifndef AIRSPY_H
 #define AIRSPY_H
 
+#include <atomic>
+#include <mutex>
+
 #include "../Host.h"
+#include "../dsp/IQConverter.h"
 #include "libairspy/airspy.h"
 
 namespace PortSDR
 {
+    /**
+     * Functions of libairspy, resolved when the host is first used.
+     */
+    struct AirSpyApi
+    {
+        decltype(&airspy_list_devices) list_devices;
+        decltype(&airspy_open_sn) open_sn;
+        decltype(&airspy_close) close;
+        decltype(&airspy_board_id_read) board_id_read;
+        decltype(&airspy_board_id_name) board_id_name;
+        decltype(&airspy_board_partid_serialno_read) board_partid_serialno_read;
+        decltype(&airspy_get_samplerates) get_samplerates;
+        decltype(&airspy_set_samplerate) set_samplerate;
+        decltype(&airspy_set_sample_type) set_sample_type;
+        decltype(&airspy_set_packing) set_packing;
+        decltype(&airspy_set_freq) set_freq;
+        decltype(&airspy_set_lna_gain) set_lna_gain;
+        decltype(&airspy_set_mixer_gain) set_mixer_gain;
+        decltype(&airspy_set_vga_gain) set_vga_gain;
+        decltype(&airspy_set_linearity_gain) set_linearity_gain;
+        decltype(&airspy_set_sensitivity_gain) set_sensitivity_gain;
+        decltype(&airspy_start_rx) start_rx;
+        decltype(&airspy_stop_rx) stop_rx;
+        decltype(&airspy_is_streaming) is_streaming;
+
+        /**
+         * Loads libairspy on the first call.
+         * @return functions, nullptr if the library or one of the functions is missing.
+         */
+        static const AirSpyApi* Get();
+    };
+
     class AirSpyHost final : public Host
     {
     public:
-        AirSpyHost();
+        explicit AirSpyHost(const AirSpyApi& api);
 
         [[nodiscard]] std::vector<Device> AvailableDevices() const override;
         [[nodiscard]] std::unique_ptr<StreamImpl> CreateStream() const override;
+
+    private:
+        const AirSpyApi& m_api;
     };
 
     class AirSpyStream final : public StreamImpl
     {
     public:
+        explicit AirSpyStream(const AirSpyApi& api);
         ~AirSpyStream() override;
 
         ErrorCode Initialize(const Device& device) override;
@@ -42,31 +82,85 @@ namespace PortSDR
         ErrorCode SetMixGain(double gain);
         ErrorCode SetIfGain(double gain);
 
+        /**
+         * Sends samples over USB packed as 12-bit instead of 16-bit.
+         * This lowers the bandwidth by 25%, the samples are unpacked and converted to IQ by the library.
+         * Can only be changed while not streaming.
+         * @param enabled true to enable packing
+         * @return ret code
+         */
+        ErrorCode SetPacking(bool enabled);
+
+        /**
+         * Receives real samples from libairspy and does the fs/4 shift, half-band decimation
+         * and DC removal in the library with vectorized kernels instead of libairspy's converter.
+         * Can only be changed while not streaming.
+         * @param enabled true to convert in the library
+         * @return ret code
+         */
+        ErrorCode SetLibraryDdc(bool enabled);
+
+        ErrorCode SetSetting(std::string_view key, std::string_view value) override;
+        [[nodiscard]] std::string GetSetting(std::string_view key) const override;
+
         [[nodiscard]] std::vector<uint32_t> GetSampleRates() const override;
         [[nodiscard]] std::vector<SampleFormat> GetSampleFormats() const override;
 
         [[nodiscard]] std::vector<GainMode> GetGainModes() const override;
         [[nodiscard]] std::vector<Gain> GetGainStages() const override;
         [[nodiscard]] std::vector<Gain> GetGainStages(GainMode mode) const override;
+        [[nodiscard]] std::string GetTunerType() const override;
 
         [[nodiscard]] uint32_t GetCenterFrequency() const override;
         [[nodiscard]] uint32_t GetSampleRate() const override;
         [[nodiscard]] double GetGain(std::string_view name) const override;
         [[nodiscard]] GainMode GetGainMode() const override;
 
+    protected:
+        ErrorCode Reopen() override;
+
+        [[nodiscard]] bool CanReopen() const override
+        {
+            return true;
+        }
+
     private:
         static int AirSpySDRCallback(airspy_transfer* transfer);
         static airspy_sample_type ConvertToSampleType(SampleFormat format) ;
+
+        [[nodiscard]] airspy_sample_type GetDeviceSampleType(bool packing, bool libraryDdc) const;
+        void ProcessReal(const airspy_transfer* transfer);
+
+        [[nodiscard]] DeviceInfo QueryUSBStrings() const;
+        [[nodiscard]] std::vector<uint32_t> QuerySampleRates() const;
     private:
+        const AirSpyApi& m_api;
         airspy_device* m_device = nullptr;
-        SampleFormat m_sampleType = SAMPLE_FORMAT_IQ_FLOAT32;
-        uint32_t m_sampleRate = 0;
-        uint32_t m_freq = 0;
-        uint8_t m_gain = 0;
-        uint8_t m_lnaGain = 0;
-        uint8_t m_mixGain = 0;
-        uint8_t m_ifGain = 0;
-        GainMode m_gainMode = GAIN_MODE_LINEARITY;
+        uint64_t m_serial = 0;
+        /* Guards the device handle and its control transfers, never taken by the receiving thread */
+        mutable std::recursive_mutex m_controlMutex;
+        std::atomic<bool> m_streaming{false};
+
+        /* Fixed by the device, queried by Initialize() so the getters never take the lock */
+        DeviceInfo m_usbStrings;
+        std::vector<uint32_t> m_sampleRates;
+
+        /* Read by the getters and the receiving thread without the lock */
+        std::atomic<SampleFormat> m_sampleType{SAMPLE_FORMAT_IQ_FLOAT32};
+        std::atomic<uint32_t> m_sampleRate{0};
+        std::atomic<uint32_t> m_freq{0};
+        /* Only gains that were set are applied again when reopening, -1 until set */
+        std::atomic<int> m_gain{-1};
+        std::atomic<int> m_lnaGain{-1};
+        std::atomic<int> m_mixGain{-1};
+        std::atomic<int> m_ifGain{-1};
+        std::atomic<GainMode> m_gainMode{GAIN_MODE_LINEARITY};
+
+        std::atomic<bool> m_packing{false};
+        std::atomic<bool> m_libraryDdc{false};
+        IQConverter m_converter;
+        Buffer<int16_t> m_unpacked;
+        Buffer<uint8_t> m_converted;
     };
 }
 #endif //AIRSPY_H
@@ -4,9 +4,66 @@
 
 #include "AirSpyHf.h"
 
+#include "Trace.h"
 #include "../Utils.h"
+#include "VendorLibrary.h"
+#include "../dsp/Convert.h"
+
+#ifdef _WIN32
+#define AIRSPYHF_LIBRARY_NAMES {"airspyhf.dll", "libairspyhf.dll"}
+#elif defined(__APPLE__)
+#define AIRSPYHF_LIBRARY_NAMES {"libairspyhf.0.dylib", "libairspyhf.dylib"}
+#else
+#define AIRSPYHF_LIBRARY_NAMES {"libairspyhf.so.0", "libairspyhf.so"}
+#endif
+
+#ifdef AIRSPYHF_LINKED
+static std::unique_ptr<PortSDR::AirSpyHfApi> LoadApi()
+{
+    // Built from source as a static library and linked in, there is nothing to load.
+    auto api = std::make_unique<PortSDR::AirSpyHfApi>();
+    api->list_devices = airspyhf_list_devices;
+    api->open_sn = airspyhf_open_sn;
+    api->close = airspyhf_close;
+    api->board_partid_serialno_read = airspyhf_board_partid_serialno_read;
+    api->get_samplerates = airspyhf_get_samplerates;
+    api->set_samplerate = airspyhf_set_samplerate;
+    api->set_freq = airspyhf_set_freq;
+    api->set_hf_att = airspyhf_set_hf_att;
+    api->start = airspyhf_start;
+    api->stop = airspyhf_stop;
+    return api;
+}
+#else
+static std::unique_ptr<PortSDR::AirSpyHfApi> LoadApi()
+{
+    PortSDR::VendorLibrary library;
+    if (!library.Open(AIRSPYHF_LIBRARY_NAMES))
+        return nullptr;
+
+    auto api = std::make_unique<PortSDR::AirSpyHfApi>();
+    const bool resolved = library.Resolve("airspyhf_list_devices", api->list_devices)
+        && library.Resolve("airspyhf_open_sn", api->open_sn)
+        && library.Resolve("airspyhf_close", api->close)
+        && library.Resolve("airspyhf_board_partid_serialno_read", api->board_partid_serialno_read)
+        && library.Resolve("airspyhf_get_samplerates", api->get_samplerates)
+        && library.Resolve("airspyhf_set_samplerate", api->set_samplerate)
+        && library.Resolve("airspyhf_set_freq", api->set_freq)
+        && library.Resolve("airspyhf_set_hf_att", api->set_hf_att)
+        && library.Resolve("airspyhf_start", api->start)
+        && library.Resolve("airspyhf_stop", api->stop);
+
+    return resolved ? std::move(api) : nullptr;
+}
+#endif
+
+const PortSDR::AirSpyHfApi* PortSDR::AirSpyHfApi::Get()
+{
+    static const std::unique_ptr<AirSpyHfApi> api = LoadApi();
+    return api.get();
+}
 
-PortSDR::AirSpyHfHost::AirSpyHfHost() : Host(HostType::AIRSPY_HF)
+PortSDR::AirSpyHfHost::AirSpyHfHost(const AirSpyHfApi& api) : Host(HostType::AIRSPY_HF), m_api(api)
 {
 }
 
@@ -14,12 +71,12 @@ std::vector<PortSDR::Device> PortSDR::AirSpyHfHost::AvailableDevices() const
 {
     std::vector<Device> devices;
 
-    const int device_count = airspyhf_list_devices(nullptr, 0);
+    const int device_count = m_api.list_devices(nullptr, 0);
     if (device_count <= 0)
         return {};
 
     uint64_t serials[device_count];
-    int ret = airspyhf_list_devices(serials, device_count);
+    int ret = m_api.list_devices(serials, device_count);
     if (ret < 0)
         return {};
 
@@ -38,19 +95,28 @@ std::vector<PortSDR::Device> PortSDR::AirSpyHfHost::AvailableDevices() const
 
 std::unique_ptr<PortSDR::StreamImpl> PortSDR::AirSpyHfHost::CreateStream() const
 {
-    return std::make_unique<AirSpyHfStream>();
+    return std::make_unique<AirSpyHfStream>(m_api);
+}
+
+PortSDR::AirSpyHfStream::AirSpyHfStream(const AirSpyHfApi& api) : m_api(api)
+{
 }
 
 PortSDR::AirSpyHfStream::~AirSpyHfStream()
 {
+    StopCommands();
+    DisableRecovery();
+
+    std::lock_guard lock(m_controlMutex);
     if (m_device)
     {
-        airspyhf_close(m_device);
+        m_api.close(m_device);
     }
 }
 
 PortSDR::ErrorCode PortSDR::AirSpyHfStream::Initialize(const Device& device)
 {
+    std::lock_guard lock(m_controlMutex);
     if (m_device)
         return ErrorCode::INVALID_ARGUMENT;
 
@@ -61,23 +127,34 @@ PortSDR::ErrorCode PortSDR::AirSpyHfStream::Initialize(const Device& device)
         device.serial.c_str(),
         nullptr,
         16);
-    const int ret = airspyhf_open_sn(&m_device, num);
+    const int ret = m_api.open_sn(&m_device, num);
     if (ret != AIRSPYHF_SUCCESS)
     {
+        m_device = nullptr;
         return ErrorCode::UNKNOWN;
     }
 
+    m_serial = num;
+
+    // Reopen() opens the same device again, so these stay valid.
+    m_usbStrings = QueryUSBStrings();
+    m_sampleRates = QuerySampleRates();
     return ErrorCode::OK;
 }
 
 PortSDR::DeviceInfo PortSDR::AirSpyHfStream::GetUSBStrings()
+{
+    return m_usbStrings;
+}
+
+PortSDR::DeviceInfo PortSDR::AirSpyHfStream::QueryUSBStrings() const
 {
     DeviceInfo device;
     airspyhf_read_partid_serialno_t read_partid_serialno;
 
     device.name = "AIRSPY HF";
 
-    if (airspyhf_board_partid_serialno_read(
+    if (m_api.board_partid_serialno_read(
         m_device,
         &read_partid_serialno) == AIRSPYHF_SUCCESS)
     {
@@ -92,58 +169,117 @@ PortSDR::DeviceInfo PortSDR::AirSpyHfStream::GetUSBStrings()
 
 PortSDR::ErrorCode PortSDR::AirSpyHfStream::Start()
 {
+    PORTSDR_TRACE_SCOPE("start");
+    std::lock_guard lock(m_controlMutex);
+
     if (!m_device)
         return ErrorCode::INVALID_ARGUMENT;
 
-    const int ret = airspyhf_start(m_device, AirSpySDRCallback, this);
+    const int ret = m_api.start(m_device, AirSpySDRCallback, this);
     if (ret != AIRSPYHF_SUCCESS)
         return ErrorCode::UNKNOWN;
+
+    m_streaming = true;
     return ErrorCode::OK;
 }
 
 PortSDR::ErrorCode PortSDR::AirSpyHfStream::Stop()
 {
-    if (!m_device)
+    PORTSDR_TRACE_SCOPE("stop");
+    std::lock_guard lock(m_controlMutex);
+
+    // A failed recovery leaves the stream streaming without a device.
+    if (!m_streaming && !m_device)
         return ErrorCode::INVALID_ARGUMENT;
 
-    const int ret = airspyhf_stop(m_device);
+    CancelReads();
+    m_streaming = false;
+
+    if (!m_device)
+        return ErrorCode::OK;
+
+    const int ret = m_api.stop(m_device);
     if (ret != AIRSPYHF_SUCCESS)
         return ErrorCode::UNKNOWN;
     return ErrorCode::OK;
 }
 
+PortSDR::ErrorCode PortSDR::AirSpyHfStream::Reopen()
+{
+    std::lock_guard lock(m_controlMutex);
+
+    if (!m_streaming)
+        return ErrorCode::STOPPED;
+
+    if (m_device)
+    {
+        m_api.stop(m_device);
+        m_api.close(m_device);
+        m_device = nullptr;
+    }
+
+    int ret = m_api.open_sn(&m_device, m_serial);
+    if (ret != AIRSPYHF_SUCCESS)
+    {
+        m_device = nullptr;
+        return ErrorCode::DEVICE_NOT_FOUND;
+    }
+
+    if (m_sampleRate != 0)
+        ret = m_api.set_samplerate(m_device, m_sampleRate);
+    if (ret == AIRSPYHF_SUCCESS && m_freq != 0)
+        ret = m_api.set_freq(m_device, m_freq);
+    if (ret == AIRSPYHF_SUCCESS && m_attenuation >= 0)
+        ret = m_api.set_hf_att(m_device, static_cast<uint8_t>(m_attenuation));
+    if (ret == AIRSPYHF_SUCCESS)
+        ret = m_api.start(m_device, AirSpySDRCallback, this);
+
+    return ret == AIRSPYHF_SUCCESS ? ErrorCode::OK : ErrorCode::UNKNOWN;
+}
+
 PortSDR::ErrorCode PortSDR::AirSpyHfStream::SetCenterFrequency(uint32_t freq)
 {
+    PORTSDR_TRACE_SCOPE_VALUE("retune", freq);
+    std::lock_guard lock(m_controlMutex);
+
     if (!m_device)
         return ErrorCode::INVALID_ARGUMENT;
 
-    int ret = airspyhf_set_freq(m_device, freq);
+    int ret = m_api.set_freq(m_device, freq);
     if (ret != AIRSPYHF_SUCCESS)
     {
         return ErrorCode::UNKNOWN;
     }
 
     m_freq = freq;
+    PostTag(STREAM_TAG_FREQUENCY, freq);
     return ErrorCode::OK;
 }
 
 PortSDR::ErrorCode PortSDR::AirSpyHfStream::SetSampleRate(uint32_t sampleRate)
 {
+    std::lock_guard lock(m_controlMutex);
     if (!m_device)
         return ErrorCode::INVALID_ARGUMENT;
 
-    int ret = airspyhf_set_samplerate(m_device, sampleRate);
+    int ret = m_api.set_samplerate(m_device, sampleRate);
     if (ret != AIRSPYHF_SUCCESS)
     {
         return ErrorCode::UNKNOWN;
     }
 
     m_sampleRate = sampleRate;
+    PostTag(STREAM_TAG_SAMPLE_RATE, sampleRate);
     return ErrorCode::OK;
 }
 
 PortSDR::ErrorCode PortSDR::AirSpyHfStream::SetSampleFormat(SampleFormat format)
 {
+    if (CheckSampleFormat(format) != ErrorCode::OK)
+        return ErrorCode::INVALID_ARGUMENT;
+
+    std::lock_guard lock(m_controlMutex);
+
     if (!m_device)
         return ErrorCode::INVALID_ARGUMENT;
 
@@ -156,6 +292,9 @@ PortSDR::ErrorCode PortSDR::AirSpyHfStream::SetSampleFormat(SampleFormat format)
 
 PortSDR::ErrorCode PortSDR::AirSpyHfStream::SetGain(double gain, std::string_view name)
 {
+    PORTSDR_TRACE_SCOPE_VALUE("gain", gain * 10);
+    std::lock_guard lock(m_controlMutex);
+
     if (!m_device)
         return ErrorCode::INVALID_ARGUMENT;
 
@@ -177,28 +316,37 @@ PortSDR::ErrorCode PortSDR::AirSpyHfStream::SetGainMode(const GainMode mode)
 
 PortSDR::ErrorCode PortSDR::AirSpyHfStream::SetAttenuation(double attenuation)
 {
+    std::lock_guard lock(m_controlMutex);
     if (!m_device)
         return ErrorCode::INVALID_ARGUMENT;
 
-    const int ret = airspyhf_set_hf_att(m_device, static_cast<int>(attenuation));
+    const int ret = m_api.set_hf_att(m_device, static_cast<int>(attenuation));
     if (ret != AIRSPYHF_SUCCESS)
         return ErrorCode::UNKNOWN;
+
+    m_attenuation = static_cast<int>(attenuation);
+    PostTag(STREAM_TAG_GAIN, static_cast<int>(attenuation), "ATT");
     return ErrorCode::OK;
 }
 
 std::vector<uint32_t> PortSDR::AirSpyHfStream::GetSampleRates() const
+{
+    return m_sampleRates;
+}
+
+std::vector<uint32_t> PortSDR::AirSpyHfStream::QuerySampleRates() const
 {
     std::vector<uint32_t> sampleRates;
     uint32_t count;
 
-    int ret = airspyhf_get_samplerates(m_device, &count, 0);
+    int ret = m_api.get_samplerates(m_device, &count, 0);
     if (ret < 0)
         return {};
 
     if (count > 0)
     {
         sampleRates.resize(count);
-        airspyhf_get_samplerates(m_device, sampleRates.data(), count);
+        m_api.get_samplerates(m_device, sampleRates.data(), count);
     }
 
     return sampleRates;
@@ -226,6 +374,11 @@ std::vector<PortSDR::Gain> PortSDR::AirSpyHfStream::GetGainStages(GainMode mode)
     return gains;
 }
 
+std::string PortSDR::AirSpyHfStream::GetTunerType() const
+{
+    return "HF+";
+}
+
 uint32_t PortSDR::AirSpyHfStream::GetCenterFrequency() const
 {
     return m_freq;
@@ -238,6 +391,8 @@ uint32_t PortSDR::AirSpyHfStream::GetSampleRate() const
 
 double PortSDR::AirSpyHfStream::GetGain(std::string_view name) const
 {
+    if (name == "ATT" && m_attenuation >= 0)
+        return m_attenuation;
     return 0;
 }
 
@@ -253,7 +408,7 @@ PortSDR::SampleFormat PortSDR::AirSpyHfStream::getNativeSampleFormat()
 
 int PortSDR::AirSpyHfStream::AirSpySDRCallback(airspyhf_transfer_t* transfer)
 {
-    const auto* obj = static_cast<AirSpyHfStream*>(transfer->ctx);
+    auto* obj = static_cast<AirSpyHfStream*>(transfer->ctx);
 
     SDRTransfer sdr_transfer{};
     sdr_transfer.data = transfer->samples;
@@ -261,6 +416,14 @@ int PortSDR::AirSpyHfStream::AirSpySDRCallback(airspyhf_transfer_t* transfer)
     sdr_transfer.dropped_samples = transfer->dropped_samples;
     sdr_transfer.format = getNativeSampleFormat();
 
-    obj->m_callback(sdr_transfer);
+    // Split while copying out of the buffer of libairspyhf.
+    if (obj->IsPlanar())
+    {
+        obj->PreparePlanar(sdr_transfer, sdr_transfer.frame_size, sdr_transfer.format);
+        ConvertSamplesPlanar(transfer->samples, sdr_transfer.format, sdr_transfer.data, sdr_transfer.data_q,
+                             sdr_transfer.format, sdr_transfer.frame_size * 2);
+    }
+
+    obj->Deliver(sdr_transfer);
     return 0;
 }
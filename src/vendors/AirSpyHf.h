@@ -5,23 +5,53 @@
 #ifndef AIRSPYHF_H
 #define AIRSPYHF_H
 
+#include <atomic>
+#include <mutex>
+
 #include "../Host.h"
 #include <libairspyhf/airspyhf.h>
 
 namespace PortSDR
 {
+    /**
+     * Functions of libairspyhf, resolved when the host is first used.
+     */
+    struct AirSpyHfApi
+    {
+        decltype(&airspyhf_list_devices) list_devices;
+        decltype(&airspyhf_open_sn) open_sn;
+        decltype(&airspyhf_close) close;
+        decltype(&airspyhf_board_partid_serialno_read) board_partid_serialno_read;
+        decltype(&airspyhf_get_samplerates) get_samplerates;
+        decltype(&airspyhf_set_samplerate) set_samplerate;
+        decltype(&airspyhf_set_freq) set_freq;
+        decltype(&airspyhf_set_hf_att) set_hf_att;
+        decltype(&airspyhf_start) start;
+        decltype(&airspyhf_stop) stop;
+
+        /**
+         * Loads libairspyhf on the first call.
+         * @return functions, nullptr if the library or one of the functions is missing.
+         */
+        static const AirSpyHfApi* Get();
+    };
+
     class AirSpyHfHost final : public Host
     {
     public:
-        AirSpyHfHost();
+        explicit AirSpyHfHost(const AirSpyHfApi& api);
 
         [[nodiscard]] std::vector<Device> AvailableDevices() const override;
         [[nodiscard]] std::unique_ptr<StreamImpl> CreateStream() const override;
+
+    private:
+        const AirSpyHfApi& m_api;
     };
 
     class AirSpyHfStream final : public StreamImpl
     {
     public:
+        explicit AirSpyHfStream(const AirSpyHfApi& api);
         ~AirSpyHfStream() override;
 
         ErrorCode Initialize(const Device& device) override;
@@ -44,22 +74,46 @@ namespace PortSDR
 
         [[nodiscard]] std::vector<GainMode> GetGainModes() const override;
         [[nodiscard]] std::vector<Gain> GetGainStages(GainMode mode) const override;
+        [[nodiscard]] std::string GetTunerType() const override;
 
         [[nodiscard]] uint32_t GetCenterFrequency() const override;
         [[nodiscard]] uint32_t GetSampleRate() const override;
         [[nodiscard]] double GetGain(std::string_view name) const override;
         [[nodiscard]] GainMode GetGainMode() const override;
 
+    protected:
+        ErrorCode Reopen() override;
+
+        [[nodiscard]] bool CanReopen() const override
+        {
+            return true;
+        }
+
     private:
         [[nodiscard]] static SampleFormat getNativeSampleFormat();
 
         static int AirSpySDRCallback(airspyhf_transfer_t* transfer);
 
+        [[nodiscard]] DeviceInfo QueryUSBStrings() const;
+        [[nodiscard]] std::vector<uint32_t> QuerySampleRates() const;
+
     private:
+        const AirSpyHfApi& m_api;
         airspyhf_device *m_device = nullptr;
+        uint64_t m_serial = 0;
+
+        /* Guards the device handle and its control transfers, never taken by the receiving thread */
+        mutable std::recursive_mutex m_controlMutex;
+        std::atomic<bool> m_streaming{false};
+
+        /* Fixed by the device, queried by Initialize() so the getters never take the lock */
+        DeviceInfo m_usbStrings;
+        std::vector<uint32_t> m_sampleRates;
 
-        uint32_t m_freq = 0;
-        uint32_t m_sampleRate = 0;
+        /* Applied again when reopening once set, read by the getters without the lock */
+        std::atomic<uint32_t> m_freq{0};
+        std::atomic<uint32_t> m_sampleRate{0};
+        std::atomic<int> m_attenuation{-1};
     };
 }
 
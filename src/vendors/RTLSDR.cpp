@@ -6,27 +6,98 @@
 #include "rtl-sdr.h"
 
 #include <cassert>
+#include <cmath>
 #include <cstring>
 #include <map>
 #include <numeric>
 #include <thread>
 
 #include "../Utils.h"
+#include "VendorLibrary.h"
+#include "../dsp/Convert.h"
+#include "../net/RtlTcpProtocol.h"
 
 #include "Ranges.h"
+#include "Trace.h"
 
 #define MAX_STR_SIZE 256
 #define BUF_NUM  64
 #define BUF_LEN  (4 * 32 * 512) /* must be multiple of 512 */
 
-PortSDR::RTLHost::RTLHost() : Host(HostType::RTL_SDR)
+#ifdef _WIN32
+#define RTLSDR_LIBRARY_NAMES {"rtlsdr.dll", "librtlsdr.dll"}
+#elif defined(__APPLE__)
+#define RTLSDR_LIBRARY_NAMES {"librtlsdr.0.dylib", "librtlsdr.dylib"}
+#else
+#define RTLSDR_LIBRARY_NAMES {"librtlsdr.so.0", "librtlsdr.so"}
+#endif
+
+#ifdef RTLSDR_LINKED
+static std::unique_ptr<PortSDR::RTLApi> LoadApi()
+{
+    // Built from source as a static library and linked in, there is nothing to load.
+    auto api = std::make_unique<PortSDR::RTLApi>();
+    api->get_device_count = rtlsdr_get_device_count;
+    api->get_device_usb_strings = rtlsdr_get_device_usb_strings;
+    api->get_index_by_serial = rtlsdr_get_index_by_serial;
+    api->open = rtlsdr_open;
+    api->close = rtlsdr_close;
+    api->get_usb_strings = rtlsdr_get_usb_strings;
+    api->set_offset_tuning = rtlsdr_set_offset_tuning;
+    api->reset_buffer = rtlsdr_reset_buffer;
+    api->set_center_freq = rtlsdr_set_center_freq;
+    api->set_sample_rate = rtlsdr_set_sample_rate;
+    api->get_tuner_type = rtlsdr_get_tuner_type;
+    api->get_tuner_gains = rtlsdr_get_tuner_gains;
+    api->set_tuner_gain = rtlsdr_set_tuner_gain;
+    api->set_tuner_if_gain = rtlsdr_set_tuner_if_gain;
+    api->read_async = rtlsdr_read_async;
+    api->cancel_async = rtlsdr_cancel_async;
+    return api;
+}
+#else
+static std::unique_ptr<PortSDR::RTLApi> LoadApi()
+{
+    PortSDR::VendorLibrary library;
+    if (!library.Open(RTLSDR_LIBRARY_NAMES))
+        return nullptr;
+
+    auto api = std::make_unique<PortSDR::RTLApi>();
+    const bool resolved = library.Resolve("rtlsdr_get_device_count", api->get_device_count)
+        && library.Resolve("rtlsdr_get_device_usb_strings", api->get_device_usb_strings)
+        && library.Resolve("rtlsdr_get_index_by_serial", api->get_index_by_serial)
+        && library.Resolve("rtlsdr_open", api->open)
+        && library.Resolve("rtlsdr_close", api->close)
+        && library.Resolve("rtlsdr_get_usb_strings", api->get_usb_strings)
+        && library.Resolve("rtlsdr_set_offset_tuning", api->set_offset_tuning)
+        && library.Resolve("rtlsdr_reset_buffer", api->reset_buffer)
+        && library.Resolve("rtlsdr_set_center_freq", api->set_center_freq)
+        && library.Resolve("rtlsdr_set_sample_rate", api->set_sample_rate)
+        && library.Resolve("rtlsdr_get_tuner_type", api->get_tuner_type)
+        && library.Resolve("rtlsdr_get_tuner_gains", api->get_tuner_gains)
+        && library.Resolve("rtlsdr_set_tuner_gain", api->set_tuner_gain)
+        && library.Resolve("rtlsdr_set_tuner_if_gain", api->set_tuner_if_gain)
+        && library.Resolve("rtlsdr_read_async", api->read_async)
+        && library.Resolve("rtlsdr_cancel_async", api->cancel_async);
+
+    return resolved ? std::move(api) : nullptr;
+}
+#endif
+
+const PortSDR::RTLApi* PortSDR::RTLApi::Get()
+{
+    static const std::unique_ptr<RTLApi> api = LoadApi();
+    return api.get();
+}
+
+PortSDR::RTLHost::RTLHost(const RTLApi& api) : Host(HostType::RTL_SDR), m_api(api)
 {
 }
 
 std::vector<PortSDR::Device> PortSDR::RTLHost::AvailableDevices() const
 {
     std::vector<Device> devices;
-    const uint32_t device_count = rtlsdr_get_device_count();
+    const uint32_t device_count = m_api.get_device_count();
 
     devices.resize(device_count);
 
@@ -36,7 +107,7 @@ std::vector<PortSDR::Device> PortSDR::RTLHost::AvailableDevices() const
     {
         char serial[MAX_STR_SIZE];
 
-        const int ret = rtlsdr_get_device_usb_strings(
+        const int ret = m_api.get_device_usb_strings(
             i, nullptr, nullptr,
             serial);
         if (ret != 0)
@@ -54,6 +125,11 @@ std::vector<PortSDR::Device> PortSDR::RTLHost::AvailableDevices() const
 }
 
 PortSDR::DeviceInfo PortSDR::RTLStream::GetUSBStrings()
+{
+    return m_usbStrings;
+}
+
+PortSDR::DeviceInfo PortSDR::RTLStream::QueryUSBStrings() const
 {
     DeviceInfo device;
 
@@ -67,7 +143,7 @@ PortSDR::DeviceInfo PortSDR::RTLStream::GetUSBStrings()
     memset(product, 0, sizeof(product));
     memset(serial, 0, sizeof(serial));
 
-    if (rtlsdr_get_usb_strings(m_dev, manufact, product, serial) == 0)
+    if (m_api.get_usb_strings(m_dev, manufact, product, serial) == 0)
     {
         device.serial = serial;
         device.name += string_format(" %s %s SN: %s", manufact, product, serial);
@@ -78,28 +154,50 @@ PortSDR::DeviceInfo PortSDR::RTLStream::GetUSBStrings()
 
 std::unique_ptr<PortSDR::StreamImpl> PortSDR::RTLHost::CreateStream() const
 {
-    return std::make_unique<RTLStream>();
+    return std::make_unique<RTLStream>(m_api);
+}
+
+PortSDR::RTLStream::RTLStream(const RTLApi& api) : m_api(api)
+{
 }
 
 PortSDR::RTLStream::~RTLStream()
 {
-    if (!m_dev)
-        return;
+    StopCommands();
+    DisableRecovery();
 
     Stop();
 
-    rtlsdr_close(m_dev);
+    if (m_dev)
+        m_api.close(m_dev);
     m_dev = nullptr;
 }
 
 PortSDR::ErrorCode PortSDR::RTLStream::Initialize(const Device& device)
 {
-    int ret = 0;
-
     if (m_dev)
         return ErrorCode::INVALID_ARGUMENT;
 
-    const int index = rtlsdr_get_index_by_serial(device.serial.c_str());
+    m_serial = device.serial;
+
+    const ErrorCode ret = Open();
+    if (ret != ErrorCode::OK)
+        return ret;
+
+    // Reopen() opens the same device again, so these stay valid.
+    const int tuner = m_api.get_tuner_type(m_dev);
+    m_usbStrings = QueryUSBStrings();
+    m_tunerType = RtlTcpTunerName(tuner);
+    m_hasIfGain = tuner == RTLSDR_TUNER_E4000;
+    m_gainRange = QueryGainRange();
+    return ErrorCode::OK;
+}
+
+PortSDR::ErrorCode PortSDR::RTLStream::Open()
+{
+    int ret = 0;
+
+    const int index = m_api.get_index_by_serial(m_serial.c_str());
     if (index < 0)
     {
         if (index == -2 || index == -1)
@@ -108,23 +206,38 @@ PortSDR::ErrorCode PortSDR::RTLStream::Initialize(const Device& device)
         return ErrorCode::UNKNOWN;
     }
 
-    ret = rtlsdr_open(&m_dev, index);
+    ret = m_api.open(&m_dev, index);
     if (ret < 0)
+    {
+        m_dev = nullptr;
         return ErrorCode::UNKNOWN;
+    }
 
-    ret = rtlsdr_set_offset_tuning(m_dev, 1);
+    ret = m_api.set_offset_tuning(m_dev, 1);
     if (ret != 0 && ret != -2)
+    {
+        m_api.close(m_dev);
+        m_dev = nullptr;
         return ErrorCode::UNKNOWN;
+    }
 
-    ret = rtlsdr_reset_buffer(m_dev);
+    ret = m_api.reset_buffer(m_dev);
     if (ret < 0)
+    {
+        m_api.close(m_dev);
+        m_dev = nullptr;
         return ErrorCode::UNKNOWN;
+    }
 
     return ErrorCode::OK;
 }
 
 PortSDR::ErrorCode PortSDR::RTLStream::Start()
 {
+    PORTSDR_TRACE_SCOPE("start");
+
+    std::lock_guard lock(m_controlMutex);
+
     if (!m_dev)
         return ErrorCode::INVALID_ARGUMENT;
 
@@ -138,53 +251,121 @@ PortSDR::ErrorCode PortSDR::RTLStream::Start()
 
 PortSDR::ErrorCode PortSDR::RTLStream::Stop()
 {
-    if (!m_dev || !m_thread.joinable())
+    PORTSDR_TRACE_SCOPE("stop");
+
+    std::lock_guard lock(m_controlMutex);
+
+    // A failed recovery leaves the stream running without a thread.
+    if (!running && !m_thread.joinable())
         return ErrorCode::INVALID_ARGUMENT;
 
+    CancelReads();
+
     running = false;
+    StopThread();
+    return ErrorCode::OK;
+}
+
+void PortSDR::RTLStream::StopThread()
+{
+    if (!m_thread.joinable())
+        return;
+
+    // Cancelled here as well, a stalled device doesn't call back anymore.
+    if (m_dev)
+        m_api.cancel_async(m_dev);
     m_thread.join();
+}
+
+PortSDR::ErrorCode PortSDR::RTLStream::Reopen()
+{
+    std::lock_guard lock(m_controlMutex);
+
+    if (!running)
+        return ErrorCode::STOPPED;
+
+    StopThread();
+
+    if (m_dev)
+        m_api.close(m_dev);
+    m_dev = nullptr;
+
+    ErrorCode ret = Open();
+    if (ret != ErrorCode::OK)
+        return ret;
+
+    // The setters take the lock again, it is recursive.
+    if (m_sampleRate != 0 && (ret = SetSampleRate(m_sampleRate)) != ErrorCode::OK)
+        return ret;
+    if (m_freq != 0 && (ret = SetCenterFrequency(m_freq)) != ErrorCode::OK)
+        return ret;
+    if (!std::isnan(m_ifGain.load()) && (ret = SetIfGain(m_ifGain)) != ErrorCode::OK)
+        return ret;
+    if (!std::isnan(m_lnaGain.load()) && (ret = SetRegularGain(m_lnaGain)) != ErrorCode::OK)
+        return ret;
+
+    m_thread = std::thread(&RTLStream::Process, this);
     return ErrorCode::OK;
 }
 
 PortSDR::ErrorCode PortSDR::RTLStream::SetCenterFrequency(const uint32_t freq)
 {
+    PORTSDR_TRACE_SCOPE_VALUE("retune", freq);
+
+    std::lock_guard lock(m_controlMutex);
+
     if (!m_dev)
         return ErrorCode::INVALID_ARGUMENT;
 
-    int ret = rtlsdr_set_center_freq(m_dev, freq);
+    int ret = m_api.set_center_freq(m_dev, freq);
     if (ret < 0)
         return ErrorCode::UNKNOWN;
+
+    m_freq = freq;
+    PostTag(STREAM_TAG_FREQUENCY, freq);
     return ErrorCode::OK;
 }
 
 PortSDR::ErrorCode PortSDR::RTLStream::SetSampleRate(const uint32_t freq)
 {
+    std::lock_guard lock(m_controlMutex);
+
     if (!m_dev)
         return ErrorCode::INVALID_ARGUMENT;
 
-    int ret = rtlsdr_set_sample_rate(m_dev, freq);
+    int ret = m_api.set_sample_rate(m_dev, freq);
     if (ret < 0)
     {
         if (ret == -EINVAL)
             return ErrorCode::INVALID_ARGUMENT;
         return ErrorCode::UNKNOWN;
     }
+
+    m_sampleRate = freq;
+    PostTag(STREAM_TAG_SAMPLE_RATE, freq);
     return ErrorCode::OK;
 }
 
 PortSDR::ErrorCode PortSDR::RTLStream::SetSampleFormat(const SampleFormat type)
 {
+    if (CheckSampleFormat(type) != ErrorCode::OK)
+        return ErrorCode::INVALID_ARGUMENT;
+
     if (type != SAMPLE_FORMAT_IQ_UINT8)
         return ErrorCode::INVALID_ARGUMENT;
+
+    PostTag(STREAM_TAG_FORMAT, type);
     return ErrorCode::OK;
 }
 
 PortSDR::ErrorCode PortSDR::RTLStream::SetIfGain(const double gain)
 {
+    std::lock_guard lock(m_controlMutex);
+
     if (!m_dev)
         return ErrorCode::INVALID_ARGUMENT;
 
-    if (rtlsdr_get_tuner_type(m_dev) != RTLSDR_TUNER_E4000)
+    if (!m_hasIfGain)
     {
         return ErrorCode::OK;
     }
@@ -236,17 +417,22 @@ PortSDR::ErrorCode PortSDR::RTLStream::SetIfGain(const double gain)
 
     for (int stage = 1; stage <= gains.size(); stage++)
     {
-        const int ret = rtlsdr_set_tuner_if_gain(
+        const int ret = m_api.set_tuner_if_gain(
             m_dev, stage,
             static_cast<int>(gains[stage] * 10.0));
         if (ret < 0)
             return ErrorCode::UNKNOWN;
     }
+
+    m_ifGain = gain;
+    PostTag(STREAM_TAG_GAIN, gain, "IF");
     return ErrorCode::OK;
 }
 
 PortSDR::ErrorCode PortSDR::RTLStream::SetGain(double gain, std::string_view name)
 {
+    PORTSDR_TRACE_SCOPE_VALUE("gain", gain * 10);
+
     if ("IF" == name)
     {
         return SetIfGain(gain);
@@ -258,14 +444,19 @@ PortSDR::ErrorCode PortSDR::RTLStream::SetGain(double gain, std::string_view nam
     return ErrorCode::INVALID_ARGUMENT;
 }
 
-PortSDR::ErrorCode PortSDR::RTLStream::SetRegularGain(double gain) const
+PortSDR::ErrorCode PortSDR::RTLStream::SetRegularGain(double gain)
 {
+    std::lock_guard lock(m_controlMutex);
+
     if (!m_dev)
         return ErrorCode::INVALID_ARGUMENT;
 
-    const int ret = rtlsdr_set_tuner_gain(m_dev, gain * 10.0);
+    const int ret = m_api.set_tuner_gain(m_dev, gain * 10.0);
     if (ret < 0)
         return ErrorCode::UNKNOWN;
+
+    m_lnaGain = gain;
+    PostTag(STREAM_TAG_GAIN, gain, "LNA");
     return ErrorCode::OK;
 }
 
@@ -279,30 +470,18 @@ PortSDR::ErrorCode PortSDR::RTLStream::SetGainMode(GainMode mode)
 
 uint32_t PortSDR::RTLStream::GetCenterFrequency() const
 {
-    if (!m_dev)
-        return -1;
-
-    return rtlsdr_get_center_freq(m_dev);
+    return m_freq;
 }
 
 uint32_t PortSDR::RTLStream::GetSampleRate() const
 {
-    if (!m_dev)
-        return 0;
-
-    const uint32_t ret = rtlsdr_get_sample_rate(m_dev);
-    if (ret <= 0)
-        return 0;
-
-    return rtlsdr_get_sample_rate(m_dev);
+    return m_sampleRate;
 }
 
 double PortSDR::RTLStream::GetLNAGain() const
 {
-    if (!m_dev)
-        return 0;
-
-    return rtlsdr_get_tuner_gain(m_dev) / 10.0;
+    const double gain = m_lnaGain;
+    return std::isnan(gain) ? 0 : gain;
 }
 
 double PortSDR::RTLStream::GetGain(std::string_view name) const
@@ -326,7 +505,7 @@ std::vector<PortSDR::Gain> PortSDR::RTLStream::GetGainStages(const GainMode mode
 
     if (mode == GAIN_MODE_FREE)
     {
-        if (rtlsdr_get_tuner_type(m_dev) == RTLSDR_TUNER_E4000)
+        if (m_hasIfGain)
         {
             gain_stages.emplace_back("IF", MetaRange{3, 56, 1});
         }
@@ -336,20 +515,27 @@ std::vector<PortSDR::Gain> PortSDR::RTLStream::GetGainStages(const GainMode mode
     return gain_stages;
 }
 
+std::string PortSDR::RTLStream::GetTunerType() const
+{
+    return m_tunerType;
+}
+
 PortSDR::MetaRange PortSDR::RTLStream::GetGainRange() const
 {
-    MetaRange range;
+    return m_gainRange;
+}
 
-    if (!m_dev)
-        return {};
+PortSDR::MetaRange PortSDR::RTLStream::QueryGainRange() const
+{
+    MetaRange range;
 
-    int count = rtlsdr_get_tuner_gains(m_dev, nullptr);
+    int count = m_api.get_tuner_gains(m_dev, nullptr);
     if (count <= 0)
         return {};
 
     std::vector<int> gains(count);
 
-    count = rtlsdr_get_tuner_gains(m_dev, gains.data());
+    count = m_api.get_tuner_gains(m_dev, gains.data());
     for (int i = 0; i < count; i++)
         range.emplace_back(static_cast<double>(gains[i]) / 10.0f);
 
@@ -389,12 +575,12 @@ std::vector<PortSDR::SampleFormat> PortSDR::RTLStream::GetSampleFormats() const
 
 void PortSDR::RTLStream::RTLSDRCallback(unsigned char* buf, uint32_t len, void* ctx)
 {
-    const auto* stream = static_cast<RTLStream*>(ctx);
+    auto* stream = static_cast<RTLStream*>(ctx);
     assert(stream != nullptr);
 
     if (!stream->running)
     {
-        rtlsdr_cancel_async(stream->m_dev);
+        stream->m_api.cancel_async(stream->m_dev);
     }
 
     SDRTransfer transfer{};
@@ -403,15 +589,22 @@ void PortSDR::RTLStream::RTLSDRCallback(unsigned char* buf, uint32_t len, void*
     transfer.data = buf;
     transfer.frame_size = len / 2;
 
-    stream->m_callback(transfer);
+    // Split while copying out of the USB buffer.
+    if (stream->IsPlanar())
+    {
+        stream->PreparePlanar(transfer, transfer.frame_size, SAMPLE_FORMAT_IQ_UINT8);
+        ConvertSamplesPlanar(buf, SAMPLE_FORMAT_IQ_UINT8, transfer.data, transfer.data_q, SAMPLE_FORMAT_IQ_UINT8,
+                             transfer.frame_size * 2);
+    }
+
+    stream->Deliver(transfer);
 }
 
 void PortSDR::RTLStream::Process()
 {
-    int ret = rtlsdr_read_async(m_dev, RTLSDRCallback, this, BUF_NUM, BUF_LEN);
-    if (ret != 0)
-    {
-        // TODO: handle error
-        m_dev = nullptr;
-    }
+    // Only returns on its own when the device failed or was unplugged.
+    // The handle stays open, it is closed by Reopen() or the destructor.
+    m_api.read_async(m_dev, RTLSDRCallback, this, BUF_NUM, BUF_LEN);
+    if (running)
+        ReportFailure(ErrorCode::LIBUSB_ERROR);
 }
@@ -6,6 +6,9 @@
 #define RTLSDR_H
 
 #include <atomic>
+#include <cmath>
+#include <mutex>
+#include <string>
 
 #include "../Host.h"
 #include "rtl-sdr.h"
@@ -14,18 +17,51 @@
 
 namespace PortSDR
 {
+    /**
+     * Functions of librtlsdr, resolved when the RTL-SDR host is first used.
+     */
+    struct RTLApi
+    {
+        decltype(&rtlsdr_get_device_count) get_device_count;
+        decltype(&rtlsdr_get_device_usb_strings) get_device_usb_strings;
+        decltype(&rtlsdr_get_index_by_serial) get_index_by_serial;
+        decltype(&rtlsdr_open) open;
+        decltype(&rtlsdr_close) close;
+        decltype(&rtlsdr_get_usb_strings) get_usb_strings;
+        decltype(&rtlsdr_set_offset_tuning) set_offset_tuning;
+        decltype(&rtlsdr_reset_buffer) reset_buffer;
+        decltype(&rtlsdr_set_center_freq) set_center_freq;
+        decltype(&rtlsdr_set_sample_rate) set_sample_rate;
+        decltype(&rtlsdr_get_tuner_type) get_tuner_type;
+        decltype(&rtlsdr_get_tuner_gains) get_tuner_gains;
+        decltype(&rtlsdr_set_tuner_gain) set_tuner_gain;
+        decltype(&rtlsdr_set_tuner_if_gain) set_tuner_if_gain;
+        decltype(&rtlsdr_read_async) read_async;
+        decltype(&rtlsdr_cancel_async) cancel_async;
+
+        /**
+         * Loads librtlsdr on the first call.
+         * @return functions, nullptr if the library or one of the functions is missing.
+         */
+        static const RTLApi* Get();
+    };
+
     class RTLHost final : public Host
     {
     public:
-        RTLHost();
+        explicit RTLHost(const RTLApi& api);
 
         [[nodiscard]] std::vector<Device> AvailableDevices() const override;
         [[nodiscard]] std::unique_ptr<StreamImpl> CreateStream() const override;
+
+    private:
+        const RTLApi& m_api;
     };
 
     class RTLStream final : public StreamImpl
     {
     public:
+        explicit RTLStream(const RTLApi& api);
         ~RTLStream() override;
 
         ErrorCode Initialize(const Device& device) override;
@@ -39,7 +75,7 @@ namespace PortSDR
         ErrorCode SetSampleFormat(SampleFormat type) override;
 
         ErrorCode SetGain(double gain, std::string_view name) override;
-        ErrorCode SetRegularGain(double gain) const;
+        ErrorCode SetRegularGain(double gain);
         ErrorCode SetGainMode(GainMode mode) override;
 
         ErrorCode SetIfGain(double gain);
@@ -56,15 +92,48 @@ namespace PortSDR
         [[nodiscard]] MetaRange GetGainRange() const;
 
         [[nodiscard]] std::vector<Gain> GetGainStages(GainMode mode) const override;
+        [[nodiscard]] std::string GetTunerType() const override;
+
+    protected:
+        ErrorCode Reopen() override;
+
+        [[nodiscard]] bool CanReopen() const override
+        {
+            return true;
+        }
 
     private:
         static void RTLSDRCallback(unsigned char* buf, uint32_t len, void* ctx);
         void Process();
 
+        ErrorCode Open();
+        void StopThread();
+
+        [[nodiscard]] DeviceInfo QueryUSBStrings() const;
+        [[nodiscard]] MetaRange QueryGainRange() const;
+
     private:
+        const RTLApi& m_api;
         rtlsdr_dev_t* m_dev{nullptr};
         std::thread m_thread;
-        std::atomic<bool> running;
+        std::atomic<bool> running{false};
+
+        /* Guards the device handle and its control transfers, never taken by the receiving thread */
+        mutable std::recursive_mutex m_controlMutex;
+
+        /* Fixed by the device, queried by Initialize() so the getters never take the lock */
+        DeviceInfo m_usbStrings;
+        std::string m_tunerType;
+        bool m_hasIfGain = false;
+        MetaRange m_gainRange;
+
+        /* Recovery opens the device by its serial again, with the settings that were last applied.
+         * Getters read them without the lock, 0 or NaN until set. */
+        std::string m_serial;
+        std::atomic<uint32_t> m_freq{0};
+        std::atomic<uint32_t> m_sampleRate{0};
+        std::atomic<double> m_lnaGain{NAN};
+        std::atomic<double> m_ifGain{NAN};
     };
 }
 
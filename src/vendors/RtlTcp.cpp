@@ -0,0 +1,624 @@
+#include "RtlTcp.h"
+
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "Trace.h"
+#include "../dsp/Convert.h"
+
+#define DEFAULT_PORT "1234"
+#define BLOCK_SIZE (64 * 1024) /* bytes, must be even */
+#define BLOCK_NUM 64
+#define SOCKET_BUFFER_SIZE (4 * 1024 * 1024)
+#define POLL_TIMEOUT_MS 100
+#define CONNECT_TIMEOUT_S 5
+
+/* Gain tables of librtlsdr in tenths of a dB */
+static const std::vector<int> kE4000Gains = {-10, 15, 40, 65, 90, 115, 140, 165, 190, 215, 240, 290, 340, 420};
+static const std::vector<int> kFC0012Gains = {-99, -40, 71, 179, 192};
+static const std::vector<int> kFC0013Gains = {
+    -99, -73, -65, -63, -60, -58, -54, 58, 61, 63, 65, 67,
+    68, 70, 71, 179, 181, 182, 184, 186, 188, 191, 197
+};
+static const std::vector<int> kR82XXGains = {
+    0, 9, 14, 27, 37, 77, 87, 125, 144, 157, 166, 197, 207, 229, 254,
+    280, 297, 328, 338, 364, 372, 386, 402, 421, 434, 439, 445, 480, 496
+};
+
+PortSDR::RtlTcpHost::RtlTcpHost() : Host(HostType::RTL_TCP)
+{
+}
+
+std::vector<PortSDR::Device> PortSDR::RtlTcpHost::AvailableDevices() const
+{
+    std::vector<Device> devices;
+
+    // Endpoints are not probed, connecting is left to CreateStream().
+    const char* env = std::getenv("PORTSDR_RTL_TCP");
+    if (!env)
+        return devices;
+
+    const std::string_view list(env);
+    std::size_t start = 0;
+
+    while (start < list.size())
+    {
+        std::size_t end = list.find(',', start);
+        if (end == std::string_view::npos)
+            end = list.size();
+
+        std::string_view endpoint = list.substr(start, end - start);
+        while (!endpoint.empty() && endpoint.front() == ' ')
+            endpoint.remove_prefix(1);
+        while (!endpoint.empty() && endpoint.back() == ' ')
+            endpoint.remove_suffix(1);
+
+        if (!endpoint.empty())
+        {
+            Device& device = devices.emplace_back();
+            device.type = GetType();
+            device.serial = endpoint;
+        }
+
+        start = end + 1;
+    }
+
+    return devices;
+}
+
+std::unique_ptr<PortSDR::StreamImpl> PortSDR::RtlTcpHost::CreateStream() const
+{
+    return std::make_unique<RtlTcpStream>();
+}
+
+/**
+ * Connects without blocking for longer than CONNECT_TIMEOUT_S.
+ * @return blocking socket, -1 if the address couldn't be reached in time.
+ */
+static int ConnectWithTimeout(const addrinfo* ai)
+{
+    const int fd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, ai->ai_protocol);
+    if (fd < 0)
+        return -1;
+
+    if (connect(fd, ai->ai_addr, ai->ai_addrlen) < 0)
+    {
+        if (errno != EINPROGRESS)
+        {
+            close(fd);
+            return -1;
+        }
+
+        pollfd pfd{fd, POLLOUT, 0};
+        int error = 0;
+        socklen_t length = sizeof(error);
+
+        if (poll(&pfd, 1, CONNECT_TIMEOUT_S * 1000) != 1
+            || getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) < 0
+            || error != 0)
+        {
+            close(fd);
+            return -1;
+        }
+    }
+
+    // The receiving thread polls on its own, commands are sent blocking.
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+    return fd;
+}
+
+PortSDR::RtlTcpStream::~RtlTcpStream()
+{
+    StopCommands();
+    DisableRecovery();
+
+    std::lock_guard lock(m_controlMutex);
+    Stop();
+
+    if (m_socket >= 0)
+        close(m_socket);
+    m_socket = -1;
+}
+
+PortSDR::ErrorCode PortSDR::RtlTcpStream::Initialize(const Device& device)
+{
+    std::lock_guard lock(m_controlMutex);
+    if (m_socket >= 0)
+        return ErrorCode::INVALID_ARGUMENT;
+
+    m_endpoint = device.serial;
+
+    const ErrorCode ret = Connect();
+    if (ret != ErrorCode::OK)
+        return ret;
+
+    m_blockSize = BLOCK_SIZE;
+    m_blockCount = BLOCK_NUM;
+    m_ring.resize(m_blockSize * m_blockCount);
+
+    return ErrorCode::OK;
+}
+
+PortSDR::ErrorCode PortSDR::RtlTcpStream::Connect()
+{
+    std::string host = m_endpoint;
+    std::string port = DEFAULT_PORT;
+
+    const std::size_t separator = host.rfind(':');
+    if (separator != std::string::npos)
+    {
+        port = host.substr(separator + 1);
+        host = host.substr(0, separator);
+    }
+
+    if (host.empty())
+        return ErrorCode::INVALID_ARGUMENT;
+
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    addrinfo* result = nullptr;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &result) != 0)
+        return ErrorCode::DEVICE_NOT_FOUND;
+
+    for (const addrinfo* ai = result; ai; ai = ai->ai_next)
+    {
+        m_socket = ConnectWithTimeout(ai);
+        if (m_socket >= 0)
+            break;
+    }
+
+    freeaddrinfo(result);
+
+    if (m_socket < 0)
+        return ErrorCode::DEVICE_NOT_FOUND;
+
+    // Commands are tiny and should reach the server as soon as a setter is called.
+    constexpr int enable = 1;
+    setsockopt(m_socket, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+    constexpr int bufferSize = SOCKET_BUFFER_SIZE;
+    setsockopt(m_socket, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+
+    timeval timeout{CONNECT_TIMEOUT_S, 0};
+    setsockopt(m_socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    uint8_t header[kRtlTcpHeaderSize];
+    RtlTcpHeader decoded{};
+    const ssize_t ret = recv(m_socket, header, sizeof(header), MSG_WAITALL);
+
+    timeout = {0, 0};
+    setsockopt(m_socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    if (ret != sizeof(header) || !DecodeRtlTcpHeader(header, decoded))
+    {
+        close(m_socket);
+        m_socket = -1;
+        return ErrorCode::FAILED_TO_INITIALIZE;
+    }
+
+    m_tunerType = decoded.tunerType;
+
+    m_disconnected = false;
+    return ErrorCode::OK;
+}
+
+PortSDR::DeviceInfo PortSDR::RtlTcpStream::GetUSBStrings()
+{
+    DeviceInfo device;
+    device.name = "RTL-TCP " + m_endpoint;
+    device.serial = m_endpoint;
+    return device;
+}
+
+PortSDR::ErrorCode PortSDR::RtlTcpStream::Start()
+{
+    PORTSDR_TRACE_SCOPE("start");
+    std::lock_guard lock(m_controlMutex);
+
+    if (m_socket < 0)
+        return ErrorCode::INVALID_ARGUMENT;
+
+    if (m_streaming)
+        return ErrorCode::OK;
+
+    // Threads may have exited on their own after the server disconnected.
+    StopThreads();
+
+    // Samples queued in the socket while stopped are stale.
+    uint8_t discard[BLOCK_SIZE];
+    ssize_t ret;
+    while ((ret = recv(m_socket, discard, sizeof(discard), MSG_DONTWAIT)) > 0)
+    {
+    }
+
+    // The server closed the connection, only Reopen() connects again.
+    if (ret == 0 || m_disconnected)
+    {
+        m_disconnected = true;
+        return ErrorCode::NETWORK_ERROR;
+    }
+
+    m_streaming = true;
+    StartThreads();
+    return ErrorCode::OK;
+}
+
+PortSDR::ErrorCode PortSDR::RtlTcpStream::Stop()
+{
+    PORTSDR_TRACE_SCOPE("stop");
+    std::lock_guard lock(m_controlMutex);
+
+    // A failed recovery leaves the stream running without threads.
+    if (!m_streaming && !m_receiveThread.joinable())
+        return ErrorCode::INVALID_ARGUMENT;
+
+    CancelReads();
+
+    m_streaming = false;
+    StopThreads();
+    return ErrorCode::OK;
+}
+
+PortSDR::ErrorCode PortSDR::RtlTcpStream::Reopen()
+{
+    std::lock_guard lock(m_controlMutex);
+    if (!m_streaming)
+        return ErrorCode::STOPPED;
+
+    StopThreads();
+
+    if (m_socket >= 0)
+        close(m_socket);
+    m_socket = -1;
+
+    ErrorCode ret = Connect();
+    if (ret != ErrorCode::OK)
+        return ret;
+
+    if (m_sampleRate != 0 && (ret = SetSampleRate(m_sampleRate)) != ErrorCode::OK)
+        return ret;
+    if (m_freq != 0 && (ret = SetCenterFrequency(m_freq)) != ErrorCode::OK)
+        return ret;
+    if (m_gainSet && (ret = SetGain(m_gain / 10.0, "LNA")) != ErrorCode::OK)
+        return ret;
+
+    StartThreads();
+    return ErrorCode::OK;
+}
+
+void PortSDR::RtlTcpStream::StartThreads()
+{
+    m_readBlock = 0;
+    m_writeBlock = 0;
+
+    m_running = true;
+    m_receiveThread = std::thread(&RtlTcpStream::Receive, this);
+    m_deliverThread = std::thread(&RtlTcpStream::Dispatch, this);
+}
+
+void PortSDR::RtlTcpStream::StopThreads()
+{
+    {
+        std::lock_guard lock(m_ringMutex);
+        m_running = false;
+    }
+    m_ringCond.notify_all();
+
+    if (m_receiveThread.joinable())
+        m_receiveThread.join();
+    if (m_deliverThread.joinable())
+        m_deliverThread.join();
+}
+
+PortSDR::ErrorCode PortSDR::RtlTcpStream::SetCenterFrequency(const uint32_t freq)
+{
+    PORTSDR_TRACE_SCOPE_VALUE("retune", freq);
+    std::lock_guard lock(m_controlMutex);
+
+    const ErrorCode ret = SendCommand(RTL_TCP_SET_FREQUENCY, freq);
+    if (ret == ErrorCode::OK)
+    {
+        m_freq = freq;
+        PostTag(STREAM_TAG_FREQUENCY, freq);
+    }
+    return ret;
+}
+
+PortSDR::ErrorCode PortSDR::RtlTcpStream::SetSampleRate(const uint32_t sampleRate)
+{
+    std::lock_guard lock(m_controlMutex);
+    const ErrorCode ret = SendCommand(RTL_TCP_SET_SAMPLE_RATE, sampleRate);
+    if (ret == ErrorCode::OK)
+    {
+        m_sampleRate = sampleRate;
+        PostTag(STREAM_TAG_SAMPLE_RATE, sampleRate);
+    }
+    return ret;
+}
+
+PortSDR::ErrorCode PortSDR::RtlTcpStream::SetSampleFormat(const SampleFormat format)
+{
+    if (CheckSampleFormat(format) != ErrorCode::OK)
+        return ErrorCode::INVALID_ARGUMENT;
+
+    if (format != SAMPLE_FORMAT_IQ_UINT8
+        && format != SAMPLE_FORMAT_IQ_INT16
+        && format != SAMPLE_FORMAT_IQ_FLOAT32)
+        return ErrorCode::INVALID_ARGUMENT;
+
+    // The wire is always uint8, anything else is converted on delivery.
+    std::lock_guard lock(m_controlMutex);
+    m_sampleFormat = format;
+    PostTag(STREAM_TAG_FORMAT, format);
+    return ErrorCode::OK;
+}
+
+PortSDR::ErrorCode PortSDR::RtlTcpStream::SetGain(const double gain, const std::string_view name)
+{
+    PORTSDR_TRACE_SCOPE_VALUE("gain", gain * 10);
+    std::lock_guard lock(m_controlMutex);
+
+    if ("LNA" != name)
+        return ErrorCode::INVALID_ARGUMENT;
+
+    ErrorCode ret = SendCommand(RTL_TCP_SET_GAIN_MODE, 1);
+    if (ret != ErrorCode::OK)
+        return ret;
+
+    const int tenths = static_cast<int>(std::lround(gain * 10.0));
+    ret = SendCommand(RTL_TCP_SET_GAIN, static_cast<uint32_t>(tenths));
+    if (ret == ErrorCode::OK)
+    {
+        m_gain = tenths;
+        m_gainSet = true;
+        PostTag(STREAM_TAG_GAIN, tenths / 10.0, "LNA");
+    }
+    return ret;
+}
+
+PortSDR::ErrorCode PortSDR::RtlTcpStream::SetGainMode(const GainMode mode)
+{
+    if (mode == GAIN_MODE_FREE)
+        return ErrorCode::OK;
+
+    return ErrorCode::INVALID_ARGUMENT;
+}
+
+std::vector<uint32_t> PortSDR::RtlTcpStream::GetSampleRates() const
+{
+    return {
+        250000, 1000000, 1024000, 1800000, 1920000, 2000000, 2048000,
+        2400000, 2560000, 2600000, 2800000, 3000000, 3200000
+    };
+}
+
+std::vector<PortSDR::SampleFormat> PortSDR::RtlTcpStream::GetSampleFormats() const
+{
+    return {SAMPLE_FORMAT_IQ_UINT8, SAMPLE_FORMAT_IQ_INT16, SAMPLE_FORMAT_IQ_FLOAT32};
+}
+
+std::vector<PortSDR::GainMode> PortSDR::RtlTcpStream::GetGainModes() const
+{
+    return {GAIN_MODE_FREE};
+}
+
+std::vector<PortSDR::Gain> PortSDR::RtlTcpStream::GetGainStages(const GainMode mode) const
+{
+    std::vector<Gain> gain_stages;
+
+    if (mode != GAIN_MODE_FREE)
+        return gain_stages;
+
+    const std::vector<int> gains = GetTunerGains();
+    if (gains.empty())
+    {
+        gain_stages.emplace_back("LNA", MetaRange{0, 50, 1});
+        return gain_stages;
+    }
+
+    MetaRange range;
+    for (const int gain : gains)
+        range.emplace_back(gain / 10.0);
+
+    gain_stages.emplace_back("LNA", range);
+    return gain_stages;
+}
+
+std::string PortSDR::RtlTcpStream::GetTunerType() const
+{
+    return RtlTcpTunerName(m_tunerType);
+}
+
+uint32_t PortSDR::RtlTcpStream::GetCenterFrequency() const
+{
+    return m_freq;
+}
+
+uint32_t PortSDR::RtlTcpStream::GetSampleRate() const
+{
+    return m_sampleRate;
+}
+
+double PortSDR::RtlTcpStream::GetGain(const std::string_view name) const
+{
+    if ("LNA" == name)
+        return m_gain / 10.0;
+
+    return 0;
+}
+
+PortSDR::GainMode PortSDR::RtlTcpStream::GetGainMode() const
+{
+    return GAIN_MODE_FREE;
+}
+
+PortSDR::ErrorCode PortSDR::RtlTcpStream::SendCommand(const RtlTcpCommand command, const uint32_t param)
+{
+    std::lock_guard lock(m_controlMutex);
+    if (m_socket < 0)
+        return ErrorCode::INVALID_ARGUMENT;
+
+    uint8_t buf[kRtlTcpCommandSize];
+    EncodeRtlTcpCommand(buf, command, param);
+
+    std::size_t sent = 0;
+    while (sent < sizeof(buf))
+    {
+        const ssize_t ret = send(m_socket, buf + sent, sizeof(buf) - sent, MSG_NOSIGNAL);
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return ErrorCode::NETWORK_ERROR;
+        }
+        sent += ret;
+    }
+    return ErrorCode::OK;
+}
+
+std::vector<int> PortSDR::RtlTcpStream::GetTunerGains() const
+{
+    switch (m_tunerType)
+    {
+    case kRtlTcpTunerE4000:
+        return kE4000Gains;
+    case kRtlTcpTunerFC0012:
+        return kFC0012Gains;
+    case kRtlTcpTunerFC0013:
+        return kFC0013Gains;
+    case kRtlTcpTunerR820T:
+    case kRtlTcpTunerR828D:
+        return kR82XXGains;
+    default:
+        return {};
+    }
+}
+
+void PortSDR::RtlTcpStream::Receive()
+{
+    pollfd pfd{m_socket, POLLIN, 0};
+
+    while (m_running)
+    {
+        uint8_t* block;
+        {
+            std::unique_lock lock(m_ringMutex);
+            m_ringCond.wait(lock, [this]
+            {
+                return m_writeBlock - m_readBlock < m_blockCount || !m_running;
+            });
+
+            if (!m_running)
+                break;
+
+            block = m_ring.data() + (m_writeBlock % m_blockCount) * m_blockSize;
+        }
+
+        std::size_t filled = 0;
+        while (filled < m_blockSize && m_running)
+        {
+            const int ready = poll(&pfd, 1, POLL_TIMEOUT_MS);
+            if (ready == 0 || (ready < 0 && errno == EINTR))
+                continue;
+
+            const ssize_t ret = ready > 0 ? recv(m_socket, block + filled, m_blockSize - filled, 0) : -1;
+            if (ret < 0 && errno == EINTR)
+                continue;
+
+            if (ret <= 0)
+            {
+                // Server went away, Dispatch() finishes what is queued and exits.
+                std::lock_guard lock(m_ringMutex);
+                m_running = false;
+                m_disconnected = true;
+                break;
+            }
+
+            filled += ret;
+        }
+
+        if (filled < m_blockSize)
+            break;
+
+        {
+            std::lock_guard lock(m_ringMutex);
+            m_writeBlock++;
+        }
+        m_ringCond.notify_all();
+    }
+
+    m_ringCond.notify_all();
+
+    if (m_disconnected && m_streaming)
+        ReportFailure(ErrorCode::NETWORK_ERROR);
+}
+
+void PortSDR::RtlTcpStream::Dispatch()
+{
+    while (true)
+    {
+        const uint8_t* block;
+        {
+            std::unique_lock lock(m_ringMutex);
+            m_ringCond.wait(lock, [this]
+            {
+                return m_readBlock < m_writeBlock || !m_running;
+            });
+
+            // Stopped, what is still queued is stale.
+            if (!m_streaming)
+            {
+                m_readBlock = m_writeBlock;
+                break;
+            }
+
+            if (m_readBlock == m_writeBlock)
+                break;
+
+            block = m_ring.data() + (m_readBlock % m_blockCount) * m_blockSize;
+        }
+
+        const SampleFormat format = m_sampleFormat;
+
+        SDRTransfer transfer{};
+        transfer.format = format;
+        transfer.frame_size = m_blockSize / 2;
+
+        if (IsPlanar())
+        {
+            // Converted and split in the same pass.
+            PreparePlanar(transfer, transfer.frame_size, format);
+            ConvertSamplesPlanar(block, SAMPLE_FORMAT_IQ_UINT8, transfer.data, transfer.data_q, format, m_blockSize);
+        }
+        else if (format == SAMPLE_FORMAT_IQ_UINT8)
+        {
+            transfer.data = const_cast<uint8_t*>(block);
+        }
+        else
+        {
+            m_converted.resize(transfer.frame_size * GetSampleSize(format));
+            ConvertFromUInt8(block, format, m_converted.data(), m_blockSize);
+            transfer.data = m_converted.data();
+        }
+
+        Deliver(transfer);
+
+        {
+            std::lock_guard lock(m_ringMutex);
+            m_readBlock++;
+        }
+        m_ringCond.notify_all();
+    }
+}
@@ -0,0 +1,112 @@
+#ifndef RTLTCP_H
+#define RTLTCP_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../Host.h"
+#include "../net/RtlTcpProtocol.h"
+
+namespace PortSDR
+{
+    /**
+     * Remote rtl_tcp servers.
+     * Devices are "host:port" endpoints listed in the PORTSDR_RTL_TCP environment variable,
+     * separated by commas. Any endpoint can also be opened directly with a Device of this type.
+     */
+    class RtlTcpHost final : public Host
+    {
+    public:
+        RtlTcpHost();
+
+        [[nodiscard]] std::vector<Device> AvailableDevices() const override;
+        [[nodiscard]] std::unique_ptr<StreamImpl> CreateStream() const override;
+    };
+
+    class RtlTcpStream final : public StreamImpl
+    {
+    public:
+        ~RtlTcpStream() override;
+
+        ErrorCode Initialize(const Device& device) override;
+        DeviceInfo GetUSBStrings() override;
+
+        ErrorCode Start() override;
+        ErrorCode Stop() override;
+
+        ErrorCode SetCenterFrequency(uint32_t freq) override;
+        ErrorCode SetSampleRate(uint32_t sampleRate) override;
+        ErrorCode SetSampleFormat(SampleFormat format) override;
+
+        ErrorCode SetGain(double gain, std::string_view name) override;
+        ErrorCode SetGainMode(GainMode mode) override;
+
+        [[nodiscard]] std::vector<uint32_t> GetSampleRates() const override;
+        [[nodiscard]] std::vector<SampleFormat> GetSampleFormats() const override;
+
+        [[nodiscard]] std::vector<GainMode> GetGainModes() const override;
+        [[nodiscard]] std::vector<Gain> GetGainStages(GainMode mode) const override;
+        [[nodiscard]] std::string GetTunerType() const override;
+
+        [[nodiscard]] uint32_t GetCenterFrequency() const override;
+        [[nodiscard]] uint32_t GetSampleRate() const override;
+        [[nodiscard]] double GetGain(std::string_view name) const override;
+        [[nodiscard]] GainMode GetGainMode() const override;
+
+    protected:
+        ErrorCode Reopen() override;
+
+        [[nodiscard]] bool CanReopen() const override
+        {
+            return true;
+        }
+
+    private:
+        ErrorCode Connect();
+        void StartThreads();
+        void StopThreads();
+
+        ErrorCode SendCommand(RtlTcpCommand command, uint32_t param);
+        [[nodiscard]] std::vector<int> GetTunerGains() const;
+
+        void Receive();
+        void Dispatch();
+
+    private:
+        /* Guards the socket, the connection and commands sent on it, never taken by the receiving threads */
+        mutable std::recursive_mutex m_controlMutex;
+        int m_socket = -1;
+        std::string m_endpoint; // Set once by Initialize()
+
+        /* Read by the getters without the lock, so a callback may call them */
+        std::atomic<uint32_t> m_tunerType{0};
+
+        std::atomic<uint32_t> m_freq{0};
+        std::atomic<uint32_t> m_sampleRate{0};
+        std::atomic<int> m_gain{0};
+        std::atomic<bool> m_gainSet{false};
+        std::atomic<SampleFormat> m_sampleFormat{SAMPLE_FORMAT_IQ_UINT8};
+
+        /* Blocks of received bytes, filled by Receive() and handed to Dispatch() */
+        Buffer<uint8_t> m_ring;
+        std::size_t m_blockSize = 0;
+        std::size_t m_blockCount = 0;
+        uint64_t m_readBlock = 0;
+        uint64_t m_writeBlock = 0;
+        std::mutex m_ringMutex;
+        std::condition_variable m_ringCond;
+
+        Buffer<uint8_t> m_converted;
+
+        std::thread m_receiveThread;
+        std::thread m_deliverThread;
+        std::atomic<bool> m_running{false}; // Threads keep going, cleared when the server disconnects
+        std::atomic<bool> m_streaming{false}; // Between Start() and Stop()
+        std::atomic<bool> m_disconnected{false};
+    };
+}
+
+#endif //RTLTCP_H
@@ -0,0 +1,34 @@
+#include "VendorLibrary.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+bool PortSDR::VendorLibrary::Open(const std::initializer_list<const char*> names)
+{
+    for (const char* name : names)
+    {
+#ifdef _WIN32
+        m_handle = reinterpret_cast<void*>(LoadLibraryA(name));
+#else
+        m_handle = dlopen(name, RTLD_NOW | RTLD_LOCAL);
+#endif
+        if (m_handle)
+            return true;
+    }
+    return false;
+}
+
+void* PortSDR::VendorLibrary::Symbol(const char* name) const
+{
+    if (!m_handle)
+        return nullptr;
+
+#ifdef _WIN32
+    return reinterpret_cast<void*>(GetProcAddress(static_cast<HMODULE>(m_handle), name));
+#else
+    return dlsym(m_handle, name);
+#endif
+}
@@ -0,0 +1,42 @@
+#ifndef PORTSDR_VENDORLIBRARY_H
+#define PORTSDR_VENDORLIBRARY_H
+
+#include <initializer_list>
+
+namespace PortSDR
+{
+    /**
+     * Vendor library loaded at runtime, so a missing one only makes its host unavailable.
+     * The library stays loaded until the process exits.
+     */
+    class VendorLibrary
+    {
+    public:
+        /**
+         * Loads the first of the names that can be found.
+         * @param names file names in the order they are tried.
+         * @return true if one was loaded.
+         */
+        bool Open(std::initializer_list<const char*> names);
+
+        /**
+         * Looks up a function of the library.
+         * @param name exported name.
+         * @param function set to the address, nullptr if it isn't exported.
+         * @return true if it was found.
+         */
+        template <typename T>
+        bool Resolve(const char* name, T& function) const
+        {
+            function = reinterpret_cast<T>(Symbol(name));
+            return function != nullptr;
+        }
+
+    private:
+        [[nodiscard]] void* Symbol(const char* name) const;
+
+        void* m_handle = nullptr;
+    };
+}
+
+#endif //PORTSDR_VENDORLIBRARY_H
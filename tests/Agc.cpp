@@ -0,0 +1,149 @@
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "Agc.h"
+#include "FakeStream.h"
+
+using namespace std::chrono_literals;
+
+/**
+ * Generates a tone whose amplitude follows the gain of the stream, like a receiver would.
+ */
+static PortSDR::SDRTransfer MakeTone(std::vector<int16_t>& buffer, const double gain, const double inputDbfs)
+{
+    constexpr std::size_t frames = 4096;
+    const double amplitude = std::pow(10.0, (inputDbfs + gain) / 20.0) * 32767.0;
+
+    buffer.resize(frames * 2);
+    for (std::size_t i = 0; i < frames; i++)
+    {
+        const double phase = 0.05 * static_cast<double>(i);
+        buffer[i * 2] = static_cast<int16_t>(std::clamp(amplitude * std::cos(phase), -32768.0, 32767.0));
+        buffer[i * 2 + 1] = static_cast<int16_t>(std::clamp(amplitude * std::sin(phase), -32768.0, 32767.0));
+    }
+
+    PortSDR::SDRTransfer transfer{};
+    transfer.data = buffer.data();
+    transfer.frame_size = frames;
+    transfer.format = PortSDR::SAMPLE_FORMAT_IQ_INT16;
+    return transfer;
+}
+
+TEST(Agc, UnknownStage)
+{
+    FakeStream stream;
+    PortSDR::Agc agc(stream);
+
+    PortSDR::AgcConfig config;
+    config.stage = "VGA";
+    EXPECT_EQ(agc.Start(config), PortSDR::ErrorCode::INVALID_ARGUMENT);
+}
+
+TEST(Agc, ConvergesToTarget)
+{
+    FakeStream stream;
+    PortSDR::Agc agc(stream);
+
+    std::vector<PortSDR::GainEvent> events;
+    agc.SetEventCallback([&](const PortSDR::GainEvent& event)
+    {
+        events.push_back(event);
+    });
+
+    std::size_t forwarded = 0;
+    agc.SetCallback([&](PortSDR::SDRTransfer&)
+    {
+        forwarded++;
+    });
+
+    PortSDR::AgcConfig config;
+    config.min_interval = 1ms;
+    ASSERT_EQ(agc.Start(config), PortSDR::ErrorCode::OK);
+
+    // A -50 dBFS signal needs about 38 dB of gain to reach -12 dBFS.
+    std::vector<int16_t> buffer;
+    for (int i = 0; i < 500; i++)
+    {
+        stream.Inject([&] { return MakeTone(buffer, stream.GetGain("LNA"), -50.0); });
+        std::this_thread::sleep_for(1ms);
+    }
+    agc.Stop();
+
+    EXPECT_EQ(forwarded, 500u);
+    EXPECT_NEAR(agc.GetPowerDbfs(), config.target_dbfs, config.hysteresis_db);
+    EXPECT_NEAR(stream.GetGain("LNA"), 38.0, config.hysteresis_db);
+
+    // Each change starts at the transfer its gain tag was delivered with.
+    ASSERT_FALSE(events.empty());
+    for (std::size_t i = 0; i < events.size(); i++)
+    {
+        EXPECT_LE(std::fabs(events[i].gain - events[i].previous), config.max_step_db);
+        EXPECT_EQ(events[i].sample_index % 4096, 0u);
+        if (i > 0)
+        {
+            EXPECT_GT(events[i].sample_index, events[i - 1].sample_index);
+            EXPECT_EQ(events[i].previous, events[i - 1].gain);
+        }
+    }
+    EXPECT_EQ(events.back().gain, agc.GetGain());
+}
+
+TEST(Agc, ClippingBacksOff)
+{
+    FakeStream stream;
+    ASSERT_EQ(stream.SetGain(40, "LNA"), PortSDR::ErrorCode::OK);
+
+    PortSDR::Agc agc(stream);
+
+    std::vector<PortSDR::GainEvent> events;
+    agc.SetEventCallback([&](const PortSDR::GainEvent& event)
+    {
+        events.push_back(event);
+    });
+
+    PortSDR::AgcConfig config;
+    config.min_interval = 1ms;
+    ASSERT_EQ(agc.Start(config), PortSDR::ErrorCode::OK);
+
+    // Overdriven by 10 dB, the average power alone would be close to the target.
+    std::vector<int16_t> buffer;
+    for (int i = 0; i < 100 && events.empty(); i++)
+    {
+        stream.Inject([&] { return MakeTone(buffer, stream.GetGain("LNA"), -30.0); });
+        std::this_thread::sleep_for(1ms);
+    }
+    agc.Stop();
+
+    ASSERT_FALSE(events.empty());
+    EXPECT_EQ(events[0].previous, 40);
+    EXPECT_EQ(events[0].gain, 40 - config.max_step_db);
+}
+
+TEST(Agc, RateLimited)
+{
+    FakeStream stream;
+    PortSDR::Agc agc(stream);
+
+    int changes = 0;
+    agc.SetEventCallback([&](const PortSDR::GainEvent&) { ++changes; });
+
+    PortSDR::AgcConfig config;
+    config.min_interval = 200ms;
+    ASSERT_EQ(agc.Start(config), PortSDR::ErrorCode::OK);
+
+    // The signal never responds to the gain, so the AGC keeps asking for more.
+    std::vector<int16_t> buffer;
+    const auto end = std::chrono::steady_clock::now() + 300ms;
+    while (std::chrono::steady_clock::now() < end)
+    {
+        stream.Inject([&] { return MakeTone(buffer, 0, -80.0); });
+        std::this_thread::sleep_for(1ms);
+    }
+    agc.Stop();
+
+    EXPECT_GE(changes, 1);
+    EXPECT_LE(changes, 2);
+}
@@ -0,0 +1,98 @@
+#include <cstdint>
+#include <cstring>
+#include <gtest/gtest.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "Allocator.h"
+
+/**
+ * Counts what goes through it, on top of the default allocator.
+ */
+class CountingAllocator final : public PortSDR::Allocator
+{
+public:
+    void* Allocate(const std::size_t size) override
+    {
+        allocated += size;
+        return m_inner.Allocate(size);
+    }
+
+    void Deallocate(void* ptr, const std::size_t size) override
+    {
+        allocated -= size;
+        m_inner.Deallocate(ptr, size);
+    }
+
+    std::size_t allocated = 0;
+
+private:
+    PortSDR::HugePageAllocator m_inner;
+};
+
+TEST(Allocator, SmallAndLarge)
+{
+    PortSDR::HugePageAllocator allocator;
+
+    void* small = allocator.Allocate(1000);
+    ASSERT_NE(small, nullptr);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(small) % 64, 0u);
+    std::memset(small, 1, 1000);
+    allocator.Deallocate(small, 1000);
+
+    // Huge pages if the system has some reserved, regular pages otherwise.
+    constexpr std::size_t size = 5 * 1024 * 1024;
+    auto* large = static_cast<uint8_t*>(allocator.Allocate(size));
+    ASSERT_NE(large, nullptr);
+    std::memset(large, 2, size);
+    EXPECT_EQ(large[size - 1], 2);
+
+#ifdef __linux__
+    EXPECT_EQ(allocator.GetHugePageBytes() + allocator.GetFallbackBytes(), 6u * 1024 * 1024);
+#endif
+
+    allocator.Deallocate(large, size);
+    EXPECT_EQ(allocator.GetHugePageBytes(), 0u);
+    EXPECT_EQ(allocator.GetFallbackBytes(), 0u);
+}
+
+#ifdef __linux__
+TEST(Allocator, NumaNode)
+{
+    PortSDR::HugePageAllocator allocator(0);
+    EXPECT_EQ(allocator.GetNumaNode(), 0);
+
+    constexpr std::size_t size = 256 * 1024;
+    void* ptr = allocator.Allocate(size);
+    ASSERT_NE(ptr, nullptr);
+
+    // MPOL_F_ADDR reports the policy of the mapping, MPOL_PREFERRED on node 0.
+    int mode = -1;
+    unsigned long mask = 0;
+    if (syscall(SYS_get_mempolicy, &mode, &mask, sizeof(mask) * 8 + 1, ptr, 2) == 0)
+    {
+        EXPECT_EQ(mode, 1);
+        EXPECT_EQ(mask, 1u);
+    }
+
+    allocator.Deallocate(ptr, size);
+}
+#endif
+
+TEST(Allocator, LibraryBuffers)
+{
+    CountingAllocator counting;
+    PortSDR::SetAllocator(&counting);
+    {
+        PortSDR::Buffer<float> buffer(1024);
+        EXPECT_EQ(counting.allocated, 1024 * sizeof(float));
+        EXPECT_EQ(buffer.get_allocator().GetAllocator(), &counting);
+    }
+    EXPECT_EQ(counting.allocated, 0u);
+
+    PortSDR::SetAllocator(nullptr);
+    EXPECT_NE(&PortSDR::GetAllocator(), &counting);
+}
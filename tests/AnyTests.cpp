@@ -48,3 +48,20 @@ TEST(AnyTest, Devices)
 
     ASSERT_TRUE(device);
 }
+
+TEST(AnyTest, UnavailableHost)
+{
+    PortSDR::PortSDR sdr;
+
+    // Hosts whose vendor library is missing can't create streams, without failing anything else.
+    for (const PortSDR::HostType type : {PortSDR::HostType::RTL_SDR, PortSDR::HostType::AIRSPY,
+                                         PortSDR::HostType::AIRSPY_HF, PortSDR::HostType::RTL_TCP})
+    {
+        if (sdr.IsHostAvailable(type))
+            continue;
+
+        std::unique_ptr<PortSDR::Stream> stream;
+        EXPECT_EQ(sdr.CreateStream({type, "00000000"}, stream), PortSDR::ErrorCode::HOST_UNAVAILABLE);
+        EXPECT_TRUE(sdr.GetHostDevices(type).empty());
+    }
+}
@@ -0,0 +1,168 @@
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "Burst.h"
+#include "FakeStream.h"
+
+using namespace std::chrono_literals;
+
+namespace
+{
+    /**
+     * Noise with tone bursts in samples [from, to) of each burst.
+     */
+    class BurstSource
+    {
+    public:
+        explicit BurstSource(std::vector<std::pair<uint64_t, uint64_t>> bursts)
+            : m_bursts(std::move(bursts))
+        {
+        }
+
+        std::vector<float> Generate(const uint64_t from, const std::size_t count)
+        {
+            std::uniform_real_distribution<float> noise(-0.01f, 0.01f);
+
+            std::vector<float> values(count * 2);
+            for (std::size_t i = 0; i < count; i++)
+            {
+                const uint64_t index = from + i;
+                values[i * 2] = noise(m_random);
+                values[i * 2 + 1] = noise(m_random);
+
+                for (const auto& [start, end] : m_bursts)
+                {
+                    if (index >= start && index < end)
+                    {
+                        values[i * 2] += 0.5f * std::cos(0.1f * index);
+                        values[i * 2 + 1] += 0.5f * std::sin(0.1f * index);
+                    }
+                }
+            }
+            return values;
+        }
+
+    private:
+        std::vector<std::pair<uint64_t, uint64_t>> m_bursts;
+        std::mt19937 m_random{1234};
+    };
+
+    std::vector<float> Feed(PortSDR::BurstRecorder& recorder, BurstSource& source, const int transfers,
+                            const std::size_t frameSize)
+    {
+        std::vector<float> all;
+        for (int t = 0; t < transfers; t++)
+        {
+            std::vector<float> values = source.Generate(t * frameSize, frameSize);
+            all.insert(all.end(), values.begin(), values.end());
+
+            PortSDR::SDRTransfer transfer{};
+            transfer.data = values.data();
+            transfer.frame_size = frameSize;
+            transfer.format = PortSDR::SAMPLE_FORMAT_IQ_FLOAT32;
+            recorder.Process(transfer);
+        }
+        return all;
+    }
+
+    std::vector<float> ReadFile(const std::string& path)
+    {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        std::vector<float> values(static_cast<std::size_t>(file.tellg()) / sizeof(float));
+        file.seekg(0);
+        file.read(reinterpret_cast<char*>(values.data()), static_cast<std::streamsize>(values.size() * sizeof(float)));
+        return values;
+    }
+}
+
+TEST(Burst, Record)
+{
+    FakeStream stream(PortSDR::SAMPLE_FORMAT_IQ_FLOAT32);
+    stream.SetSampleRate(1000000);
+    stream.SetCenterFrequency(433920000);
+
+    PortSDR::BurstConfig config;
+    config.pre_padding = 5ms;
+    config.post_padding = 10ms;
+    config.format = PortSDR::SAMPLE_FORMAT_IQ_FLOAT32;
+
+    const std::string path = testing::TempDir() + "portsdr_bursts.cf32";
+    PortSDR::BurstRecorder recorder(stream);
+    ASSERT_EQ(recorder.Start(path, config), PortSDR::ErrorCode::OK);
+
+    BurstSource source({{50000, 55000}, {150000, 152000}});
+    const std::vector<float> all = Feed(recorder, source, 30, 10000);
+    EXPECT_LT(recorder.GetNoiseFloor(), -40.0);
+    recorder.Stop();
+
+    const std::vector<PortSDR::BurstInfo> bursts = recorder.GetBursts();
+    ASSERT_EQ(bursts.size(), 2u);
+
+    // Block aligned, so the ends are off by less than a block.
+    EXPECT_EQ(bursts[0].start_sample, 45000u);
+    EXPECT_GE(bursts[0].start_sample + bursts[0].samples, 65000u);
+    EXPECT_LT(bursts[0].start_sample + bursts[0].samples, 65000u + config.block_size);
+    EXPECT_EQ(bursts[1].start_sample, 145000u);
+    EXPECT_GE(bursts[1].start_sample + bursts[1].samples, 162000u);
+    EXPECT_LT(bursts[1].start_sample + bursts[1].samples, 162000u + config.block_size);
+
+    EXPECT_EQ(bursts[0].frequency, 433920000);
+    EXPECT_NEAR(bursts[0].peak_dbfs, 10.0 * std::log10(0.25), 1.0);
+    EXPECT_LT(bursts[0].noise_dbfs, -40.0);
+
+    // Only the bursts are on disk, back to back.
+    const std::vector<float> data = ReadFile(path);
+    ASSERT_EQ(data.size(), (bursts[0].samples + bursts[1].samples) * 2);
+    for (const PortSDR::BurstInfo& burst : bursts)
+    {
+        const float* expected = all.data() + burst.start_sample * 2;
+        const float* actual = data.data() + burst.offset / sizeof(float);
+        EXPECT_TRUE(std::equal(actual, actual + burst.samples * 2, expected));
+    }
+
+    std::ifstream index(path + ".csv");
+    std::string line;
+    int lines = 0;
+    while (std::getline(index, line))
+        lines++;
+    EXPECT_EQ(lines, 3);
+
+    std::remove(path.c_str());
+    std::remove((path + ".csv").c_str());
+}
+
+TEST(Burst, Split)
+{
+    FakeStream stream(PortSDR::SAMPLE_FORMAT_IQ_FLOAT32);
+    stream.SetSampleRate(1000000);
+
+    PortSDR::BurstConfig config;
+    config.pre_padding = 5ms;
+    config.post_padding = 10ms;
+    config.max_burst = 40ms;
+    config.format = PortSDR::SAMPLE_FORMAT_IQ_FLOAT32;
+
+    const std::string path = testing::TempDir() + "portsdr_bursts_split.cf32";
+    PortSDR::BurstRecorder recorder(stream);
+    ASSERT_EQ(recorder.Start(path, config), PortSDR::ErrorCode::OK);
+
+    BurstSource source({{50000, 150000}});
+    Feed(recorder, source, 20, 10000);
+    recorder.Stop();
+
+    // The pieces follow each other without a gap.
+    const std::vector<PortSDR::BurstInfo> bursts = recorder.GetBursts();
+    ASSERT_GE(bursts.size(), 3u);
+    EXPECT_EQ(bursts[0].start_sample, 45000u);
+    for (std::size_t i = 1; i < bursts.size(); i++)
+        EXPECT_EQ(bursts[i].start_sample, bursts[i - 1].start_sample + bursts[i - 1].samples);
+    EXPECT_GE(bursts.back().start_sample + bursts.back().samples, 160000u);
+
+    std::remove(path.c_str());
+    std::remove((path + ".csv").c_str());
+}
@@ -0,0 +1,137 @@
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Capabilities.h"
+#include "FakeStream.h"
+
+static std::string CachePath(const char* test)
+{
+    return testing::TempDir() + "portsdr_capabilities_" + test + "_" + std::to_string(getpid());
+}
+
+static ino_t FileId(const std::string& path)
+{
+    struct stat info{};
+    return stat(path.c_str(), &info) == 0 ? info.st_ino : 0;
+}
+
+TEST(Capabilities, RoundTrip)
+{
+    const std::string path = CachePath("roundtrip");
+    const PortSDR::Device device{PortSDR::HostType::RTL_SDR, "FAKE0001"};
+    const PortSDR::Device other{PortSDR::HostType::AIRSPY, "FAKE0001"};
+
+    FakeStream stream;
+    {
+        PortSDR::CapabilityCache cache(path);
+        ASSERT_EQ(cache.Load(), PortSDR::ErrorCode::OK);
+
+        PortSDR::Capabilities capabilities;
+        EXPECT_FALSE(cache.Find(device, capabilities));
+
+        ASSERT_EQ(cache.Refresh(device, stream).get(), PortSDR::ErrorCode::OK);
+        ASSERT_EQ(cache.Store(other, {}), PortSDR::ErrorCode::OK);
+        EXPECT_EQ(cache.GetSize(), 2u);
+    }
+
+    // Another process starting up only maps the file.
+    PortSDR::CapabilityCache cache(path);
+    ASSERT_EQ(cache.Load(), PortSDR::ErrorCode::OK);
+    EXPECT_EQ(cache.GetSize(), 2u);
+
+    PortSDR::Capabilities capabilities;
+    ASSERT_TRUE(cache.Find(device, capabilities));
+    EXPECT_EQ(capabilities.tuner_type, "Fake");
+    EXPECT_EQ(capabilities.sample_rates, stream.GetSampleRates());
+    EXPECT_EQ(capabilities.sample_formats, stream.GetSampleFormats());
+    ASSERT_EQ(capabilities.gain_modes, std::vector<PortSDR::GainMode>{PortSDR::GAIN_MODE_FREE});
+    ASSERT_EQ(capabilities.gain_stages.size(), 1u);
+    ASSERT_EQ(capabilities.gain_stages[0].size(), 1u);
+    EXPECT_EQ(capabilities.gain_stages[0][0].stage, "LNA");
+    EXPECT_EQ(capabilities.gain_stages[0][0].range.Max(), 49);
+
+    ASSERT_TRUE(cache.Find(other, capabilities));
+    EXPECT_TRUE(capabilities.sample_rates.empty());
+
+    // Up to date, so it isn't written again.
+    const ino_t written = FileId(path);
+    ASSERT_EQ(cache.Refresh(device, stream).get(), PortSDR::ErrorCode::OK);
+    EXPECT_EQ(FileId(path), written);
+
+    // Changed, so it is replaced.
+    capabilities.tuner_type = "Old";
+    ASSERT_EQ(cache.Store(device, capabilities), PortSDR::ErrorCode::OK);
+    ASSERT_EQ(cache.Refresh(device, stream).get(), PortSDR::ErrorCode::OK);
+    ASSERT_TRUE(cache.Find(device, capabilities));
+    EXPECT_EQ(capabilities.tuner_type, "Fake");
+    EXPECT_EQ(cache.GetSize(), 2u);
+
+    std::remove(path.c_str());
+    std::remove((path + ".lock").c_str());
+}
+
+TEST(Capabilities, ConcurrentStores)
+{
+    const std::string path = CachePath("concurrent");
+
+    // Both map the file before either stores, like two processes starting together.
+    PortSDR::CapabilityCache first(path);
+    PortSDR::CapabilityCache second(path);
+    ASSERT_EQ(first.Load(), PortSDR::ErrorCode::OK);
+    ASSERT_EQ(second.Load(), PortSDR::ErrorCode::OK);
+
+    ASSERT_EQ(first.Store({PortSDR::HostType::RTL_SDR, "FAKE0001"}, {}), PortSDR::ErrorCode::OK);
+    ASSERT_EQ(second.Store({PortSDR::HostType::RTL_SDR, "FAKE0002"}, {}), PortSDR::ErrorCode::OK);
+    EXPECT_EQ(second.GetSize(), 2u);
+
+    // Writers racing each other keep every entry.
+    std::vector<std::thread> writers;
+    for (int i = 0; i < 8; i++)
+    {
+        writers.emplace_back([&path, i]
+        {
+            PortSDR::CapabilityCache cache(path);
+            for (int j = 0; j < 10; j++)
+            {
+                const PortSDR::Device device{PortSDR::HostType::AIRSPY, std::to_string(i * 10 + j)};
+                EXPECT_EQ(cache.Store(device, {}), PortSDR::ErrorCode::OK);
+            }
+        });
+    }
+    for (std::thread& writer : writers)
+        writer.join();
+
+    PortSDR::CapabilityCache cache(path);
+    ASSERT_EQ(cache.Load(), PortSDR::ErrorCode::OK);
+    EXPECT_EQ(cache.GetSize(), 82u);
+
+    std::remove(path.c_str());
+    std::remove((path + ".lock").c_str());
+}
+
+TEST(Capabilities, OtherVersion)
+{
+    const std::string path = CachePath("version");
+    {
+        std::ofstream file(path, std::ios::binary);
+        const uint32_t header[4] = {0x43445350, 0, 1, 0};
+        file.write(reinterpret_cast<const char*>(header), sizeof(header));
+        file << "garbage";
+    }
+
+    PortSDR::CapabilityCache cache(path);
+    ASSERT_EQ(cache.Load(), PortSDR::ErrorCode::OK);
+    EXPECT_EQ(cache.GetSize(), 0u);
+
+    PortSDR::Capabilities capabilities;
+    EXPECT_FALSE(cache.Find({PortSDR::HostType::RTL_SDR, "FAKE0001"}, capabilities));
+
+    std::remove(path.c_str());
+}
@@ -0,0 +1,168 @@
+#include <cstdio>
+#include <future>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "Capture.h"
+#include "FakeStream.h"
+
+using namespace std::chrono_literals;
+
+namespace
+{
+    // Values of samples [from, to) of the fake stream.
+    std::vector<uint8_t> Pattern(const uint64_t from, const uint64_t to)
+    {
+        std::vector<uint8_t> values;
+        for (uint64_t i = from * 2; i < to * 2; i++)
+            values.push_back(static_cast<uint8_t>(i));
+        return values;
+    }
+
+    std::vector<uint8_t> Join(const PortSDR::CaptureSnapshot& snapshot)
+    {
+        std::vector<uint8_t> values(snapshot.GetFirst().begin(), snapshot.GetFirst().end());
+        values.insert(values.end(), snapshot.GetSecond().begin(), snapshot.GetSecond().end());
+        return values;
+    }
+}
+
+TEST(Capture, Window)
+{
+    FakeStream stream(PortSDR::SAMPLE_FORMAT_IQ_UINT8, 1000);
+    stream.SetSampleRate(1024000);
+
+    PortSDR::CaptureRing ring(stream);
+
+    // Transfers are handed on once recorded.
+    uint64_t forwarded = 0;
+    ring.SetCallback([&ring, &forwarded](const PortSDR::SDRTransfer& transfer)
+    {
+        forwarded = ring.GetNewestIndex();
+        EXPECT_EQ(transfer.frame_size, 1000u);
+    });
+
+    PortSDR::CaptureConfig config;
+    config.duration = 4ms;
+    ASSERT_EQ(ring.Start(config), PortSDR::ErrorCode::OK);
+    EXPECT_EQ(ring.GetCapacity(), 4096u);
+    EXPECT_EQ(ring.GetMemoryUsage(), 4096u * 2);
+
+    for (int i = 0; i < 10; i++)
+        stream.Emit();
+
+    EXPECT_EQ(ring.GetNewestIndex(), 10000u);
+    EXPECT_EQ(ring.GetOldestIndex(), 10000u - 4096);
+    EXPECT_EQ(forwarded, 10000u);
+
+    // Wraps around the end of the ring.
+    PortSDR::CaptureSnapshot snapshot;
+    ASSERT_EQ(ring.Snapshot(7000, 9000, snapshot), PortSDR::ErrorCode::OK);
+    EXPECT_FALSE(snapshot.GetSecond().empty());
+    EXPECT_EQ(Join(snapshot), Pattern(7000, 9000));
+
+    // Clamped to what the ring holds.
+    ASSERT_EQ(ring.Snapshot(0, 20000, snapshot), PortSDR::ErrorCode::OK);
+    EXPECT_EQ(snapshot.GetFrom(), 10000u - 4096);
+    EXPECT_EQ(snapshot.GetTo(), 10000u);
+    EXPECT_EQ(Join(snapshot), Pattern(10000 - 4096, 10000));
+
+    EXPECT_EQ(ring.Snapshot(0, 1000, snapshot), PortSDR::ErrorCode::INVALID_ARGUMENT);
+    EXPECT_FALSE(snapshot.IsValid());
+
+    // The stream callback is removed, the samples stay.
+    snapshot.Release();
+    ring.Stop();
+    stream.Emit();
+    EXPECT_EQ(ring.GetNewestIndex(), 10000u);
+    EXPECT_EQ(forwarded, 10000u);
+}
+
+TEST(Capture, MemoryBound)
+{
+    FakeStream stream(PortSDR::SAMPLE_FORMAT_IQ_FLOAT32, 1024);
+    stream.SetSampleRate(2048000);
+
+    PortSDR::CaptureRing ring(stream);
+
+    PortSDR::CaptureConfig config;
+    config.duration = 10s;
+    config.max_bytes = 1 << 20;
+    config.format = PortSDR::SAMPLE_FORMAT_IQ_FLOAT32;
+    ASSERT_EQ(ring.Start(config), PortSDR::ErrorCode::OK);
+    EXPECT_EQ(ring.GetMemoryUsage(), 1u << 20);
+    EXPECT_EQ(ring.GetCapacity(), (1u << 20) / 8);
+}
+
+TEST(Capture, Pinned)
+{
+    FakeStream stream(PortSDR::SAMPLE_FORMAT_IQ_UINT8, 1024);
+    stream.SetSampleRate(1024000);
+
+    PortSDR::CaptureRing ring(stream);
+
+    PortSDR::CaptureConfig config;
+    config.duration = 4ms;
+    ASSERT_EQ(ring.Start(config), PortSDR::ErrorCode::OK);
+
+    for (int i = 0; i < 4; i++)
+        stream.Emit();
+
+    PortSDR::CaptureSnapshot snapshot;
+    ASSERT_EQ(ring.Snapshot(0, 4096, snapshot), PortSDR::ErrorCode::OK);
+
+    // The pinned samples aren't overwritten.
+    stream.Emit();
+    stream.Emit();
+    EXPECT_EQ(ring.GetBlockedSamples(), 2048u);
+    EXPECT_EQ(Join(snapshot), Pattern(0, 4096));
+
+    // Recording starts over after the gap.
+    snapshot.Release();
+    stream.Emit();
+    EXPECT_EQ(ring.GetOldestIndex(), 6144u);
+    EXPECT_EQ(ring.GetNewestIndex(), 7168u);
+
+    ASSERT_EQ(ring.Snapshot(6144, 7168, snapshot), PortSDR::ErrorCode::OK);
+    EXPECT_EQ(Join(snapshot), Pattern(6144, 7168));
+}
+
+TEST(Capture, Save)
+{
+    FakeStream stream(PortSDR::SAMPLE_FORMAT_IQ_UINT8, 1024);
+    stream.SetSampleRate(1024000);
+
+    PortSDR::CaptureRing ring(stream);
+
+    PortSDR::CaptureConfig config;
+    config.duration = 4ms;
+    ASSERT_EQ(ring.Start(config), PortSDR::ErrorCode::OK);
+
+    for (int i = 0; i < 6; i++)
+        stream.Emit();
+
+    const std::string path = testing::TempDir() + "portsdr_capture.cu8";
+
+    std::promise<PortSDR::ErrorCode> saved;
+    ASSERT_EQ(ring.Save(3000, 6000, path, [&saved](const PortSDR::ErrorCode ret, const std::string&)
+    {
+        saved.set_value(ret);
+    }), PortSDR::ErrorCode::OK);
+
+    std::future<PortSDR::ErrorCode> result = saved.get_future();
+    ASSERT_EQ(result.wait_for(5s), std::future_status::ready);
+    ASSERT_EQ(result.get(), PortSDR::ErrorCode::OK);
+
+    std::vector<uint8_t> values(3000 * 2 + 1);
+    FILE* file = std::fopen(path.c_str(), "rb");
+    ASSERT_NE(file, nullptr);
+    values.resize(std::fread(values.data(), 1, values.size(), file));
+    std::fclose(file);
+    std::remove(path.c_str());
+
+    EXPECT_EQ(values, Pattern(3000, 6000));
+
+    // Unpinned once written.
+    stream.Emit();
+    EXPECT_EQ(ring.GetBlockedSamples(), 0u);
+}
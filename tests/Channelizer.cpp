@@ -0,0 +1,204 @@
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "Channelizer.h"
+
+static constexpr double kPi = 3.14159265358979323846;
+
+using Channels = std::vector<std::vector<std::complex<float>>>;
+
+/**
+ * Runs samples through a channelizer in pieces of the given size and collects every channel.
+ */
+static Channels Channelize(const PortSDR::ChannelizerConfig& config,
+                           std::vector<std::complex<float>> input,
+                           const std::size_t piece)
+{
+    Channels channels(config.channels);
+
+    PortSDR::Channelizer channelizer;
+    channelizer.SetCallback([&channels](const std::size_t channel, const PortSDR::SDRTransfer& transfer)
+    {
+        EXPECT_EQ(transfer.format, PortSDR::SAMPLE_FORMAT_IQ_FLOAT32);
+        const auto* data = static_cast<const std::complex<float>*>(transfer.data);
+        channels[channel].insert(channels[channel].end(), data, data + transfer.frame_size);
+    });
+    EXPECT_EQ(channelizer.Create(config), PortSDR::ErrorCode::OK);
+
+    for (std::size_t i = 0; i < input.size(); i += piece)
+    {
+        PortSDR::SDRTransfer transfer{};
+        transfer.data = input.data() + i;
+        transfer.frame_size = std::min(piece, input.size() - i);
+        transfer.format = PortSDR::SAMPLE_FORMAT_IQ_FLOAT32;
+        EXPECT_EQ(channelizer.Process(transfer), PortSDR::ErrorCode::OK);
+    }
+    return channels;
+}
+
+static double PowerDb(const std::vector<std::complex<float>>& samples, const std::size_t skip)
+{
+    double sum = 0;
+    for (std::size_t i = skip; i < samples.size(); i++)
+        sum += std::norm(samples[i]);
+    return 10.0 * std::log10(sum / static_cast<double>(samples.size() - skip) + 1e-30);
+}
+
+TEST(Channelizer, InvalidConfig)
+{
+    PortSDR::Channelizer channelizer;
+
+    PortSDR::ChannelizerConfig config;
+    config.channels = 48;
+    EXPECT_EQ(channelizer.Create(config), PortSDR::ErrorCode::INVALID_ARGUMENT);
+
+    PortSDR::SDRTransfer transfer{};
+    EXPECT_EQ(channelizer.Process(transfer), PortSDR::ErrorCode::UNINITIALIZED);
+}
+
+TEST(Channelizer, SeparatesTones)
+{
+    PortSDR::ChannelizerConfig config;
+    config.channels = 32;
+
+    // A tone in the center of channel 5 and a weaker one slightly off the center of channel 27 (-5).
+    std::vector<std::complex<float>> input(32 * 512);
+    for (std::size_t i = 0; i < input.size(); i++)
+    {
+        const double t = static_cast<double>(i);
+        input[i] = std::polar(0.5f, static_cast<float>(2 * kPi * 5.0 / 32.0 * t))
+            + std::polar(0.1f, static_cast<float>(2 * kPi * -5.1 / 32.0 * t));
+    }
+
+    const Channels channels = Channelize(config, input, 4096);
+    const std::size_t skip = config.taps_per_channel;
+
+    ASSERT_EQ(channels[5].size(), 512u);
+    EXPECT_NEAR(PowerDb(channels[5], skip), 20 * std::log10(0.5), 0.1);
+    EXPECT_NEAR(PowerDb(channels[27], skip), 20 * std::log10(0.1), 0.5);
+
+    for (std::size_t k = 0; k < config.channels; k++)
+    {
+        // Only the neighbouring channels share a transition band.
+        if (k >= 4 && k <= 6)
+            continue;
+        if (k >= 26 && k <= 28)
+            continue;
+        EXPECT_LT(PowerDb(channels[k], skip), -60.0) << "channel " << k;
+    }
+}
+
+TEST(Channelizer, MatchesMixer)
+{
+    PortSDR::ChannelizerConfig config;
+    config.channels = 16;
+    config.taps_per_channel = 8;
+
+    // An impulse comes out as the decimated prototype, mixed by the delay of the impulse.
+    constexpr std::size_t delay = 3;
+    std::vector<std::complex<float>> input(16 * 16);
+    input[delay] = 1.0f;
+
+    const Channels channels = Channelize(config, input, input.size());
+
+    for (std::size_t k = 0; k < config.channels; k++)
+    {
+        const std::complex<double> mixer = std::polar(1.0, -2 * kPi * static_cast<double>(k * delay) / 16.0);
+        for (std::size_t n = 0; n < channels[k].size(); n++)
+        {
+            const std::complex<double> expected = std::complex<double>(channels[0][n]) * mixer;
+            EXPECT_NEAR(channels[k][n].real(), expected.real(), 1e-6);
+            EXPECT_NEAR(channels[k][n].imag(), expected.imag(), 1e-6);
+        }
+    }
+
+    // Every channels-th tap of a prototype with unity gain adds up to about 1 / channels.
+    double sum = 0;
+    for (const auto& sample : channels[0])
+        sum += sample.real();
+    EXPECT_NEAR(sum, 1.0 / 16.0, 1e-3);
+}
+
+TEST(Channelizer, ThreadsAndPieces)
+{
+    std::mt19937 rng(99);
+    std::normal_distribution<float> dist(0.0f, 0.2f);
+
+    std::vector<std::complex<float>> input(256 * 64);
+    for (auto& sample : input)
+        sample = {dist(rng), dist(rng)};
+
+    PortSDR::ChannelizerConfig config;
+    config.channels = 256;
+
+    const Channels reference = Channelize(config, input, input.size());
+
+    config.threads = 4;
+    const Channels threaded = Channelize(config, input, input.size());
+    EXPECT_EQ(threaded, reference);
+
+    // Pieces that don't line up with the channels still give the same samples.
+    const Channels pieces = Channelize(config, input, 1000);
+    EXPECT_EQ(pieces, reference);
+}
+
+TEST(Channelizer, ChannelOffset)
+{
+    PortSDR::Channelizer channelizer;
+
+    PortSDR::ChannelizerConfig config;
+    config.channels = 8;
+    ASSERT_EQ(channelizer.Create(config), PortSDR::ErrorCode::OK);
+
+    EXPECT_DOUBLE_EQ(channelizer.GetChannelOffset(0, 2400000), 0);
+    EXPECT_DOUBLE_EQ(channelizer.GetChannelOffset(1, 2400000), 300000);
+    EXPECT_DOUBLE_EQ(channelizer.GetChannelOffset(7, 2400000), -300000);
+}
+
+TEST(Channelizer, Tags)
+{
+    constexpr std::size_t m = 8;
+    PortSDR::ChannelizerConfig config;
+    config.channels = m;
+    config.taps_per_channel = 4;
+
+    // Output n is the first to include input n * m.
+    std::vector<std::size_t> outputs(m);
+    std::vector<std::size_t> tagged(m, SIZE_MAX);
+
+    PortSDR::Channelizer channelizer;
+    channelizer.SetCallback([&](const std::size_t channel, const PortSDR::SDRTransfer& transfer)
+    {
+        for (std::size_t i = 0; i < transfer.tag_count; i++)
+        {
+            EXPECT_EQ(transfer.tags[i].sample_index, 250u);
+            tagged[channel] = outputs[channel] + transfer.tags[i].offset;
+        }
+        outputs[channel] += transfer.frame_size;
+    });
+    ASSERT_EQ(channelizer.Create(config), PortSDR::ErrorCode::OK);
+
+    std::vector<std::complex<float>> input(100);
+    for (std::size_t i = 0; i < 5; i++)
+    {
+        PortSDR::StreamTag tag{};
+        tag.type = PortSDR::STREAM_TAG_FREQUENCY;
+        tag.offset = 50;
+        tag.sample_index = 250;
+
+        PortSDR::SDRTransfer transfer{};
+        transfer.data = input.data();
+        transfer.frame_size = input.size();
+        transfer.format = PortSDR::SAMPLE_FORMAT_IQ_FLOAT32;
+        transfer.tags = i == 2 ? &tag : nullptr;
+        transfer.tag_count = i == 2 ? 1 : 0;
+        ASSERT_EQ(channelizer.Process(transfer), PortSDR::ErrorCode::OK);
+    }
+
+    for (std::size_t k = 0; k < m; k++)
+        EXPECT_EQ(tagged[k], (250 + m - 1) / m);
+}
@@ -0,0 +1,117 @@
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "FakeStream.h"
+
+using namespace std::chrono_literals;
+
+TEST(Control, Order)
+{
+    FakeStream stream;
+
+    std::vector<int> applied;
+    std::vector<std::future<PortSDR::ErrorCode>> results;
+    for (int i = 0; i < 1000; i++)
+    {
+        results.push_back(stream.Submit([&applied, i](PortSDR::Stream&)
+        {
+            applied.push_back(i);
+            return PortSDR::ErrorCode::OK;
+        }));
+    }
+    results.push_back(stream.SetCenterFrequencyAsync(100000000));
+    results.push_back(stream.SetGainAsync(20, "VGA"));
+
+    for (std::size_t i = 0; i < results.size() - 1; i++)
+        EXPECT_EQ(results[i].get(), PortSDR::ErrorCode::OK);
+    EXPECT_EQ(results.back().get(), PortSDR::ErrorCode::INVALID_ARGUMENT);
+
+    ASSERT_EQ(applied.size(), 1000u);
+    for (int i = 0; i < 1000; i++)
+        EXPECT_EQ(applied[i], i);
+    EXPECT_EQ(stream.GetCenterFrequency(), 100000000u);
+}
+
+TEST(Control, Stress)
+{
+    constexpr int threadCount = 8;
+    constexpr int commandCount = 500;
+
+    FakeStream stream(PortSDR::SAMPLE_FORMAT_IQ_UINT8, 1024);
+    stream.SetSampleRate(1024000);
+
+    // Retunes from the callback as well, it must not wait on anything.
+    std::atomic<uint64_t> transfers{0};
+    stream.SetCallback([&stream, &transfers](PortSDR::SDRTransfer&)
+    {
+        if (transfers.fetch_add(1) % 16 == 0)
+            stream.SetCenterFrequencyAsync(stream.GetCenterFrequency());
+    });
+    ASSERT_EQ(stream.Start(), PortSDR::ErrorCode::OK);
+
+    // Run on the control thread only, one at a time.
+    std::vector<int> last(threadCount, -1);
+    bool ordered = true;
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; t++)
+    {
+        threads.emplace_back([&, t]
+        {
+            std::vector<std::future<PortSDR::ErrorCode>> results;
+            for (int i = 0; i < commandCount; i++)
+            {
+                results.push_back(stream.Submit([&last, &ordered, t, i](PortSDR::Stream& target)
+                {
+                    ordered &= last[t] == i - 1;
+                    last[t] = i;
+                    return target.SetCenterFrequency(100000000 + t * 1000 + i);
+                }));
+                results.push_back(stream.SetGainAsync(i % 50, "LNA"));
+
+                if (i % 50 == 0)
+                {
+                    stream.SetSampleRate(i % 100 == 0 ? 1024000 : 2048000);
+                    EXPECT_GE(stream.GetGain("LNA"), 0.0);
+                }
+            }
+
+            for (std::future<PortSDR::ErrorCode>& result : results)
+                EXPECT_EQ(result.get(), PortSDR::ErrorCode::OK);
+        });
+    }
+
+    for (std::thread& thread : threads)
+        thread.join();
+
+    EXPECT_EQ(stream.Stop(), PortSDR::ErrorCode::OK);
+    EXPECT_TRUE(ordered);
+    for (int t = 0; t < threadCount; t++)
+        EXPECT_EQ(last[t], commandCount - 1);
+    EXPECT_GT(transfers.load(), 0u);
+}
+
+TEST(Control, Destroyed)
+{
+    auto stream = std::make_unique<FakeStream>();
+
+    std::future<PortSDR::ErrorCode> running = stream->Submit([](PortSDR::Stream&)
+    {
+        std::this_thread::sleep_for(50ms);
+        return PortSDR::ErrorCode::OK;
+    });
+    std::this_thread::sleep_for(10ms);
+
+    std::vector<std::future<PortSDR::ErrorCode>> queued;
+    for (int i = 0; i < 4; i++)
+        queued.push_back(stream->SetCenterFrequencyAsync(100000000 + i));
+
+    // The running command finishes, the rest are dropped.
+    stream.reset();
+    EXPECT_EQ(running.get(), PortSDR::ErrorCode::OK);
+    for (std::future<PortSDR::ErrorCode>& result : queued)
+        EXPECT_EQ(result.get(), PortSDR::ErrorCode::STOPPED);
+}
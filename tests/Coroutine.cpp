@@ -0,0 +1,156 @@
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <gtest/gtest.h>
+
+#include "Coroutine.h"
+#include "FakeStream.h"
+
+/**
+ * Single threaded event loop, the kind of executor a DSP service would run.
+ */
+class LoopExecutor
+{
+public:
+    void Post(const std::coroutine_handle<> handle)
+    {
+        {
+            std::lock_guard lock(m_mutex);
+            m_queue.push_back(handle);
+        }
+        m_cond.notify_one();
+    }
+
+    void Run(const std::atomic<bool>& done)
+    {
+        while (!done)
+        {
+            std::unique_lock lock(m_mutex);
+            if (!m_cond.wait_for(lock, std::chrono::seconds(5), [this] { return !m_queue.empty(); }))
+                return;
+
+            const auto handle = m_queue.front();
+            m_queue.pop_front();
+            lock.unlock();
+
+            m_thread = std::this_thread::get_id();
+            handle.resume();
+        }
+    }
+
+    std::thread::id m_thread;
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::deque<std::coroutine_handle<>> m_queue;
+};
+
+struct ReceiveState
+{
+    std::size_t blocks = 0;
+    std::size_t errors = 0;
+    uint64_t nextIndex = 0;
+    bool firstBlock = true;
+    std::thread::id thread;
+    std::atomic<bool> done{false};
+};
+
+static PortSDR::Task Receive(PortSDR::AsyncStream<LoopExecutor>& async, ReceiveState& state, const std::size_t count)
+{
+    while (PortSDR::SampleBlock block = co_await async.Next())
+    {
+        state.thread = std::this_thread::get_id();
+
+        // The stream may have started before the first block was copied.
+        if (state.firstBlock)
+            state.nextIndex = block.sample_index();
+        state.firstBlock = false;
+
+        const auto* values = static_cast<const int16_t*>(block.data());
+        if (block.sample_index() != state.nextIndex || values[0] != static_cast<int8_t>(block.sample_index() * 2) * 256)
+            state.errors++;
+
+        state.nextIndex = block.sample_index() + block.frame_size() + block.dropped_samples();
+        if (++state.blocks == count)
+            break;
+    }
+    state.done = true;
+}
+
+TEST(Coroutine, Executor)
+{
+    FakeStream stream(PortSDR::SAMPLE_FORMAT_IQ_INT16, 4096);
+    LoopExecutor loop;
+    PortSDR::AsyncStream<LoopExecutor> async(stream, loop, 32, 1024);
+
+    ReceiveState state;
+    Receive(async, state, 64);
+
+    ASSERT_EQ(stream.Start(), PortSDR::ErrorCode::OK);
+    loop.Run(state.done);
+    ASSERT_EQ(stream.Stop(), PortSDR::ErrorCode::OK);
+
+    ASSERT_TRUE(state.done) << "coroutine never finished";
+    EXPECT_EQ(state.blocks, 64u);
+    EXPECT_EQ(state.errors, 0u);
+    EXPECT_EQ(state.thread, std::this_thread::get_id()) << "resumed outside of the executor";
+}
+
+static PortSDR::Task TakeAll(PortSDR::AsyncStream<PortSDR::InlineExecutor>& async,
+                             std::vector<std::size_t>& dropped)
+{
+    while (PortSDR::SampleBlock block = co_await async.Next())
+        dropped.push_back(block.dropped_samples());
+}
+
+TEST(Coroutine, PoolExhausted)
+{
+    FakeStream stream(PortSDR::SAMPLE_FORMAT_IQ_UINT8, 4096);
+    PortSDR::InlineExecutor executor;
+    PortSDR::AsyncStream<PortSDR::InlineExecutor> async(stream, executor, 2, 1024);
+
+    // Two blocks of 1024, the rest of the transfer finds no free block.
+    stream.Emit();
+    EXPECT_EQ(async.GetDroppedSamples(), 4096u - 2048u);
+
+    std::vector<std::size_t> dropped;
+    TakeAll(async, dropped);
+    ASSERT_EQ(dropped.size(), 2u);
+    EXPECT_EQ(dropped[0], 0u);
+
+    // The coroutine is suspended again, the next block resumes it inline and reports the gap.
+    stream.Emit();
+    ASSERT_GE(dropped.size(), 3u);
+    EXPECT_EQ(dropped[2], 4096u - 2048u);
+
+    async.Close();
+}
+
+TEST(Coroutine, FramePool)
+{
+    void* first = PortSDR::FramePool::Allocate(200);
+    PortSDR::FramePool::Free(first, 200);
+
+    // Same size class comes back from the pool.
+    void* second = PortSDR::FramePool::Allocate(250);
+    EXPECT_EQ(first, second);
+    PortSDR::FramePool::Free(second, 250);
+}
+
+TEST(Coroutine, DestroyWhileStreaming)
+{
+    FakeStream stream(PortSDR::SAMPLE_FORMAT_IQ_UINT8, 4096);
+    PortSDR::InlineExecutor executor;
+    ASSERT_EQ(stream.Start(), PortSDR::ErrorCode::OK);
+
+    // The pool of each one goes away while transfers keep arriving.
+    for (int i = 0; i < 20; i++)
+    {
+        PortSDR::AsyncStream<PortSDR::InlineExecutor> async(stream, executor, 2, 1024);
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+
+    ASSERT_EQ(stream.Stop(), PortSDR::ErrorCode::OK);
+}
@@ -0,0 +1,278 @@
+#include <cmath>
+#include <complex>
+#include <cstring>
+#include <random>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "dsp/Convert.h"
+#include "dsp/IQConverter.h"
+#include "dsp/Level.h"
+#include "dsp/Unpack.h"
+
+static std::vector<uint8_t> PackAirSpy12(const std::vector<uint16_t>& samples)
+{
+    std::vector<uint8_t> packed(samples.size() / 8 * 12);
+    uint8_t* dst = packed.data();
+
+    for (std::size_t i = 0; i + 8 <= samples.size(); i += 8)
+    {
+        const uint16_t* x = &samples[i];
+        const uint32_t words[3] = {
+            static_cast<uint32_t>(x[0] << 20 | x[1] << 8 | x[2] >> 4),
+            static_cast<uint32_t>((x[2] & 0xf) << 28 | x[3] << 16 | x[4] << 4 | x[5] >> 8),
+            static_cast<uint32_t>((x[5] & 0xff) << 24 | x[6] << 12 | x[7]),
+        };
+        std::memcpy(dst, words, sizeof(words));
+        dst += sizeof(words);
+    }
+    return packed;
+}
+
+TEST(Dsp, UnpackAirSpy12)
+{
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<int> dist(0, 4095);
+
+    // Odd amount of groups to cover the scalar tail after the vector loop.
+    std::vector<uint16_t> samples(8 * 1001);
+    for (auto& sample : samples)
+        sample = static_cast<uint16_t>(dist(rng));
+    samples[0] = 0;
+    samples[1] = 4095;
+
+    const std::vector<uint8_t> packed = PackAirSpy12(samples);
+
+    std::vector<int16_t> expected(samples.size());
+    std::vector<int16_t> scalar(samples.size());
+    std::vector<int16_t> unpacked(samples.size());
+
+    PortSDR::ConvertAirSpy12(samples.data(), expected.data(), samples.size());
+    PortSDR::UnpackAirSpy12Scalar(packed.data(), scalar.data(), samples.size());
+    PortSDR::UnpackAirSpy12(packed.data(), unpacked.data(), samples.size());
+
+    EXPECT_EQ(expected[0], -32768);
+    EXPECT_EQ(expected[1], 32752);
+    EXPECT_EQ(scalar, expected);
+    EXPECT_EQ(unpacked, expected);
+}
+
+TEST(Dsp, IQConverter)
+{
+    // Like libairspy the IF is mirrored, a tone at fs/4 + fs/20 ends up at -fs/20,
+    // -0.1 of the decimated rate with the amplitude of the real cosine.
+    constexpr std::size_t count = 16384;
+    constexpr double pi = 3.14159265358979323846;
+
+    std::vector<int16_t> real(count);
+    for (std::size_t n = 0; n < count; n++)
+        real[n] = static_cast<int16_t>(1000 + 8000 * std::cos(2 * pi * 0.3 * static_cast<double>(n)));
+
+    PortSDR::IQConverter converter;
+    std::vector<float> iq(count);
+    ASSERT_EQ(converter.Process(real.data(), count / 2, PortSDR::SAMPLE_FORMAT_IQ_FLOAT32, iq.data()),
+              PortSDR::ErrorCode::OK);
+    ASSERT_EQ(converter.Process(real.data() + count / 2, count / 2, PortSDR::SAMPLE_FORMAT_IQ_FLOAT32,
+                  iq.data() + count / 2),
+              PortSDR::ErrorCode::OK);
+
+    // Correlate against both the tone and its image, skipping the filter warm up.
+    std::complex<double> tone, image;
+    const std::size_t frames = count / 2;
+    for (std::size_t k = 256; k < frames; k++)
+    {
+        const std::complex<double> sample(iq[2 * k], iq[2 * k + 1]);
+        tone += sample * std::polar(1.0, 2 * pi * 0.1 * static_cast<double>(k));
+        image += sample * std::polar(1.0, -2 * pi * 0.1 * static_cast<double>(k));
+    }
+
+    const double amplitude = std::abs(tone) / static_cast<double>(frames - 256);
+    EXPECT_NEAR(amplitude, 8000.0 / 32768.0, 0.005);
+    EXPECT_GT(std::abs(tone), std::abs(image) * 1000);
+
+    EXPECT_EQ(converter.Process(real.data(), count, PortSDR::SAMPLE_FORMAT_IQ_UINT8, iq.data()),
+              PortSDR::ErrorCode::INVALID_ARGUMENT);
+}
+
+TEST(Dsp, IQConverterKernels)
+{
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<int> dist(-32768, 32767);
+
+    std::vector<int16_t> real(20000);
+    for (auto& sample : real)
+        sample = static_cast<int16_t>(dist(rng));
+
+    for (const auto format : {PortSDR::SAMPLE_FORMAT_IQ_INT16, PortSDR::SAMPLE_FORMAT_IQ_FLOAT32})
+    {
+        PortSDR::IQConverter scalar(false);
+        PortSDR::IQConverter vector;
+        PortSDR::IQConverter scalarPlanar(false);
+        PortSDR::IQConverter vectorPlanar;
+
+        const std::size_t frameSize = PortSDR::GetSampleSize(format);
+        const std::size_t valueSize = frameSize / 2;
+        std::vector<uint8_t> expected(real.size() / 2 * frameSize);
+        std::vector<uint8_t> output(expected.size());
+        std::vector<uint8_t> scalarI(expected.size() / 2), scalarQ(expected.size() / 2);
+        std::vector<uint8_t> vectorI(expected.size() / 2), vectorQ(expected.size() / 2);
+
+        // Uneven block sizes to cover the history and sign carried between calls.
+        std::size_t offset = 0;
+        for (const std::size_t count : {1000, 18, 4002, 14980})
+        {
+            const std::size_t out = offset / 2 * frameSize;
+            const std::size_t plane = offset / 2 * valueSize;
+            ASSERT_EQ(scalar.Process(real.data() + offset, count, format, expected.data() + out),
+                      PortSDR::ErrorCode::OK);
+            ASSERT_EQ(vector.Process(real.data() + offset, count, format, output.data() + out),
+                      PortSDR::ErrorCode::OK);
+            ASSERT_EQ(scalarPlanar.Process(real.data() + offset, count, format,
+                                           scalarI.data() + plane, scalarQ.data() + plane),
+                      PortSDR::ErrorCode::OK);
+            ASSERT_EQ(vectorPlanar.Process(real.data() + offset, count, format,
+                                           vectorI.data() + plane, vectorQ.data() + plane),
+                      PortSDR::ErrorCode::OK);
+            offset += count;
+        }
+
+        // The planar output of a kernel holds exactly the values of its interleaved output.
+        for (std::size_t k = 0; k < real.size() / 2; k++)
+        {
+            ASSERT_EQ(std::memcmp(&scalarI[k * valueSize], &expected[k * frameSize], valueSize), 0) << "I " << k;
+            ASSERT_EQ(std::memcmp(&scalarQ[k * valueSize], &expected[k * frameSize + valueSize], valueSize), 0)
+                << "Q " << k;
+            ASSERT_EQ(std::memcmp(&vectorI[k * valueSize], &output[k * frameSize], valueSize), 0) << "I " << k;
+            ASSERT_EQ(std::memcmp(&vectorQ[k * valueSize], &output[k * frameSize + valueSize], valueSize), 0)
+                << "Q " << k;
+        }
+
+        // Only the order of the additions differs.
+        for (std::size_t k = 0; k < real.size(); k++)
+        {
+            if (format == PortSDR::SAMPLE_FORMAT_IQ_INT16)
+            {
+                const auto* a = reinterpret_cast<const int16_t*>(expected.data());
+                const auto* b = reinterpret_cast<const int16_t*>(output.data());
+                ASSERT_NEAR(a[k], b[k], 1) << "sample " << k;
+            }
+            else
+            {
+                const auto* a = reinterpret_cast<const float*>(expected.data());
+                const auto* b = reinterpret_cast<const float*>(output.data());
+                ASSERT_NEAR(a[k], b[k], 1e-5) << "sample " << k;
+            }
+        }
+    }
+}
+
+TEST(Dsp, ConvertSamplesPlanar)
+{
+    const PortSDR::SampleFormat formats[] = {
+        PortSDR::SAMPLE_FORMAT_IQ_UINT8, PortSDR::SAMPLE_FORMAT_IQ_INT16, PortSDR::SAMPLE_FORMAT_IQ_FLOAT32
+    };
+
+    // Not a multiple of the vector width nor of the conversion block.
+    const std::size_t frames = 1537;
+
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<int> dist(0, 255);
+    std::vector<uint8_t> wire(frames * 2);
+    for (auto& value : wire)
+        value = static_cast<uint8_t>(dist(rng));
+
+    for (const auto srcFormat : formats)
+    {
+        std::vector<uint8_t> src(wire.size() * PortSDR::GetSampleSize(srcFormat) / 2);
+        PortSDR::ConvertFromUInt8(wire.data(), srcFormat, src.data(), wire.size());
+
+        for (const auto dstFormat : formats)
+        {
+            const std::size_t valueSize = PortSDR::GetSampleSize(dstFormat) / 2;
+            std::vector<uint8_t> interleaved(frames * 2 * valueSize);
+            std::vector<uint8_t> i(frames * valueSize);
+            std::vector<uint8_t> q(frames * valueSize);
+
+            PortSDR::ConvertSamples(src.data(), srcFormat, interleaved.data(), dstFormat, frames * 2);
+            PortSDR::ConvertSamplesPlanar(src.data(), srcFormat, i.data(), q.data(), dstFormat, frames * 2);
+
+            for (std::size_t k = 0; k < frames; k++)
+            {
+                ASSERT_EQ(std::memcmp(&i[k * valueSize], &interleaved[2 * k * valueSize], valueSize), 0)
+                    << "I of sample " << k << ", " << srcFormat << " to " << dstFormat;
+                ASSERT_EQ(std::memcmp(&q[k * valueSize], &interleaved[(2 * k + 1) * valueSize], valueSize), 0)
+                    << "Q of sample " << k << ", " << srcFormat << " to " << dstFormat;
+            }
+
+            // And merged again, into every format.
+            for (const auto mergedFormat : formats)
+            {
+                const std::size_t mergedSize = frames * PortSDR::GetSampleSize(mergedFormat);
+                std::vector<uint8_t> expected(mergedSize);
+                std::vector<uint8_t> merged(mergedSize);
+
+                PortSDR::ConvertSamples(interleaved.data(), dstFormat, expected.data(), mergedFormat, frames * 2);
+                PortSDR::ConvertSamplesInterleaved(i.data(), q.data(), dstFormat, merged.data(), mergedFormat,
+                                                   frames * 2);
+                ASSERT_EQ(merged, expected) << dstFormat << " to " << mergedFormat;
+            }
+        }
+    }
+}
+
+TEST(Dsp, MeasureLevel)
+{
+    // Odd count so the scalar tail is covered as well.
+    constexpr std::size_t count = 40001;
+
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> dist(-32768, 32767);
+
+    std::vector<uint8_t> u8(count);
+    std::vector<int16_t> s16(count);
+    std::vector<float> f32(count);
+    for (std::size_t i = 0; i < count; i++)
+    {
+        s16[i] = static_cast<int16_t>(dist(rng));
+        u8[i] = static_cast<uint8_t>((s16[i] >> 8) + 128);
+        f32[i] = s16[i] / 32768.0f;
+    }
+
+    double sum8 = 0, sum16 = 0;
+    double dc16[2] = {0, 0};
+    int peak16 = 0;
+    std::size_t clipped8 = 0, clipped16 = 0, clippedF = 0;
+    for (std::size_t i = 0; i < count; i++)
+    {
+        const int v8 = u8[i] - 128;
+        sum8 += v8 * v8 / (128.0 * 128.0);
+        sum16 += static_cast<double>(s16[i]) * s16[i] / (32768.0 * 32768.0);
+        dc16[i & 1] += s16[i] / 32768.0;
+        peak16 = std::max(peak16, std::abs(static_cast<int>(s16[i])));
+        clipped8 += u8[i] == 0 || u8[i] == 255;
+        clipped16 += std::abs(static_cast<int>(s16[i])) >= static_cast<int>(PortSDR::kClipLevel * 32768.0f);
+        clippedF += std::fabs(f32[i]) >= PortSDR::kClipLevel;
+    }
+
+    const PortSDR::LevelStats a = PortSDR::MeasureLevel(u8.data(), PortSDR::SAMPLE_FORMAT_IQ_UINT8, count);
+    EXPECT_NEAR(a.sumSquares, sum8, 1e-6);
+    EXPECT_EQ(a.clipped, clipped8);
+    EXPECT_EQ(a.count, count);
+
+    const PortSDR::LevelStats b = PortSDR::MeasureLevel(s16.data(), PortSDR::SAMPLE_FORMAT_IQ_INT16, count);
+    EXPECT_NEAR(b.sumSquares, sum16, 1e-6);
+    EXPECT_FLOAT_EQ(b.peak, peak16 / 32768.0f);
+    EXPECT_EQ(b.clipped, clipped16);
+    EXPECT_NEAR(b.sumI, dc16[0], 1e-6);
+    EXPECT_NEAR(b.sumQ, dc16[1], 1e-6);
+
+    const PortSDR::LevelStats c = PortSDR::MeasureLevel(f32.data(), PortSDR::SAMPLE_FORMAT_IQ_FLOAT32, count);
+    EXPECT_NEAR(c.sumSquares, sum16, 1e-2);
+    EXPECT_FLOAT_EQ(c.peak, peak16 / 32768.0f);
+    EXPECT_EQ(c.clipped, clippedF);
+    EXPECT_NEAR(c.sumI, dc16[0], 1e-2);
+    EXPECT_NEAR(c.sumQ, dc16[1], 1e-2);
+
+    // Uniform noise has a power of 1/3 per value.
+    EXPECT_NEAR(10.0 * std::log10(b.Power()), 10.0 * std::log10(2.0 / 3.0), 0.1);
+}
@@ -0,0 +1,395 @@
+#ifndef PORTSDR_FAKESTREAM_H
+#define PORTSDR_FAKESTREAM_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <PortSDR.h>
+
+/**
+ * Stream that generates a counting pattern without any hardware.
+ * Every value is the low bits of its index in the stream.
+ */
+class FakeStream final : public PortSDR::Stream
+{
+public:
+    explicit FakeStream(const PortSDR::SampleFormat format = PortSDR::SAMPLE_FORMAT_IQ_UINT8,
+                        const std::size_t frameSize = 4096)
+        : m_format(format), m_frameSize(frameSize)
+    {
+    }
+
+    ~FakeStream() override
+    {
+        StopCommands();
+        DisableRecovery();
+        Stop();
+    }
+
+    PortSDR::DeviceInfo GetUSBStrings() override
+    {
+        return {"Fake", "FAKE0001"};
+    }
+
+    PortSDR::ErrorCode Start() override
+    {
+        if (m_thread.joinable())
+            return PortSDR::ErrorCode::OK;
+
+        m_running = true;
+        m_clockStart = 0;
+        m_thread = std::thread(&FakeStream::Process, this);
+        return PortSDR::ErrorCode::OK;
+    }
+
+    PortSDR::ErrorCode Stop() override
+    {
+        if (!m_thread.joinable())
+            return PortSDR::ErrorCode::INVALID_ARGUMENT;
+
+        CancelReads();
+
+        m_running = false;
+        m_thread.join();
+        return PortSDR::ErrorCode::OK;
+    }
+
+    PortSDR::ErrorCode SetSampleRate(const uint32_t sampleRate) override
+    {
+        std::lock_guard lock(m_emitMutex);
+        m_sampleRate = sampleRate;
+        PostTag(PortSDR::STREAM_TAG_SAMPLE_RATE, sampleRate);
+        return PortSDR::ErrorCode::OK;
+    }
+
+    PortSDR::ErrorCode SetCenterFrequency(const uint32_t freq) override
+    {
+        std::lock_guard lock(m_emitMutex);
+        m_freq = freq;
+
+        // Takes effect with the next transfer, where the stream anchors its tag.
+        m_retuneIndex = m_sample;
+        m_settleFrom = m_sample;
+        m_settleUntil = m_sample + m_settleSamples;
+        PostTag(PortSDR::STREAM_TAG_FREQUENCY, freq);
+        return PortSDR::ErrorCode::OK;
+    }
+
+    PortSDR::ErrorCode SetSampleFormat(const PortSDR::SampleFormat format) override
+    {
+        if (CheckSampleFormat(format) != PortSDR::ErrorCode::OK)
+            return PortSDR::ErrorCode::INVALID_ARGUMENT;
+
+        std::lock_guard lock(m_emitMutex);
+        m_format = format;
+        PostTag(PortSDR::STREAM_TAG_FORMAT, format);
+        return PortSDR::ErrorCode::OK;
+    }
+
+    PortSDR::ErrorCode SetGain(const double gain, std::string_view name) override
+    {
+        if (name != "LNA")
+            return PortSDR::ErrorCode::INVALID_ARGUMENT;
+
+        std::lock_guard lock(m_emitMutex);
+        m_gain = gain;
+        PostTag(PortSDR::STREAM_TAG_GAIN, gain, name);
+        return PortSDR::ErrorCode::OK;
+    }
+
+    PortSDR::ErrorCode SetGainMode(const PortSDR::GainMode mode) override
+    {
+        return mode == PortSDR::GAIN_MODE_FREE ? PortSDR::ErrorCode::OK : PortSDR::ErrorCode::INVALID_ARGUMENT;
+    }
+
+    [[nodiscard]] std::vector<uint32_t> GetSampleRates() const override
+    {
+        return {1024000, 2048000};
+    }
+
+    [[nodiscard]] std::vector<PortSDR::SampleFormat> GetSampleFormats() const override
+    {
+        return {PortSDR::SAMPLE_FORMAT_IQ_UINT8, PortSDR::SAMPLE_FORMAT_IQ_INT16, PortSDR::SAMPLE_FORMAT_IQ_FLOAT32};
+    }
+
+    [[nodiscard]] std::vector<PortSDR::GainMode> GetGainModes() const override
+    {
+        return {PortSDR::GAIN_MODE_FREE};
+    }
+
+    [[nodiscard]] std::vector<PortSDR::Gain> GetGainStages(PortSDR::GainMode) const override
+    {
+        return {{"LNA", PortSDR::MetaRange{0, 49, 1}}};
+    }
+
+    [[nodiscard]] std::string GetTunerType() const override
+    {
+        return "Fake";
+    }
+
+    [[nodiscard]] uint32_t GetCenterFrequency() const override
+    {
+        return m_freq;
+    }
+
+    [[nodiscard]] uint32_t GetSampleRate() const override
+    {
+        return m_sampleRate;
+    }
+
+    [[nodiscard]] double GetGain(std::string_view) const override
+    {
+        return m_gain;
+    }
+
+    [[nodiscard]] PortSDR::GainMode GetGainMode() const override
+    {
+        return PortSDR::GAIN_MODE_FREE;
+    }
+
+    /**
+     * Emits a single transfer from the calling thread.
+     * @param dropped samples reported as dropped before it.
+     */
+    void Emit(const std::size_t dropped = 0)
+    {
+        const std::size_t count = m_frameSize * 2;
+        const uint64_t first = m_sample + dropped;
+
+        // Waits without the lock, setters aren't held up for a whole transfer.
+        if (m_paced && m_sampleRate != 0)
+            WaitForCapture(first + m_frameSize);
+
+        std::lock_guard lock(m_emitMutex);
+        m_sample = first + m_frameSize;
+        m_planar = IsPlanar();
+
+        m_uint8.resize(count);
+        m_int16.resize(count);
+        m_float32.resize(count);
+
+        // Like a backend, the planes are written by the same pass that generates the values.
+        for (std::size_t i = 0; i < count; i++, m_index++)
+        {
+            const std::size_t at = Position(i);
+            m_uint8[at] = static_cast<uint8_t>(m_index);
+            m_int16[at] = static_cast<int16_t>(static_cast<int8_t>(m_index) * 256);
+            m_float32[at] = static_cast<int8_t>(m_index) / 128.0f;
+        }
+
+        Settle(first);
+
+        const PortSDR::SampleFormat format = m_format;
+
+        PortSDR::SDRTransfer transfer{};
+        transfer.frame_size = m_frameSize;
+        transfer.dropped_samples = dropped;
+        transfer.format = format;
+        transfer.layout = m_planar ? PortSDR::SAMPLE_LAYOUT_PLANAR : PortSDR::SAMPLE_LAYOUT_INTERLEAVED;
+
+        switch (format)
+        {
+        case PortSDR::SAMPLE_FORMAT_IQ_UINT8:
+            transfer.data = m_uint8.data();
+            transfer.data_q = m_uint8.data() + m_frameSize;
+            break;
+        case PortSDR::SAMPLE_FORMAT_IQ_INT16:
+            transfer.data = m_int16.data();
+            transfer.data_q = m_int16.data() + m_frameSize;
+            break;
+        case PortSDR::SAMPLE_FORMAT_IQ_FLOAT32:
+            transfer.data = m_float32.data();
+            transfer.data_q = m_float32.data() + m_frameSize;
+            break;
+        }
+        if (!m_planar)
+            transfer.data_q = nullptr;
+
+        Deliver(transfer);
+    }
+
+    /**
+     * Delivers a transfer built by the caller instead of the counting pattern, from the calling thread.
+     * It is built under the lock the setters take, so it reflects the settings its tags announce.
+     * @param make returns the SDRTransfer to deliver.
+     */
+    template <typename Make>
+    void Inject(Make make)
+    {
+        std::lock_guard lock(m_emitMutex);
+        PortSDR::SDRTransfer transfer = make();
+        m_sample += transfer.dropped_samples + transfer.frame_size;
+        Deliver(transfer);
+    }
+
+    /**
+     * Delivers every transfer once its last sample was captured by a clock running at the sample rate.
+     * @param paced true to follow the sample clock, false to emit as fast as called.
+     */
+    void SetPaced(const bool paced)
+    {
+        m_paced = paced;
+    }
+
+    /**
+     * Models a tuner that settles after every retune, its samples are attenuated meanwhile.
+     * @param samples settle time in samples, starting at the first sample delivered after the retune.
+     */
+    void SetSettleSamples(const std::size_t samples)
+    {
+        m_settleSamples = samples;
+    }
+
+    /**
+     * Stops emitting transfers without stopping, like a stalled device.
+     * @param error reported as the cause, OK to let the stall be noticed by itself.
+     */
+    void Fail(const PortSDR::ErrorCode error = PortSDR::ErrorCode::OK)
+    {
+        m_failed = true;
+        if (error != PortSDR::ErrorCode::OK)
+            ReportFailure(error);
+    }
+
+    /**
+     * @param count amount of following Reopen() calls that fail.
+     */
+    void SetReopenFailures(const int count)
+    {
+        m_reopenFailures = count;
+    }
+
+    [[nodiscard]] int GetReopens() const
+    {
+        return m_reopens;
+    }
+
+    /**
+     * @return stream index of the sample the last retune took effect at.
+     */
+    [[nodiscard]] uint64_t GetRetuneIndex() const
+    {
+        return m_retuneIndex;
+    }
+
+protected:
+    PortSDR::ErrorCode Reopen() override
+    {
+        if (!m_running)
+            return PortSDR::ErrorCode::STOPPED;
+        if (m_reopenFailures > 0)
+        {
+            m_reopenFailures--;
+            return PortSDR::ErrorCode::DEVICE_NOT_FOUND;
+        }
+
+        m_reopens++;
+        m_clockStart = 0;
+        m_failed = false;
+        return PortSDR::ErrorCode::OK;
+    }
+
+    [[nodiscard]] bool CanReopen() const override
+    {
+        return true;
+    }
+
+private:
+    static int64_t Now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void WaitForCapture(const uint64_t end)
+    {
+        // The first transfer ends now, the following ones once the clock reaches their last sample.
+        if (m_clockStart == 0)
+        {
+            m_clockStart = Now() - static_cast<int64_t>(end * 1e9 / m_sampleRate);
+            return;
+        }
+
+        const int64_t wait = CaptureTime(end) - Now();
+        if (wait > 0)
+            std::this_thread::sleep_for(std::chrono::nanoseconds(wait));
+    }
+
+    [[nodiscard]] int64_t CaptureTime(const uint64_t sample) const
+    {
+        return m_clockStart + static_cast<int64_t>(sample * 1e9 / m_sampleRate);
+    }
+
+    /**
+     * @return where interleaved value i of the transfer is stored, Q follows the I plane when planar.
+     */
+    [[nodiscard]] std::size_t Position(const std::size_t i) const
+    {
+        return m_planar ? (i % 2) * m_frameSize + i / 2 : i;
+    }
+
+    void Settle(const uint64_t first)
+    {
+        const uint64_t from = std::max(first, m_settleFrom);
+        const uint64_t until = std::min(first + m_frameSize, m_settleUntil);
+        for (uint64_t i = from; i < until; i++)
+        {
+            for (std::size_t j = (i - first) * 2; j < (i - first) * 2 + 2; j++)
+            {
+                const std::size_t at = Position(j);
+                m_uint8[at] = static_cast<uint8_t>(128 + (m_uint8[at] - 128) / 10);
+                m_int16[at] = static_cast<int16_t>(m_int16[at] / 10);
+                m_float32[at] *= 0.1f;
+            }
+        }
+    }
+
+    void Process()
+    {
+        while (m_running)
+        {
+            if (!m_failed)
+                Emit();
+            if (m_failed || !m_paced || m_sampleRate == 0)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    std::atomic<PortSDR::SampleFormat> m_format;
+    std::size_t m_frameSize;
+    std::size_t m_index = 0;
+    uint64_t m_sample = 0;
+    bool m_planar = false; // Layout of the transfer being emitted
+
+    std::vector<uint8_t> m_uint8;
+    std::vector<int16_t> m_int16;
+    std::vector<float> m_float32;
+
+    std::thread m_thread;
+    std::atomic<bool> m_running{false};
+    std::atomic<bool> m_failed{false};
+    std::atomic<int> m_reopenFailures{0};
+    std::atomic<int> m_reopens{0};
+
+    std::atomic<uint32_t> m_freq{0};
+    std::atomic<uint32_t> m_sampleRate{0};
+    std::atomic<double> m_gain{0};
+
+    std::atomic<std::size_t> m_settleSamples{0};
+    std::atomic<bool> m_paced{false};
+    std::atomic<int64_t> m_clockStart{0};
+
+    /* Held across each transfer and by the setters, so a change lands exactly between two transfers.
+     * Recursive, so the callback can call the setters. */
+    std::recursive_mutex m_emitMutex;
+    std::atomic<uint64_t> m_retuneIndex{0};
+    uint64_t m_settleFrom = 0;
+    uint64_t m_settleUntil = 0;
+};
+
+#endif //PORTSDR_FAKESTREAM_H
@@ -0,0 +1,54 @@
+#include <cmath>
+#include <gtest/gtest.h>
+
+#include "FakeStream.h"
+
+TEST(Health, Disabled)
+{
+    FakeStream stream;
+
+    bool measured = true;
+    stream.SetCallback([&](const PortSDR::SDRTransfer& transfer)
+    {
+        measured = transfer.health != nullptr;
+    });
+
+    stream.Emit();
+    EXPECT_FALSE(measured);
+    EXPECT_EQ(stream.GetHealth().rms, 0.0f);
+}
+
+TEST(Health, PerTransfer)
+{
+    // The counting pattern walks every 8-bit value once per 256 values.
+    double sumSquares = 0;
+    for (int v = 0; v < 256; v++)
+        sumSquares += (v - 128) * (v - 128) / (128.0 * 128.0);
+    const float rms = static_cast<float>(std::sqrt(sumSquares * 2.0 / 256.0));
+
+    FakeStream stream(PortSDR::SAMPLE_FORMAT_IQ_UINT8, 4096);
+    stream.SetHealthMonitor(true);
+
+    PortSDR::SignalHealth health{};
+    stream.SetCallback([&](const PortSDR::SDRTransfer& transfer)
+    {
+        ASSERT_NE(transfer.health, nullptr);
+        health = *transfer.health;
+    });
+
+    stream.Emit();
+    EXPECT_FLOAT_EQ(health.rms, rms);
+    EXPECT_FLOAT_EQ(health.peak, 1.0f);
+    EXPECT_FLOAT_EQ(health.saturation, 2.0f / 256.0f);
+    EXPECT_FLOAT_EQ(health.dc_i, -1.0f / 128.0f);
+    EXPECT_FLOAT_EQ(health.dc_q, 0.0f);
+
+    // Every transfer looks the same, so the rolling gauges settle on the same values.
+    for (int i = 0; i < 10; i++)
+        stream.Emit();
+
+    const PortSDR::SignalHealth gauges = stream.GetHealth();
+    EXPECT_FLOAT_EQ(gauges.rms, rms);
+    EXPECT_FLOAT_EQ(gauges.saturation, 2.0f / 256.0f);
+    EXPECT_FLOAT_EQ(gauges.dc_i, -1.0f / 128.0f);
+}
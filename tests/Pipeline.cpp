@@ -0,0 +1,174 @@
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "FakeStream.h"
+#include "Pipeline.h"
+
+using namespace std::chrono_literals;
+
+TEST(Pipeline, ThreadPoolSteals)
+{
+    PortSDR::ThreadPool pool(4);
+    ASSERT_EQ(pool.GetThreadCount(), 4u);
+
+    std::mutex mutex;
+    std::set<std::thread::id> threads;
+    std::atomic<int> done{0};
+
+    // Everything is submitted from one pool thread, the others have to steal it.
+    pool.Submit([&]
+    {
+        for (int i = 0; i < 64; i++)
+        {
+            pool.Submit([&]
+            {
+                std::this_thread::sleep_for(1ms);
+                {
+                    std::lock_guard lock(mutex);
+                    threads.insert(std::this_thread::get_id());
+                }
+                ++done;
+            });
+        }
+    });
+
+    for (int i = 0; i < 1000 && done < 64; i++)
+        std::this_thread::sleep_for(1ms);
+
+    EXPECT_EQ(done, 64);
+    std::lock_guard lock(mutex);
+    EXPECT_GT(threads.size(), 1u);
+}
+
+TEST(Pipeline, StreamToSink)
+{
+    FakeStream stream(PortSDR::SAMPLE_FORMAT_IQ_UINT8, 1024);
+    PortSDR::ThreadPool pool(2);
+    PortSDR::Pipeline pipeline(pool);
+
+    // uint8 to float, then a sink checking the counting pattern of the stream.
+    const auto convert = pipeline.AddStage("convert", [](const PortSDR::SDRTransfer& input, PortSDR::Emitter& emitter)
+    {
+        std::vector<float> converted(input.frame_size * 2);
+        const auto* data = static_cast<const uint8_t*>(input.data);
+        for (std::size_t i = 0; i < converted.size(); i++)
+            converted[i] = data[i];
+
+        PortSDR::SDRTransfer output = input;
+        output.data = converted.data();
+        output.format = PortSDR::SAMPLE_FORMAT_IQ_FLOAT32;
+        emitter.Emit(output);
+    }, 64);
+
+    std::size_t received = 0;
+    float expected = 0;
+    bool ordered = true;
+    const auto sink = pipeline.AddStage("sink", [&](const PortSDR::SDRTransfer& input, PortSDR::Emitter&)
+    {
+        ASSERT_EQ(input.format, PortSDR::SAMPLE_FORMAT_IQ_FLOAT32);
+        const auto* data = static_cast<const float*>(input.data);
+        for (std::size_t i = 0; i < input.frame_size * 2; i++)
+        {
+            ordered &= data[i] == expected;
+            expected = expected == 255 ? 0 : expected + 1;
+        }
+        received += input.frame_size;
+    }, 64);
+
+    ASSERT_EQ(pipeline.Connect(convert, sink), PortSDR::ErrorCode::OK);
+    EXPECT_EQ(pipeline.Connect(sink, sink), PortSDR::ErrorCode::INVALID_ARGUMENT);
+
+    ASSERT_EQ(pipeline.SetSource(stream, convert), PortSDR::ErrorCode::OK);
+
+    stream.Emit();
+    ASSERT_EQ(pipeline.Start(), PortSDR::ErrorCode::OK);
+    for (int i = 0; i < 32; i++)
+        stream.Emit();
+    pipeline.Stop();
+
+    // The transfer before Start() is refused, the rest arrives complete and in order.
+    EXPECT_EQ(received, 32u * 1024u);
+    EXPECT_TRUE(ordered);
+
+    const std::vector<PortSDR::StageStats> stats = pipeline.GetStats();
+    ASSERT_EQ(stats.size(), 2u);
+    EXPECT_EQ(stats[0].name, "convert");
+    EXPECT_EQ(stats[0].samples, 32u * 1024u);
+    EXPECT_EQ(stats[1].blocks, 32u);
+    EXPECT_EQ(stats[1].dropped, 0u);
+    EXPECT_EQ(stats[1].queue_depth, 0u);
+    EXPECT_GT(stats[0].samples_per_second, 0.0);
+}
+
+TEST(Pipeline, SourceOutlivesPipeline)
+{
+    FakeStream stream(PortSDR::SAMPLE_FORMAT_IQ_UINT8, 1024);
+    PortSDR::ThreadPool pool(1);
+
+    std::atomic<std::size_t> received{0};
+    {
+        PortSDR::Pipeline pipeline(pool);
+        const auto sink = pipeline.AddStage("sink", [&](const PortSDR::SDRTransfer& input, PortSDR::Emitter&)
+        {
+            received += input.frame_size;
+        });
+        ASSERT_EQ(pipeline.SetSource(stream, sink), PortSDR::ErrorCode::OK);
+        ASSERT_EQ(pipeline.Start(), PortSDR::ErrorCode::OK);
+        stream.Emit();
+    }
+
+    // The destroyed pipeline removed itself from the stream.
+    stream.Emit();
+    EXPECT_EQ(received, 1024u);
+}
+
+TEST(Pipeline, FanOutAndDrops)
+{
+    PortSDR::ThreadPool pool(2);
+    PortSDR::Pipeline pipeline(pool);
+
+    const auto source = pipeline.AddStage("source", [](const PortSDR::SDRTransfer&, PortSDR::Emitter& emitter)
+    {
+        emitter.Forward();
+    }, 256);
+
+    std::atomic<std::size_t> fast{0};
+    const auto fastSink = pipeline.AddStage("fast", [&](const PortSDR::SDRTransfer& input, PortSDR::Emitter&)
+    {
+        fast += input.frame_size;
+    }, 256);
+
+    // Too slow for its small queue, so it has to drop.
+    std::atomic<std::size_t> slow{0};
+    const auto slowSink = pipeline.AddStage("slow", [&](const PortSDR::SDRTransfer& input, PortSDR::Emitter&)
+    {
+        std::this_thread::sleep_for(1ms);
+        slow += input.frame_size;
+    }, 2);
+
+    ASSERT_EQ(pipeline.Connect(source, fastSink), PortSDR::ErrorCode::OK);
+    ASSERT_EQ(pipeline.Connect(source, slowSink), PortSDR::ErrorCode::OK);
+    ASSERT_EQ(pipeline.Start(), PortSDR::ErrorCode::OK);
+
+    std::vector<uint8_t> buffer(256);
+    PortSDR::SDRTransfer transfer{};
+    transfer.data = buffer.data();
+    transfer.frame_size = buffer.size() / 2;
+    transfer.format = PortSDR::SAMPLE_FORMAT_IQ_UINT8;
+
+    for (int i = 0; i < 100; i++)
+        ASSERT_EQ(pipeline.Push(source, transfer), PortSDR::ErrorCode::OK);
+    pipeline.Stop();
+
+    EXPECT_EQ(pipeline.Push(source, transfer), PortSDR::ErrorCode::STOPPED);
+
+    const std::vector<PortSDR::StageStats> stats = pipeline.GetStats();
+    EXPECT_EQ(fast, 100u * 128u);
+    EXPECT_GT(stats[2].dropped, 0u);
+    EXPECT_EQ(slow + stats[2].dropped, 100u * 128u);
+}
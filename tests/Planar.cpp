@@ -0,0 +1,157 @@
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "Capture.h"
+#include "FakeStream.h"
+#include "dsp/Level.h"
+
+TEST(Planar, Callback)
+{
+    FakeStream stream(PortSDR::SAMPLE_FORMAT_IQ_INT16, 1000);
+    ASSERT_EQ(stream.SetSampleLayout(PortSDR::SAMPLE_LAYOUT_PLANAR), PortSDR::ErrorCode::OK);
+
+    std::size_t transfers = 0;
+    stream.SetCallback([&](PortSDR::SDRTransfer& transfer)
+    {
+        ASSERT_EQ(transfer.layout, PortSDR::SAMPLE_LAYOUT_PLANAR);
+
+        const auto i = PortSDR::GetInPhase<PortSDR::SAMPLE_FORMAT_IQ_INT16>(transfer);
+        const auto q = PortSDR::GetQuadrature<PortSDR::SAMPLE_FORMAT_IQ_INT16>(transfer);
+        ASSERT_EQ(i.size(), 1000u);
+        ASSERT_EQ(q.size(), 1000u);
+        for (std::size_t k = 0; k < i.size(); k++)
+        {
+            ASSERT_EQ(i[k], static_cast<int8_t>(2 * k) * 256) << "sample " << k;
+            ASSERT_EQ(q[k], static_cast<int8_t>(2 * k + 1) * 256) << "sample " << k;
+        }
+        transfers++;
+    });
+
+    stream.Emit();
+    EXPECT_EQ(transfers, 1u);
+
+    stream.SetSampleLayout(PortSDR::SAMPLE_LAYOUT_INTERLEAVED);
+    stream.SetCallback([&](PortSDR::SDRTransfer& transfer)
+    {
+        EXPECT_EQ(transfer.layout, PortSDR::SAMPLE_LAYOUT_INTERLEAVED);
+        transfers++;
+    });
+    stream.Emit();
+    EXPECT_EQ(transfers, 2u);
+}
+
+TEST(Planar, ReadInto)
+{
+    FakeStream stream(PortSDR::SAMPLE_FORMAT_IQ_UINT8, 1024);
+    ASSERT_EQ(stream.SetSampleLayout(PortSDR::SAMPLE_LAYOUT_PLANAR), PortSDR::ErrorCode::OK);
+
+    std::thread producer([&stream]
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        stream.Emit();
+    });
+
+    // Converted and split in one pass, I in the first half and Q in the second.
+    std::vector<float> values(2 * 1024);
+    std::size_t frames = 0;
+    ASSERT_EQ(stream.ReadInto(values, frames), PortSDR::ErrorCode::OK);
+    ASSERT_EQ(frames, 1024u);
+
+    for (std::size_t k = 0; k < frames; k++)
+    {
+        ASSERT_NEAR(values[k], static_cast<uint8_t>(2 * k) / 127.5f - 1.0f, 1e-6) << "sample " << k;
+        ASSERT_NEAR(values[1024 + k], static_cast<uint8_t>(2 * k + 1) / 127.5f - 1.0f, 1e-6) << "sample " << k;
+    }
+
+    producer.join();
+}
+
+TEST(Planar, TypedCallback)
+{
+    FakeStream stream;
+    ASSERT_EQ(stream.SetSampleLayout(PortSDR::SAMPLE_LAYOUT_PLANAR), PortSDR::ErrorCode::OK);
+    EXPECT_EQ(stream.SetTypedCallback<PortSDR::SAMPLE_FORMAT_IQ_UINT8>(
+                  [](PortSDR::Span<const PortSDR::IQ<uint8_t>>, PortSDR::SDRTransfer&)
+                  {
+                  }), PortSDR::ErrorCode::INVALID_ARGUMENT);
+
+    ASSERT_EQ(stream.SetSampleLayout(PortSDR::SAMPLE_LAYOUT_INTERLEAVED), PortSDR::ErrorCode::OK);
+    ASSERT_EQ(stream.SetTypedCallback<PortSDR::SAMPLE_FORMAT_IQ_UINT8>(
+                  [](PortSDR::Span<const PortSDR::IQ<uint8_t>>, PortSDR::SDRTransfer&)
+                  {
+                  }), PortSDR::ErrorCode::OK);
+    EXPECT_EQ(stream.SetSampleLayout(PortSDR::SAMPLE_LAYOUT_PLANAR), PortSDR::ErrorCode::INVALID_ARGUMENT);
+}
+
+TEST(Planar, Drain)
+{
+    FakeStream stream(PortSDR::SAMPLE_FORMAT_IQ_UINT8, 1000);
+    ASSERT_EQ(stream.SetSampleLayout(PortSDR::SAMPLE_LAYOUT_PLANAR), PortSDR::ErrorCode::OK);
+    ASSERT_EQ(stream.SetPollWatermark(1000, 4096), PortSDR::ErrorCode::OK);
+
+    // Wraps around the end of the buffer on the way in and on the way out.
+    std::vector<uint8_t> values(2 * 1500);
+    std::size_t next = 0;
+    for (int round = 0; round < 6; round++)
+    {
+        stream.Emit();
+        stream.Emit();
+        stream.Emit();
+
+        for (int half = 0; half < 2; half++)
+        {
+            std::size_t frames = 0;
+            ASSERT_EQ(stream.Drain(values, frames), PortSDR::ErrorCode::OK);
+            ASSERT_EQ(frames, 1500u);
+            for (std::size_t k = 0; k < frames; k++, next++)
+            {
+                ASSERT_EQ(values[k], static_cast<uint8_t>(2 * next)) << "sample " << next;
+                ASSERT_EQ(values[frames + k], static_cast<uint8_t>(2 * next + 1)) << "sample " << next;
+            }
+        }
+    }
+    EXPECT_EQ(stream.GetPollOverflows(), 0u);
+}
+
+TEST(Planar, Consumers)
+{
+    using namespace std::chrono_literals;
+
+    FakeStream stream(PortSDR::SAMPLE_FORMAT_IQ_UINT8, 1000);
+    stream.SetSampleRate(1024000);
+    ASSERT_EQ(stream.SetSampleLayout(PortSDR::SAMPLE_LAYOUT_PLANAR), PortSDR::ErrorCode::OK);
+
+    // Helpers see the same samples as with an interleaved stream.
+    PortSDR::CaptureRing ring(stream);
+    std::size_t measured = 0;
+    ring.SetCallback([&measured](const PortSDR::SDRTransfer& transfer)
+    {
+        ASSERT_EQ(transfer.layout, PortSDR::SAMPLE_LAYOUT_PLANAR);
+
+        std::vector<uint8_t> interleaved(transfer.frame_size * 2);
+        PortSDR::ConvertTransfer(transfer, 0, interleaved.data(), transfer.format, transfer.frame_size);
+        const PortSDR::LevelStats level = PortSDR::MeasureLevel(transfer, 100, transfer.frame_size - 100);
+        const PortSDR::LevelStats tail = PortSDR::MeasureLevel(interleaved.data() + 200, transfer.format,
+                                                               interleaved.size() - 200);
+        EXPECT_NEAR(level.Power(), tail.Power(), 1e-12);
+        measured++;
+    });
+
+    PortSDR::CaptureConfig config;
+    config.duration = 4ms;
+    ASSERT_EQ(ring.Start(config), PortSDR::ErrorCode::OK);
+
+    for (int i = 0; i < 10; i++)
+        stream.Emit();
+    EXPECT_EQ(measured, 10u);
+
+    PortSDR::CaptureSnapshot snapshot;
+    ASSERT_EQ(ring.Snapshot(7000, 9000, snapshot), PortSDR::ErrorCode::OK);
+    std::vector<uint8_t> values(snapshot.GetFirst().begin(), snapshot.GetFirst().end());
+    values.insert(values.end(), snapshot.GetSecond().begin(), snapshot.GetSecond().end());
+    ASSERT_EQ(values.size(), 4000u);
+    for (std::size_t k = 0; k < values.size(); k++)
+        ASSERT_EQ(values[k], static_cast<uint8_t>(7000 * 2 + k)) << "value " << k;
+}
@@ -0,0 +1,127 @@
+#include <complex>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include <poll.h>
+
+#include "FakeStream.h"
+
+static bool IsReadable(const int fd)
+{
+    pollfd pfd{fd, POLLIN, 0};
+    return poll(&pfd, 1, 0) == 1 && (pfd.revents & POLLIN);
+}
+
+TEST(Poll, Watermark)
+{
+    FakeStream stream(PortSDR::SAMPLE_FORMAT_IQ_UINT8, 4096);
+
+    std::vector<int16_t> values(8192 * 2);
+    std::size_t frames = 0;
+
+    EXPECT_EQ(stream.GetPollFd(), -1);
+    EXPECT_EQ(stream.Drain(values, frames), PortSDR::ErrorCode::UNINITIALIZED);
+
+    ASSERT_EQ(stream.SetPollWatermark(10000), PortSDR::ErrorCode::OK);
+    const int fd = stream.GetPollFd();
+    ASSERT_GE(fd, 0);
+
+    stream.Emit();
+    stream.Emit();
+    EXPECT_FALSE(IsReadable(fd)) << "below the watermark";
+
+    stream.Emit();
+    EXPECT_TRUE(IsReadable(fd));
+
+    // 12288 buffered, draining 8192 drops below the watermark again.
+    ASSERT_EQ(stream.Drain(values, frames), PortSDR::ErrorCode::OK);
+    EXPECT_EQ(frames, 8192u);
+    EXPECT_FALSE(IsReadable(fd));
+
+    for (std::size_t i = 0; i < frames * 2; i++)
+        ASSERT_EQ(values[i], (static_cast<uint8_t>(i) - 128) * 256) << "value " << i;
+
+    stream.Emit();
+    stream.Emit();
+    EXPECT_TRUE(IsReadable(fd));
+
+    // A lower watermark keeps it readable after a partial drain.
+    ASSERT_EQ(stream.SetPollWatermark(1000), PortSDR::ErrorCode::OK);
+    ASSERT_EQ(stream.Drain(PortSDR::Span<int16_t>(values.data(), 4096 * 2), frames), PortSDR::ErrorCode::OK);
+    EXPECT_TRUE(IsReadable(fd));
+
+    std::size_t total = 0;
+    while (stream.Drain(values, frames) == PortSDR::ErrorCode::OK && frames > 0)
+        total += frames;
+    EXPECT_EQ(total, 12288u - 4096u);
+    EXPECT_FALSE(IsReadable(fd));
+    EXPECT_EQ(stream.GetPollOverflows(), 0u);
+}
+
+TEST(Poll, Overflow)
+{
+    FakeStream stream(PortSDR::SAMPLE_FORMAT_IQ_FLOAT32, 4096);
+    ASSERT_EQ(stream.SetPollWatermark(1024, 4096), PortSDR::ErrorCode::OK);
+
+    for (int i = 0; i < 16; i++)
+        stream.Emit();
+
+    // Only the first transfer fit, the others were dropped as a whole.
+    EXPECT_EQ(stream.GetPollOverflows(), 15 * 4096u);
+
+    // What was kept is the oldest data, converted into complex samples.
+    std::vector<std::complex<float>> samples(1024);
+    std::size_t frames = 0;
+    ASSERT_EQ(stream.Drain(samples, frames), PortSDR::ErrorCode::OK);
+    ASSERT_EQ(frames, 1024u);
+    for (std::size_t i = 0; i < frames; i++)
+    {
+        ASSERT_FLOAT_EQ(samples[i].real(), static_cast<int8_t>(i * 2) / 128.0f);
+        ASSERT_FLOAT_EQ(samples[i].imag(), static_cast<int8_t>(i * 2 + 1) / 128.0f);
+    }
+
+    // Room for 1024 samples isn't enough for the next transfer either.
+    stream.Emit();
+    EXPECT_EQ(stream.GetPollOverflows(), 16 * 4096u);
+
+    std::size_t total = frames;
+    while (stream.Drain(samples, frames) == PortSDR::ErrorCode::OK && frames > 0)
+        total += frames;
+    EXPECT_EQ(total, 4096u);
+}
+
+TEST(Poll, Streaming)
+{
+    // Paced like a device, 4 ms per transfer. The buffer holds the whole run,
+    // so a reader that is descheduled for a while doesn't lose anything.
+    FakeStream stream(PortSDR::SAMPLE_FORMAT_IQ_INT16, 4096);
+    stream.SetSampleRate(1024000);
+    stream.SetPaced(true);
+    ASSERT_EQ(stream.SetPollWatermark(16384, 4096 * 64), PortSDR::ErrorCode::OK);
+    ASSERT_EQ(stream.Start(), PortSDR::ErrorCode::OK);
+
+    std::vector<float> values(16384 * 2);
+    std::size_t total = 0;
+    std::size_t wakeups = 0;
+
+    while (total < 4096 * 64)
+    {
+        pollfd pfd{stream.GetPollFd(), POLLIN, 0};
+        ASSERT_EQ(poll(&pfd, 1, 5000), 1) << "no wakeup";
+        wakeups++;
+
+        std::size_t frames = 0;
+        while (stream.Drain(values, frames) == PortSDR::ErrorCode::OK && frames > 0)
+        {
+            for (std::size_t i = 0; i < frames * 2; i++)
+                ASSERT_FLOAT_EQ(values[i], static_cast<int8_t>(total * 2 + i) / 128.0f);
+            total += frames;
+        }
+    }
+
+    ASSERT_EQ(stream.Stop(), PortSDR::ErrorCode::OK);
+
+    // Batched wakeups, at most one for every four transfers.
+    EXPECT_LE(wakeups, 64u / 4u + 1u);
+    EXPECT_EQ(stream.GetPollOverflows(), 0u);
+}
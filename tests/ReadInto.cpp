@@ -0,0 +1,149 @@
+#include <atomic>
+#include <array>
+#include <complex>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "FakeStream.h"
+
+TEST(ReadInto, Conversion)
+{
+    FakeStream stream(PortSDR::SAMPLE_FORMAT_IQ_UINT8, 1024);
+    std::thread producer([&stream]
+    {
+        // Transfers are only kept for ReadInto() once it was called.
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        for (int i = 0; i < 2; i++)
+            stream.Emit();
+    });
+
+    // Smaller than a transfer, the rest must come with the next reads.
+    std::vector<int16_t> values(1024);
+    std::size_t frames = 0;
+    ASSERT_EQ(stream.ReadInto(values, frames), PortSDR::ErrorCode::OK);
+    ASSERT_EQ(frames, 512u);
+
+    for (std::size_t i = 0; i < values.size(); i++)
+        ASSERT_EQ(values[i], (static_cast<uint8_t>(i) - 128) * 256) << "value " << i;
+
+    // The rest of the first transfer was buffered, reads continue right after it.
+    std::vector<std::complex<float>> samples(1024);
+    std::size_t total = 512;
+    while (total < 2048)
+    {
+        ASSERT_EQ(stream.ReadInto(samples, frames), PortSDR::ErrorCode::OK);
+        for (std::size_t i = 0; i < frames; i++)
+        {
+            const std::size_t index = (total + i) * 2;
+            ASSERT_NEAR(samples[i].real(), static_cast<uint8_t>(index) / 127.5f - 1.0f, 1e-6);
+            ASSERT_NEAR(samples[i].imag(), static_cast<uint8_t>(index + 1) / 127.5f - 1.0f, 1e-6);
+        }
+        total += frames;
+    }
+    EXPECT_EQ(total, 2048u);
+    EXPECT_EQ(stream.GetReadOverflows(), 0u);
+
+    producer.join();
+}
+
+TEST(ReadInto, FloatToInt16)
+{
+    FakeStream stream(PortSDR::SAMPLE_FORMAT_IQ_FLOAT32, 1000);
+    std::thread producer([&stream]
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        stream.Emit();
+    });
+
+    std::vector<int16_t> values(2000);
+    std::size_t frames = 0;
+    ASSERT_EQ(stream.ReadInto(values, frames), PortSDR::ErrorCode::OK);
+    ASSERT_EQ(frames, 1000u);
+
+    for (std::size_t i = 0; i < values.size(); i++)
+        ASSERT_EQ(values[i], static_cast<int8_t>(i) * 256) << "value " << i;
+
+    producer.join();
+}
+
+TEST(ReadInto, Timeout)
+{
+    FakeStream stream;
+
+    std::vector<float> values(1024);
+    std::size_t frames = 0;
+    EXPECT_EQ(stream.ReadInto(values, frames, std::chrono::milliseconds(20)), PortSDR::ErrorCode::TIMEOUT);
+    EXPECT_EQ(frames, 0u);
+
+    EXPECT_EQ(stream.ReadInto(PortSDR::Span<float>(), frames), PortSDR::ErrorCode::INVALID_ARGUMENT);
+}
+
+TEST(ReadInto, Streaming)
+{
+    FakeStream stream(PortSDR::SAMPLE_FORMAT_IQ_INT16, 4096);
+    ASSERT_EQ(stream.Start(), PortSDR::ErrorCode::OK);
+
+    // Every sample arrives exactly once and in order.
+    std::vector<float> values(3000);
+    std::size_t total = 0;
+    while (total < 4096 * 8)
+    {
+        std::size_t frames = 0;
+        ASSERT_EQ(stream.ReadInto(values, frames), PortSDR::ErrorCode::OK);
+
+        for (std::size_t i = 0; i < frames * 2; i++)
+            ASSERT_FLOAT_EQ(values[i], static_cast<int8_t>(total * 2 + i) / 128.0f);
+        total += frames;
+    }
+
+    // Stopping releases the held transfer and wakes up waiting readers.
+    std::thread reader([&stream, &values]
+    {
+        std::size_t frames = 0;
+        PortSDR::ErrorCode ret;
+        do
+        {
+            ret = stream.ReadInto(values, frames, std::chrono::seconds(5));
+        }
+        while (ret == PortSDR::ErrorCode::OK);
+        EXPECT_EQ(ret, PortSDR::ErrorCode::STOPPED);
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    ASSERT_EQ(stream.Stop(), PortSDR::ErrorCode::OK);
+    reader.join();
+}
+
+TEST(ReadInto, AbandonedReader)
+{
+    FakeStream stream(PortSDR::SAMPLE_FORMAT_IQ_UINT8, 65536);
+
+    std::atomic<int> transfers{0};
+    stream.SetCallback([&transfers](PortSDR::SDRTransfer&)
+    {
+        transfers++;
+    });
+    ASSERT_EQ(stream.Start(), PortSDR::ErrorCode::OK);
+
+    std::vector<uint8_t> values(1024);
+    std::size_t frames = 0;
+    ASSERT_EQ(stream.ReadInto(values, frames), PortSDR::ErrorCode::OK);
+    const uint8_t last = values.back();
+
+    // Nobody reads anymore, the receiving thread keeps going and drops what doesn't fit.
+    const int start = transfers;
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while ((transfers - start < 200 || stream.GetReadOverflows() == 0) && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    EXPECT_GE(transfers - start, 200);
+    EXPECT_GT(stream.GetReadOverflows(), 0u);
+
+    // Reading picks up the oldest buffered samples, right after the first read.
+    ASSERT_EQ(stream.ReadInto(values, frames), PortSDR::ErrorCode::OK);
+    ASSERT_EQ(frames, 512u);
+    EXPECT_EQ(values[0], static_cast<uint8_t>(last + 1));
+
+    ASSERT_EQ(stream.Stop(), PortSDR::ErrorCode::OK);
+}
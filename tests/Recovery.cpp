@@ -0,0 +1,155 @@
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <gtest/gtest.h>
+
+#include "FakeStream.h"
+
+using namespace std::chrono_literals;
+
+/**
+ * Collects recovery events and the first transfer after each recovery.
+ */
+class RecoveryObserver
+{
+public:
+    explicit RecoveryObserver(PortSDR::Stream& stream)
+    {
+        stream.SetRecoveryCallback([this](const PortSDR::RecoveryEvent& event)
+        {
+            std::lock_guard lock(m_mutex);
+            m_event = event;
+            m_cond.notify_all();
+        });
+        stream.SetCallback([this](const PortSDR::SDRTransfer& transfer)
+        {
+            std::lock_guard lock(m_mutex);
+            m_transfers++;
+            if (transfer.discontinuity)
+            {
+                m_gap = transfer.dropped_samples;
+                EXPECT_GE(transfer.tag_count, 1u);
+                EXPECT_EQ(transfer.tags[0].type, PortSDR::STREAM_TAG_RECOVERY);
+            }
+            m_cond.notify_all();
+        });
+    }
+
+    std::optional<PortSDR::RecoveryEvent> WaitEvent(const std::chrono::milliseconds timeout = 5s)
+    {
+        std::unique_lock lock(m_mutex);
+        m_cond.wait_for(lock, timeout, [this] { return m_event.has_value(); });
+        return m_event;
+    }
+
+    std::optional<std::size_t> WaitGap(const std::chrono::milliseconds timeout = 5s)
+    {
+        std::unique_lock lock(m_mutex);
+        m_cond.wait_for(lock, timeout, [this] { return m_gap.has_value(); });
+        return m_gap;
+    }
+
+    bool WaitTransfers(const int count)
+    {
+        std::unique_lock lock(m_mutex);
+        return m_cond.wait_for(lock, 5s, [this, count] { return m_transfers >= count; });
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::optional<PortSDR::RecoveryEvent> m_event;
+    std::optional<std::size_t> m_gap;
+    int m_transfers = 0;
+};
+
+TEST(Recovery, Stall)
+{
+    FakeStream stream(PortSDR::SAMPLE_FORMAT_IQ_UINT8, 1024);
+    stream.SetSampleRate(1024000);
+    RecoveryObserver observer(stream);
+
+    ASSERT_EQ(stream.SetRecovery({100ms, 10ms, 0}), PortSDR::ErrorCode::OK);
+    ASSERT_EQ(stream.Start(), PortSDR::ErrorCode::OK);
+    ASSERT_TRUE(observer.WaitTransfers(5));
+
+    stream.Fail();
+
+    const auto event = observer.WaitEvent();
+    ASSERT_TRUE(event.has_value());
+    EXPECT_EQ(event->cause, PortSDR::ErrorCode::TIMEOUT);
+    EXPECT_TRUE(event->recovered);
+    EXPECT_EQ(event->attempts, 1u);
+    EXPECT_GE(event->downtime, 100ms);
+
+    // At least the stall timeout worth of samples is missing.
+    const auto gap = observer.WaitGap();
+    ASSERT_TRUE(gap.has_value());
+    EXPECT_GE(*gap, 100000u);
+
+    stream.Stop();
+
+    const PortSDR::RecoveryStats stats = stream.GetRecoveryStats();
+    EXPECT_EQ(stats.recoveries, 1u);
+    EXPECT_EQ(stats.failures, 0u);
+    EXPECT_EQ(stats.last_downtime, event->downtime);
+    EXPECT_EQ(stream.GetReopens(), 1);
+}
+
+TEST(Recovery, ReportedFailure)
+{
+    FakeStream stream;
+    RecoveryObserver observer(stream);
+
+    // Reported errors don't wait for the stall timeout.
+    ASSERT_EQ(stream.SetRecovery({10s, 10ms, 0}), PortSDR::ErrorCode::OK);
+    ASSERT_EQ(stream.Start(), PortSDR::ErrorCode::OK);
+    ASSERT_TRUE(observer.WaitTransfers(5));
+
+    stream.SetReopenFailures(2);
+    stream.Fail(PortSDR::ErrorCode::LIBUSB_ERROR);
+
+    const auto event = observer.WaitEvent(2s);
+    ASSERT_TRUE(event.has_value());
+    EXPECT_EQ(event->cause, PortSDR::ErrorCode::LIBUSB_ERROR);
+    EXPECT_TRUE(event->recovered);
+    EXPECT_EQ(event->attempts, 3u);
+    EXPECT_TRUE(observer.WaitGap(2s).has_value());
+}
+
+TEST(Recovery, GivesUp)
+{
+    FakeStream stream;
+    RecoveryObserver observer(stream);
+
+    ASSERT_EQ(stream.SetRecovery({50ms, 5ms, 3}), PortSDR::ErrorCode::OK);
+    ASSERT_EQ(stream.Start(), PortSDR::ErrorCode::OK);
+    ASSERT_TRUE(observer.WaitTransfers(5));
+
+    stream.SetReopenFailures(100);
+    stream.Fail();
+
+    const auto event = observer.WaitEvent();
+    ASSERT_TRUE(event.has_value());
+    EXPECT_FALSE(event->recovered);
+    EXPECT_EQ(event->attempts, 3u);
+
+    // Not retried again until a transfer arrives.
+    std::this_thread::sleep_for(200ms);
+    EXPECT_EQ(stream.GetRecoveryStats().failures, 1u);
+    EXPECT_EQ(stream.GetReopens(), 0);
+}
+
+TEST(Recovery, StopIsNoFailure)
+{
+    FakeStream stream;
+    RecoveryObserver observer(stream);
+
+    ASSERT_EQ(stream.SetRecovery({50ms, 5ms, 0}), PortSDR::ErrorCode::OK);
+    ASSERT_EQ(stream.Start(), PortSDR::ErrorCode::OK);
+    ASSERT_TRUE(observer.WaitTransfers(5));
+    ASSERT_EQ(stream.Stop(), PortSDR::ErrorCode::OK);
+
+    EXPECT_FALSE(observer.WaitEvent(200ms).has_value());
+    EXPECT_EQ(stream.GetReopens(), 0);
+}
@@ -0,0 +1,212 @@
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "FakeStream.h"
+#include "RtlTcpServer.h"
+
+static int ConnectLoopback(const uint16_t port)
+{
+    const int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    timeval timeout{2, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static bool ReadExact(const int fd, uint8_t* data, const std::size_t size)
+{
+    std::size_t done = 0;
+    while (done < size)
+    {
+        const ssize_t ret = recv(fd, data + done, size - done, 0);
+        if (ret <= 0)
+            return false;
+        done += ret;
+    }
+    return true;
+}
+
+static void SendCommand(const int fd, const uint8_t command, const uint32_t param)
+{
+    const uint8_t buf[5] = {
+        command,
+        static_cast<uint8_t>(param >> 24),
+        static_cast<uint8_t>(param >> 16),
+        static_cast<uint8_t>(param >> 8),
+        static_cast<uint8_t>(param)
+    };
+    ASSERT_EQ(send(fd, buf, sizeof(buf), 0), sizeof(buf));
+}
+
+static void ExpectCountingPattern(const std::vector<uint8_t>& data)
+{
+    for (std::size_t i = 1; i < data.size(); i++)
+    {
+        ASSERT_EQ(static_cast<uint8_t>(data[i - 1] + 1), data[i]) << "Discontinuity at " << i;
+    }
+}
+
+TEST(RtlTcpServer, HeaderAndSamples)
+{
+    FakeStream stream;
+    PortSDR::RtlTcpServer server(stream);
+
+    ASSERT_EQ(server.Start("127.0.0.1", 0), PortSDR::ErrorCode::OK);
+    ASSERT_NE(server.GetPort(), 0);
+
+    const int fd = ConnectLoopback(server.GetPort());
+    ASSERT_GE(fd, 0);
+
+    uint8_t header[12];
+    ASSERT_TRUE(ReadExact(fd, header, sizeof(header)));
+    EXPECT_EQ(std::memcmp(header, "RTL0", 4), 0);
+    // FakeStream advertises LNA gains 0 to 49 dB
+    EXPECT_EQ(header[11], 50);
+
+    std::vector<uint8_t> samples(256 * 1024);
+    ASSERT_TRUE(ReadExact(fd, samples.data(), samples.size()));
+    ExpectCountingPattern(samples);
+
+    close(fd);
+    EXPECT_EQ(server.Stop(), PortSDR::ErrorCode::OK);
+}
+
+TEST(RtlTcpServer, ConvertsInt16)
+{
+    FakeStream stream(PortSDR::SAMPLE_FORMAT_IQ_INT16);
+    PortSDR::RtlTcpServer server(stream);
+
+    ASSERT_EQ(server.Start("127.0.0.1", 0), PortSDR::ErrorCode::OK);
+
+    const int fd = ConnectLoopback(server.GetPort());
+    ASSERT_GE(fd, 0);
+
+    std::vector<uint8_t> samples(12 + 64 * 1024);
+    ASSERT_TRUE(ReadExact(fd, samples.data(), samples.size()));
+    samples.erase(samples.begin(), samples.begin() + 12);
+    ExpectCountingPattern(samples);
+
+    close(fd);
+}
+
+TEST(RtlTcpServer, ConvertsFloat32)
+{
+    FakeStream stream(PortSDR::SAMPLE_FORMAT_IQ_FLOAT32);
+    PortSDR::RtlTcpServer server(stream);
+
+    ASSERT_EQ(server.Start("127.0.0.1", 0), PortSDR::ErrorCode::OK);
+
+    const int fd = ConnectLoopback(server.GetPort());
+    ASSERT_GE(fd, 0);
+
+    std::vector<uint8_t> samples(12 + 64 * 1024);
+    ASSERT_TRUE(ReadExact(fd, samples.data(), samples.size()));
+    samples.erase(samples.begin(), samples.begin() + 12);
+
+    // Scaling by 127.5 is not exact, allow one step of error.
+    for (std::size_t i = 1; i < samples.size(); i++)
+    {
+        const int step = static_cast<uint8_t>(samples[i] - samples[i - 1]);
+        ASSERT_TRUE(step == 1 || step == 2 || step == 0 || static_cast<uint8_t>(step + 254) <= 2)
+            << "Unexpected step " << step << " at " << i;
+    }
+
+    close(fd);
+}
+
+TEST(RtlTcpServer, Commands)
+{
+    FakeStream stream;
+    PortSDR::RtlTcpServer server(stream);
+
+    ASSERT_EQ(server.Start("127.0.0.1", 0), PortSDR::ErrorCode::OK);
+
+    const int fd = ConnectLoopback(server.GetPort());
+    ASSERT_GE(fd, 0);
+
+    SendCommand(fd, 0x01, 100700000);
+    SendCommand(fd, 0x02, 1024000);
+    SendCommand(fd, 0x04, 212); // 21.2 dB, closest is 21 dB
+    SendCommand(fd, 0x0d, 0);
+    SendCommand(fd, 0x04, 330);
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (stream.GetGain("LNA") != 33 && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    EXPECT_EQ(stream.GetCenterFrequency(), 100700000);
+    EXPECT_EQ(stream.GetSampleRate(), 1024000);
+    EXPECT_EQ(stream.GetGain("LNA"), 33);
+
+    close(fd);
+}
+
+TEST(RtlTcpServer, MultipleClients)
+{
+    FakeStream stream;
+    PortSDR::RtlTcpServer server(stream);
+
+    ASSERT_EQ(server.Start("127.0.0.1", 0), PortSDR::ErrorCode::OK);
+
+    int fds[4];
+    for (int& fd : fds)
+    {
+        fd = ConnectLoopback(server.GetPort());
+        ASSERT_GE(fd, 0);
+    }
+
+    for (const int fd : fds)
+    {
+        std::vector<uint8_t> samples(12 + 32 * 1024);
+        ASSERT_TRUE(ReadExact(fd, samples.data(), samples.size()));
+        samples.erase(samples.begin(), samples.begin() + 12);
+        ExpectCountingPattern(samples);
+    }
+
+    EXPECT_EQ(server.GetClientCount(), 4);
+
+    for (const int fd : fds)
+        close(fd);
+}
+
+TEST(RtlTcpServer, GrowsRingForLargeTransfers)
+{
+    FakeStream stream(PortSDR::SAMPLE_FORMAT_IQ_UINT8, 8192);
+    PortSDR::RtlTcpServer server(stream);
+    server.SetBufferSize(4096);
+
+    ASSERT_EQ(server.Start("127.0.0.1", 0), PortSDR::ErrorCode::OK);
+
+    const int fd = ConnectLoopback(server.GetPort());
+    ASSERT_GE(fd, 0);
+
+    // Transfers are no longer cut to half of the ring.
+    std::vector<uint8_t> samples(12 + 4096);
+    ASSERT_TRUE(ReadExact(fd, samples.data(), samples.size()));
+    samples.erase(samples.begin(), samples.begin() + 12);
+    ExpectCountingPattern(samples);
+
+    // The transfer that didn't fit is counted.
+    EXPECT_GE(server.GetDroppedSamples(), 8192);
+
+    close(fd);
+}
@@ -0,0 +1,95 @@
+#include <cmath>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "FakeStream.h"
+#include "Settle.h"
+
+using namespace std::chrono_literals;
+
+TEST(Settle, Calibrate)
+{
+    constexpr std::size_t settleSamples = 3000;
+    constexpr std::size_t blockSize = 256;
+
+    FakeStream stream(PortSDR::SAMPLE_FORMAT_IQ_FLOAT32, 1024);
+    stream.SetSampleRate(1024000);
+    stream.SetSettleSamples(settleSamples);
+    stream.SetPaced(true);
+
+    PortSDR::RetuneCalibrator calibrator(stream);
+    stream.SetCallback([&calibrator](const PortSDR::SDRTransfer& transfer)
+    {
+        calibrator.Process(transfer);
+    });
+    ASSERT_EQ(stream.Start(), PortSDR::ErrorCode::OK);
+
+    PortSDR::SettleConfig config;
+    config.block_size = blockSize;
+
+    PortSDR::SettleResult result;
+    ASSERT_EQ(calibrator.Calibrate({100000000, 101000000, 102000000}, result, config), PortSDR::ErrorCode::OK);
+    stream.Stop();
+
+    // The settle time ends within the block after the attenuated samples.
+    EXPECT_EQ(result.tuner, "Fake");
+    EXPECT_EQ(result.retunes, 3u);
+    EXPECT_GE(result.settle_time.count(), static_cast<int64_t>(settleSamples * 1e6 / 1024000));
+    EXPECT_LE(result.settle_time.count(), static_cast<int64_t>((settleSamples + 2 * blockSize) * 1e6 / 1024000));
+    EXPECT_LE(result.average, result.settle_time);
+
+    EXPECT_EQ(stream.GetSettleSkip(), result.settle_time);
+    EXPECT_EQ(PortSDR::GetCalibratedSettleTime("Fake"), result.settle_time);
+    EXPECT_FALSE(PortSDR::GetCalibratedSettleTime("Unknown").has_value());
+}
+
+TEST(Settle, Skip)
+{
+    FakeStream stream(PortSDR::SAMPLE_FORMAT_IQ_FLOAT32, 1024);
+    stream.SetSampleRate(1024000);
+    stream.SetSettleSamples(3000);
+    stream.SetSettleSkip(4ms);
+
+    std::vector<float> values;
+    std::vector<PortSDR::StreamTag> tags;
+    std::size_t received = 0;
+    std::size_t dropped = 0;
+    std::size_t retuneDropped = 0;
+    stream.SetCallback([&](const PortSDR::SDRTransfer& transfer)
+    {
+        const auto* data = static_cast<const float*>(transfer.data);
+        values.insert(values.end(), data, data + transfer.frame_size * 2);
+
+        for (std::size_t i = 0; i < transfer.tag_count; i++)
+        {
+            if (transfer.tags[i].type != PortSDR::STREAM_TAG_FREQUENCY)
+                continue;
+            tags.push_back(transfer.tags[i]);
+            retuneDropped = transfer.dropped_samples;
+        }
+
+        received += transfer.frame_size;
+        dropped += transfer.dropped_samples;
+    });
+
+    stream.Emit();
+    stream.Emit();
+    stream.SetCenterFrequency(100000000);
+    for (int i = 0; i < 10; i++)
+        stream.Emit();
+
+    EXPECT_EQ(received + dropped, 12 * 1024u);
+    EXPECT_GE(dropped, 4096u);
+    EXPECT_EQ(retuneDropped, dropped);
+
+    ASSERT_EQ(tags.size(), 1u);
+    EXPECT_EQ(tags[0].offset, 0u);
+
+    // None of the attenuated samples made it through.
+    std::size_t run = 0;
+    for (std::size_t i = 0; i < values.size(); i += 2)
+    {
+        run = std::fabs(values[i]) < 0.15f && std::fabs(values[i + 1]) < 0.15f ? run + 1 : 0;
+        ASSERT_LT(run, 32u) << "at sample " << i / 2;
+    }
+}
@@ -0,0 +1,225 @@
+#include <chrono>
+#include <string>
+#include <thread>
+#include <gtest/gtest.h>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "FakeStream.h"
+#include "SharedMemory.h"
+
+using namespace std::chrono_literals;
+
+static std::string UniqueName(const char* test)
+{
+    return "/portsdr-test-" + std::string(test) + "-" + std::to_string(getpid());
+}
+
+static PortSDR::SDRTransfer MakeTransfer(std::vector<uint8_t>& buffer, const std::size_t frames, uint8_t& value)
+{
+    buffer.resize(frames * 2);
+    for (auto& v : buffer)
+        v = value++;
+
+    PortSDR::SDRTransfer transfer{};
+    transfer.data = buffer.data();
+    transfer.frame_size = frames;
+    transfer.format = PortSDR::SAMPLE_FORMAT_IQ_UINT8;
+    return transfer;
+}
+
+TEST(SharedMemory, PublishAndRead)
+{
+    const std::string name = UniqueName("read");
+
+    PortSDR::ShmPublisher publisher;
+    ASSERT_EQ(publisher.Create(name, 8, 4096), PortSDR::ErrorCode::OK);
+
+    PortSDR::ShmSubscriber subscriber;
+    ASSERT_EQ(subscriber.Open(name), PortSDR::ErrorCode::OK);
+    ASSERT_EQ(publisher.GetReaders().size(), 1);
+
+    PortSDR::ShmBlock block{};
+    EXPECT_EQ(subscriber.Next(block, 10ms), PortSDR::ErrorCode::TIMEOUT);
+
+    // 3000 frames do not fit a 4096 byte slot and are split in two blocks.
+    std::vector<uint8_t> buffer;
+    uint8_t value = 0;
+    ASSERT_EQ(publisher.Publish(MakeTransfer(buffer, 3000, value)), PortSDR::ErrorCode::OK);
+
+    ASSERT_EQ(subscriber.Next(block, 100ms), PortSDR::ErrorCode::OK);
+    EXPECT_EQ(block.frame_size, 2048);
+    EXPECT_EQ(block.sample_index, 0);
+    EXPECT_EQ(static_cast<const uint8_t*>(block.data)[1], 1);
+    EXPECT_TRUE(subscriber.IsValid(block));
+
+    ASSERT_EQ(subscriber.Next(block, 100ms), PortSDR::ErrorCode::OK);
+    EXPECT_EQ(block.frame_size, 952);
+    EXPECT_EQ(block.sample_index, 2048);
+    EXPECT_EQ(static_cast<const uint8_t*>(block.data)[0], static_cast<uint8_t>(4096));
+    EXPECT_TRUE(subscriber.IsValid(block));
+}
+
+TEST(SharedMemory, LaggingReader)
+{
+    const std::string name = UniqueName("lag");
+
+    PortSDR::ShmPublisher publisher;
+    ASSERT_EQ(publisher.Create(name, 4, 1024), PortSDR::ErrorCode::OK);
+
+    PortSDR::ShmSubscriber subscriber;
+    ASSERT_EQ(subscriber.Open(name), PortSDR::ErrorCode::OK);
+
+    std::vector<uint8_t> buffer;
+    uint8_t value = 0;
+
+    PortSDR::ShmBlock stale{};
+    ASSERT_EQ(publisher.Publish(MakeTransfer(buffer, 512, value)), PortSDR::ErrorCode::OK);
+    ASSERT_EQ(subscriber.Next(stale, 100ms), PortSDR::ErrorCode::OK);
+
+    // The publisher never waits, the reader loses the oldest blocks.
+    for (int i = 0; i < 10; i++)
+        ASSERT_EQ(publisher.Publish(MakeTransfer(buffer, 512, value)), PortSDR::ErrorCode::OK);
+
+    EXPECT_FALSE(subscriber.IsValid(stale));
+
+    PortSDR::ShmBlock block{};
+    ASSERT_EQ(subscriber.Next(block, 100ms), PortSDR::ErrorCode::OK);
+    EXPECT_EQ(block.sequence, 8);
+    EXPECT_EQ(subscriber.GetLostBlocks(), 7);
+    EXPECT_TRUE(subscriber.IsValid(block));
+}
+
+TEST(SharedMemory, OtherProcess)
+{
+    const std::string name = UniqueName("process");
+
+    PortSDR::ShmPublisher publisher;
+    ASSERT_EQ(publisher.Create(name, 64, 16384), PortSDR::ErrorCode::OK);
+
+    const pid_t child = fork();
+    ASSERT_GE(child, 0);
+
+    if (child == 0)
+    {
+        PortSDR::ShmSubscriber subscriber;
+        if (subscriber.Open(name) != PortSDR::ErrorCode::OK)
+            _exit(2);
+
+        // Verify the counting pattern across blocks written by the parent.
+        std::size_t received = 0;
+        int last = -1;
+        while (received < 256 * 1024)
+        {
+            PortSDR::ShmBlock block{};
+            if (subscriber.Next(block, 2s) != PortSDR::ErrorCode::OK)
+                _exit(3);
+
+            const auto* data = static_cast<const uint8_t*>(block.data);
+            for (std::size_t i = 0; i < block.frame_size * 2; i++)
+            {
+                if (last >= 0 && static_cast<uint8_t>(last + 1) != data[i])
+                    _exit(4);
+                last = data[i];
+            }
+
+            if (!subscriber.IsValid(block) || subscriber.GetLostBlocks() != 0)
+                _exit(5);
+
+            received += block.frame_size * 2;
+        }
+        _exit(0);
+    }
+
+    // Wait for the child to attach before publishing.
+    const auto deadline = std::chrono::steady_clock::now() + 2s;
+    while (publisher.GetReaders().empty() && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(1ms);
+    ASSERT_EQ(publisher.GetReaders().size(), 1);
+
+    FakeStream stream(PortSDR::SAMPLE_FORMAT_IQ_UINT8, 4096);
+    stream.SetCallback([&](const PortSDR::SDRTransfer& transfer)
+    {
+        publisher.Publish(transfer);
+    });
+
+    ASSERT_EQ(stream.Start(), PortSDR::ErrorCode::OK);
+
+    int status = 0;
+    ASSERT_EQ(waitpid(child, &status, 0), child);
+    stream.Stop();
+
+    ASSERT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+}
+
+TEST(SharedMemory, CrashedReader)
+{
+    const std::string name = UniqueName("crash");
+
+    PortSDR::ShmPublisher publisher;
+    ASSERT_EQ(publisher.Create(name, 4, 1024), PortSDR::ErrorCode::OK);
+
+    const pid_t child = fork();
+    ASSERT_GE(child, 0);
+
+    if (child == 0)
+    {
+        // Leaves without releasing its reader slot.
+        auto* subscriber = new PortSDR::ShmSubscriber;
+        _exit(subscriber->Open(name) == PortSDR::ErrorCode::OK ? 0 : 1);
+    }
+
+    int status = 0;
+    ASSERT_EQ(waitpid(child, &status, 0), child);
+    ASSERT_EQ(WEXITSTATUS(status), 0);
+
+    EXPECT_TRUE(publisher.GetReaders().empty());
+
+    std::vector<uint8_t> buffer;
+    uint8_t value = 0;
+    for (int i = 0; i < 16; i++)
+        EXPECT_EQ(publisher.Publish(MakeTransfer(buffer, 256, value)), PortSDR::ErrorCode::OK);
+}
+
+TEST(SharedMemory, LivePublisherKeepsName)
+{
+    const std::string name = UniqueName("owner");
+
+    PortSDR::ShmPublisher publisher;
+    ASSERT_EQ(publisher.Create(name, 4, 1024), PortSDR::ErrorCode::OK);
+
+    PortSDR::ShmSubscriber subscriber;
+    ASSERT_EQ(subscriber.Open(name), PortSDR::ErrorCode::OK);
+
+    // Would take the segment away from the readers of the first one.
+    PortSDR::ShmPublisher second;
+    EXPECT_EQ(second.Create(name, 4, 1024), PortSDR::ErrorCode::FAILED_TO_INITIALIZE);
+    EXPECT_EQ(publisher.GetReaders().size(), 1);
+
+    publisher.Close();
+    EXPECT_EQ(second.Create(name, 4, 1024), PortSDR::ErrorCode::OK);
+}
+
+TEST(SharedMemory, CrashedPublisher)
+{
+    const std::string name = UniqueName("stale");
+
+    const pid_t child = fork();
+    ASSERT_GE(child, 0);
+
+    if (child == 0)
+    {
+        // Leaves without removing its segment.
+        auto* publisher = new PortSDR::ShmPublisher;
+        _exit(publisher->Create(name, 4, 1024) == PortSDR::ErrorCode::OK ? 0 : 1);
+    }
+
+    int status = 0;
+    ASSERT_EQ(waitpid(child, &status, 0), child);
+    ASSERT_EQ(WEXITSTATUS(status), 0);
+
+    PortSDR::ShmPublisher publisher;
+    EXPECT_EQ(publisher.Create(name, 4, 1024), PortSDR::ErrorCode::OK);
+}
@@ -0,0 +1,135 @@
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "FakeStream.h"
+
+using namespace std::chrono_literals;
+
+TEST(Tags, BeforeStart)
+{
+    FakeStream stream(PortSDR::SAMPLE_FORMAT_IQ_UINT8, 1024);
+
+    std::vector<std::vector<PortSDR::StreamTag>> tags;
+    stream.SetCallback([&tags](const PortSDR::SDRTransfer& transfer)
+    {
+        tags.emplace_back(transfer.tags, transfer.tags + transfer.tag_count);
+    });
+
+    stream.SetSampleRate(1024000);
+    stream.SetCenterFrequency(100000000);
+
+    stream.Emit();
+    stream.Emit();
+
+    ASSERT_EQ(tags.size(), 2u);
+    ASSERT_EQ(tags[0].size(), 2u);
+    EXPECT_EQ(tags[0][0].type, PortSDR::STREAM_TAG_SAMPLE_RATE);
+    EXPECT_EQ(tags[0][0].value, 1024000);
+    EXPECT_EQ(tags[0][1].type, PortSDR::STREAM_TAG_FREQUENCY);
+    EXPECT_EQ(tags[0][1].value, 100000000);
+    EXPECT_EQ(tags[0][1].offset, 0u);
+    EXPECT_EQ(tags[0][1].sample_index, 0u);
+    EXPECT_TRUE(tags[1].empty());
+}
+
+TEST(Tags, MidStream)
+{
+    FakeStream stream(PortSDR::SAMPLE_FORMAT_IQ_UINT8, 4096);
+    stream.SetSampleRate(1024000);
+
+    std::vector<std::vector<PortSDR::StreamTag>> tags;
+    stream.SetCallback([&tags](const PortSDR::SDRTransfer& transfer)
+    {
+        tags.emplace_back(transfer.tags, transfer.tags + transfer.tag_count);
+    });
+
+    stream.Emit();
+    stream.SetGain(20, "LNA");
+    stream.Emit();
+
+    ASSERT_EQ(tags.size(), 2u);
+    ASSERT_EQ(tags[1].size(), 1u);
+
+    // On the first sample delivered after it was applied.
+    const PortSDR::StreamTag& tag = tags[1][0];
+    EXPECT_EQ(tag.type, PortSDR::STREAM_TAG_GAIN);
+    EXPECT_EQ(tag.value, 20);
+    EXPECT_STREQ(tag.name, "LNA");
+    EXPECT_EQ(tag.offset, 0u);
+    EXPECT_EQ(tag.sample_index, 4096u);
+}
+
+TEST(Tags, Anchored)
+{
+    // 1 ms per transfer, captured in real time by the receiving thread.
+    FakeStream stream(PortSDR::SAMPLE_FORMAT_IQ_UINT8, 1024);
+    stream.SetSampleRate(1024000);
+    stream.SetPaced(true);
+
+    std::mutex mutex;
+    std::vector<PortSDR::StreamTag> retunes;
+    std::atomic<std::size_t> transfers{0};
+    stream.SetCallback([&](const PortSDR::SDRTransfer& transfer)
+    {
+        std::lock_guard lock(mutex);
+        for (std::size_t i = 0; i < transfer.tag_count; i++)
+        {
+            if (transfer.tags[i].type == PortSDR::STREAM_TAG_FREQUENCY)
+                retunes.push_back(transfer.tags[i]);
+        }
+        transfers++;
+    });
+    ASSERT_EQ(stream.Start(), PortSDR::ErrorCode::OK);
+
+    const auto deadline = std::chrono::steady_clock::now() + 2s;
+    while (transfers < 5 && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(1ms);
+
+    // Retuned from another thread while streaming.
+    stream.SetCenterFrequency(100000000);
+    const uint64_t change = stream.GetRetuneIndex();
+
+    const std::size_t after = transfers;
+    while (transfers < after + 2 && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(1ms);
+    stream.Stop();
+
+    // Exactly on the sample the retune took effect at.
+    std::lock_guard lock(mutex);
+    ASSERT_EQ(retunes.size(), 1u);
+    EXPECT_GE(change, 5 * 1024u);
+    EXPECT_EQ(retunes[0].sample_index, change);
+    EXPECT_EQ(retunes[0].offset, 0u);
+}
+
+TEST(Tags, Overflow)
+{
+    FakeStream stream(PortSDR::SAMPLE_FORMAT_IQ_UINT8, 1000);
+
+    std::vector<std::vector<PortSDR::StreamTag>> tags;
+    stream.SetCallback([&tags](const PortSDR::SDRTransfer& transfer)
+    {
+        tags.emplace_back(transfer.tags, transfer.tags + transfer.tag_count);
+    });
+
+    stream.Emit();
+    stream.Emit(500);
+    stream.SetSampleFormat(PortSDR::SAMPLE_FORMAT_IQ_INT16);
+    stream.Emit();
+
+    ASSERT_EQ(tags.size(), 3u);
+    ASSERT_EQ(tags[1].size(), 1u);
+    EXPECT_EQ(tags[1][0].type, PortSDR::STREAM_TAG_OVERFLOW);
+    EXPECT_EQ(tags[1][0].value, 500);
+    EXPECT_EQ(tags[1][0].sample_index, 1500u);
+
+    // Sample indices keep counting the dropped samples.
+    ASSERT_EQ(tags[2].size(), 1u);
+    EXPECT_EQ(tags[2][0].type, PortSDR::STREAM_TAG_FORMAT);
+    EXPECT_EQ(tags[2][0].value, PortSDR::SAMPLE_FORMAT_IQ_INT16);
+    EXPECT_EQ(tags[2][0].sample_index, 2500u);
+}
@@ -0,0 +1,76 @@
+#include <string>
+#include <thread>
+#include <gtest/gtest.h>
+
+#include "FakeStream.h"
+#include "Trace.h"
+
+static std::size_t CountOf(const std::string& json, const std::string& needle)
+{
+    std::size_t count = 0;
+    for (std::size_t pos = json.find(needle); pos != std::string::npos; pos = json.find(needle, pos + 1))
+        count++;
+    return count;
+}
+
+TEST(Trace, Disabled)
+{
+    PortSDR::SetTracing(false);
+    PortSDR::ClearTrace();
+
+    FakeStream stream;
+    stream.SetCallback([](const PortSDR::SDRTransfer&)
+    {
+    });
+    stream.Emit();
+
+    EXPECT_EQ(PortSDR::GetTraceJson(), R"({"displayTimeUnit":"ns","traceEvents":[]})");
+}
+
+#ifdef PORTSDR_TRACING
+TEST(Trace, HotPath)
+{
+    FakeStream stream;
+    stream.SetCallback([](const PortSDR::SDRTransfer&)
+    {
+        PORTSDR_TRACE_SCOPE("demod");
+    });
+
+    PortSDR::ClearTrace();
+    PortSDR::SetTracing(true);
+    for (int i = 0; i < 3; i++)
+        stream.Emit();
+    PortSDR::SetTracing(false);
+
+    const std::string json = PortSDR::GetTraceJson();
+    EXPECT_EQ(CountOf(json, R"({"name":"transfer","ph":"i")"), 3u);
+    EXPECT_EQ(CountOf(json, R"({"name":"callback","ph":"X")"), 3u);
+    EXPECT_EQ(CountOf(json, R"({"name":"demod","ph":"X")"), 3u);
+    EXPECT_EQ(CountOf(json, R"("args":{"value":4096})"), 3u);
+}
+#endif
+
+TEST(Trace, PerThread)
+{
+    PortSDR::ClearTrace();
+    PortSDR::SetTracing(true);
+
+    auto record = []
+    {
+        for (int i = 0; i < 1000; i++)
+            PortSDR::TraceInstant("tick", i);
+    };
+    std::thread first(record);
+    std::thread second(record);
+    first.join();
+    second.join();
+
+    PortSDR::SetTracing(false);
+
+    const std::string json = PortSDR::GetTraceJson();
+    EXPECT_EQ(CountOf(json, R"("name":"tick")"), 2000u);
+    EXPECT_EQ(CountOf(json, R"("args":{"value":999})"), 2u);
+
+    PortSDR::ClearTrace();
+    EXPECT_EQ(CountOf(PortSDR::GetTraceJson(), R"("name":"tick")"), 0u);
+}
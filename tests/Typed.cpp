@@ -0,0 +1,96 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <gtest/gtest.h>
+
+#include "FakeStream.h"
+
+TEST(Typed, Samples)
+{
+    FakeStream stream;
+
+    std::size_t transfers = 0;
+    ASSERT_EQ(stream.SetTypedCallback<PortSDR::SAMPLE_FORMAT_IQ_INT16>(
+                  [&](PortSDR::Span<const PortSDR::IQ<int16_t>> samples, PortSDR::SDRTransfer& transfer)
+                  {
+                      ASSERT_EQ(samples.size(), transfer.frame_size);
+                      for (std::size_t i = 0; i < samples.size(); i++)
+                      {
+                          EXPECT_EQ(samples[i].i, static_cast<int8_t>(2 * i) * 256);
+                          EXPECT_EQ(samples[i].q, static_cast<int8_t>(2 * i + 1) * 256);
+                      }
+                      transfers++;
+                  }), PortSDR::ErrorCode::OK);
+
+    stream.Emit();
+    EXPECT_EQ(transfers, 1u);
+}
+
+TEST(Typed, Bound)
+{
+    FakeStream stream;
+
+    std::size_t transfers = 0;
+    ASSERT_EQ(stream.SetTypedCallback<PortSDR::SAMPLE_FORMAT_IQ_FLOAT32>(
+                  [&](PortSDR::Span<const std::complex<float>> samples, PortSDR::SDRTransfer&)
+                  {
+                      EXPECT_FLOAT_EQ(samples[1].real(), 2 / 128.0f);
+                      transfers++;
+                  }), PortSDR::ErrorCode::OK);
+
+    EXPECT_EQ(stream.SetSampleFormat(PortSDR::SAMPLE_FORMAT_IQ_UINT8), PortSDR::ErrorCode::INVALID_ARGUMENT);
+    EXPECT_EQ(stream.SetSampleFormatAsync(PortSDR::SAMPLE_FORMAT_IQ_INT16).get(),
+              PortSDR::ErrorCode::INVALID_ARGUMENT);
+    EXPECT_EQ(stream.SetSampleFormat(PortSDR::SAMPLE_FORMAT_IQ_FLOAT32), PortSDR::ErrorCode::OK);
+
+    stream.Emit();
+    EXPECT_EQ(transfers, 1u);
+
+    // Another typed callback rebinds, an untyped one releases the format.
+    ASSERT_EQ(stream.SetTypedCallback<PortSDR::SAMPLE_FORMAT_IQ_UINT8>(
+                  [&](PortSDR::Span<const PortSDR::IQ<uint8_t>>, PortSDR::SDRTransfer&)
+                  {
+                      transfers++;
+                  }), PortSDR::ErrorCode::OK);
+    EXPECT_EQ(stream.SetSampleFormat(PortSDR::SAMPLE_FORMAT_IQ_FLOAT32), PortSDR::ErrorCode::INVALID_ARGUMENT);
+
+    stream.SetCallback({});
+    EXPECT_EQ(stream.SetSampleFormat(PortSDR::SAMPLE_FORMAT_IQ_FLOAT32), PortSDR::ErrorCode::OK);
+    stream.Emit();
+    EXPECT_EQ(transfers, 1u);
+}
+
+TEST(Typed, SwitchWhileStreaming)
+{
+    FakeStream stream;
+
+    std::atomic<bool> inside{false};
+    std::atomic<int> transfers{0};
+    stream.SetCallback([&](PortSDR::SDRTransfer&)
+    {
+        inside = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        transfers++;
+        inside = false;
+    });
+    ASSERT_EQ(stream.Start(), PortSDR::ErrorCode::OK);
+
+    while (transfers == 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    // Returns once the old callback left, it doesn't run anymore afterward.
+    std::atomic<int> typed{0};
+    ASSERT_EQ(stream.SetTypedCallback<PortSDR::SAMPLE_FORMAT_IQ_UINT8>(
+                  [&](PortSDR::Span<const PortSDR::IQ<uint8_t>>, PortSDR::SDRTransfer&)
+                  {
+                      typed++;
+                  }), PortSDR::ErrorCode::OK);
+    EXPECT_FALSE(inside);
+
+    const int old = transfers;
+    while (typed < 5)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    EXPECT_EQ(transfers, old);
+
+    ASSERT_EQ(stream.Stop(), PortSDR::ErrorCode::OK);
+}
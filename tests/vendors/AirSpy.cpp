@@ -3,6 +3,7 @@
 //
 
 #include <PortSDR.h>
+#include <atomic>
 #include <thread>
 #include <gtest/gtest.h>
 
@@ -65,3 +66,65 @@ TEST(AirSpy, Stream)
 
     ASSERT_EQ(stream->Stop(), PortSDR::ErrorCode::OK) << "Failed to stop stream";
 }
+
+TEST(AirSpy, Packing)
+{
+    PortSDR::PortSDR portSDR;
+    const std::vector<PortSDR::Device> devices = portSDR.GetHostDevices(PortSDR::HostType::AIRSPY);
+
+    ASSERT_TRUE(!devices.empty());
+
+    std::unique_ptr<PortSDR::Stream> stream;
+    ASSERT_EQ(portSDR.CreateStream(devices.front(), stream), PortSDR::ErrorCode::OK);
+
+    ASSERT_EQ(stream->SetSetting("packing", "true"), PortSDR::ErrorCode::OK) << "Failed to enable packing";
+    ASSERT_EQ(stream->GetSetting("packing"), "true");
+    ASSERT_EQ(stream->SetSetting("packing", "maybe"), PortSDR::ErrorCode::INVALID_ARGUMENT);
+    ASSERT_EQ(stream->SetSampleFormat(PortSDR::SAMPLE_FORMAT_IQ_FLOAT32), PortSDR::ErrorCode::OK);
+
+    std::atomic<std::size_t> received = 0;
+    stream->SetCallback([&received](const PortSDR::SDRTransfer& sdr)
+    {
+        EXPECT_EQ(sdr.format, PortSDR::SAMPLE_FORMAT_IQ_FLOAT32);
+        received += sdr.frame_size;
+    });
+
+    ASSERT_EQ(stream->Start(), PortSDR::ErrorCode::OK) << "Failed to start stream";
+    std::this_thread::sleep_for(std::chrono::milliseconds{200});
+
+    // Packing can't change while streaming.
+    EXPECT_EQ(stream->SetSetting("packing", "false"), PortSDR::ErrorCode::INVALID_ARGUMENT);
+    ASSERT_EQ(stream->Stop(), PortSDR::ErrorCode::OK) << "Failed to stop stream";
+
+    EXPECT_GT(received, 0u);
+    EXPECT_EQ(stream->SetSetting("packing", "false"), PortSDR::ErrorCode::OK);
+}
+
+TEST(AirSpy, LibraryDdc)
+{
+    PortSDR::PortSDR portSDR;
+    const std::vector<PortSDR::Device> devices = portSDR.GetHostDevices(PortSDR::HostType::AIRSPY);
+
+    ASSERT_TRUE(!devices.empty());
+
+    std::unique_ptr<PortSDR::Stream> stream;
+    ASSERT_EQ(portSDR.CreateStream(devices.front(), stream), PortSDR::ErrorCode::OK);
+
+    ASSERT_EQ(stream->SetSetting("library_ddc", "true"), PortSDR::ErrorCode::OK) << "Failed to enable library DDC";
+    ASSERT_EQ(stream->GetSetting("library_ddc"), "true");
+    ASSERT_EQ(stream->SetSampleFormat(PortSDR::SAMPLE_FORMAT_IQ_INT16), PortSDR::ErrorCode::OK);
+
+    std::atomic<std::size_t> received = 0;
+    stream->SetCallback([&received](const PortSDR::SDRTransfer& sdr)
+    {
+        EXPECT_EQ(sdr.format, PortSDR::SAMPLE_FORMAT_IQ_INT16);
+        received += sdr.frame_size;
+    });
+
+    ASSERT_EQ(stream->Start(), PortSDR::ErrorCode::OK) << "Failed to start stream";
+    std::this_thread::sleep_for(std::chrono::milliseconds{200});
+    ASSERT_EQ(stream->Stop(), PortSDR::ErrorCode::OK) << "Failed to stop stream";
+
+    EXPECT_GT(received, 0u);
+    EXPECT_EQ(stream->SetSetting("library_ddc", "false"), PortSDR::ErrorCode::OK);
+}
@@ -0,0 +1,295 @@
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "PortSDR.h"
+#include "RtlTcpServer.h"
+#include "../FakeStream.h"
+
+// Uses RtlTcpServer serving a FakeStream as the local rtl_tcp stand-in.
+class RtlTcp : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        ASSERT_EQ(m_server.Start("127.0.0.1", 0), PortSDR::ErrorCode::OK);
+
+        m_device.type = PortSDR::HostType::RTL_TCP;
+        m_device.serial = "127.0.0.1:" + std::to_string(m_server.GetPort());
+    }
+
+    FakeStream m_remote;
+    PortSDR::RtlTcpServer m_server{m_remote};
+    PortSDR::Device m_device;
+};
+
+template <typename T>
+static bool WaitFor(T predicate)
+{
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (!predicate())
+    {
+        if (std::chrono::steady_clock::now() > deadline)
+            return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+TEST_F(RtlTcp, Devices)
+{
+    setenv("PORTSDR_RTL_TCP", " mast1:1234, 10.0.0.2 ,", 1);
+
+    PortSDR::PortSDR portSDR;
+    const std::vector<PortSDR::Device> devices = portSDR.GetHostDevices(PortSDR::HostType::RTL_TCP);
+
+    unsetenv("PORTSDR_RTL_TCP");
+
+    ASSERT_EQ(devices.size(), 2);
+    EXPECT_EQ(devices[0].serial, "mast1:1234");
+    EXPECT_EQ(devices[1].serial, "10.0.0.2");
+}
+
+TEST_F(RtlTcp, Stream)
+{
+    PortSDR::PortSDR portSDR;
+    std::unique_ptr<PortSDR::Stream> stream;
+
+    ASSERT_EQ(portSDR.CreateStream(m_device, stream), PortSDR::ErrorCode::OK);
+
+    // FakeStream is reported as an R820T
+    const auto stages = stream->GetGainStages();
+    ASSERT_EQ(stages.size(), 1);
+    EXPECT_EQ(stages[0].range.Max(), 49.6);
+
+    std::mutex mutex;
+    std::vector<uint8_t> received;
+
+    stream->SetCallback([&](const PortSDR::SDRTransfer& transfer)
+    {
+        ASSERT_EQ(transfer.format, PortSDR::SAMPLE_FORMAT_IQ_UINT8);
+
+        const auto* data = static_cast<const uint8_t*>(transfer.data);
+        std::lock_guard lock(mutex);
+        received.insert(received.end(), data, data + transfer.frame_size * 2);
+    });
+
+    ASSERT_EQ(stream->Start(), PortSDR::ErrorCode::OK);
+    ASSERT_TRUE(WaitFor([&]
+        {
+        std::lock_guard lock(mutex);
+        return received.size() >= 256 * 1024;
+        }));
+    ASSERT_EQ(stream->Stop(), PortSDR::ErrorCode::OK);
+
+    for (std::size_t i = 1; i < received.size(); i++)
+    {
+        ASSERT_EQ(static_cast<uint8_t>(received[i - 1] + 1), received[i]) << "Discontinuity at " << i;
+    }
+}
+
+TEST_F(RtlTcp, Commands)
+{
+    PortSDR::PortSDR portSDR;
+    std::unique_ptr<PortSDR::Stream> stream;
+
+    ASSERT_EQ(portSDR.CreateStream(m_device, stream), PortSDR::ErrorCode::OK);
+
+    EXPECT_EQ(stream->SetCenterFrequency(433920000), PortSDR::ErrorCode::OK);
+    EXPECT_EQ(stream->SetSampleRate(1024000), PortSDR::ErrorCode::OK);
+    EXPECT_EQ(stream->SetGain(28.0, "LNA"), PortSDR::ErrorCode::OK);
+    EXPECT_EQ(stream->SetGain(28.0, "IF"), PortSDR::ErrorCode::INVALID_ARGUMENT);
+
+    EXPECT_TRUE(WaitFor([&] { return m_remote.GetGain("LNA") == 28; }));
+    EXPECT_EQ(m_remote.GetCenterFrequency(), 433920000);
+    EXPECT_EQ(m_remote.GetSampleRate(), 1024000);
+
+    EXPECT_EQ(stream->GetCenterFrequency(), 433920000);
+    EXPECT_EQ(stream->GetGain("LNA"), 28.0);
+}
+
+TEST_F(RtlTcp, Conversion)
+{
+    PortSDR::PortSDR portSDR;
+    std::unique_ptr<PortSDR::Stream> stream;
+
+    ASSERT_EQ(portSDR.CreateStream(m_device, stream), PortSDR::ErrorCode::OK);
+    ASSERT_EQ(stream->SetSampleFormat(PortSDR::SAMPLE_FORMAT_IQ_FLOAT32), PortSDR::ErrorCode::OK);
+
+    std::atomic<bool> checked{false};
+    stream->SetCallback([&](const PortSDR::SDRTransfer& transfer)
+    {
+        ASSERT_EQ(transfer.format, PortSDR::SAMPLE_FORMAT_IQ_FLOAT32);
+
+        const auto* data = static_cast<const float*>(transfer.data);
+        for (std::size_t i = 0; i < transfer.frame_size * 2; i++)
+        {
+            ASSERT_GE(data[i], -1.0f);
+            ASSERT_LE(data[i], 1.0f);
+        }
+        checked = true;
+    });
+
+    ASSERT_EQ(stream->Start(), PortSDR::ErrorCode::OK);
+    EXPECT_TRUE(WaitFor([&] { return checked.load(); }));
+    ASSERT_EQ(stream->Stop(), PortSDR::ErrorCode::OK);
+}
+
+TEST_F(RtlTcp, StopDropsQueued)
+{
+    PortSDR::PortSDR portSDR;
+    std::unique_ptr<PortSDR::Stream> stream;
+
+    ASSERT_EQ(portSDR.CreateStream(m_device, stream), PortSDR::ErrorCode::OK);
+
+    // Slower than the blocks arrive, so they queue up.
+    std::atomic<int> transfers{0};
+    stream->SetCallback([&](const PortSDR::SDRTransfer&)
+    {
+        transfers++;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    });
+
+    ASSERT_EQ(stream->Start(), PortSDR::ErrorCode::OK);
+    ASSERT_TRUE(WaitFor([&] { return transfers >= 10; }));
+
+    // At most the transfer in the callback finishes, the queued ones are dropped.
+    const int before = transfers;
+    ASSERT_EQ(stream->Stop(), PortSDR::ErrorCode::OK);
+    EXPECT_LE(transfers - before, 1);
+}
+
+TEST_F(RtlTcp, ControlStress)
+{
+    constexpr int threadCount = 4;
+    constexpr int commandCount = 200;
+
+    PortSDR::PortSDR portSDR;
+    std::unique_ptr<PortSDR::Stream> stream;
+
+    ASSERT_EQ(portSDR.CreateStream(m_device, stream), PortSDR::ErrorCode::OK);
+
+    // The getters must not wait on the control lock, Stop() holds it while joining this thread.
+    std::atomic<uint64_t> transfers{0};
+    stream->SetCallback([&](const PortSDR::SDRTransfer&)
+    {
+        EXPECT_EQ(stream->GetTunerType(), "R820T");
+        EXPECT_EQ(stream->GetGainStages().size(), 1u);
+        EXPECT_EQ(stream->GetUSBStrings().serial, m_device.serial);
+        if (transfers.fetch_add(1) % 16 == 0)
+            stream->SetCenterFrequencyAsync(stream->GetCenterFrequency());
+    });
+    ASSERT_EQ(stream->Start(), PortSDR::ErrorCode::OK);
+    ASSERT_TRUE(WaitFor([&] { return transfers > 0; }));
+
+    std::vector<int> last(threadCount, -1);
+    bool ordered = true;
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; t++)
+    {
+        threads.emplace_back([&, t]
+        {
+            std::vector<std::future<PortSDR::ErrorCode>> results;
+            for (int i = 0; i < commandCount; i++)
+            {
+                results.push_back(stream->Submit([&last, &ordered, t, i](PortSDR::Stream& target)
+                {
+                    ordered &= last[t] == i - 1;
+                    last[t] = i;
+                    return target.SetCenterFrequency(100000000 + t * 1000 + i);
+                }));
+                results.push_back(stream->SetGainAsync(i % 50, "LNA"));
+
+                if (i % 50 == 0)
+                    EXPECT_EQ(stream->SetSampleRate(i % 100 == 0 ? 1024000 : 2048000), PortSDR::ErrorCode::OK);
+
+                // Restarts while the others keep sending commands.
+                if (t == 0 && i % 50 == 25)
+                {
+                    EXPECT_EQ(stream->Stop(), PortSDR::ErrorCode::OK);
+                    EXPECT_EQ(stream->Start(), PortSDR::ErrorCode::OK);
+                }
+            }
+
+            for (std::future<PortSDR::ErrorCode>& result : results)
+                EXPECT_EQ(result.get(), PortSDR::ErrorCode::OK);
+        });
+    }
+
+    for (std::thread& thread : threads)
+        thread.join();
+
+    EXPECT_EQ(stream->Stop(), PortSDR::ErrorCode::OK);
+    EXPECT_TRUE(ordered);
+    for (int t = 0; t < threadCount; t++)
+        EXPECT_EQ(last[t], commandCount - 1);
+
+    // Commands reach the server in the order they were sent.
+    EXPECT_TRUE(WaitFor([&] { return m_remote.GetGain("LNA") == stream->GetGain("LNA"); }));
+}
+
+TEST_F(RtlTcp, ServerGone)
+{
+    PortSDR::PortSDR portSDR;
+    std::unique_ptr<PortSDR::Stream> stream;
+
+    ASSERT_EQ(portSDR.CreateStream(m_device, stream), PortSDR::ErrorCode::OK);
+    stream->SetCallback([](const PortSDR::SDRTransfer&)
+    {
+    });
+
+    ASSERT_EQ(stream->Start(), PortSDR::ErrorCode::OK);
+    m_server.Stop();
+
+    // The stream goes quiet but must still stop cleanly.
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(stream->Stop(), PortSDR::ErrorCode::OK);
+
+    // The connection is gone, only recovery connects again.
+    EXPECT_EQ(stream->Start(), PortSDR::ErrorCode::NETWORK_ERROR);
+}
+
+TEST_F(RtlTcp, Reconnects)
+{
+    PortSDR::PortSDR portSDR;
+    std::unique_ptr<PortSDR::Stream> stream;
+
+    ASSERT_EQ(portSDR.CreateStream(m_device, stream), PortSDR::ErrorCode::OK);
+    ASSERT_EQ(stream->SetCenterFrequency(433920000), PortSDR::ErrorCode::OK);
+
+    std::atomic<int> transfers{0};
+    std::atomic<bool> discontinuity{false};
+    stream->SetCallback([&](const PortSDR::SDRTransfer& transfer)
+    {
+        transfers++;
+        if (transfer.discontinuity)
+            discontinuity = true;
+    });
+
+    PortSDR::RecoveryConfig config;
+    config.retry_interval = std::chrono::milliseconds(10);
+    ASSERT_EQ(stream->SetRecovery(config), PortSDR::ErrorCode::OK);
+
+    ASSERT_EQ(stream->Start(), PortSDR::ErrorCode::OK);
+    ASSERT_TRUE(WaitFor([&] { return transfers > 0; }));
+
+    // The disconnect is reported right away instead of waiting for the stall timeout.
+    const uint16_t port = m_server.GetPort();
+    m_server.Stop();
+    m_remote.SetCenterFrequency(0);
+    ASSERT_EQ(m_server.Start("127.0.0.1", port), PortSDR::ErrorCode::OK);
+
+    EXPECT_TRUE(WaitFor([&] { return discontinuity.load(); }));
+    EXPECT_EQ(stream->GetRecoveryStats().recoveries, 1);
+
+    // Settings are applied to the new connection.
+    EXPECT_TRUE(WaitFor([&] { return m_remote.GetCenterFrequency() == 433920000; }));
+
+    EXPECT_EQ(stream->Stop(), PortSDR::ErrorCode::OK);
+}